@@ -46,3 +46,10 @@ void Rm_client::unmap(addr_t core_local_base, addr_t virt_base, size_t size)
 		l4_fpage_unmap(l4_fpage(addr, L4_LOG2_PAGESIZE, 0, 0),
 		               L4_FP_FLUSH_PAGE);
 }
+
+
+bool Rm_client::decode_fault(unsigned * const, Rm_session::State &) {
+	return 0; }
+
+
+void Rm_client::apply_decoded_fault(Rm_session::State const &, unsigned const) { }
@@ -0,0 +1,24 @@
+/*
+ * \brief   Pager parts that are specific to ARM V6
+ * \author  Martin Stein
+ * \date    2013-01-24
+ */
+
+/*
+ * Copyright (C) 2013 Genode Labs GmbH
+ *
+ * This file is part of the Genode OS framework, which is distributed
+ * under the terms of the GNU General Public License version 2.
+ */
+
+/* core includes */
+#include <rm_session_component.h>
+
+using namespace Genode;
+
+
+bool Rm_client::decode_fault(unsigned * const, Rm_session::State &) {
+	return 0; }
+
+
+void Rm_client::apply_decoded_fault(Rm_session::State const &, unsigned const) { }
@@ -12,18 +12,62 @@
  */
 
 /* Genode includes */
-#include <base/pager.h>
+#include <base/instruction.h>
+#include <base/thread_state.h>
 
-namespace Genode
+/* core includes */
+#include <rm_session_component.h>
+#include <platform_thread.h>
+#include <assert.h>
+
+using namespace Genode;
+
+
+/**
+ * Mask 'value' according to access format 'f'
+ */
+static unsigned access_value(Rm_session::Access_format const f,
+                             unsigned const value)
 {
-	bool instruction_writes_word(unsigned * const code,
-	                             unsigned & value,
-	                             unsigned const thread_id)
-	{ return 0; }
+	switch (f) {
+	case Rm_session::LSB8:  return value & 0xff;
+	case Rm_session::LSB16: return value & 0xffff;
+	default:                return value;
+	}
 }
 
 
-void Genode::Pager_object::instruction_processed(unsigned * const code,
-                                                 unsigned const read)
-{ }
+bool Rm_client::decode_fault(unsigned * const instr, Rm_session::State &state)
+{
+	/* decode the instruction */
+	bool writes;
+	unsigned reg;
+	if (!Instruction::load_store(*instr, writes, state.format, reg))
+		return 0;
+	state.type = writes ? Rm_session::WRITE_FAULT : Rm_session::READ_FAULT;
+	_fault_reg = reg;
+	if (!writes) return 1;
+
+	/* fetch the value to be stored directly from the kernel */
+	Platform_thread * const pt = Kernel::get_thread(badge());
+	assert(pt);
+	Thread_state const ts = pt->state();
+	unsigned value;
+	if (!ts.get_gpr(reg, value)) return 0;
+	state.value = access_value(state.format, value);
+	return 1;
+}
+
 
+void Rm_client::apply_decoded_fault(Rm_session::State const &fault,
+                                    unsigned const read)
+{
+	/* write back the result of a load and skip the instruction */
+	Platform_thread * const pt = Kernel::get_thread(badge());
+	assert(pt);
+	Thread_state ts = pt->state();
+	if (fault.type == Rm_session::READ_FAULT)
+		assert(ts.set_gpr(_fault_reg, access_value(fault.format, read)));
+	ts.ip += Instruction::size();
+	pt->state(ts);
+}
@@ -13,6 +13,7 @@ INC_DIR += $(REP_DIR)/src/core/imx31
 # add C++ sources
 SRC_CC += platform_services.cc \
           platform_support.cc \
+          pager_support.cc \
           syscall.cc
 
 # add assembly sources
@@ -21,6 +22,7 @@ SRC_S += mode_transition.s \
          crt0.s
 
 # declare source paths
+vpath pager_support.cc     $(REP_DIR)/src/core/arm_v6
 vpath platform_services.cc $(BASE_DIR)/src/core
 vpath platform_support.cc  $(REP_DIR)/src/core/imx31
 vpath mode_transition.s    $(REP_DIR)/src/core/arm_v6
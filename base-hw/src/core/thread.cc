@@ -5,7 +5,7 @@
  */
 
 /*
- * Copyright (C) 2012 Genode Labs GmbH
+ * Copyright (C) 2012-2013 Genode Labs GmbH
  *
  * This file is part of the Genode OS framework, which is distributed
  * under the terms of the GNU General Public License version 2.
@@ -68,6 +68,8 @@ Thread_base::Thread_base(const char *name, size_t stack_size)
 
 Thread_base::~Thread_base()
 {
+	_deinit_generic_thread();
+
 	kernel_log() << __PRETTY_FUNCTION__ << ": Not implemented\n";
 	while (1) ;
 }
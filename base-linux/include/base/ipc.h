@@ -5,7 +5,7 @@
  */
 
 /*
- * Copyright (C) 2012 Genode Labs GmbH
+ * Copyright (C) 2012-2013 Genode Labs GmbH
  *
  * This file is part of the Genode OS framework, which is distributed
  * under the terms of the GNU General Public License version 2.
@@ -17,6 +17,23 @@
 #include <base/ipc_generic.h>
 
 
+namespace Genode {
+
+	/**
+	 * Enable or disable the shared-memory fast path for calls of this process
+	 *
+	 * The fast path is disabled by default. A parent enables it for a child
+	 * via the 'ipc_fast_path' PD-session argument, for example by the
+	 * 'ipc_fast_path="yes"' attribute of the '<start>' node of init. It is
+	 * taken by calls that transfer no capabilities and whose messages fit
+	 * into the message page of the connection. All other calls use the
+	 * socket path. A process with disabled fast path also refuses the
+	 * message pages of its clients.
+	 */
+	void ipc_fast_path(bool enabled);
+}
+
+
 inline void Genode::Ipc_ostream::_marshal_capability(Genode::Native_capability const &cap)
 {
 	_write_to_buf(cap.local_name());
@@ -5,7 +5,7 @@
  */
 
 /*
- * Copyright (C) 2007-2012 Genode Labs GmbH
+ * Copyright (C) 2007-2013 Genode Labs GmbH
  *
  * This file is part of the Genode OS framework, which is distributed
  * under the terms of the GNU General Public License version 2.
@@ -31,9 +31,9 @@ namespace Genode {
 	/**
 	 * Native lock type
 	 *
-	 * We are using a sleeping spinlock as lock implementation on Linux. This
-	 * is a temporary solution until we have implemented futex-based locking.
-	 * In a previous version, we have relied on POSIX semaphores as provided by
+	 * The lock implementation blocks contended threads on futexes, see
+	 * 'Native_thread_id'. In a previous version, we have relied on POSIX
+	 * semaphores as provided by
 	 * the glibc. However, relying on the glibc badly interferes with a custom
 	 * libc implementation. The glibc semaphore implementation expects to find
 	 * a valid pthread structure via the TLS pointer. We do not have such a
@@ -46,8 +46,10 @@ namespace Genode {
 	/**
 	 * Thread ID used in lock implementation
 	 *
-	 * Unfortunately, both - PID and TID - are needed for lx_tgkill() in
-	 * thread_check_stopped_and_restart().
+	 * A thread that blocks for a lock sleeps on its own futex word until
+	 * the former lock owner writes the ticket of the blocking attempt to
+	 * it. Each lock attempt uses a new ticket, so late wakeups that
+	 * belong to an earlier attempt do no harm.
 	 */
 	struct Native_thread_id
 	{
@@ -55,9 +57,13 @@ namespace Genode {
 		                      'clone' system call */
 		unsigned int pid;  /* process ID (resp. thread-group ID) */
 
-		Native_thread_id() : tid(0), pid(0) { }
-		Native_thread_id(unsigned int tid, unsigned int pid)
-		: tid(tid), pid(pid) { }
+		volatile int *futex;  /* futex word of the thread */
+		int           ticket; /* value that ends the blocking */
+
+		Native_thread_id() : tid(0), pid(0), futex(0), ticket(0) { }
+		Native_thread_id(unsigned int tid, unsigned int pid,
+		                 volatile int *futex = 0, int ticket = 0)
+		: tid(tid), pid(pid), futex(futex), ticket(ticket) { }
 	};
 
 	struct Thread_meta_data;
@@ -86,7 +92,14 @@ namespace Genode {
 		 */
 		Thread_meta_data *meta_data;
 
-		Native_thread() : is_ipc_server(false), meta_data(0) { }
+		/**
+		 * Futex word and last ticket of the thread, see 'Native_thread_id'
+		 */
+		volatile int lock_futex;
+		int          lock_ticket;
+
+		Native_thread()
+		: is_ipc_server(false), meta_data(0), lock_futex(0), lock_ticket(0) { }
 	};
 
 	inline bool operator == (Native_thread_id t1, Native_thread_id t2) {
@@ -163,21 +176,25 @@ namespace Genode {
 
 			unsigned _uid;
 			unsigned _gid;
+			bool     _ipc_fast_path;
 
 		public:
 
-			Native_pd_args() : _uid(0), _gid(0) { _root[0] = 0; }
+			Native_pd_args() : _uid(0), _gid(0), _ipc_fast_path(false) {
+				_root[0] = 0; }
 
-			Native_pd_args(char const *root, unsigned uid, unsigned gid)
+			Native_pd_args(char const *root, unsigned uid, unsigned gid,
+			               bool ipc_fast_path = false)
 			:
-				_uid(uid), _gid(gid)
+				_uid(uid), _gid(gid), _ipc_fast_path(ipc_fast_path)
 			{
 				Genode::strncpy(_root, root, sizeof(_root));
 			}
 
-			char const *root() const { return _root; }
-			unsigned    uid()  const { return _uid;  }
-			unsigned    gid()  const { return _gid;  }
+			char const *root()          const { return _root; }
+			unsigned    uid()           const { return _uid;  }
+			unsigned    gid()           const { return _gid;  }
+			bool        ipc_fast_path() const { return _ipc_fast_path; }
 	};
 }
 
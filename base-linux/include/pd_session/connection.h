@@ -12,7 +12,7 @@
  */
 
 /*
- * Copyright (C) 2012 Genode Labs GmbH
+ * Copyright (C) 2012-2013 Genode Labs GmbH
  *
  * This file is part of the Genode OS framework, which is distributed
  * under the terms of the GNU General Public License version 2.
@@ -77,6 +77,19 @@ namespace Genode {
 				}
 			};
 
+			/**
+			 * Convert IPC fast-path argument to session-construction parameter
+			 */
+			struct Ipc_fast_path_arg : Arg<64>
+			{
+				Ipc_fast_path_arg(Native_pd_args const *args)
+				{
+					if (args && args->ipc_fast_path())
+						Genode::snprintf(string, sizeof(string),
+						                 ", ipc_fast_path=yes");
+				}
+			};
+
 		public:
 
 			/**
@@ -88,10 +101,11 @@ namespace Genode {
 			Pd_connection(char const *label = "", Native_pd_args const *pd_args = 0)
 			:
 				Connection<Pd_session>(
-					session("ram_quota=4K, label=\"%s\"%s%s%s", label,
+					session("ram_quota=4K, label=\"%s\"%s%s%s%s", label,
 					        Root_arg(pd_args).string,
 					        Uid_arg(pd_args).string,
-					        Gid_arg(pd_args).string)),
+					        Gid_arg(pd_args).string,
+					        Ipc_fast_path_arg(pd_args).string)),
 				Pd_session_client(cap())
 			{ }
 	};
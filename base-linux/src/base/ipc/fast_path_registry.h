@@ -0,0 +1,404 @@
+/*
+ * \brief  Linux-specific registries of the shared-memory IPC fast path
+ * \author Martin Stein
+ * \date   2013-02-07
+ *
+ * A client thread and a server entrypoint share one message page per
+ * connection. The client sets the page up when it first calls the
+ * entrypoint. Afterwards, requests and replies that transfer no
+ * capabilities are copied through the page instead of through the kernel.
+ * The server still gets woken by a datagram at its entrypoint socket
+ * because it must keep one blocking point for both paths. This datagram,
+ * however, carries nothing but the slot of the page at the server. The
+ * client waits for the reply on a futex within the page.
+ *
+ * The fast path is used only by processes that opt in, see 'ipc_fast_path'.
+ * The page is a RAM dataspace of the client and thereby charged to the
+ * quota of the client. The bookkeeping of both registries grows on demand
+ * and is allocated from 'ipc_fast_heap()', which is bounded and leaves a
+ * reserve of the RAM quota untouched.
+ */
+
+/*
+ * Copyright (C) 2013 Genode Labs GmbH
+ *
+ * This file is part of the Genode OS framework, which is distributed
+ * under the terms of the GNU General Public License version 2.
+ */
+
+#ifndef _BASE__IPC__FAST_PATH_REGISTRY_H_
+#define _BASE__IPC__FAST_PATH_REGISTRY_H_
+
+/* Genode includes */
+#include <base/lock.h>
+#include <base/allocator.h>
+#include <util/list.h>
+#include <util/string.h>
+#include <ram_session/ram_session.h>
+
+/* Linux includes */
+#include <linux_syscalls.h>
+
+
+namespace Genode
+{
+	struct Ipc_fast_page;
+	struct Ipc_fast_channel;
+
+	class Ipc_fast_channel_registry;
+	class Ipc_fast_slot_registry;
+
+	typedef Ipc_fast_channel_registry Ipc_fast_channels;
+	typedef Ipc_fast_slot_registry    Ipc_fast_slots;
+
+	/**
+	 * Return heap for the bookkeeping of the fast path
+	 */
+	Allocator *ipc_fast_heap();
+
+	/**
+	 * Return singleton instance of registry for client-side channels
+	 */
+	Ipc_fast_channels *ipc_fast_channels();
+
+	/**
+	 * Return singleton instance of registry for server-side message pages
+	 */
+	Ipc_fast_slots *ipc_fast_slots();
+}
+
+
+/**
+ * Message page shared by one client thread and one server entrypoint
+ */
+struct Genode::Ipc_fast_page
+{
+	enum {
+		SIZE = 8*1024,
+
+		/* values of 'state', which also serves as futex of the client */
+		IDLE            = 0, /* client may write a request */
+		REQUEST         = 1, /* request in 'buf' awaits the server */
+		REPLY           = 2, /* reply in 'buf' awaits the client */
+		REPLY_ON_SOCKET = 3, /* reply awaits the client at the reply socket */
+		CLOSED          = 4, /* client abandoned the page */
+	};
+
+	volatile int state;
+	int          server_pid; /* written by the server at setup */
+	int          server_tid;
+	int          len;        /* length of the message in 'buf' */
+	long         align;
+
+	char buf[SIZE - 4*sizeof(int) - sizeof(long)];
+
+	static size_t max_msg_len() { return sizeof(((Ipc_fast_page *)0)->buf); }
+};
+
+
+/**
+ * Client-side end of a fast-path connection
+ */
+struct Genode::Ipc_fast_channel : List<Ipc_fast_channel>::Element
+{
+	enum { SLOT_NONE = -1 /* server refused, calls take the socket path */ };
+
+	int const                tid;       /* owning client thread */
+	int const                server_id; /* thread ID of the server entrypoint */
+	int                      slot;      /* slot of the page at the server */
+	int                      reply_sd;  /* local end of the reply socket */
+	Ipc_fast_page           *page;
+	Ram_dataspace_capability ds;
+
+	Ipc_fast_channel(int tid, int server_id)
+	: tid(tid), server_id(server_id), slot(SLOT_NONE), reply_sd(-1), page(0) { }
+
+	/**
+	 * Wether the owning thread is gone
+	 */
+	bool orphaned() const { return lx_tgkill(lx_getpid(), tid, 0) < 0; }
+};
+
+
+/**
+ * Registry of the fast-path channels of all threads of a process
+ *
+ * A channel gets looked up, inserted, and removed under the lock of the
+ * registry. In between, it is accessed by its owning thread only.
+ *
+ * Setting up a channel and allocating bookkeeping may involve calls
+ * themselves, for instance to the RAM session. Such nested calls must not
+ * set up channels on their part, so the thread holds a 'Bypass' meanwhile.
+ *
+ * Each channel costs a page of the RAM quota, so a thread sets up channels
+ * to at most 'MAX_CHANNELS_PER_THREAD' entrypoints. Calls to further
+ * entrypoints take the socket path.
+ */
+class Genode::Ipc_fast_channel_registry
+{
+	public:
+
+		enum { MAX_CHANNELS_PER_THREAD = 8 };
+
+		/**
+		 * Let all calls of the constructing thread take the socket path
+		 */
+		class Bypass : public List<Bypass>::Element
+		{
+			private:
+
+				Ipc_fast_channel_registry &_registry;
+				int const                  _tid;
+
+			public:
+
+				Bypass(Ipc_fast_channel_registry &registry, int tid)
+				: _registry(registry), _tid(tid)
+				{
+					Lock::Guard guard(_registry._lock);
+					_registry._bypasses.insert(this);
+				}
+
+				~Bypass()
+				{
+					Lock::Guard guard(_registry._lock);
+					_registry._bypasses.remove(this);
+				}
+
+				int tid() const { return _tid; }
+		};
+
+	private:
+
+		List<Ipc_fast_channel> _channels;
+		List<Bypass>           _bypasses;
+		Lock                   _lock;
+		bool                   _enabled;
+
+		bool _bypassed(int const tid) const
+		{
+			for (Bypass *b = _bypasses.first(); b; b = b->next())
+				if (b->tid() == tid) return true;
+			return false;
+		}
+
+	public:
+
+		Ipc_fast_channel_registry(bool const enabled) : _enabled(enabled) { }
+
+		void enabled(bool const enabled) { _enabled = enabled; }
+		bool enabled() const             { return _enabled; }
+
+		/**
+		 * Look up the channel of thread 'tid' to entrypoint 'server_id'
+		 *
+		 * \param setup  gets true if there is no channel yet and the
+		 *               caller may set one up, false if the thread has
+		 *               no channel left
+		 *
+		 * \return  channel or 0
+		 */
+		Ipc_fast_channel *channel(int const tid, int const server_id,
+		                          bool &setup)
+		{
+			setup = false;
+			if (!_enabled) return 0;
+
+			Lock::Guard guard(_lock);
+			if (_bypassed(tid)) return 0;
+
+			unsigned num = 0;
+			for (Ipc_fast_channel *c = _channels.first(); c; c = c->next()) {
+				if (c->tid != tid) continue;
+				if (c->server_id == server_id) return c;
+				num++;
+			}
+
+			setup = num < MAX_CHANNELS_PER_THREAD;
+			return 0;
+		}
+
+		void insert(Ipc_fast_channel * const c)
+		{
+			Lock::Guard guard(_lock);
+			_channels.insert(c);
+		}
+
+		/**
+		 * Remove channel 'c', its resources must be closed by the caller
+		 */
+		void remove(Ipc_fast_channel * const c)
+		{
+			Lock::Guard guard(_lock);
+			_channels.remove(c);
+		}
+
+		/**
+		 * Remove one channel of a vanished thread
+		 *
+		 * \return  removed channel that must be closed by the caller, or 0
+		 */
+		Ipc_fast_channel *remove_orphan()
+		{
+			Lock::Guard guard(_lock);
+			for (Ipc_fast_channel *c = _channels.first(); c; c = c->next())
+				if (c->orphaned()) {
+					_channels.remove(c);
+					return c;
+				}
+			return 0;
+		}
+};
+
+
+/**
+ * Registry of the message pages of all entrypoints of a process
+ *
+ * The slot table grows on demand, slot indices stay valid until the slot
+ * is freed. Slots get allocated and freed by the entrypoint that owns them
+ * only.
+ */
+class Genode::Ipc_fast_slot_registry
+{
+	private:
+
+		struct Slot
+		{
+			Ipc_fast_page *page;
+			int            server_sd;  /* socket of the owning entrypoint */
+			int            reply_sd;   /* remote end of the reply socket */
+			int            client_pid; /* peer of the reply socket */
+
+			Slot() : page(0), server_sd(-1), reply_sd(-1), client_pid(-1) { }
+
+			bool is_free() const { return !page; }
+
+			/**
+			 * Wether the client abandoned the page or is gone
+			 *
+			 * The client process is known from the credentials of the
+			 * reply socket. Threads that vanish without closing their
+			 * pages are reclaimed by the client process itself.
+			 */
+			bool dead() const
+			{
+				return page->state == Ipc_fast_page::CLOSED ||
+				       lx_tgkill(client_pid, client_pid, 0) < 0;
+			}
+		};
+
+		Slot        *_slots;
+		unsigned     _num_slots;
+		Lock mutable _lock;
+
+		void _free(Slot &s)
+		{
+			lx_munmap(s.page, Ipc_fast_page::SIZE);
+			lx_close(s.reply_sd);
+			s = Slot();
+		}
+
+		/**
+		 * Double the size of the slot table
+		 */
+		bool _grow()
+		{
+			unsigned const num = _num_slots ? 2*_num_slots : 16;
+
+			Slot *slots = 0;
+			if (!ipc_fast_heap()->alloc(num*sizeof(Slot), &slots))
+				return false;
+
+			for (unsigned i = 0; i < num; i++)
+				slots[i] = i < _num_slots ? _slots[i] : Slot();
+
+			if (_slots)
+				ipc_fast_heap()->free(_slots, _num_slots*sizeof(Slot));
+
+			_slots     = slots;
+			_num_slots = num;
+			return true;
+		}
+
+		Slot *_lookup(int const i, int const server_sd) const
+		{
+			if (i < 0 || i >= (int)_num_slots) return 0;
+			Slot * const s = &_slots[i];
+			return !s->is_free() && s->server_sd == server_sd ? s : 0;
+		}
+
+	public:
+
+		Ipc_fast_slot_registry() : _slots(0), _num_slots(0) { }
+
+		/**
+		 * Allocate a slot for a page of the entrypoint at 'server_sd'
+		 *
+		 * \param client_pid  process ID of the peer of 'reply_sd'
+		 *
+		 * \return  slot index or -1 if there is no memory left
+		 *
+		 * Slots of the entrypoint whose client is gone get freed first.
+		 */
+		int alloc(Ipc_fast_page * const page, int const server_sd,
+		          int const reply_sd, int const client_pid)
+		{
+			Lock::Guard guard(_lock);
+			int unused = -1;
+			for (unsigned i = 0; i < _num_slots; i++) {
+				Slot &s = _slots[i];
+				if (!s.is_free() && s.server_sd == server_sd && s.dead())
+					_free(s);
+				if (unused < 0 && s.is_free()) unused = i;
+			}
+			if (unused < 0) {
+				unused = _num_slots;
+				if (!_grow()) return -1;
+			}
+			_slots[unused].page       = page;
+			_slots[unused].server_sd  = server_sd;
+			_slots[unused].reply_sd   = reply_sd;
+			_slots[unused].client_pid = client_pid;
+			return unused;
+		}
+
+		/**
+		 * Page of slot 'i' if it belongs to the entrypoint at 'server_sd'
+		 */
+		Ipc_fast_page *page(int const i, int const server_sd) const
+		{
+			Lock::Guard guard(_lock);
+			Slot const * const s = _lookup(i, server_sd);
+			return s ? s->page : 0;
+		}
+
+		/**
+		 * Remote end of the reply socket of slot 'i', or -1
+		 */
+		int reply_sd(int const i, int const server_sd) const
+		{
+			Lock::Guard guard(_lock);
+			Slot const * const s = _lookup(i, server_sd);
+			return s ? s->reply_sd : -1;
+		}
+
+		void free(int const i, int const server_sd)
+		{
+			Lock::Guard guard(_lock);
+			Slot * const s = _lookup(i, server_sd);
+			if (s) _free(*s);
+		}
+
+		/**
+		 * Free all slots of the entrypoint at 'server_sd'
+		 */
+		void free_all(int const server_sd)
+		{
+			Lock::Guard guard(_lock);
+			for (unsigned i = 0; i < _num_slots; i++)
+				if (!_slots[i].is_free() && _slots[i].server_sd == server_sd)
+					_free(_slots[i]);
+		}
+};
+
+#endif /* _BASE__IPC__FAST_PATH_REGISTRY_H_ */
@@ -18,10 +18,14 @@
  *
  * All fields are naturally aligned, i.e., aligend on 4 or 8 byte boundaries on
  * 32-bit resp. 64-bit systems.
+ *
+ * Calls that transfer no capabilities may take a shared-memory fast path
+ * instead (see 'fast_path_registry.h'). Its datagrams consist of a single
+ * 'int' and are thereby shorter than any request of the socket path.
  */
 
 /*
- * Copyright (C) 2011-2012 Genode Labs GmbH
+ * Copyright (C) 2011-2013 Genode Labs GmbH
  *
  * This file is part of the Genode OS framework, which is distributed
  * under the terms of the GNU General Public License version 2.
@@ -32,15 +36,21 @@
 #include <base/thread.h>
 #include <base/blocking.h>
 #include <base/env.h>
+#include <base/heap.h>
+#include <cpu/atomic.h>
+#include <util/arg_string.h>
 #include <linux_cpu_session/linux_cpu_session.h>
+#include <linux_dataspace/client.h>
 
 /* local includes */
 #include <socket_descriptor_registry.h>
+#include <fast_path_registry.h>
 
 /* Linux includes */
 #include <linux_syscalls.h>
 #include <sys/un.h>
 #include <sys/socket.h>
+#include <sys/mman.h>
 
 
 using namespace Genode;
@@ -83,10 +93,7 @@ Genode::Ep_socket_descriptor_registry *Genode::ep_sd_registry()
  ** Communication over Unix-domain sockets **
  ********************************************/
 
-enum {
-	LX_EINTR        = 4,
-	LX_ECONNREFUSED = 111
-};
+enum { LX_ECONNREFUSED = 111 };
 
 
 /**
@@ -344,34 +351,568 @@ static inline void lx_call(int dst_sd,
 }
 
 
+/**********************************************
+ ** Shared-memory fast path for simple calls **
+ **********************************************/
+
+enum {
+	FAST_SETUP         = -1,       /* datagram value that hands over a new page */
+	FAST_NONE          = -1,       /* 'local_name' of socket-path reply caps */
+	FAST_ALIVE_S       = 1,        /* interval of checking wether the server is alive */
+	FAST_QUOTA_RESERVE = 64*1024,  /* RAM quota that pages must leave over */
+	FAST_HEAP_LIMIT    = 256*1024, /* bookkeeping of the fast path */
+};
+
+
 /**
- * for request from client
+ * Heap for the bookkeeping of the fast path
  *
- * \return  socket descriptor of reply capability
+ * The heap is separate from 'env()->heap()' because a thread that allocates
+ * from 'env()->heap()' may call the RAM session and thereby set up a
+ * channel. Like the pages, the bookkeeping never takes the last
+ * 'FAST_QUOTA_RESERVE' bytes of the RAM quota. The caller must hold a
+ * 'Bypass' of the channel registry.
  */
-static inline int lx_wait(Genode::Native_connection_state &cs,
-                          Genode::Msgbuf_base &recv_msgbuf)
+class Ipc_fast_heap : public Genode::Allocator
 {
-	Message msg(recv_msgbuf.buf, recv_msgbuf.size());
+	private:
 
-	msg.accept_sockets(Message::MAX_SDS_PER_MSG);
+		Genode::Heap _heap;
 
-	int ret = lx_recvmsg(cs.server_sd, msg.msg(), 0);
+	public:
 
-	/* system call got interrupted by a signal */
+		Ipc_fast_heap()
+		: _heap(env()->ram_session(), env()->rm_session(), FAST_HEAP_LIMIT) { }
+
+		bool alloc(Genode::size_t size, void **out_addr)
+		{
+			if (env()->ram_session()->avail() < size + FAST_QUOTA_RESERVE)
+				return false;
+
+			return _heap.alloc(size, out_addr);
+		}
+
+		void free(void *addr, Genode::size_t size) { _heap.free(addr, size); }
+
+		Genode::size_t consumed() { return _heap.consumed(); }
+
+		Genode::size_t overhead(Genode::size_t size) {
+			return _heap.overhead(size); }
+
+		bool need_size_for_free() const { return _heap.need_size_for_free(); }
+};
+
+
+Genode::Allocator *Genode::ipc_fast_heap()
+{
+	static Ipc_fast_heap heap;
+	return &heap;
+}
+
+
+/**
+ * List of Unix environment variables, initialized by the startup code
+ */
+extern char **lx_environ;
+
+
+/**
+ * Return wether the fast path is configured for this process
+ *
+ * The parent opts in via the 'ipc_fast_path' PD-session argument, which
+ * core hands over as environment variable.
+ */
+static bool fast_path_configured()
+{
+	for (char **curr = lx_environ; curr && *curr; curr++) {
+
+		Arg arg = Arg_string::find_arg(*curr, "ipc_fast_path");
+		if (arg.valid())
+			return arg.bool_value(false);
+	}
+	return false;
+}
+
+
+Genode::Ipc_fast_channels *Genode::ipc_fast_channels()
+{
+	static Genode::Ipc_fast_channels registry(fast_path_configured());
+	return &registry;
+}
+
+
+Genode::Ipc_fast_slots *Genode::ipc_fast_slots()
+{
+	static Genode::Ipc_fast_slots registry;
+	return &registry;
+}
+
+
+void Genode::ipc_fast_path(bool const enabled) {
+	ipc_fast_channels()->enabled(enabled); }
+
+
+/**
+ * Utility: Return Linux thread ID of the calling thread
+ */
+static int my_tid()
+{
+	Thread_base * const myself = Thread_base::myself();
+	int const tid = myself ? myself->tid().tid : 0;
+	return tid ? tid : lx_gettid();
+}
+
+
+/**
+ * Utility: Return thread ID of the entrypoint that socket 'sd' points to
+ *
+ * Other than the socket descriptor, which may get closed and reused for
+ * another entrypoint, the thread ID identifies the entrypoint for good.
+ *
+ * \return  thread ID or -1 if the entrypoint is unknown
+ */
+static int fast_server_id(int const sd)
+{
+	int const id = ep_sd_registry()->lookup_global_id(sd);
+	if (id >= 0)
+		return id;
+
+	try { return lookup_tid_by_client_socket(sd); }
+	catch (...) { return -1; }
+}
+
+
+/**
+ * Utility: Map message page that is backed by file 'fd'
+ *
+ * \return  page or 0 on failure
+ */
+static Ipc_fast_page *map_fast_page(int const fd)
+{
+	void * const addr = lx_mmap(0, Ipc_fast_page::SIZE, PROT_READ | PROT_WRITE,
+	                            MAP_SHARED, fd, 0);
+	if (((long)addr < 0) && ((long)addr > -4095))
+		return 0;
+	return (Ipc_fast_page *)addr;
+}
+
+
+/**
+ * Close the resources of client-side channel 'c'
+ *
+ * The calling thread must hold a 'Bypass' of the channel registry.
+ */
+static void fast_close(Ipc_fast_channel &c)
+{
+	if (c.page) {
+		c.page->state = Ipc_fast_page::CLOSED;
+		lx_munmap(c.page, Ipc_fast_page::SIZE);
+	}
+	if (c.reply_sd >= 0)
+		lx_close(c.reply_sd);
+	if (c.ds.valid())
+		env()->ram_session()->free(c.ds);
+
+	c.page     = 0;
+	c.reply_sd = -1;
+	c.ds       = Ram_dataspace_capability();
+	c.slot     = Ipc_fast_channel::SLOT_NONE;
+}
+
+
+/**
+ * Close and destruct client-side channel 'c' that is not registered
+ */
+static void fast_destroy(Ipc_fast_channel * const c)
+{
+	fast_close(*c);
+	destroy(ipc_fast_heap(), c);
+}
+
+
+/**
+ * Remove, close, and destruct client-side channel 'c'
+ */
+static void fast_drop(Ipc_fast_channel * const c)
+{
+	Ipc_fast_channels::Bypass bypass(*ipc_fast_channels(), c->tid);
+	ipc_fast_channels()->remove(c);
+	fast_destroy(c);
+}
+
+
+/**
+ * Hand a new message page of channel 'c' over to the server at 'dst_sd'
+ *
+ * \return  slot of the page at the server, or -1 if the setup failed
+ *
+ * The page is a RAM dataspace of the calling process, so it is charged to
+ * the quota of the process. Pages never take the last 'FAST_QUOTA_RESERVE'
+ * bytes of the quota because the process needs them for its sessions.
+ */
+static int fast_setup(Ipc_fast_channel &c, int const dst_sd)
+{
+	if (env()->ram_session()->avail() < Ipc_fast_page::SIZE + FAST_QUOTA_RESERVE)
+		return -1;
+
+	/* allocate the page, the caller closes all resources on failure */
+	try { c.ds = env()->ram_session()->alloc(Ipc_fast_page::SIZE); }
+	catch (...) { return -1; }
+
+	int const fd = Linux_dataspace_client(c.ds).fd().dst().socket;
+	if (fd < 0)
+		return -1;
+
+	c.page = map_fast_page(fd);
+	int sd[2] = { -1, -1 };
+	if (c.page && lx_socketpair(AF_UNIX, SOCK_DGRAM | SOCK_CLOEXEC, 0, sd) == 0) {
+
+		c.page->state = Ipc_fast_page::IDLE;
+		c.reply_sd    = sd[0];
+
+		/* the server gets the page and the remote end of the reply socket */
+		int setup = FAST_SETUP;
+		Message msg(&setup, sizeof(setup));
+		msg.marshal_socket(fd);
+		msg.marshal_socket(sd[1]);
+		if (lx_sendmsg(dst_sd, msg.msg(), 0) < 0)
+			c.reply_sd = -1;
+		lx_close(sd[1]);
+	}
+	lx_close(fd);
+	if (c.reply_sd < 0) {
+		if (sd[0] >= 0) lx_close(sd[0]);
+		return -1;
+	}
+
+	/* the server answers with the slot of the page */
+	int slot = -1;
+	Message answer(&slot, sizeof(slot));
+	int const ret = lx_recvmsg(c.reply_sd, answer.msg(), 0);
 	if (ret == -LX_EINTR)
 		throw Genode::Blocking_canceled();
 
+	/* the page must have reached the entrypoint we meant */
+	if (ret != sizeof(slot) || c.page->server_tid != c.server_id)
+		return -1;
+
+	return slot;
+}
+
+
+/**
+ * Set up a channel of the calling thread to the entrypoint at 'dst_sd'
+ *
+ * \return  new channel or 0
+ *
+ * If the server refuses, the channel is still registered, so we don't
+ * retry with each call.
+ */
+static Ipc_fast_channel *fast_open(int const tid, int const server_id,
+                                   int const dst_sd)
+{
+	Ipc_fast_channels * const channels = ipc_fast_channels();
+	Ipc_fast_channels::Bypass bypass(*channels, tid);
+
+	/* reclaim the channels of vanished threads */
+	while (Ipc_fast_channel * const orphan = channels->remove_orphan())
+		fast_destroy(orphan);
+
+	Ipc_fast_channel *c = 0;
+	try { c = new (ipc_fast_heap()) Ipc_fast_channel(tid, server_id); }
+	catch (...) { return 0; }
+
+	int slot = -1;
+	try { slot = fast_setup(*c, dst_sd); }
+	catch (Genode::Blocking_canceled) { fast_destroy(c); throw; }
+
+	if (slot < 0)
+		fast_close(*c);
+	else
+		c->slot = slot;
+
+	channels->insert(c);
+	return c;
+}
+
+
+/**
+ * Try to perform call through the message page of the connection
+ *
+ * \return  false if the call must take the socket path
+ */
+static bool fast_call(int const dst_sd,
+                      Genode::Msgbuf_base &send_msgbuf, Genode::size_t send_msg_len,
+                      Genode::Msgbuf_base &recv_msgbuf)
+{
+	if (send_msgbuf.used_caps() || send_msg_len > Ipc_fast_page::max_msg_len())
+		return false;
+
+	if (!ipc_fast_channels()->enabled())
+		return false;
+
+	int const server_id = fast_server_id(dst_sd);
+	if (server_id < 0)
+		return false;
+
+	int const tid = my_tid();
+	bool setup = false;
+	Ipc_fast_channel *c = ipc_fast_channels()->channel(tid, server_id, setup);
+	if (setup)
+		c = fast_open(tid, server_id, dst_sd);
+
+	if (!c || c->slot < 0)
+		return false;
+
+	/* write request, publish it, and ring the server */
+	Ipc_fast_page * const page = c->page;
+	Genode::memcpy(page->buf, send_msgbuf.buf, send_msg_len);
+	page->len = send_msg_len;
+	__sync_synchronize();
+	page->state = Ipc_fast_page::REQUEST;
+
+	int doorbell = c->slot;
+	Message msg(&doorbell, sizeof(doorbell));
+	int ret = lx_sendmsg(dst_sd, msg.msg(), 0);
 	if (ret < 0) {
-		PRAW("lx_recvmsg failed with %d in lx_wait(), sd=%d", ret, cs.server_sd);
+		PRAW("[%d] lx_sendmsg to sd %d failed with %d in fast_call()",
+		     lx_getpid(), dst_sd, ret);
+		fast_drop(c);
 		throw Genode::Ipc_error();
 	}
 
-	int const reply_socket = msg.socket_at_index(0);
+	/* wait for the reply, the server may vanish meanwhile */
+	struct timespec const alive_timeout = { FAST_ALIVE_S, 0 };
+	while (page->state == Ipc_fast_page::REQUEST) {
+
+		ret = lx_futex(&page->state, LX_FUTEX_WAIT_SHARED,
+		               Ipc_fast_page::REQUEST, &alive_timeout);
+
+		/* system call got interrupted by a signal */
+		if (ret == -LX_EINTR) {
+			fast_drop(c);
+			throw Genode::Blocking_canceled();
+		}
+		if (ret == -LX_ETIMEDOUT &&
+		    lx_tgkill(page->server_pid, page->server_tid, 0) < 0)
+		{
+			PRAW("[%d] server vanished during fast_call()", lx_getpid());
+			fast_drop(c);
+			throw Genode::Ipc_error();
+		}
+	}
+	__sync_synchronize();
+
+	if (page->state == Ipc_fast_page::REPLY_ON_SOCKET) {
+
+		/* the reply transfers capabilities */
+		Message recv_msg(recv_msgbuf.buf, recv_msgbuf.size());
+		recv_msg.accept_sockets(Message::MAX_SDS_PER_MSG);
+		ret = lx_recvmsg(c->reply_sd, recv_msg.msg(), 0);
+		if (ret < 0) {
+			PRAW("[%d] lx_recvmsg failed with %d in fast_call()",
+			     lx_getpid(), ret);
+			fast_drop(c);
+			throw Genode::Ipc_error();
+		}
+		extract_sds_from_message(0, recv_msg, recv_msgbuf);
+
+	} else {
+
+		Genode::size_t const len = min((Genode::size_t)page->len,
+		                               Ipc_fast_page::max_msg_len());
+		Genode::memcpy(recv_msgbuf.buf, page->buf, min(len, recv_msgbuf.size()));
+		recv_msgbuf.reset_caps();
+	}
+	__sync_synchronize();
+	page->state = Ipc_fast_page::IDLE;
+	return true;
+}
+
+
+/**
+ * Utility: Return process ID of the creator of the socket pair of 'sd'
+ *
+ * \return  process ID or -1 on failure
+ *
+ * Other than the content of the page, the credentials are provided by the
+ * kernel and cannot be forged by the client.
+ */
+static int fast_peer_pid(int const sd)
+{
+	struct ucred cred;
+	socklen_t len = sizeof(cred);
+	if (lx_getsockopt(sd, SOL_SOCKET, SO_PEERCRED, &cred, &len) < 0
+	 || len != sizeof(cred) || cred.pid <= 0)
+		return -1;
+
+	return cred.pid;
+}
+
+
+/**
+ * Accept the message page that a client hands over with 'msg'
+ *
+ * A process with disabled fast path, namely core, refuses all pages. The
+ * bookkeeping of a page would be paid by the server and not by the client.
+ */
+static void fast_accept(Genode::Native_connection_state const &cs,
+                        Message const &msg)
+{
+	if (msg.num_sockets() != 2) {
+		for (unsigned i = 0; i < msg.num_sockets(); i++)
+			lx_close(msg.socket_at_index(i));
+		return;
+	}
+	int const fd       = msg.socket_at_index(0);
+	int const reply_sd = msg.socket_at_index(1);
+
+	int const client_pid = fast_peer_pid(reply_sd);
+
+	Ipc_fast_page * const page =
+		ipc_fast_channels()->enabled() && client_pid > 0 ? map_fast_page(fd) : 0;
+	lx_close(fd);
 
-	extract_sds_from_message(1, msg, recv_msgbuf);
+	int slot = -1;
+	if (page) {
+		page->server_pid = lx_getpid();
+		page->server_tid = my_tid();
 
-	return reply_socket;
+		/* growing the slot table may call the RAM session */
+		Ipc_fast_channels::Bypass bypass(*ipc_fast_channels(), my_tid());
+		slot = ipc_fast_slots()->alloc(page, cs.server_sd, reply_sd, client_pid);
+		if (slot < 0)
+			lx_munmap(page, Ipc_fast_page::SIZE);
+	}
+	Message answer(&slot, sizeof(slot));
+	lx_sendmsg(reply_sd, answer.msg(), 0);
+	if (slot < 0)
+		lx_close(reply_sd);
+}
+
+
+/**
+ * Fetch the request in the message page at 'slot'
+ *
+ * \return  reply capability that names the slot, or an invalid capability
+ *          if the page holds no request
+ *
+ * The reply socket of the slot is the destination of the reply capability
+ * and its 'local_name' is the slot. So the reply gets routed to the page
+ * even if it is issued later via 'Rpc_entrypoint::explicit_reply'.
+ */
+static Native_capability fast_receive(Genode::Native_connection_state &cs,
+                                      int const slot,
+                                      Genode::Msgbuf_base &recv_msgbuf)
+{
+	Ipc_fast_page * const page = ipc_fast_slots()->page(slot, cs.server_sd);
+	if (!page || page->state != Ipc_fast_page::REQUEST)
+		return Native_capability();
+
+	__sync_synchronize();
+	Genode::size_t const len = min((Genode::size_t)page->len,
+	                               Ipc_fast_page::max_msg_len());
+	Genode::memcpy(recv_msgbuf.buf, page->buf, min(len, recv_msgbuf.size()));
+	recv_msgbuf.reset_caps();
+
+	typedef Native_capability::Dst Dst;
+	return Native_capability(Dst(ipc_fast_slots()->reply_sd(slot, cs.server_sd)),
+	                         slot);
+}
+
+
+/**
+ * Send reply through the message page named by 'reply_cap'
+ */
+static void fast_reply(Genode::Native_connection_state const &cs,
+                       Native_capability const &reply_cap,
+                       Genode::Msgbuf_base &send_msgbuf, Genode::size_t msg_len)
+{
+	int const slot     = reply_cap.local_name();
+	int const reply_sd = ipc_fast_slots()->reply_sd(slot, cs.server_sd);
+
+	/* the page was reclaimed since the reply capability was handed out */
+	Ipc_fast_page * const page = ipc_fast_slots()->page(slot, cs.server_sd);
+	if (!page || reply_sd != reply_cap.dst().socket)
+		return;
+
+	int state = Ipc_fast_page::REPLY;
+	if (send_msgbuf.used_caps() || msg_len > Ipc_fast_page::max_msg_len()) {
+
+		/* capabilities keep using the socket */
+		Message msg(send_msgbuf.buf, msg_len);
+		for (unsigned i = 0; i < send_msgbuf.used_caps(); i++)
+			msg.marshal_socket(send_msgbuf.cap(i));
+
+		lx_sendmsg(reply_sd, msg.msg(), 0);
+		state = Ipc_fast_page::REPLY_ON_SOCKET;
+
+	} else {
+
+		Genode::memcpy(page->buf, send_msgbuf.buf, msg_len);
+		page->len = msg_len;
+	}
+
+	/* the client may have abandoned the page meanwhile */
+	if (!cmpxchg(&page->state, Ipc_fast_page::REQUEST, state)) {
+		ipc_fast_slots()->free(slot, cs.server_sd);
+		return;
+	}
+	lx_futex(&page->state, LX_FUTEX_WAKE_SHARED, 1);
+}
+
+
+/**
+ * for request from client
+ *
+ * \return  reply capability
+ */
+static inline Native_capability lx_wait(Genode::Native_connection_state &cs,
+                                        Genode::Msgbuf_base &recv_msgbuf)
+{
+	for (;;) {
+		Message msg(recv_msgbuf.buf, recv_msgbuf.size());
+
+		msg.accept_sockets(Message::MAX_SDS_PER_MSG);
+
+		int ret = lx_recvmsg(cs.server_sd, msg.msg(), 0);
+
+		/* system call got interrupted by a signal */
+		if (ret == -LX_EINTR)
+			throw Genode::Blocking_canceled();
+
+		if (ret < 0) {
+			PRAW("lx_recvmsg failed with %d in lx_wait(), sd=%d", ret, cs.server_sd);
+			throw Genode::Ipc_error();
+		}
+
+		/* datagram of the fast path */
+		if (ret == sizeof(int)) {
+			int const slot = *(int *)recv_msgbuf.buf;
+			if (slot == FAST_SETUP) {
+				fast_accept(cs, msg);
+				continue;
+			}
+			Native_capability const reply_cap =
+				fast_receive(cs, slot, recv_msgbuf);
+			if (reply_cap.valid())
+				return reply_cap;
+			continue;
+		}
+
+		int const reply_socket = msg.socket_at_index(0);
+
+		extract_sds_from_message(1, msg, recv_msgbuf);
+
+		/*
+		 * The 'local_name' of a capability is meaningful for addressing
+		 * server objects only. Because a reply capability of the socket
+		 * path does not address a server object, the 'local_name' is
+		 * meaningless.
+		 */
+		typedef Native_capability::Dst Dst;
+		return Native_capability(Dst(reply_socket), FAST_NONE);
+	}
 }
 
 
@@ -403,6 +944,24 @@ static inline void lx_reply(int reply_socket,
 }
 
 
+/**
+ * Send reply to the client that 'reply_cap' refers to
+ *
+ * Reply capabilities of the fast path carry the slot of their message page
+ * as 'local_name', those of the socket path carry 'FAST_NONE'.
+ */
+static inline void reply(Genode::Native_connection_state const &cs,
+                         Native_capability const &reply_cap,
+                         Genode::Msgbuf_base &send_msgbuf,
+                         Genode::size_t msg_len)
+{
+	if (reply_cap.valid() && reply_cap.local_name() != FAST_NONE)
+		fast_reply(cs, reply_cap, send_msgbuf, msg_len);
+	else
+		lx_reply(reply_cap.dst().socket, send_msgbuf, msg_len);
+}
+
+
 /*****************
  ** Ipc_ostream **
  *****************/
@@ -478,6 +1037,10 @@ Ipc_istream::~Ipc_istream()
 			thread->tid().is_ipc_server = false;
 	}
 
+	/* drop the message pages of the fast path */
+	if (_rcv_cs.server_sd != -1)
+		ipc_fast_slots()->free_all(_rcv_cs.server_sd);
+
 	destroy_server_socket_pair(_rcv_cs);
 	_rcv_cs.client_sd = -1;
 	_rcv_cs.server_sd = -1;
@@ -505,8 +1068,11 @@ void Ipc_client::_prepare_next_call()
 
 void Ipc_client::_call()
 {
-	if (Ipc_ostream::_dst.valid())
-		lx_call(Ipc_ostream::_dst.dst().socket, *_snd_msg, _write_offset, *_rcv_msg);
+	if (Ipc_ostream::_dst.valid()) {
+		int const dst_sd = Ipc_ostream::_dst.dst().socket;
+		if (!fast_call(dst_sd, *_snd_msg, _write_offset, *_rcv_msg))
+			lx_call(dst_sd, *_snd_msg, _write_offset, *_rcv_msg);
+	}
 
 	_prepare_next_call();
 }
@@ -556,18 +1122,8 @@ void Ipc_server::_wait()
 	}
 
 	try {
-		int const reply_socket = lx_wait(_rcv_cs, *_rcv_msg);
-
-		/*
-		 * Remember reply capability
-		 *
-		 * The 'local_name' of a capability is meaningful for addressing server
-		 * objects only. Because a reply capabilities does not address a server
-		 * object, the 'local_name' is meaningless.
-		 */
-		enum { DUMMY_LOCAL_NAME = -1 };
-		typedef Native_capability::Dst Dst;
-		Ipc_ostream::_dst = Native_capability(Dst(reply_socket), DUMMY_LOCAL_NAME);
+		/* remember reply capability */
+		Ipc_ostream::_dst = lx_wait(_rcv_cs, *_rcv_msg);
 
 		_prepare_next_reply_wait();
 	} catch (Blocking_canceled) { }
@@ -577,7 +1133,7 @@ void Ipc_server::_wait()
 void Ipc_server::_reply()
 {
 	try {
-		lx_reply(Ipc_ostream::_dst.dst().socket, *_snd_msg, _write_offset); }
+		reply(_rcv_cs, Ipc_ostream::_dst, *_snd_msg, _write_offset); }
 	catch (Ipc_error) { }
 
 	_prepare_next_reply_wait();
@@ -588,7 +1144,7 @@ void Ipc_server::_reply_wait()
 {
 	/* when first called, there was no request yet */
 	if (_reply_needed)
-		lx_reply(Ipc_ostream::_dst.dst().socket, *_snd_msg, _write_offset);
+		reply(_rcv_cs, Ipc_ostream::_dst, *_snd_msg, _write_offset);
 
 	_wait();
 }
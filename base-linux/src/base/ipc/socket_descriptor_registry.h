@@ -11,7 +11,7 @@
  */
 
 /*
- * Copyright (C) 2012 Genode Labs GmbH
+ * Copyright (C) 2012-2013 Genode Labs GmbH
  *
  * This file is part of the Genode OS framework, which is distributed
  * under the terms of the GNU General Public License version 2.
@@ -102,6 +102,22 @@ class Genode::Socket_descriptor_registry
 
 	public:
 
+		/**
+		 * Lookup global ID that is associated with socket descriptor 'sd'
+		 *
+		 * \return global ID or -1 if 'sd' is not associated
+		 */
+		int lookup_global_id(int sd) const
+		{
+			Genode::Lock::Guard guard(_lock);
+
+			for (unsigned i = 0; i < MAX_FDS; i++)
+				if (_entries[i].fd == sd)
+					return _entries[i].global_id;
+
+			return -1;
+		}
+
 		void disassociate(int sd)
 		{
 			Genode::Lock::Guard guard(_lock);
@@ -20,6 +20,7 @@
 /* Genode includes */
 #include <base/native_types.h>
 #include <base/thread.h>
+#include <cpu/atomic.h>
 
 /* Linux includes */
 #include <linux_syscalls.h>
@@ -35,23 +36,71 @@
 Genode::Thread_base * __attribute__((weak)) Genode::Thread_base::myself() { return 0; }
 
 
-static inline void thread_yield()
+enum {
+	/*
+	 * Number of checks of the futex word before a blocking thread enters
+	 * the kernel, covers the common case of short critical sections
+	 */
+	LOCK_SPIN_ROUNDS = 100,
+};
+
+
+/**
+ * Get the futex word and the ticket counter of the calling thread
+ */
+static inline void thread_my_futex(volatile int **futex, int **ticket)
 {
-	struct timespec ts = { 0, 1000 };
-	lx_nanosleep(&ts, 0);
+	static volatile int main_thread_futex;
+	static int          main_thread_ticket;
+
+	Genode::Thread_base * const myself = Genode::Thread_base::myself();
+	if (!myself) {
+		*futex  = &main_thread_futex;
+		*ticket = &main_thread_ticket;
+		return;
+	}
+	*futex  = &myself->tid().lock_futex;
+	*ticket = &myself->tid().lock_ticket;
 }
 
 
+static inline void thread_yield() { lx_sched_yield(); }
+
+
 static inline bool thread_check_stopped_and_restart(Genode::Native_thread_id tid)
 {
-	lx_tgkill(tid.pid, tid.tid, LX_SIGUSR1);
+	if (!tid.futex) {
+		lx_tgkill(tid.pid, tid.tid, LX_SIGUSR1);
+		return true;
+	}
+	/*
+	 * Publish the ticket unless the thread already moved on to a newer
+	 * attempt, then wake the thread if it is sleeping in the kernel.
+	 */
+	for (;;) {
+		int const old = *tid.futex;
+		if (tid.ticket - old <= 0) break;
+		if (Genode::cmpxchg(tid.futex, old, tid.ticket)) break;
+	}
+	lx_futex(tid.futex, LX_FUTEX_WAKE, 1);
 	return true;
 }
 
 
 static inline Genode::Native_thread_id thread_get_my_native_id()
 {
-	return Genode::Native_thread_id(lx_gettid(), lx_getpid());
+	volatile int *futex;
+	int          *ticket;
+	thread_my_futex(&futex, &ticket);
+	int const t = ++*ticket;
+
+	/* avoid the system calls if the thread library knows our IDs */
+	Genode::Thread_base * const myself = Genode::Thread_base::myself();
+	if (myself && myself->tid().tid)
+		return Genode::Native_thread_id(myself->tid().tid, myself->tid().pid,
+		                                futex, t);
+
+	return Genode::Native_thread_id(lx_gettid(), lx_getpid(), futex, t);
 }
 
 
@@ -73,8 +122,24 @@ static inline void thread_switch_to(Genode::Native_thread_id tid)
 }
 
 
+/**
+ * Block until our current ticket got published
+ *
+ * Returns prematurely if the blocking gets canceled via 'LX_SIGUSR1'.
+ */
 static inline void thread_stop_myself()
 {
-	struct timespec ts = { 1000, 0 };
-	while (lx_nanosleep(&ts, 0) == 0);
+	volatile int *futex;
+	int          *ticket;
+	thread_my_futex(&futex, &ticket);
+
+	for (unsigned i = 0; i < LOCK_SPIN_ROUNDS; i++) {
+		if (*futex - *ticket >= 0) return;
+		asm volatile ("" : : : "memory");
+	}
+	for (;;) {
+		int const value = *futex;
+		if (value - *ticket >= 0) return;
+		if (lx_futex(futex, LX_FUTEX_WAIT, value) == -LX_EINTR) return;
+	}
 }
@@ -5,7 +5,7 @@
  */
 
 /*
- * Copyright (C) 2012 Genode Labs GmbH
+ * Copyright (C) 2012-2013 Genode Labs GmbH
  *
  * This file is part of the Genode OS framework, which is distributed
  * under the terms of the GNU General Public License version 2.
@@ -35,6 +35,7 @@ namespace Genode {
 			char               _root[ROOT_PATH_MAX_LEN];
 			unsigned           _uid;
 			unsigned           _gid;
+			bool               _ipc_fast_path;
 			Parent_capability  _parent;
 			Rpc_entrypoint    *_ds_ep;
 
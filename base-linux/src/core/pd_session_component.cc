@@ -5,7 +5,7 @@
  */
 
 /*
- * Copyright (C) 2012 Genode Labs GmbH
+ * Copyright (C) 2012-2013 Genode Labs GmbH
  *
  * This file is part of the Genode OS framework, which is distributed
  * under the terms of the GNU General Public License version 2.
@@ -307,7 +307,7 @@ static const char *get_env(const char *key)
 
 Pd_session_component::Pd_session_component(Rpc_entrypoint *ep, const char *args)
 :
-	_pid(0), _uid(0), _gid(0), _ds_ep(ep)
+	_pid(0), _uid(0), _gid(0), _ipc_fast_path(false), _ds_ep(ep)
 {
 	Arg_string::find_arg(args, "label").string(_label, sizeof(_label),
 	                                           "<unlabeled>");
@@ -320,6 +320,8 @@ Pd_session_component::Pd_session_component(Rpc_entrypoint *ep, const char *args)
 	_uid = Arg_string::find_arg(args, "uid").ulong_value(0);
 	_gid = Arg_string::find_arg(args, "gid").ulong_value(0);
 
+	_ipc_fast_path = Arg_string::find_arg(args, "ipc_fast_path").bool_value(false);
+
 	bool const is_chroot = (Genode::strcmp(_root, "") != 0);
 
 	/*
@@ -377,7 +379,7 @@ void Pd_session_component::start(Capability<Dataspace> binary)
 
 	/* pass parent capability as environment variable to the child */
 	enum { ENV_STR_LEN = 256 };
-	static char envbuf[5][ENV_STR_LEN];
+	static char envbuf[6][ENV_STR_LEN];
 	Genode::snprintf(envbuf[1], ENV_STR_LEN, "parent_local_name=%lu",
 	                 _parent.local_name());
 	Genode::snprintf(envbuf[2], ENV_STR_LEN, "DISPLAY=%s",
@@ -386,9 +388,11 @@ void Pd_session_component::start(Capability<Dataspace> binary)
 	                 get_env("HOME"));
 	Genode::snprintf(envbuf[4], ENV_STR_LEN, "LD_LIBRARY_PATH=%s",
 	                 get_env("LD_LIBRARY_PATH"));
+	Genode::snprintf(envbuf[5], ENV_STR_LEN, "ipc_fast_path=%s",
+	                 _ipc_fast_path ? "yes" : "no");
 
 	char *env[] = { &envbuf[0][0], &envbuf[1][0], &envbuf[2][0],
-	                &envbuf[3][0], &envbuf[4][0], 0 };
+	                &envbuf[3][0], &envbuf[4][0], &envbuf[5][0], 0 };
 
 	/* prefix name of Linux program (helps killing some zombies) */
 	char const *prefix = "[Genode] ";
@@ -5,7 +5,7 @@
  */
 
 /*
- * Copyright (C) 2006-2012 Genode Labs GmbH
+ * Copyright (C) 2006-2013 Genode Labs GmbH
  *
  * This file is part of the Genode OS framework, which is distributed
  * under the terms of the GNU General Public License version 2.
@@ -13,6 +13,7 @@
 
 /* Genode includes */
 #include <base/lock.h>
+#include <base/ipc.h>
 #include <linux_dataspace/client.h>
 
 /* local includes */
@@ -59,6 +60,15 @@ Platform::Platform()
 	 * PARENT_SOCKET_HANDLE as both source and target descriptor.
 	 */
 	lx_dup2(0, PARENT_SOCKET_HANDLE);
+
+	/*
+	 * Setting up a message page for the IPC fast path involves calls to
+	 * the dataspace entrypoint of core. So core, which hardly calls other
+	 * servers anyway, always uses the socket path. Core also refuses the
+	 * pages of its clients because their bookkeeping would not be paid by
+	 * the clients.
+	 */
+	ipc_fast_path(false);
 }
 
 
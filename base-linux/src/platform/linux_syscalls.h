@@ -19,7 +19,7 @@
  */
 
 /*
- * Copyright (C) 2008-2012 Genode Labs GmbH
+ * Copyright (C) 2008-2013 Genode Labs GmbH
  *
  * This file is part of the Genode OS framework, which is distributed
  * under the terms of the GNU General Public License version 2.
@@ -132,6 +132,14 @@ inline int lx_getpeername(int sockfd, struct sockaddr *name, socklen_t *namelen)
 	return lx_socketcall(SYS_GETPEERNAME, args);
 }
 
+
+inline int lx_getsockopt(int sockfd, int level, int optname, void *optval,
+                         socklen_t *optlen)
+{
+	long args[5] = { sockfd, level, optname, (long)optval, (long)optlen };
+	return lx_socketcall(SYS_GETSOCKOPT, args);
+}
+
 #else
 
 inline int lx_socketpair(int domain, int type, int protocol, int sd[2])
@@ -157,6 +165,13 @@ inline int lx_getpeername(int sockfd, struct sockaddr *name, socklen_t *namelen)
 	return lx_syscall(SYS_getpeername, sockfd, name, namelen);
 }
 
+
+inline int lx_getsockopt(int sockfd, int level, int optname, void *optval,
+                         socklen_t *optlen)
+{
+	return lx_syscall(SYS_getsockopt, sockfd, level, optname, optval, optlen);
+}
+
 /* TODO add missing socket system calls */
 
 #endif /* SYS_socketcall */
@@ -338,6 +353,33 @@ inline int lx_nanosleep(const struct timespec *req, struct timespec *rem)
 }
 
 
+inline int lx_sched_yield() { return lx_syscall(SYS_sched_yield); }
+
+
+enum {
+	LX_FUTEX_WAIT        = 128, /* FUTEX_WAIT | FUTEX_PRIVATE_FLAG */
+	LX_FUTEX_WAKE        = 129, /* FUTEX_WAKE | FUTEX_PRIVATE_FLAG */
+	LX_FUTEX_WAIT_SHARED = 0,   /* FUTEX_WAIT on memory shared with others */
+	LX_FUTEX_WAKE_SHARED = 1,   /* FUTEX_WAKE on memory shared with others */
+	LX_EINTR             = 4,
+	LX_ETIMEDOUT         = 110,
+};
+
+
+/**
+ * Simplified binding for futex operations
+ *
+ * \param timeout  relative timeout of wait operations, 0 for none
+ *
+ * \return  negative error code on failure
+ */
+inline int lx_futex(volatile int *uaddr, int op, int val,
+                    struct timespec const *timeout = 0)
+{
+	return lx_syscall(SYS_futex, uaddr, op, val, timeout, 0UL, 0);
+}
+
+
 /**
  * Signal set corrsponding to glibc's 'sigset_t'
  */
@@ -349,6 +349,8 @@ Thread_base::~Thread_base()
 			     ret, errno);
 	}
 
+	_deinit_generic_thread();
+
 	destroy(env()->heap(), _tid.meta_data);
 	_tid.meta_data = 0;
 
@@ -0,0 +1,164 @@
+/*
+ * \brief  IPC round-trip benchmark for Linux
+ * \author Martin Stein
+ * \date   2013-02-07
+ *
+ * The main thread calls an entrypoint of the same process with small and
+ * large arguments and with a capability argument. Each kind of call gets
+ * measured with the shared-memory fast path of the IPC library enabled
+ * and disabled. Calls with a capability take the socket path either way.
+ */
+
+/*
+ * Copyright (C) 2013 Genode Labs GmbH
+ *
+ * This file is part of the Genode OS framework, which is distributed
+ * under the terms of the GNU General Public License version 2.
+ */
+
+/* Genode includes */
+#include <base/env.h>
+#include <base/printf.h>
+#include <base/ipc.h>
+#include <base/rpc_server.h>
+#include <base/rpc_client.h>
+#include <cap_session/connection.h>
+
+/* Linux includes */
+#include <linux_syscalls.h>
+#include <time.h>
+
+using namespace Genode;
+
+enum {
+	CALLS        = 50*1000,
+	PAYLOAD_SIZE = 1024,
+	STACK_SIZE   = 16*1024,
+};
+
+
+static unsigned long long now_us()
+{
+	struct timespec ts;
+	lx_syscall(SYS_clock_gettime, CLOCK_MONOTONIC, &ts);
+	return (unsigned long long)ts.tv_sec * 1000 * 1000 + ts.tv_nsec / 1000;
+}
+
+
+struct Payload { char data[PAYLOAD_SIZE]; };
+
+
+/**
+ * Interface of the benchmarked server
+ */
+struct Bench_session
+{
+	virtual int                add(int a, int b)            = 0;
+	virtual int                sum(Payload const &p)         = 0;
+	virtual Untyped_capability echo(Untyped_capability cap) = 0;
+
+	GENODE_RPC(Rpc_add, int, add, int, int);
+	GENODE_RPC(Rpc_sum, int, sum, Payload const &);
+	GENODE_RPC(Rpc_echo, Untyped_capability, echo, Untyped_capability);
+	GENODE_RPC_INTERFACE(Rpc_add, Rpc_sum, Rpc_echo);
+};
+
+
+struct Bench_component : Rpc_object<Bench_session, Bench_component>
+{
+	int add(int a, int b) { return a + b; }
+
+	int sum(Payload const &p)
+	{
+		int s = 0;
+		for (unsigned i = 0; i < PAYLOAD_SIZE; i++) s += p.data[i];
+		return s;
+	}
+
+	Untyped_capability echo(Untyped_capability cap) { return cap; }
+};
+
+
+struct Bench_client : Rpc_client<Bench_session>
+{
+	Bench_client(Capability<Bench_session> cap)
+	: Rpc_client<Bench_session>(cap) { }
+
+	int add(int a, int b) { return call<Rpc_add>(a, b); }
+
+	int sum(Payload const &p) { return call<Rpc_sum>(p); }
+
+	Untyped_capability echo(Untyped_capability cap) {
+		return call<Rpc_echo>(cap); }
+};
+
+
+/**
+ * Measure 'CALLS' invocations of 'call' and print the result
+ */
+template <typename CALL>
+static void measure(char const *name, bool const fast, CALL call)
+{
+	ipc_fast_path(fast);
+	call(); /* warm up, this sets up the message page */
+
+	unsigned long long const start = now_us();
+	for (unsigned i = 0; i < CALLS; i++) call();
+	unsigned long long const us = now_us() - start;
+
+	printf("%s, %s path: %u calls in %llu us, %llu ns/call\n", name,
+	       fast ? "fast" : "socket", CALLS, us, us * 1000 / CALLS);
+}
+
+
+struct Add
+{
+	Bench_client &c;
+	void operator () () { c.add(1, 2); }
+};
+
+
+struct Sum
+{
+	Bench_client &c;
+	Payload      &p;
+	void operator () () { c.sum(p); }
+};
+
+
+struct Echo
+{
+	Bench_client      &c;
+	Untyped_capability cap;
+	void operator () () { c.echo(cap); }
+};
+
+
+int main(int, char **)
+{
+	printf("--- IPC benchmark ---\n");
+
+	static Cap_connection  cap;
+	static Rpc_entrypoint  ep(&cap, STACK_SIZE, "bench_ep");
+	static Bench_component component;
+	static Payload         payload;
+
+	Capability<Bench_session> const session = ep.manage(&component);
+	Bench_client client(session);
+
+	if (client.add(20, 22) != 42) {
+		PERR("unexpected result of the add call");
+		return -1;
+	}
+
+	for (unsigned fast = 0; fast < 2; fast++) {
+		Add  add  = { client };
+		Sum  sum  = { client, payload };
+		Echo echo = { client, session };
+		measure("add",  fast, add);
+		measure("sum",  fast, sum);
+		measure("echo", fast, echo);
+	}
+	printf("--- end of IPC benchmark ---\n");
+	return 0;
+}
@@ -0,0 +1,147 @@
+/*
+ * \brief  Lock contention benchmark for Linux
+ * \author Martin Stein
+ * \date   2013-02-06
+ *
+ * A number of threads increments a shared counter within a critical
+ * section. The benchmark compares 'Genode::Lock', which blocks contended
+ * threads on futexes, with a lock that works like the former Linux lock
+ * back end, a spinlock that sleeps for a microsecond on contention.
+ */
+
+/*
+ * Copyright (C) 2013 Genode Labs GmbH
+ *
+ * This file is part of the Genode OS framework, which is distributed
+ * under the terms of the GNU General Public License version 2.
+ */
+
+/* Genode includes */
+#include <base/env.h>
+#include <base/printf.h>
+#include <base/thread.h>
+#include <base/lock.h>
+#include <base/semaphore.h>
+#include <cpu/atomic.h>
+
+/* Linux includes */
+#include <linux_syscalls.h>
+#include <time.h>
+
+using namespace Genode;
+
+enum {
+	MAX_THREADS = 32,
+	ROUNDS      = 20*1000, /* critical sections per thread */
+	CS_LENGTH   = 100,     /* work within the critical section */
+	STACK_SIZE  = 16*1024,
+};
+
+
+static unsigned long long now_us()
+{
+	struct timespec ts;
+	lx_syscall(SYS_clock_gettime, CLOCK_MONOTONIC, &ts);
+	return (unsigned long long)ts.tv_sec * 1000 * 1000 + ts.tv_nsec / 1000;
+}
+
+
+/**
+ * Lock that behaves like the former sleeping spinlock on Linux
+ */
+class Sleeping_spinlock
+{
+	volatile int _locked;
+
+	public:
+
+		Sleeping_spinlock() : _locked(0) { }
+
+		void lock()
+		{
+			while (!cmpxchg(&_locked, 0, 1)) {
+				struct timespec ts = { 0, 1000 };
+				lx_nanosleep(&ts, 0);
+			}
+		}
+
+		void unlock() { _locked = 0; }
+};
+
+
+/**
+ * Contender for a lock of type 'LOCK'
+ */
+template <typename LOCK>
+class Contender : public Thread<STACK_SIZE>
+{
+	LOCK                    * const _lock;
+	volatile unsigned long  * const _counter;
+	Semaphore               * const _done;
+
+	public:
+
+		Contender(LOCK * const lock, volatile unsigned long * const counter,
+		          Semaphore * const done)
+		:
+			Thread<STACK_SIZE>("contender"),
+			_lock(lock), _counter(counter), _done(done)
+		{ }
+
+		void entry()
+		{
+			for (unsigned i = 0; i < ROUNDS; i++) {
+				_lock->lock();
+				for (unsigned j = 0; j < CS_LENGTH; j++) (*_counter)++;
+				_lock->unlock();
+			}
+			_done->up();
+		}
+};
+
+
+/**
+ * Let 'threads' threads contend for a lock of type 'LOCK'
+ *
+ * \return  duration in microseconds
+ */
+template <typename LOCK>
+static unsigned long long measure(unsigned const threads)
+{
+	static LOCK lock;
+	static volatile unsigned long counter;
+	static Semaphore done;
+	counter = 0;
+
+	Contender<LOCK> * contenders[MAX_THREADS];
+	for (unsigned i = 0; i < threads; i++)
+		contenders[i] = new (env()->heap()) Contender<LOCK>(&lock, &counter, &done);
+
+	unsigned long long const start = now_us();
+	for (unsigned i = 0; i < threads; i++) contenders[i]->start();
+	for (unsigned i = 0; i < threads; i++) done.down();
+	unsigned long long const time = now_us() - start;
+
+	for (unsigned i = 0; i < threads; i++) {
+		contenders[i]->join();
+		destroy(env()->heap(), contenders[i]);
+	}
+	if (counter != (unsigned long)threads * ROUNDS * CS_LENGTH)
+		PERR("lost updates, the lock is broken");
+
+	return time;
+}
+
+
+int main(int, char **)
+{
+	printf("--- lock benchmark ---\n");
+	for (unsigned threads = 2; threads <= MAX_THREADS; threads *= 2) {
+		unsigned long long const sleeping = measure<Sleeping_spinlock>(threads);
+		unsigned long long const futex    = measure<Lock>(threads);
+		printf("%2u threads: sleeping spinlock %llu us, futex lock %llu us\n",
+		       threads, sleeping, futex);
+	}
+	printf("--- end of lock benchmark ---\n");
+	return 0;
+}
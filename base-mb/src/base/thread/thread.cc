@@ -205,6 +205,7 @@ Thread_base::Thread_base(const char *name, size_t stack_size)
 Thread_base::~Thread_base()
 {
 	_deinit_platform_thread();
+	_deinit_generic_thread();
 	_free_context();
 }
 
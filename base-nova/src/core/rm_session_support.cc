@@ -61,3 +61,10 @@ void Rm_client::unmap(addr_t core_local_base, addr_t virt_base, size_t size)
 			return;
 	}
 }
+
+
+bool Rm_client::decode_fault(unsigned * const, Rm_session::State &) {
+	return 0; }
+
+
+void Rm_client::apply_decoded_fault(Rm_session::State const &, unsigned const) { }
@@ -88,3 +88,10 @@ void Rm_client::unmap(addr_t, addr_t virt_base, size_t size)
 		size_log2--;
 	}
 }
+
+
+bool Rm_client::decode_fault(unsigned * const, Rm_session::State &) {
+	return 0; }
+
+
+void Rm_client::apply_decoded_fault(Rm_session::State const &, unsigned const) { }
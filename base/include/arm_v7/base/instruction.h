@@ -1,5 +1,5 @@
 /*
- * \brief   Instruction decoder for vinit
+ * \brief   Decoder for ARM V7A load/store instructions
  * \author  Martin Stein
  * \date    2012-04-17
  */
@@ -11,19 +11,20 @@
  * under the terms of the GNU General Public License version 2.
  */
 
-#ifndef _VINIT__ARM_V7A__INSTRUCTION_H_
-#define _VINIT__ARM_V7A__INSTRUCTION_H_
+#ifndef _INCLUDE__ARM_V7__BASE__INSTRUCTION_H_
+#define _INCLUDE__ARM_V7__BASE__INSTRUCTION_H_
 
 /* Genode includes */
 #include <util/register.h>
 #include <rm_session/rm_session.h>
 
-namespace Init
+namespace Genode
 {
-	using namespace Genode;
-
 	/**
-	 * Instruction decoder for vinit
+	 * Decoder for ARM V7A load/store instructions
+	 *
+	 * Used by core to decode faults at emulated memory and by
+	 * user-level emulators as fallback.
 	 */
 	struct Instruction
 	{
@@ -296,5 +297,5 @@ namespace Init
 	};
 }
 
-#endif /* _VINIT__ARM_V7A__INSTRUCTION_H_ */
+#endif /* _INCLUDE__ARM_V7__BASE__INSTRUCTION_H_ */
 
@@ -5,7 +5,7 @@
  */
 
 /*
- * Copyright (C) 2006-2012 Genode Labs GmbH
+ * Copyright (C) 2006-2013 Genode Labs GmbH
  *
  * This file is part of the Genode OS framework, which is distributed
  * under the terms of the GNU General Public License version 2.
@@ -22,19 +22,87 @@
 
 namespace Genode {
 
+	class Thread_base;
+
 	/**
 	 * Heap that uses dataspaces as backing store
 	 *
 	 * The heap class provides an allocator that uses a list of dataspaces of a ram
 	 * session as backing store. One dataspace may be used for holding multiple blocks.
+	 *
+	 * Optionally, small blocks get rounded up to size classes and each thread
+	 * caches freed blocks of each class in magazines that it can allocate
+	 * from again without taking the heap lock. Magazines that run full or
+	 * empty get exchanged at a per-class depot.
 	 */
 	class Heap : public Allocator
 	{
+		public:
+
+			/**
+			 * Counters of the magazine layer
+			 */
+			struct Magazine_stats
+			{
+				unsigned long hits;      /* operations served by a magazine  */
+				unsigned long misses;    /* operations that took the lock    */
+				unsigned long exchanges; /* magazines exchanged at the depot */
+				unsigned long contended; /* lock acquisitions that waited    */
+
+				Magazine_stats() : hits(0), misses(0), exchanges(0), contended(0) { }
+			};
+
 		private:
 
 			enum {
 				MIN_CHUNK_SIZE =    4*1024,  /* in machine words */
-				MAX_CHUNK_SIZE = 1024*1024
+				MAX_CHUNK_SIZE = 1024*1024,
+
+				NUM_CLASSES    = 24,   /* size classes up to 'MAX_CLASS_SIZE' */
+				MAX_CLASS_SIZE = 2048, /* in bytes including the block header */
+				MAGAZINE_SIZE  = 16,   /* blocks per magazine */
+				MAX_DEPOT      = 8,    /* non-empty magazines per depot */
+				MAX_THREADS    = 64,   /* threads that may own magazines */
+			};
+
+			/**
+			 * Stack of cached blocks of one size class
+			 */
+			struct Magazine
+			{
+				Magazine *next;
+				unsigned  count;
+				void     *blocks[MAGAZINE_SIZE];
+			};
+
+			/**
+			 * Magazines of one thread
+			 *
+			 * A set is used by its owning thread only, apart from flushing it
+			 * after the thread is gone.
+			 */
+			struct Magazine_set
+			{
+				Magazine      *loaded[NUM_CLASSES];
+				Magazine      *previous[NUM_CLASSES];
+				unsigned long  hits;
+				unsigned long  misses;
+			};
+
+			/**
+			 * Magazines of one size class that are owned by no thread
+			 */
+			struct Depot
+			{
+				Magazine *full;     /* magazines that contain blocks */
+				Magazine *empty;
+				unsigned  num_full;
+			};
+
+			struct Thread_slot
+			{
+				Thread_base  * volatile thread;
+				Magazine_set *          set;
 			};
 
 			class Dataspace : public List<Dataspace>::Element
@@ -94,12 +162,34 @@ namespace Genode {
 			 *       the calling order of the destructors!
 			 */
 
-			Lock           _lock;
-			Dataspace_pool _ds_pool;      /* list of dataspaces */
-			Allocator_avl  _alloc;        /* local allocator    */
-			size_t         _quota_limit;
-			size_t         _quota_used;
-			size_t         _chunk_size;
+			Lock               _lock;
+			Dataspace_pool     _ds_pool;      /* list of dataspaces */
+			Allocator_avl      _alloc;        /* local allocator    */
+			size_t             _quota_limit;
+			size_t             _quota_used;
+			size_t             _chunk_size;
+			volatile int       _lock_users;   /* threads at the lock */
+			bool               _used;         /* any block allocated */
+			bool               _magazines;
+			Depot              _depot[NUM_CLASSES];
+			Thread_slot        _threads[MAX_THREADS];
+			Magazine_stats     _stats;
+			List_element<Heap> _heaps_elem;   /* heaps with magazines */
+
+			/**
+			 * Guard of the heap lock that counts contended acquisitions
+			 */
+			class Guard
+			{
+				private:
+
+					Heap &_heap;
+
+				public:
+
+					Guard(Heap &heap);
+					~Guard();
+			};
 
 			/**
 			 * Try to allocate block at our local allocator
@@ -111,6 +201,40 @@ namespace Genode {
 			 */
 			bool _try_local_alloc(size_t size, void **out_addr);
 
+			/**
+			 * Allocate block at our local allocator, expand it if needed
+			 *
+			 * Must be called with the heap lock held.
+			 */
+			bool _unsynchronized_alloc(size_t size, void **out_addr);
+
+			/**
+			 * Free block at our local allocator
+			 *
+			 * Must be called with the heap lock held.
+			 */
+			void _unsynchronized_free(void *addr, size_t size);
+
+			/**
+			 * Return magazines of the calling thread, 0 if it has none
+			 */
+			Magazine_set *_magazine_set();
+
+			bool _class_alloc(unsigned cls, void **out_addr);
+			void _class_free(unsigned cls, void *addr);
+
+			/**
+			 * Put magazine to the depot of class 'cls' or drain it
+			 *
+			 * Must be called with the heap lock held.
+			 */
+			void _release_magazine(unsigned cls, Magazine *m);
+
+			/**
+			 * Return magazines of 'thread' to the depots
+			 */
+			void _flush_magazines(Thread_base *thread);
+
 		public:
 
 			enum { UNLIMITED = ~0 };
@@ -124,12 +248,22 @@ namespace Genode {
 				_ds_pool(ram_session, rm_session),
 				_alloc(0),
 				_quota_limit(quota_limit), _quota_used(0),
-				_chunk_size(MIN_CHUNK_SIZE)
+				_chunk_size(MIN_CHUNK_SIZE),
+				_lock_users(0), _used(false), _magazines(false),
+				_heaps_elem(this)
 			{
+				for (unsigned i = 0; i < NUM_CLASSES; i++)
+					_depot[i].full = _depot[i].empty = 0, _depot[i].num_full = 0;
+
+				for (unsigned i = 0; i < MAX_THREADS; i++)
+					_threads[i].thread = 0, _threads[i].set = 0;
+
 				if (static_addr)
 					_alloc.add_range((addr_t)static_addr, static_size);
 			}
 
+			~Heap();
+
 			/**
 			 * Reconfigure quota limit
 			 *
@@ -144,6 +278,30 @@ namespace Genode {
 			void reassign_resources(Ram_session *ram, Rm_session *rm) {
 				_ds_pool.reassign_resources(ram, rm); }
 
+			/**
+			 * Let threads cache freed blocks in magazines
+			 *
+			 * \return  false if the heap already handed out blocks
+			 *
+			 * The magazines must be enabled before the first allocation
+			 * because each block then carries its size in a header. Once
+			 * enabled, the magazines stay in place until the heap gets
+			 * destructed. Blocks cached by a thread count as used quota.
+			 */
+			bool enable_magazines();
+
+			/**
+			 * Return counters of the magazine layer
+			 */
+			Magazine_stats magazine_stats();
+
+			/**
+			 * Return the magazines of 'thread' at all heaps to the depots
+			 *
+			 * This function gets called on the destruction of a thread.
+			 */
+			static void flush_magazines(Thread_base *thread);
+
 
 			/*************************
 			 ** Allocator interface **
@@ -152,7 +310,8 @@ namespace Genode {
 			bool   alloc(size_t, void **);
 			void   free(void *, size_t);
 			size_t consumed() { return _quota_used; }
-			size_t overhead(size_t size) { return _alloc.overhead(size); }
+			size_t overhead(size_t size) {
+				return _alloc.overhead(size) + (_magazines ? sizeof(umword_t) : 0); }
 			bool   need_size_for_free() const { return false; }
 	};
 
@@ -18,6 +18,8 @@
 #define _INCLUDE__BASE__SIGNAL_H__
 
 #include <base/semaphore.h>
+#include <util/list.h>
+#include <util/fifo.h>
 #include <signal_session/signal_session.h>
 
 namespace Genode {
@@ -107,6 +109,11 @@ namespace Genode {
 			 */
 			List_element<Signal_context> _registry_le;
 
+			/**
+			 * Queue element in the pending contexts of 'Signal_receiver'
+			 */
+			Fifo_element<Signal_context> _pending_fe;
+
 			/**
 			 * Receiver to which the context is associated with
 			 *
@@ -136,7 +143,7 @@ namespace Genode {
 			 * Constructor
 			 */
 			Signal_context()
-			: _receiver_le(this), _registry_le(this),
+			: _receiver_le(this), _registry_le(this), _pending_fe(this),
 			  _receiver(0), _pending(0) { }
 
 			/**
@@ -210,6 +217,15 @@ namespace Genode {
 			Lock                                _contexts_lock;
 			List<List_element<Signal_context> > _contexts;
 
+			/**
+			 * Contexts with a pending signal in the order they became pending
+			 *
+			 * Nested within the lock of a context, whereas '_contexts_lock'
+			 * must not be taken while holding '_pending_lock'.
+			 */
+			Lock                                _pending_lock;
+			Fifo<Fifo_element<Signal_context> > _pending;
+
 			/**
 			 * Helper to dissolve given context
 			 *
@@ -5,7 +5,7 @@
  */
 
 /*
- * Copyright (C) 2006-2012 Genode Labs GmbH
+ * Copyright (C) 2006-2013 Genode Labs GmbH
  *
  * This file is part of the Genode OS framework, which is distributed
  * under the terms of the GNU General Public License version 2.
@@ -16,6 +16,7 @@
 
 #include <base/allocator.h>
 #include <base/stdint.h>
+#include <util/misc_math.h>
 
 namespace Genode {
 
@@ -33,21 +34,28 @@ namespace Genode {
 			Slab_block *next;  /* next block     */
 			Slab_block *prev;  /* previous block */
 
-		private:
+			enum { WORD_BITS = sizeof(umword_t) * 8 };
 
-			enum { FREE, USED };
+			/**
+			 * Number of state-bitmap words needed for 'num_elem' entries
+			 */
+			static size_t bitmap_words(size_t num_elem) {
+				return (num_elem + WORD_BITS - 1) / WORD_BITS; }
+
+		private:
 
 			Slab    *_slab;    /* back reference to slab allocator */
 			unsigned _avail;   /* free entries of this block       */
 
 			/*
 			 * Each slab block consists of three areas, a fixed-size header
-			 * that contains the member variables declared above, a byte array
-			 * called state table that holds the allocation state for each slab
+			 * that contains the member variables declared above, a bitmap
+			 * called state table that holds a set bit for each free slab
 			 * entry, and an area holding the actual slab entries. The number
-			 * of state-table elements corresponds to the maximum number of slab
+			 * of state-table bits corresponds to the maximum number of slab
 			 * entries per slab block (the '_num_elem' member variable of the
-			 * Slab allocator).
+			 * Slab allocator). Free entries are found word-wise by counting
+			 * trailing zeros.
 			 */
 
 			char _data[];  /* dynamic data (state table and slab entries) */
@@ -56,13 +64,28 @@ namespace Genode {
 			 * Caution! no member variables allowed below this line!
 			 */
 
+			/**
+			 * Word-aligned state table
+			 */
+			umword_t *_state() {
+				return (umword_t *)align_addr((addr_t)_data, log2(sizeof(umword_t))); }
+
+			enum { USED, FREE };
+
 			/**
 			 * Accessor functions to allocation state
 			 *
 			 * \param idx  index of slab entry
 			 */
-			inline bool state(int idx) { return _data[idx]; }
-			inline void state(int idx, bool state) { _data[idx] = state; }
+			inline bool state(int idx) {
+				return (_state()[idx / WORD_BITS] >> (idx % WORD_BITS)) & 1; }
+
+			inline void state(int idx, bool state)
+			{
+				umword_t &w = _state()[idx / WORD_BITS];
+				umword_t const bit = (umword_t)1 << (idx % WORD_BITS);
+				w = state == FREE ? (w | bit) : (w & ~bit);
+			}
 
 			/**
 			 * Request address of slab entry by its index
@@ -92,7 +115,7 @@ namespace Genode {
 			/**
 			 * Request number of available entries in block
 			 */
-			unsigned avail() { return _avail; }
+			unsigned avail() const { return _avail; }
 
 			/**
 			 * Allocate slab entry from block
@@ -159,15 +182,32 @@ namespace Genode {
 
 	/**
 	 * Slab allocator
+	 *
+	 * Slab blocks are kept on three lists according to their fill level.
+	 * Allocations are served from partially used blocks first, then from
+	 * empty ones. Empty blocks are kept for reuse up to a watermark. The
+	 * blocks beyond get returned to the backing store by the next
+	 * allocation because 'free' may be called from within the backing
+	 * store, for instance if the slab holds the meta data of an AVL
+	 * allocator that backs the slab itself.
 	 */
 	class Slab : public Allocator
 	{
+		friend class Slab_block;
+
 		private:
 
+			enum { EMPTY_BLOCKS_CACHED = 2 };
+
 			size_t      _slab_size;     /* size of one slab entry               */
 			size_t      _block_size;    /* size of slab block                   */
 			size_t      _num_elem;      /* number of slab entries per block     */
-			Slab_block *_first_sb;      /* first slab block                     */
+			Slab_block *_partial;       /* blocks with used and free entries    */
+			Slab_block *_full;          /* blocks without free entries          */
+			Slab_block *_empty;         /* blocks without used entries          */
+			size_t      _num_empty;     /* number of blocks in '_empty'         */
+			size_t      _num_blocks;    /* number of all blocks                 */
+			size_t      _free_entries;  /* free entries of all blocks           */
 			Slab_block *_initial_sb;    /* initial (static) slab block          */
 			bool        _alloc_state;   /* indicator for 'currently in service' */
 
@@ -178,6 +218,38 @@ namespace Genode {
 			 */
 			Slab_block *_new_slab_block();
 
+			/**
+			 * Return list that holds blocks with 'avail' free entries
+			 */
+			Slab_block **_list(unsigned avail);
+
+			/**
+			 * Remove block from list
+			 */
+			void _remove(Slab_block **list, Slab_block *sb);
+
+			/**
+			 * Insert block at the head of list
+			 */
+			void _insert(Slab_block **list, Slab_block *sb);
+
+			/**
+			 * Add initialized block to the slab
+			 */
+			void _add(Slab_block *sb);
+
+			/**
+			 * Move block to the list that matches its fill level
+			 *
+			 * \param old_avail  free entries of the block before the change
+			 */
+			void _avail_changed(Slab_block *sb, unsigned old_avail);
+
+			/**
+			 * Return empty blocks beyond the watermark to the backing store
+			 */
+			void _release_empty_blocks();
+
 		public:
 
 			inline size_t slab_size()  { return _slab_size;  }
@@ -206,16 +278,6 @@ namespace Genode {
 			 */
 			void dump_sb_list();
 
-			/**
-			 * Remove block from slab block list
-			 */
-			void remove_sb(Slab_block *sb);
-
-			/**
-			 * Insert block into slab block list
-			 */
-			void insert_sb(Slab_block *sb, Slab_block *at = 0);
-
 			/**
 			 * Allocate slab entry
 			 */
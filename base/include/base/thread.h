@@ -42,7 +42,7 @@
  */
 
 /*
- * Copyright (C) 2006-2012 Genode Labs GmbH
+ * Copyright (C) 2006-2013 Genode Labs GmbH
  *
  * This file is part of the Genode OS framework, which is distributed
  * under the terms of the GNU General Public License version 2.
@@ -230,6 +230,14 @@ namespace Genode {
 			 */
 			void _deinit_platform_thread();
 
+			/**
+			 * Release the per-thread state of generic framework parts
+			 *
+			 * Gets called by each platform-specific destructor while the
+			 * thread object is still intact.
+			 */
+			void _deinit_generic_thread();
+
 			/* hook only used for microblaze kernel */
 			void _init_context(Context* c);
 
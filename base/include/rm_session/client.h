@@ -49,6 +49,9 @@ namespace Genode {
 			return call<Rpc_dataspace>(); }
 
 		void processed(State state) { call<Rpc_processed>(state); }
+
+		bool decode_faults(bool const enable) {
+			return call<Rpc_decode_faults>(enable); }
 	};
 }
 
@@ -74,10 +74,15 @@ namespace Genode {
 			 */
 			unsigned * instr;
 
+			/**
+			 * Wether 'format' and 'value' were already decoded by core
+			 */
+			bool decoded;
+
 			/**
 			 * Default constructor
 			 */
-			State() : type(READY), addr(0), value(0) { }
+			State() : type(READY), addr(0), value(0), decoded(0) { }
 
 			/**
 			 * Constructor
@@ -87,8 +92,8 @@ namespace Genode {
 			      unsigned const fault_value = 0,
 			      unsigned * const fault_instr = 0)
 			:
-				type(fault_type), addr(fault_addr), value(fault_value),
-				instr(fault_instr)
+				type(fault_type), addr(fault_addr), imprint(imprint),
+				value(fault_value), instr(fault_instr), decoded(0)
 			{ }
 
 			/**
@@ -181,6 +186,23 @@ namespace Genode {
 			while(1);
 		};
 
+		/**
+		 * Let core decode the faulting instructions of this session
+		 *
+		 * \param  enable  wether to decode faults in core from now on
+		 * \return         wether faults get decoded in core
+		 *
+		 * If enabled, a fault at the session that was caused by a single
+		 * load or store instruction gets reported with a 'State' that is
+		 * flagged as decoded and already contains the access format and,
+		 * for stores, the value to be written. 'processed' then writes
+		 * back the 'value' of a load and lets the faulter continue
+		 * behind the instruction. Thereby, the fault handler doesn't
+		 * need to fetch and modify the state of the faulter itself.
+		 * Faults that core fails to decode are reported as usual.
+		 */
+		virtual bool decode_faults(bool const enable) { return 0; }
+
 		/**
 		 * Shortcut for attaching a dataspace at a predefined local address
 		 */
@@ -248,9 +270,11 @@ namespace Genode {
 		GENODE_RPC(Rpc_fault_handler, void, fault_handler, Signal_context_capability);
 		GENODE_RPC(Rpc_state, State, state);
 		GENODE_RPC(Rpc_dataspace, Dataspace_capability, dataspace);
+		GENODE_RPC(Rpc_decode_faults, bool, decode_faults, bool);
 
 		GENODE_RPC_INTERFACE(Rpc_attach, Rpc_processed, Rpc_detach, Rpc_add_client,
-		                     Rpc_fault_handler, Rpc_state, Rpc_dataspace);
+		                     Rpc_fault_handler, Rpc_state, Rpc_dataspace,
+		                     Rpc_decode_faults);
 	};
 }
 
@@ -145,6 +145,27 @@ namespace Genode {
 				return result;
 			}
 	};
+
+
+	/**
+	 * Helper for using member variables as fifo elements
+	 *
+	 * \param T  type of compound object to be organized in a fifo
+	 *
+	 * Analogous to 'List_element', this allows for enqueuing objects that
+	 * do not publicly inherit 'Fifo<QT>::Element'.
+	 */
+	template <typename T>
+	class Fifo_element : public Fifo<Fifo_element<T> >::Element
+	{
+		T *_object;
+
+		public:
+
+			Fifo_element(T *object) : _object(object) { }
+
+			T *object() { return _object; }
+	};
 }
 
 #endif /* _INCLUDE__UTIL__FIFO_H_ */
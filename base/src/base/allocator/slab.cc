@@ -5,7 +5,7 @@
  */
 
 /*
- * Copyright (C) 2006-2012 Genode Labs GmbH
+ * Copyright (C) 2006-2013 Genode Labs GmbH
  *
  * This file is part of the Genode OS framework, which is distributed
  * under the terms of the GNU General Public License version 2.
@@ -33,6 +33,10 @@ void Slab_block::slab(Slab *slab)
 	_avail = _slab->num_elem();
 	next   = prev = 0;
 
+	/* mark all entries as free, the bits beyond stay cleared */
+	size_t const words = bitmap_words(_avail);
+	for (unsigned i = 0; i < words; i++)
+		_state()[i] = 0;
 	for (unsigned i = 0; i < _avail; i++)
 		state(i, FREE);
 }
@@ -41,12 +45,11 @@ void Slab_block::slab(Slab *slab)
 Slab_entry *Slab_block::slab_entry(int idx)
 {
 	/*
-	 * The slab slots start after the state array that consists
-	 * of 'num_elem' bytes. We align the first slot to a four-aligned
-	 * address.
+	 * The slab slots start after the state table that consists
+	 * of 'num_elem' bits rounded up to whole words.
 	 */
-	return (Slab_entry *)&_data[align_addr(_slab->num_elem(), 2)
-	                            + _slab->entry_size()*idx];
+	addr_t const entries = (addr_t)(_state() + bitmap_words(_slab->num_elem()));
+	return (Slab_entry *)(entries + _slab->entry_size()*idx);
 }
 
 
@@ -56,24 +59,37 @@ int Slab_block::slab_entry_idx(Slab_entry *e) {
 
 void *Slab_block::alloc()
 {
-	size_t num_elem = _slab->num_elem();
-	for (unsigned i = 0; i < num_elem; i++)
-		if (state(i) == FREE) {
-			state(i, USED);
-			Slab_entry *e = slab_entry(i);
-			e->occupy(this);
-			return e->addr();
-		}
+	size_t const words = bitmap_words(_slab->num_elem());
+	umword_t * const state = _state();
+	for (unsigned i = 0; i < words; i++) {
+		if (!state[i])
+			continue;
+
+		int const idx = i * WORD_BITS + __builtin_ctzl(state[i]);
+		this->state(idx, USED);
+		Slab_entry *e = slab_entry(idx);
+		e->occupy(this);
+		return e->addr();
+	}
 	return 0;
 }
 
 
 Slab_entry *Slab_block::first_used_entry()
 {
-	size_t num_elem = _slab->num_elem();
-	for (unsigned i = 0; i < num_elem; i++)
-		if (state(i) == USED)
-			return slab_entry(i);
+	size_t const num_elem = _slab->num_elem();
+	size_t const words    = bitmap_words(num_elem);
+	umword_t * const state = _state();
+	for (unsigned i = 0; i < words; i++) {
+
+		/* bits beyond 'num_elem' are cleared but do not denote used entries */
+		umword_t used = ~state[i];
+		size_t const valid = num_elem - i * WORD_BITS;
+		if (valid < WORD_BITS)
+			used &= ((umword_t)1 << valid) - 1;
+		if (used)
+			return slab_entry(i * WORD_BITS + __builtin_ctzl(used));
+	}
 	return 0;
 }
 
@@ -84,40 +100,14 @@ void Slab_block::inc_avail(Slab_entry *e)
 	int idx = slab_entry_idx(e);
 	state(idx, FREE);
 	_avail++;
-
-	/* search previous block with higher avail value than this' */
-	Slab_block *at = prev;
-
-	while (at && (at->avail() < _avail))
-		at = at->prev;
-
-	/*
-	 * If we already are the first block or our avail value is lower than the
-	 * previous block, do not reposition the block in the list.
-	 */
-	if (prev == 0 || at == prev)
-		return;
-
-	/* reposition block in list after block with higher avail value */
-	_slab->remove_sb(this);
-	_slab->insert_sb(this, at);
+	_slab->_avail_changed(this, _avail - 1);
 }
 
 
 void Slab_block::dec_avail()
 {
 	_avail--;
-
-	/* search subsequent block with lower avail value than this' */
-	Slab_block *at = this;
-
-	while (at->next && at->next->avail() > _avail)
-		at = at->next;
-
-	if (at == this) return;
-
-	_slab->remove_sb(this);
-	_slab->insert_sb(this, at);
+	_slab->_avail_changed(this, _avail + 1);
 }
 
 
@@ -129,7 +119,10 @@ Slab::Slab(size_t slab_size, size_t block_size, Slab_block *initial_sb,
                                                 Allocator *backing_store)
 : _slab_size(slab_size),
   _block_size(block_size),
-  _first_sb(initial_sb),
+  _partial(0), _full(0), _empty(0),
+  _num_empty(0),
+  _num_blocks(0),
+  _free_entries(0),
   _initial_sb(initial_sb),
   _alloc_state(false),
   _backing_store(backing_store)
@@ -137,35 +130,44 @@ Slab::Slab(size_t slab_size, size_t block_size, Slab_block *initial_sb,
 	/*
 	 * Calculate number of entries per slab block.
 	 *
-	 * The 'sizeof(umword_t)' is for the alignment of the first slab entry.
-	 * The 1 is for one byte state entry.
+	 * The 'sizeof(umword_t)' is for the alignment of the state table.
+	 * Each entry needs one bit in the state table, which is rounded up
+	 * to whole words.
 	 */
-	_num_elem = (_block_size - sizeof(Slab_block) - sizeof(umword_t))
-	          / (entry_size() + 1);
+	size_t const space = _block_size - sizeof(Slab_block) - sizeof(umword_t);
+	_num_elem = space * 8 / (entry_size() * 8 + 1);
+	while (_num_elem && Slab_block::bitmap_words(_num_elem) * sizeof(umword_t)
+	                    + _num_elem * entry_size() > space)
+		_num_elem--;
 
 	/* if no initial slab block was specified, try to get one */
-	if (!_first_sb && _backing_store)
-		_first_sb = _new_slab_block();
+	Slab_block *sb = _initial_sb;
+	if (!sb && _backing_store)
+		sb = _new_slab_block();
 
 	/* init first slab block */
-	if (_first_sb)
-		_first_sb->slab(this);
+	if (sb) {
+		sb->slab(this);
+		_add(sb);
+	}
 }
 
 
 Slab::~Slab()
 {
 	/* free backing store */
-	while (_first_sb) {
-		Slab_block *sb = _first_sb;
-		remove_sb(_first_sb);
-
-		/*
-		 * Only free slab blocks that we allocated. This is not the case for
-		 * the '_initial_sb' that we got as constructor argument.
-		 */
-		if (_backing_store && (sb != _initial_sb))
-			_backing_store->free(sb, _block_size);
+	Slab_block **lists[] = { &_partial, &_full, &_empty };
+	for (unsigned i = 0; i < sizeof(lists)/sizeof(lists[0]); i++) {
+		while (Slab_block *sb = *lists[i]) {
+			_remove(lists[i], sb);
+
+			/*
+			 * Only free slab blocks that we allocated. This is not the case
+			 * for the '_initial_sb' that we got as constructor argument.
+			 */
+			if (_backing_store && (sb != _initial_sb))
+				_backing_store->free(sb, _block_size);
+		}
 	}
 }
 
@@ -181,7 +183,15 @@ Slab_block *Slab::_new_slab_block()
 }
 
 
-void Slab::remove_sb(Slab_block *sb)
+Slab_block **Slab::_list(unsigned avail)
+{
+	if (avail == 0)         return &_full;
+	if (avail == _num_elem) return &_empty;
+	return &_partial;
+}
+
+
+void Slab::_remove(Slab_block **list, Slab_block *sb)
 {
 	Slab_block *prev = sb->prev;
 	Slab_block *next = sb->next;
@@ -189,47 +199,86 @@ void Slab::remove_sb(Slab_block *sb)
 	if (prev) prev->next = next;
 	if (next) next->prev = prev;
 
-	if (_first_sb == sb)
-		_first_sb =  next;
+	if (*list == sb)
+		*list = next;
 
 	sb->prev = sb->next = 0;
+
+	if (list == &_empty)
+		_num_empty--;
 }
 
 
-void Slab::insert_sb(Slab_block *sb, Slab_block *at)
+void Slab::_insert(Slab_block **list, Slab_block *sb)
 {
-	/* determine next-pointer where to assign the current sb */
-	Slab_block **nextptr_to_sb = at ? &at->next : &_first_sb;
-
-	/* insert current sb */
-	sb->next = *nextptr_to_sb;
-	*nextptr_to_sb = sb;
-
-	/* update prev-pointer or succeeding block */
+	sb->prev = 0;
+	sb->next = *list;
 	if (sb->next)
 		sb->next->prev = sb;
+	*list = sb;
 
-	sb->prev = at;
+	if (list == &_empty)
+		_num_empty++;
 }
 
 
-bool Slab::num_free_entries_higher_than(int n)
+void Slab::_add(Slab_block *sb)
 {
-	int cnt = 0;
+	_insert(_list(sb->avail()), sb);
+	_num_blocks++;
+	_free_entries += sb->avail();
+}
+
 
-	for (Slab_block *b = _first_sb; b && b->avail() > 0; b = b->next) {
-		cnt += b->avail();
-		if (cnt > n)
-			return true;
+void Slab::_avail_changed(Slab_block *sb, unsigned old_avail)
+{
+	_free_entries = _free_entries + sb->avail() - old_avail;
+
+	Slab_block **old_list = _list(old_avail);
+	Slab_block **new_list = _list(sb->avail());
+	if (old_list == new_list)
+		return;
+
+	_remove(old_list, sb);
+	_insert(new_list, sb);
+}
+
+
+void Slab::_release_empty_blocks()
+{
+	Slab_block *sb = _empty;
+	while (sb && _num_empty > EMPTY_BLOCKS_CACHED) {
+
+		if (sb == _initial_sb) {
+			sb = sb->next;
+			continue;
+		}
+		_remove(&_empty, sb);
+		_num_blocks--;
+		_free_entries -= sb->avail();
+		_backing_store->free(sb, _block_size);
+
+		/* the backing store may have used entries of the slab meanwhile */
+		sb = _empty;
 	}
-	return false;
 }
 
 
+bool Slab::num_free_entries_higher_than(int n) {
+	return _free_entries > (size_t)n; }
+
+
 bool Slab::alloc(size_t size, void **out_addr)
 {
-	/* sanity check if first slab block is gone */
-	if (!_first_sb) return false;
+	/*
+	 * Release surplus empty blocks here rather than in 'free', which may
+	 * be called from within the backing store.
+	 */
+	if (_backing_store && _num_empty > EMPTY_BLOCKS_CACHED && !_alloc_state) {
+		_alloc_state = true;
+		_release_empty_blocks();
+		_alloc_state = false;
+	}
 
 	/*
 	 * If we run out of slab, we need to allocate a new slab block. For the
@@ -248,15 +297,16 @@ bool Slab::alloc(size_t size, void **out_addr)
 
 		if (!sb) return false;
 
-		/*
-		 * The new block has the maximum number of available slots and
-		 * so we can insert it at the beginning of the sorted block
-		 * list.
-		 */
-		insert_sb(sb);
+		_add(sb);
 	}
 
-	*out_addr = _first_sb->alloc();
+	/* prefer partially used blocks to let empty blocks drain */
+	Slab_block *sb = _partial ? _partial : _empty;
+
+	/* sanity check if all slab blocks are gone */
+	if (!sb) return false;
+
+	*out_addr = sb->alloc();
 	return *out_addr == 0 ? false : true;
 }
 
@@ -271,26 +321,16 @@ void Slab::free(void *addr)
 
 void *Slab::first_used_elem()
 {
-	for (Slab_block *b = _first_sb; b; b = b->next) {
-
-		/* skip completely free slab blocks */
-		if (b->avail() == _num_elem)
-			continue;
+	Slab_block *lists[] = { _full, _partial };
+	for (unsigned i = 0; i < sizeof(lists)/sizeof(lists[0]); i++) {
 
 		/* found a block with used elements - return address of the first one */
-		Slab_entry *e = b->first_used_entry();
+		if (!lists[i]) continue;
+		Slab_entry *e = lists[i]->first_used_entry();
 		if (e) return e->addr();
 	}
 	return 0;
 }
 
 
-size_t Slab::consumed()
-{
-	/* count number of slab blocks */
-	unsigned sb_cnt = 0;
-	for (Slab_block *sb = _first_sb; sb; sb = sb->next)
-		sb_cnt++;
-
-	return sb_cnt * _block_size;
-}
+size_t Slab::consumed() { return _num_blocks * _block_size; }
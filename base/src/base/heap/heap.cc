@@ -5,7 +5,7 @@
  */
 
 /*
- * Copyright (C) 2006-2012 Genode Labs GmbH
+ * Copyright (C) 2006-2013 Genode Labs GmbH
  *
  * This file is part of the Genode OS framework, which is distributed
  * under the terms of the GNU General Public License version 2.
@@ -16,10 +16,101 @@
 #include <rm_session/rm_session.h>
 #include <base/heap.h>
 #include <base/lock.h>
+#include <base/thread.h>
+#include <util/string.h>
+#include <cpu/atomic.h>
 
 using namespace Genode;
 
 
+/**
+ * Header in front of each block, holds the size of the block
+ *
+ * With the size at hand, 'free' can tell the size class of a block
+ * without relying on the size argument of the caller.
+ */
+typedef umword_t Block_header;
+
+
+/**
+ * Marks slots of threads whose magazines got flushed
+ */
+static Thread_base * const FLUSHED_THREAD = (Thread_base *)1;
+
+
+/**
+ * Heaps with magazines, used for flushing the magazines of exiting threads
+ */
+static List<List_element<Heap> > *magazine_heaps()
+{
+	static List<List_element<Heap> > heaps;
+	return &heaps;
+}
+
+
+static Lock *magazine_heaps_lock()
+{
+	static Lock lock;
+	return &lock;
+}
+
+
+/**
+ * Size class of blocks of 'size' bytes
+ *
+ * Up to 128 bytes, classes are 16 bytes apart. Above, there are four
+ * classes per power of two.
+ */
+static unsigned size_class(size_t const size)
+{
+	if (size <= 128) return size ? (size - 1) / 16 : 0;
+
+	unsigned const log2 = (sizeof(unsigned long) * 8 - 1) -
+	                      __builtin_clzl(size - 1);
+	return 8 + (log2 - 7) * 4 + ((size - 1) >> (log2 - 2)) - 4;
+}
+
+
+/**
+ * Size of the blocks of size class 'cls'
+ */
+static size_t class_size(unsigned const cls)
+{
+	if (cls < 8) return (cls + 1) * 16;
+
+	unsigned const log2 = (cls - 8) / 4 + 7;
+	return (size_t)(4 + (cls - 8) % 4 + 1) << (log2 - 2);
+}
+
+
+static unsigned thread_hash(Thread_base * const thread)
+{
+	addr_t const a = (addr_t)thread;
+	return a >> 4 ^ a >> 12;
+}
+
+
+Heap::Guard::Guard(Heap &heap) : _heap(heap)
+{
+	int users;
+	do users = _heap._lock_users;
+	while (!cmpxchg(&_heap._lock_users, users, users + 1));
+
+	_heap._lock.lock();
+	if (users) _heap._stats.contended++;
+}
+
+
+Heap::Guard::~Guard()
+{
+	_heap._lock.unlock();
+
+	int users;
+	do users = _heap._lock_users;
+	while (!cmpxchg(&_heap._lock_users, users, users - 1));
+}
+
+
 Heap::Dataspace_pool::~Dataspace_pool()
 {
 	/* free all ram_dataspaces */
@@ -88,15 +179,13 @@ bool Heap::_try_local_alloc(size_t size, void **out_addr)
 		return false;
 
 	_quota_used += size;
+	_used = true;
 	return true;
 }
 
 
-bool Heap::alloc(size_t size, void **out_addr)
+bool Heap::_unsynchronized_alloc(size_t size, void **out_addr)
 {
-	/* serialize access of heap functions */
-	Lock::Guard lock_guard(_lock);
-
 	/* check requested allocation against quota limit */
 	if (size + _quota_used > _quota_limit)
 		return false;
@@ -132,11 +221,8 @@ bool Heap::alloc(size_t size, void **out_addr)
 }
 
 
-void Heap::free(void *addr, size_t size)
+void Heap::_unsynchronized_free(void *addr, size_t size)
 {
-	/* serialize access of heap functions */
-	Lock::Guard lock_guard(_lock);
-
 	/* forward request to our local allocator */
 	_alloc.free(addr, size);
 
@@ -147,3 +233,296 @@ void Heap::free(void *addr, size_t size)
 	 * Yes, we could...
 	 */
 }
+
+
+Heap::Magazine_set *Heap::_magazine_set()
+{
+	if (!_magazines) return 0;
+
+	/* the main thread has no thread object, it uses the heap directly */
+	Thread_base * const myself = Thread_base::myself();
+	if (!myself) return 0;
+
+	/*
+	 * Only the owner enters its slot and slots never become free again.
+	 * Hence, the lookup needs no lock.
+	 */
+	unsigned const start = thread_hash(myself) % MAX_THREADS;
+	for (unsigned i = 0; i < MAX_THREADS; i++) {
+		Thread_slot &s = _threads[(start + i) % MAX_THREADS];
+		if (s.thread == myself) return s.set;
+		if (!s.thread) break;
+	}
+
+	Guard guard(*this);
+	for (unsigned i = 0; i < MAX_THREADS; i++) {
+		Thread_slot &s = _threads[(start + i) % MAX_THREADS];
+		if (s.thread && s.thread != FLUSHED_THREAD) continue;
+
+		void *set = 0;
+		if (!_unsynchronized_alloc(sizeof(Magazine_set), &set)) return 0;
+		memset(set, 0, sizeof(Magazine_set));
+		s.set    = (Magazine_set *)set;
+		s.thread = myself;
+		return s.set;
+	}
+	/* the thread uses the heap directly if all slots are taken */
+	return 0;
+}
+
+
+void Heap::_release_magazine(unsigned const cls, Magazine * const m)
+{
+	Depot &d = _depot[cls];
+	if (m->count && d.num_full < MAX_DEPOT) {
+		m->next = d.full;
+		d.full  = m;
+		d.num_full++;
+		return;
+	}
+	for (; m->count; m->count--)
+		_unsynchronized_free(m->blocks[m->count - 1], class_size(cls));
+
+	m->next = d.empty;
+	d.empty = m;
+}
+
+
+bool Heap::_class_alloc(unsigned const cls, void **out_addr)
+{
+	Magazine_set * const set = _magazine_set();
+	if (set) {
+		Magazine *&loaded   = set->loaded[cls];
+		Magazine *&previous = set->previous[cls];
+
+		if (!(loaded && loaded->count) && previous && previous->count) {
+			Magazine * const m = loaded;
+			loaded   = previous;
+			previous = m;
+		}
+		if (loaded && loaded->count) {
+			set->hits++;
+			*out_addr = loaded->blocks[--loaded->count];
+			return true;
+		}
+	}
+
+	Guard guard(*this);
+	if (!set) return _unsynchronized_alloc(class_size(cls), out_addr);
+
+	set->misses++;
+
+	/*
+	 * Both magazines are empty, keep the loaded one as previous and load
+	 * a full one of the depot.
+	 */
+	Depot &d = _depot[cls];
+	if (!d.full) return _unsynchronized_alloc(class_size(cls), out_addr);
+
+	Magazine *&loaded   = set->loaded[cls];
+	Magazine *&previous = set->previous[cls];
+	if (previous) {
+		previous->next = d.empty;
+		d.empty        = previous;
+	}
+	previous = loaded;
+	loaded   = d.full;
+	d.full = loaded->next;
+	d.num_full--;
+	_stats.exchanges++;
+
+	*out_addr = loaded->blocks[--loaded->count];
+	return true;
+}
+
+
+void Heap::_class_free(unsigned const cls, void *addr)
+{
+	Magazine_set * const set = _magazine_set();
+	if (set) {
+		Magazine *&loaded   = set->loaded[cls];
+		Magazine *&previous = set->previous[cls];
+
+		if (loaded && loaded->count == MAGAZINE_SIZE && previous &&
+		    previous->count < MAGAZINE_SIZE) {
+			Magazine * const m = loaded;
+			loaded   = previous;
+			previous = m;
+		}
+		if (loaded && loaded->count < MAGAZINE_SIZE) {
+			set->hits++;
+			loaded->blocks[loaded->count++] = addr;
+			return;
+		}
+	}
+
+	Guard guard(*this);
+	if (!set) {
+		_unsynchronized_free(addr, class_size(cls));
+		return;
+	}
+
+	set->misses++;
+
+	/*
+	 * Both magazines are full, keep the loaded one as previous and load
+	 * an empty one of the depot.
+	 */
+	Depot &d = _depot[cls];
+	void *empty = d.empty;
+	if (empty)
+		d.empty = d.empty->next;
+	else if (!_unsynchronized_alloc(sizeof(Magazine), &empty)) {
+		_unsynchronized_free(addr, class_size(cls));
+		return;
+	}
+
+	Magazine *&loaded   = set->loaded[cls];
+	Magazine *&previous = set->previous[cls];
+	if (previous) {
+		_release_magazine(cls, previous);
+		_stats.exchanges++;
+	}
+	previous = loaded;
+	loaded   = (Magazine *)empty;
+	loaded->count = 0;
+	loaded->blocks[loaded->count++] = addr;
+}
+
+
+void Heap::_flush_magazines(Thread_base * const thread)
+{
+	Guard guard(*this);
+
+	unsigned const start = thread_hash(thread) % MAX_THREADS;
+	for (unsigned i = 0; i < MAX_THREADS; i++) {
+		Thread_slot &s = _threads[(start + i) % MAX_THREADS];
+		if (!s.thread) return;
+		if (s.thread != thread) continue;
+
+		for (unsigned cls = 0; cls < NUM_CLASSES; cls++) {
+			if (s.set->loaded[cls])
+				_release_magazine(cls, s.set->loaded[cls]);
+			if (s.set->previous[cls])
+				_release_magazine(cls, s.set->previous[cls]);
+		}
+		_stats.hits   += s.set->hits;
+		_stats.misses += s.set->misses;
+		_unsynchronized_free(s.set, sizeof(Magazine_set));
+
+		s.set    = 0;
+		s.thread = FLUSHED_THREAD;
+		return;
+	}
+}
+
+
+void Heap::flush_magazines(Thread_base * const thread)
+{
+	Lock::Guard lock_guard(*magazine_heaps_lock());
+
+	for (List_element<Heap> *h = magazine_heaps()->first(); h; h = h->next())
+		h->object()->_flush_magazines(thread);
+}
+
+
+/*
+ * The heap is the only generic part of the base library that keeps state
+ * per thread. Therefore, the destruction hook of threads is implemented
+ * here.
+ */
+void Thread_base::_deinit_generic_thread()
+{
+	/* hand blocks cached by the thread over to the other threads */
+	Heap::flush_magazines(this);
+}
+
+
+bool Heap::enable_magazines()
+{
+	Lock::Guard lock_guard(*magazine_heaps_lock());
+	Guard guard(*this);
+
+	if (_magazines) return true;
+
+	/* blocks allocated so far have no block header */
+	if (_used) {
+		PWRN("heap already in use, magazines stay disabled");
+		return false;
+	}
+	magazine_heaps()->insert(&_heaps_elem);
+	_magazines = true;
+	return true;
+}
+
+
+Heap::Magazine_stats Heap::magazine_stats()
+{
+	Guard guard(*this);
+
+	Magazine_stats stats = _stats;
+	for (unsigned i = 0; i < MAX_THREADS; i++) {
+		Thread_slot &s = _threads[i];
+		if (!s.set) continue;
+		stats.hits   += s.set->hits;
+		stats.misses += s.set->misses;
+	}
+	return stats;
+}
+
+
+Heap::~Heap()
+{
+	if (!_magazines) return;
+
+	Lock::Guard lock_guard(*magazine_heaps_lock());
+	magazine_heaps()->remove(&_heaps_elem);
+}
+
+
+bool Heap::alloc(size_t size, void **out_addr)
+{
+	/* without magazines, blocks have exactly the requested size */
+	if (!_magazines) {
+		Guard guard(*this);
+		return _unsynchronized_alloc(size, out_addr);
+	}
+
+	size_t const real_size = size + sizeof(Block_header);
+	void *block = 0;
+
+	if (real_size <= MAX_CLASS_SIZE) {
+		unsigned const cls = size_class(real_size);
+		if (!_class_alloc(cls, &block)) return false;
+		*(Block_header *)block = class_size(cls);
+	} else {
+		Guard guard(*this);
+		if (!_unsynchronized_alloc(real_size, &block)) return false;
+		*(Block_header *)block = real_size;
+	}
+	*out_addr = (Block_header *)block + 1;
+	return true;
+}
+
+
+void Heap::free(void *addr, size_t size)
+{
+	if (!addr) return;
+
+	if (!_magazines) {
+		Guard guard(*this);
+		_unsynchronized_free(addr, size);
+		return;
+	}
+
+	Block_header * const block = (Block_header *)addr - 1;
+	size_t const real_size = *block;
+
+	if (real_size <= MAX_CLASS_SIZE) {
+		_class_free(size_class(real_size), block);
+		return;
+	}
+
+	Guard guard(*this);
+	_unsynchronized_free(block, real_size);
+}
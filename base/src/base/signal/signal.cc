@@ -114,33 +114,49 @@ namespace Genode {
 		private:
 
 			/*
-			 * Currently, the registry is just a linked list. If this becomes a
-			 * scalability problem, we might introduce a more sophisticated
-			 * associative data structure.
+			 * The registry is a hash table that is indexed by the context
+			 * address, so the lookup doesn't depend on the number of
+			 * contexts in the common case.
 			 */
-			Lock mutable                        _lock;
-			List<List_element<Signal_context> > _list;
+			enum { BUCKETS_LOG2 = 8, BUCKETS = 1 << BUCKETS_LOG2 };
+
+			typedef List<List_element<Signal_context> > Bucket;
+
+			Lock mutable _lock;
+			Bucket       _buckets[BUCKETS];
+
+			/**
+			 * Return bucket index of 'context'
+			 *
+			 * Contexts are at least word aligned, so the lowest address
+			 * bits are skipped.
+			 */
+			static unsigned _bucket(Signal_context const *context)
+			{
+				addr_t const a = (addr_t)context;
+				return ((a >> 4) ^ (a >> (4 + BUCKETS_LOG2))) & (BUCKETS - 1);
+			}
 
 		public:
 
 			void insert(List_element<Signal_context> *le)
 			{
 				Lock::Guard guard(_lock);
-				_list.insert(le);
+				_buckets[_bucket(le->object())].insert(le);
 			}
 
 			void remove(List_element<Signal_context> *le)
 			{
 				Lock::Guard guard(_lock);
-				_list.remove(le);
+				_buckets[_bucket(le->object())].remove(le);
 			}
 
 			bool test_and_lock(Signal_context *context) const
 			{
 				Lock::Guard guard(_lock);
 
-				/* search list for context */
-				List_element<Signal_context> *le = _list.first();
+				/* search bucket for context */
+				List_element<Signal_context> *le = _buckets[_bucket(context)].first();
 				for ( ; le; le = le->next()) {
 
 					if (context == le->object()) {
@@ -201,6 +217,15 @@ void Signal_receiver::_unsynchronized_dissolve(Signal_context *context)
 	/* remove context from context list */
 	_contexts.remove(&context->_receiver_le);
 
+	/* forget about a pending signal of the context */
+	{
+		Lock::Guard context_guard(context->_lock);
+		Lock::Guard pending_guard(_pending_lock);
+		_pending.remove(&context->_pending_fe);
+		context->_pending = false;
+		context->_curr_signal = Signal(0, 0);
+	}
+
 	/* unregister context from process-wide registry */
 	signal_context_registry()->remove(&context->_registry_le);
 }
@@ -275,19 +300,8 @@ void Signal_receiver::dissolve(Signal_context *context)
 
 bool Signal_receiver::pending()
 {
-	Lock::Guard list_lock_guard(_contexts_lock);
-
-	/* look up the contexts for the pending signal */
-	for (List_element<Signal_context> *le = _contexts.first(); le; le = le->next()) {
-
-		Signal_context *context = le->object();
-
-		Lock::Guard lock_guard(context->_lock);
-
-		if (context->_pending)
-			return true;
-	}
-	return false;
+	Lock::Guard pending_guard(_pending_lock);
+	return !_pending.empty();
 }
 
 
@@ -298,41 +312,38 @@ Signal Signal_receiver::wait_for_signal()
 		/* block until the receiver has received a signal */
 		_signal_available.down();
 
+		/* prevent the pending context from getting dissolved meanwhile */
 		Lock::Guard list_lock_guard(_contexts_lock);
 
-		/* look up the contexts for the pending signal */
-		for (List_element<Signal_context> *le = _contexts.first(); le; le = le->next()) {
-
-			Signal_context *context = le->object();
-
-			Lock::Guard lock_guard(context->_lock);
-
-			/* check if context has a pending signal */
-			if (!context->_pending)
-				continue;
+		/* take the context that is pending for the longest time */
+		Fifo_element<Signal_context> *fe;
+		{
+			Lock::Guard pending_guard(_pending_lock);
+			fe = _pending.dequeue();
+		}
+		/*
+		 * Normally, we should always find a pending context because the
+		 * '_signal_available' semaphore gets increased only when a context
+		 * gets enqueued. However, if a context gets dissolved right after
+		 * submitting a signal, we may have increased the semaphore already
+		 * while the context has left the queue.
+		 */
+		if (!fe) continue;
 
-			context->_pending = false;
-			Signal result = context->_curr_signal;
+		Signal_context *context = fe->object();
+		Lock::Guard lock_guard(context->_lock);
 
-			/* invalidate current signal in context */
-			context->_curr_signal = Signal(0, 0);
+		context->_pending = false;
+		Signal result = context->_curr_signal;
 
-			if (result.num() == 0)
-				PWRN("returning signal with num == 0");
+		/* invalidate current signal in context */
+		context->_curr_signal = Signal(0, 0);
 
-			/* return last received signal */
-			return result;
-		}
+		if (result.num() == 0)
+			PWRN("returning signal with num == 0");
 
-		/*
-		 * Normally, we should never arrive at this point because that would
-		 * mean, the '_signal_available' semaphore was increased without
-		 * registering the signal in any context associated to the receiver.
-		 *
-		 * However, if a context gets dissolved right after submitting a
-		 * signal, we may have increased the semaphore already. In this case
-		 * the signal-causing context is absent from the list.
-		 */
+		/* return last received signal */
+		return result;
 	}
 	return Signal(0, 0); /* unreachable */
 }
@@ -353,6 +364,10 @@ void Signal_receiver::local_submit(Signal ns)
 	/* wake up the receiver if the context becomes pending */
 	if (!context->_pending) {
 		context->_pending = true;
+		{
+			Lock::Guard pending_guard(_pending_lock);
+			_pending.enqueue(&context->_pending_fe);
+		}
 		_signal_available.up();
 	}
 }
@@ -35,18 +35,6 @@
 
 namespace Genode {
 
-	/**
-	 * If instruction writes a word to the memory
-	 *
-	 * \param  code       Raw instruction code
-	 * \param  value      If call returns 1, this holds the value
-	 *                    that shall be written
-	 * \param  thread_id  ID of the faulter kernel-object
-	 */
-	bool instruction_writes_word(unsigned * const code,
-	                             unsigned & value,
-	                             unsigned const thread_id);
-
 	class Dataspace_component;
 	class Rm_session_component;
 	class Rm_client;
@@ -140,6 +128,17 @@ namespace Genode {
 				_imprint(imprint)
 			{ }
 
+			virtual ~Rm_faulter() { }
+
+			/**
+			 * Adjust faulter as if its decoded instruction has been executed
+			 *
+			 * \param fault  fault state as decoded by core
+			 * \param read   result of the emulated access if it was a load
+			 */
+			virtual void apply_decoded_fault(Rm_session::State const &fault,
+			                                 unsigned const read) = 0;
+
 			/**
 			 * Assign fault state
 			 */
@@ -172,8 +171,10 @@ namespace Genode {
 
 			/**
 			 * Continue faulter after its faulting instruction has been emulated
+			 *
+			 * \param state  emulation results as reported by the RM client
 			 */
-			void continue_after_processed_fault();
+			void continue_after_processed_fault(Rm_session::State const &state);
 	};
 
 
@@ -276,6 +277,8 @@ namespace Genode {
 			Pager_entrypoint             *_pager_ep;
 			Rm_dataspace_component        _ds;           /* dataspace representation of region map */
 			Dataspace_capability          _ds_cap;
+			bool                          _decode_faults; /* decode faulting
+			                                                 instructions in core */
 
 		public:
 
@@ -311,13 +314,25 @@ namespace Genode {
 			 * for resolution.
 			 *
 			 * \param  faulter  faulting region-manager client
+			 * \param  state    fault state to be exported via 'state'
+			 */
+			void fault(Rm_faulter *faulter, Rm_session::State state);
+
+			/**
+			 * Register fault
+			 *
+			 * \param  faulter  faulting region-manager client
 			 * \param  pf_addr  page-fault address
 			 * \param  pf_type  type of page fault (read/write/execute)
 			 */
 			void fault(Rm_faulter *faulter, addr_t pf_addr,
-			           Rm_session::Fault_type pf_type,
-			           unsigned pf_w_value = 0,
-			           unsigned * pf_instr = 0);
+			           Rm_session::Fault_type pf_type) {
+				fault(faulter, Rm_session::State(pf_type, pf_addr, 0)); }
+
+			/**
+			 * Wether faulting instructions shall be decoded in core
+			 */
+			bool decodes_faults() const { return _decode_faults; }
 
 			/**
 			 * Dissolve faulter from region-manager session
@@ -353,12 +368,22 @@ namespace Genode {
 			void             fault_handler (Signal_context_capability handler);
 			State            state         ();
 			Dataspace_capability dataspace () { return _ds_cap; }
+			bool             decode_faults (bool);
 	};
 
 
 	class Rm_client : public Pager_object, public Rm_member, public Rm_faulter,
 	                  public List<Rm_client>::Element
 	{
+		private:
+
+			unsigned _fault_reg; /* register operand of the last decoded fault */
+
+			/**
+			 * Try to decode the instruction at 'ip' that caused fault 'state'
+			 */
+			void _decode_fault(addr_t const ip, Rm_session::State &state);
+
 		public:
 
 			/**
@@ -375,7 +400,7 @@ namespace Genode {
 			          unsigned imprint)
 			:
 				Pager_object(badge), Rm_member(session),
-				Rm_faulter(this, imprint)
+				Rm_faulter(this, imprint), _fault_reg(0)
 			{ }
 
 			int pager(Ipc_pager &pager);
@@ -385,6 +410,26 @@ namespace Genode {
 			 */
 			void unmap(addr_t core_local_base, addr_t virt_base, size_t size);
 
+			/**
+			 * Decode the load/store instruction that caused the current fault
+			 *
+			 * \param instr  core-local pointer to the faulting instruction
+			 * \param state  fault state that receives the access format and,
+			 *               on stores, the value to be written
+			 * \return       wether the instruction could be decoded
+			 *
+			 * Platforms that lack an instruction decoder return 0.
+			 */
+			bool decode_fault(unsigned * const instr, Rm_session::State &state);
+
+
+			/****************
+			 ** Rm_faulter **
+			 ****************/
+
+			void apply_decoded_fault(Rm_session::State const &fault,
+			                         unsigned const read);
+
 			enum { MAX_NESTING_LEVELS = 5 };
 
 			/**
@@ -233,14 +233,20 @@ int Rm_client::pager(Ipc_pager &pager)
 		if (curr_rm_session == member_rm_session())
 			print_page_fault("no RM attachment", pf_addr, pf_ip, pf_type, badge());
 
-		/* Determine if the faulting instruction can be emulated. If this is
-		 * the case, we transmit some extra information to the pager to enable
-		 * emulation. Otherwise we skip this for efficiency */
-		unsigned   pf_writes = 0;
-		unsigned * pf_instr  = 0;
+		Rm_session::State fault_state(pf_type, dst_fault_area.fault_addr()
+		                                       - curr_rm_base, 0);
+
+		/*
+		 * If the session emulates the faulting instruction, decode it
+		 * right here. This spares the fault handler to fetch and modify
+		 * the state of the faulter through its CPU session.
+		 */
+		if (curr_rm_session->decodes_faults())
+			_decode_fault(pf_ip, fault_state);
+
 		/* register fault at responsible region-manager session */
-		curr_rm_session->fault(this, dst_fault_area.fault_addr() - curr_rm_base, 
-		                       pf_type, pf_writes, pf_instr);
+		curr_rm_session->fault(this, fault_state);
+
 		/* there is no attachment return an error condition */
 		return 1;
 	}
@@ -294,6 +300,38 @@ int Rm_client::pager(Ipc_pager &pager)
 }
 
 
+void Rm_client::_decode_fault(addr_t const ip, Rm_session::State &state)
+{
+	/* lookup the instruction within the address space of the faulter */
+	Rm_session_component            *rm_session = member_rm_session();
+	addr_t                           rm_base = 0;
+	Dataspace_component             *dataspace = 0;
+	Rm_session_component::Fault_area src_area;
+	Rm_session_component::Fault_area dst_area(ip);
+	bool                             lookup;
+	unsigned                         level;
+
+	lookup_attachment(rm_session, rm_base, dataspace,
+	                  src_area, dst_area, level, lookup);
+
+	if (!lookup || level == MAX_NESTING_LEVELS || !dataspace->core_local_addr())
+		return;
+
+	/* get core-local pointer to the instruction */
+	addr_t const offset = src_area.fault_addr() - dataspace->map_src_addr();
+	unsigned * const instr = (unsigned *)(dataspace->core_local_addr() + offset);
+
+	/* the fault type must be consistent with the decoded instruction */
+	Rm_session::State decoded = state;
+	if (!decode_fault(instr, decoded) || decoded.type != state.type)
+		return;
+
+	state = decoded;
+	state.instr   = instr;
+	state.decoded = 1;
+}
+
+
 /*************
  ** Faulter **
  *************/
@@ -332,9 +370,14 @@ void Rm_faulter::continue_after_resolved_fault()
 }
 
 
-void Rm_faulter::continue_after_processed_fault()
+void Rm_faulter::continue_after_processed_fault(Rm_session::State const &state)
 {
 	Lock::Guard lock_guard(_lock);
+
+	/* apply emulation results if core has decoded the fault */
+	if (_fault_state.decoded)
+		apply_decoded_fault(_fault_state, state.value);
+
 	_pager_object->wake_up();
 	_faulting_rm_session = 0;
 	_fault_state = Rm_session::State();
@@ -360,7 +403,7 @@ void Rm_session_component::processed(Rm_session_component::State state)
 		/* Reactivate faulter */
 		if (faulter->fault_state().imprint == state.imprint) {
 			_faulters.remove(faulter);
-			faulter->continue_after_processed_fault();
+			faulter->continue_after_processed_fault(state);
 		}
 		/* Get next faulter */
 		faulter = next;
@@ -691,17 +734,13 @@ bool Rm_session_component::reverse_lookup(addr_t                dst_base,
 }
 
 
-void Rm_session_component::fault(Rm_faulter *faulter, addr_t pf_addr,
-                                 Rm_session::Fault_type pf_type,
-                                 unsigned const pf_writes,
-                                 unsigned * const pf_instr)
+void Rm_session_component::fault(Rm_faulter *faulter, Rm_session::State state)
 {
-
 	/* serialize access */
 	Lock::Guard lock_guard(_lock);
 
 	/* remeber fault state in faulting thread */
-	faulter->fault(this, Rm_session::State(pf_type, pf_addr, 0, pf_writes, pf_instr));
+	faulter->fault(this, state);
 
 	/* enqueue faulter */
 	_faulters.enqueue(faulter);
@@ -743,6 +782,16 @@ Rm_session::State Rm_session_component::state()
 }
 
 
+bool Rm_session_component::decode_faults(bool const enable)
+{
+	/* serialize access */
+	Lock::Guard lock_guard(_lock);
+
+	_decode_faults = enable;
+	return _decode_faults;
+}
+
+
 void Rm_session_component::dissolve(Rm_client *cl)
 {
 	{
@@ -787,7 +836,8 @@ Rm_session_component::Rm_session_component(Rpc_entrypoint   *ds_ep,
 	_md_alloc(md_alloc, ram_quota),
 	_client_slab(&_md_alloc), _ref_slab(&_md_alloc),
 	_map(&_md_alloc), _pager_ep(pager_ep),
-	_ds(this, vm_size), _ds_cap(_type_deduction_helper(ds_ep->manage(&_ds)))
+	_ds(this, vm_size), _ds_cap(_type_deduction_helper(ds_ep->manage(&_ds))),
+	_decode_faults(false)
 {
 	/* configure managed VM area */
 	_map.add_range(vm_start, vm_size);
@@ -3,6 +3,7 @@
 #
 
 INC_DIR += $(REP_DIR)/src/lib/ffat/contrib
+INC_DIR += $(REP_DIR)/src/lib/ffat
 
 SRC_C  = ff.c ccsbcs.c
 SRC_CC = diskio_block.cc
@@ -5,31 +5,31 @@
  */
 
 /*
- * Copyright (C) 2011-2012 Genode Labs GmbH
+ * Copyright (C) 2011-2013 Genode Labs GmbH
  *
  * This file is part of the Genode OS framework, which is distributed
  * under the terms of the GNU General Public License version 2.
  */
 
 /* Genode includes */
-#include <base/allocator_avl.h>
 #include <base/printf.h>
-#include <block_session/connection.h>
 
 /* Ffat includes */
 extern "C" {
 #include <ffat/diskio.h>
 }
 
+/* local includes */
+#include <sector_cache.h>
+
 using namespace Genode;
 
 static bool const verbose = false;
 
-static Genode::Allocator_avl _block_alloc(Genode::env()->heap());
-static Block::Connection *_block_connection;
-static size_t _blk_size = 0;
-static size_t _blk_cnt  = 0;
-static Block::Session::Tx::Source *_source;
+enum { CACHE_SIZE = 256*1024 };
+
+static Diskio::Transport    *_transport;
+static Diskio::Sector_cache *_cache;
 
 
 extern "C" DSTATUS disk_initialize (BYTE drv)
@@ -50,21 +50,18 @@ extern "C" DSTATUS disk_initialize (BYTE drv)
 	}
 
 	try {
-		_block_connection = new (Genode::env()->heap()) Block::Connection(&_block_alloc);
+		_transport = new (Genode::env()->heap()) Diskio::Transport;
 	} catch(...) {
 		PERR("could not open block connection");
 		return STA_NOINIT;
 	}
 
-	_source = _block_connection->tx();
-
-	Block::Session::Operations  ops;
-	_block_connection->info(&_blk_cnt, &_blk_size, &ops);
+	Block::Session::Operations ops = _transport->operations();
 
 	/* check for read- and write-capability */
 	if (!ops.supported(Block::Packet_descriptor::READ)) {
 		PERR("Block device not readable!");
-		destroy(env()->heap(), _block_connection);
+		destroy(env()->heap(), _transport);
 		return STA_NOINIT;
 	}
 	if (!ops.supported(Block::Packet_descriptor::WRITE)) {
@@ -73,7 +70,9 @@ extern "C" DSTATUS disk_initialize (BYTE drv)
 
 	if (verbose)
 		PDBG("We have %zu blocks with a size of %zu bytes",
-		     _blk_cnt, _blk_size);
+		     _transport->block_count(), _transport->block_size());
+
+	_cache = new (Genode::env()->heap()) Diskio::Sector_cache(*_transport, CACHE_SIZE);
 
 	initialized = true;
 
@@ -103,29 +102,11 @@ extern "C" DRESULT disk_read(BYTE drv, BYTE *buff, DWORD sector, BYTE count)
 		return RES_ERROR;
 	}
 
-	/* allocate packet-descriptor for reading */
-	Block::Packet_descriptor p(_source->alloc_packet(_blk_size),
-	                           Block::Packet_descriptor::READ, sector, count);
-	_source->submit_packet(p);
-	p = _source->get_acked_packet();
-
-	/* check for success of operation */
-	if (!p.succeeded()) {
+	try { _cache->read(sector, count, (char *)buff); }
+	catch (Diskio::Io_error) {
 		PERR("Could not read block(s)");
-		_source->release_packet(p);
 		return RES_ERROR;
 	}
-
-	memcpy(buff, _source->packet_content(p), count * _blk_size);
-
-#if 0
-	PDBG("read() successful, contents of buff = \n");
-
-	for (unsigned int i = 0; i < count * _blk_size; i++)
-		PDBG("%8x: %2x %c", i, buff[i], buff[i] >= 32 ? buff[i] : '-');
-#endif
-
-	_source->release_packet(p);
 	return RES_OK;
 }
 
@@ -142,23 +123,12 @@ extern "C" DRESULT disk_write(BYTE drv, const BYTE *buff, DWORD sector, BYTE cou
 		return RES_ERROR;
 	}
 
-	/* allocate packet-descriptor for writing */
-	Block::Packet_descriptor p(_source->alloc_packet(_blk_size),
-	                           Block::Packet_descriptor::WRITE, sector, count);
-
-	memcpy(_source->packet_content(p), buff, count * _blk_size);
-
-	_source->submit_packet(p);
-	p = _source->get_acked_packet();
-
-	/* check for success of operation */
-	if (!p.succeeded()) {
+	/* small writes are kept in the cache until the next sync */
+	try { _cache->write(sector, count, (char const *)buff); }
+	catch (Diskio::Io_error) {
 		PERR("Could not write block(s)");
-		_source->release_packet(p);
 		return RES_ERROR;
 	}
-
-	_source->release_packet(p);
 	return RES_OK;
 }
 #endif /* _READONLY */
@@ -166,9 +136,46 @@ extern "C" DRESULT disk_write(BYTE drv, const BYTE *buff, DWORD sector, BYTE cou
 
 extern "C" DRESULT disk_ioctl(BYTE drv, BYTE ctrl, void *buff)
 {
+	if (drv != 0) {
+		PERR("Only one disk drive is supported at this time.");
+		return RES_ERROR;
+	}
+
+	switch (ctrl) {
+
+	case CTRL_SYNC:
+		try { _cache->flush(); }
+		catch (Diskio::Io_error) {
+			PERR("Could not write back cached block(s)");
+			return RES_ERROR;
+		}
+		_transport->sync();
+
+		if (verbose) {
+			Diskio::Stats const &s = _cache->stats();
+			PDBG("sectors: %lu hits, %lu misses, %lu read ahead, "
+			     "%lu written, %lu written back",
+			     s.hits, s.misses, s.readahead, s.writes, s.writebacks);
+		}
+		return RES_OK;
+
+	case GET_SECTOR_COUNT:
+		*(DWORD *)buff = _transport->block_count();
+		return RES_OK;
+
+	case GET_SECTOR_SIZE:
+		*(WORD *)buff = _transport->block_size();
+		return RES_OK;
+
+	case GET_BLOCK_SIZE:
+		/* erase-block size in sectors, unknown */
+		*(DWORD *)buff = 1;
+		return RES_OK;
+	}
+
 	PWRN("disk_ioctl(drv=%u, ctrl=%u, buff=%p) called - not yet implemented.",
 	     drv, ctrl, buff);
-	return RES_OK;
+	return RES_PARERR;
 }
 
 
@@ -0,0 +1,651 @@
+/*
+ * \brief  Sector cache and pipelined block transfers of the FAT library
+ * \author Martin Stein
+ * \date   2013-02-19
+ */
+
+/*
+ * Copyright (C) 2013 Genode Labs GmbH
+ *
+ * This file is part of the Genode OS framework, which is distributed
+ * under the terms of the GNU General Public License version 2.
+ */
+
+#ifndef _SECTOR_CACHE_H_
+#define _SECTOR_CACHE_H_
+
+/* Genode includes */
+#include <base/allocator_avl.h>
+#include <base/exception.h>
+#include <base/printf.h>
+#include <block_session/connection.h>
+#include <util/string.h>
+
+namespace Diskio {
+
+	using namespace Genode;
+
+	class Io_error : public Exception { };
+
+
+	/**
+	 * Block session with pipelined multi-sector transfers
+	 *
+	 * A transfer is split into packets of at most 'max_sectors'. Packets
+	 * get submitted as long as the transmission buffer has room, so the
+	 * device works on several of them at once.
+	 *
+	 * An operation consists of the packets submitted since the last call
+	 * of 'complete'. Each operation ends with no packet in flight and
+	 * reports only the failures of its own packets, either via 'complete'
+	 * or via an exception during submission.
+	 */
+	class Transport
+	{
+		private:
+
+			enum { TX_BUF_SIZE = 256*1024 };
+
+			typedef Block::Packet_descriptor  Packet_descriptor;
+			typedef Block::Session::Tx::Source Source;
+
+			Allocator_avl              _alloc;
+			Block::Connection          _blk;
+			Source                    &_source;
+			size_t                     _blk_cnt;
+			size_t                     _blk_size;
+			Block::Session::Operations _ops;
+			unsigned                   _in_flight;
+			bool                       _failed;    /* a packet of the operation failed */
+			char                      *_read_dst;  /* destination of 'read' */
+			size_t                     _read_base; /* first sector of 'read' */
+
+			void _collect_ack()
+			{
+				Packet_descriptor p = _source.get_acked_packet();
+				_in_flight--;
+
+				bool const read = p.operation() == Packet_descriptor::READ;
+
+				if (!p.succeeded()) {
+					PERR("could not %s blocks %zu-%zu", read ? "read" : "write",
+					     p.block_number(), p.block_number() + p.block_count() - 1);
+					_failed = true;
+				}
+				else if (read)
+					/* the packets may be acknowledged in any order */
+					memcpy(_read_dst + (p.block_number() - _read_base) * _blk_size,
+					       _source.packet_content(p), p.block_count() * _blk_size);
+
+				_source.release_packet(p);
+			}
+
+			Packet_descriptor _alloc_packet(Packet_descriptor::Opcode op,
+			                                size_t sector, size_t count)
+			{
+				for (;;) {
+					try {
+						return Packet_descriptor(_source.alloc_packet(count * _blk_size),
+						                         op, sector, count);
+					} catch (Source::Packet_alloc_failed) {
+						if (!_in_flight) {
+							_failed = false;
+							throw Io_error();
+						}
+						_collect_ack();
+					}
+				}
+			}
+
+		public:
+
+			enum { MAX_TRANSFER = TX_BUF_SIZE / 4 }; /* bytes per packet */
+
+			Transport()
+			:
+				_alloc(env()->heap()), _blk(&_alloc, TX_BUF_SIZE),
+				_source(*_blk.tx()), _blk_cnt(0), _blk_size(0),
+				_in_flight(0), _failed(false), _read_dst(0), _read_base(0)
+			{
+				_blk.info(&_blk_cnt, &_blk_size, &_ops);
+			}
+
+			size_t block_count() const { return _blk_cnt; }
+			size_t block_size()  const { return _blk_size; }
+
+			Block::Session::Operations operations() const { return _ops; }
+
+			/**
+			 * Maximum number of sectors per packet
+			 */
+			size_t max_sectors() const { return max((size_t)1, MAX_TRANSFER / _blk_size); }
+
+			/**
+			 * Allocate packet for writing 'count' sectors
+			 *
+			 * The caller fills the content of the packet and passes it to
+			 * 'submit'. If the buffer is exhausted, the function waits for
+			 * acknowledgements.
+			 */
+			Packet_descriptor alloc_write(size_t sector, size_t count) {
+				return _alloc_packet(Packet_descriptor::WRITE, sector, count); }
+
+			char *content(Packet_descriptor p) { return _source.packet_content(p); }
+
+			void submit(Packet_descriptor p)
+			{
+				_source.submit_packet(p);
+				_in_flight++;
+			}
+
+			/**
+			 * Submit write of 'count' sectors, the count is not limited
+			 */
+			void write(size_t sector, size_t count, char const *src)
+			{
+				while (count) {
+					size_t const n = min(count, max_sectors());
+					Packet_descriptor p = alloc_write(sector, n);
+					memcpy(content(p), src, n * _blk_size);
+					submit(p);
+
+					sector += n;
+					count  -= n;
+					src    += n * _blk_size;
+				}
+			}
+
+			/**
+			 * Wait until all submitted packets got acknowledged
+			 *
+			 * \throw Io_error  a packet of the operation failed
+			 */
+			void complete()
+			{
+				while (_in_flight)
+					_collect_ack();
+
+				if (_failed) {
+					_failed = false;
+					throw Io_error();
+				}
+			}
+
+			/**
+			 * Read 'count' sectors, the count is not limited
+			 *
+			 * \throw Io_error
+			 */
+			void read(size_t sector, size_t count, char *dst)
+			{
+				/* packets of another operation must not write to 'dst' */
+				if (_in_flight) {
+					PERR("read while another operation is in flight");
+					throw Io_error();
+				}
+
+				_read_dst  = dst;
+				_read_base = sector;
+
+				for (size_t done = 0; done < count; ) {
+					size_t const n = min(count - done, max_sectors());
+					submit(_alloc_packet(Packet_descriptor::READ, sector + done, n));
+					done += n;
+				}
+				complete();
+			}
+
+			void sync() { _blk.sync(); }
+	};
+
+
+	/**
+	 * Statistics about the cache accesses
+	 */
+	struct Stats
+	{
+		unsigned long hits;       /* sectors read from the cache */
+		unsigned long misses;     /* sectors read from the device */
+		unsigned long readahead;  /* sectors read ahead from the device */
+		unsigned long writes;     /* sectors written by the file system */
+		unsigned long writebacks; /* dirty sectors written to the device */
+
+		Stats() : hits(0), misses(0), readahead(0), writes(0), writebacks(0) { }
+	};
+
+
+	/**
+	 * LRU cache of single sectors
+	 *
+	 * The sectors of the reserved region, the FATs, and the root directory
+	 * of FAT12/16 form a class of their own. They are evicted only if they
+	 * occupy more than three quarters of the cache, so streaming file
+	 * content cannot push them out.
+	 *
+	 * Small writes are kept in the cache and written back in runs of
+	 * adjacent sectors on 'flush', on eviction, or if too many sectors are
+	 * dirty. Large writes go to the device immediately.
+	 */
+	class Sector_cache
+	{
+		private:
+
+			enum {
+				MAX_READAHEAD = 63,  /* sectors */
+				DATA = 0, META = 1,  /* classes of lines */
+			};
+
+			struct Line
+			{
+				size_t  sector;
+				char   *data;
+				Line   *prev;      /* neighbour towards most recently used */
+				Line   *next;      /* neighbour towards least recently used */
+				Line   *hash_next; /* next line in the same hash bucket */
+				bool    valid;
+				bool    dirty;
+				bool    writing;   /* write-back is in flight */
+				bool    meta;
+			};
+
+			struct Lru
+			{
+				Line   *mru;
+				Line   *lru;
+				size_t  count;
+
+				Lru() : mru(0), lru(0), count(0) { }
+			};
+
+			Transport    &_transport;
+			size_t const  _sector_size;
+			size_t        _num_lines;
+			size_t        _num_buckets; /* power of two */
+			Line         *_lines;
+			Line        **_buckets;
+			Lru           _lru[2];
+			Line         *_free;        /* lines that hold no sector */
+			size_t const  _max_meta;    /* lines kept for the meta class */
+			size_t const  _max_dirty;
+			size_t        _num_dirty;
+			size_t const  _coalesce;    /* writes below get cached */
+			size_t        _meta_start;  /* region of the file-system meta data */
+			size_t        _meta_end;
+			size_t        _next[2];     /* sector that continues the last read */
+			size_t        _window[2];   /* current readahead in sectors */
+			char         *_stage;       /* buffer for filling lines */
+			Stats         _stats;
+
+			static unsigned _le16(unsigned char const *p) {
+				return p[0] | (p[1] << 8); }
+
+			static unsigned long _le32(unsigned char const *p) {
+				return _le16(p) | ((unsigned long)_le16(p + 2) << 16); }
+
+			Line *&_bucket(size_t const sector) {
+				return _buckets[sector & (_num_buckets - 1)]; }
+
+			Line *_lookup(size_t const sector)
+			{
+				for (Line *l = _bucket(sector); l; l = l->hash_next)
+					if (l->sector == sector) return l;
+				return 0;
+			}
+
+			bool _dirty(size_t const sector)
+			{
+				Line const * const l = _lookup(sector);
+				return l && l->dirty;
+			}
+
+			/**
+			 * Whether 'sector' is dirty and not being written back
+			 */
+			bool _unwritten(size_t const sector)
+			{
+				Line const * const l = _lookup(sector);
+				return l && l->dirty && !l->writing;
+			}
+
+			/**
+			 * Finish the write-back of all lines that are being written
+			 *
+			 * \param success  whether the device wrote the lines, the
+			 *                 lines stay dirty otherwise
+			 */
+			void _written(bool const success)
+			{
+				for (size_t i = 0; i < _num_lines; i++) {
+					Line &l = _lines[i];
+					if (!l.writing) continue;
+
+					l.writing = false;
+					if (!success) continue;
+
+					l.dirty = false;
+					_num_dirty--;
+					_stats.writebacks++;
+				}
+			}
+
+			bool _meta(size_t const sector) const {
+				return sector >= _meta_start && sector < _meta_end; }
+
+			void _unlink(Line &l)
+			{
+				Lru &lru = _lru[l.meta];
+				if (l.prev) l.prev->next = l.next; else lru.mru = l.next;
+				if (l.next) l.next->prev = l.prev; else lru.lru = l.prev;
+				l.prev = l.next = 0;
+				lru.count--;
+			}
+
+			void _push_mru(Line &l)
+			{
+				Lru &lru = _lru[l.meta];
+				l.next = lru.mru;
+				if (lru.mru) lru.mru->prev = &l; else lru.lru = &l;
+				lru.mru = &l;
+				lru.count++;
+			}
+
+			/**
+			 * Mark line as most recently used
+			 */
+			void _touch(Line &l)
+			{
+				_unlink(l);
+				_push_mru(l);
+			}
+
+			void _unhash(Line &l)
+			{
+				for (Line **p = &_bucket(l.sector); *p; p = &(*p)->hash_next)
+					if (*p == &l) { *p = l.hash_next; break; }
+				l.valid = false;
+			}
+
+			/**
+			 * Return line to be reused for another sector
+			 */
+			Line &_victim()
+			{
+				if (_free) {
+					Line &l = *_free;
+					_free = l.next;
+					l.next = 0;
+					return l;
+				}
+
+				bool const meta = !_lru[DATA].count || _lru[META].count > _max_meta;
+				Line &l = *_lru[meta].lru;
+
+				/* write back all dirty lines at once to form long runs */
+				if (l.dirty) flush();
+
+				_unlink(l);
+				_unhash(l);
+				return l;
+			}
+
+			/**
+			 * Return line for 'sector' that isn't cached yet
+			 *
+			 * \throw Io_error
+			 */
+			Line &_insert(size_t const sector)
+			{
+				Line &l = _victim();
+				l.sector    = sector;
+				l.valid     = true;
+				l.dirty     = false;
+				l.writing   = false;
+				l.meta      = _meta(sector);
+				l.hash_next = _bucket(sector);
+				_bucket(sector) = &l;
+				_push_mru(l);
+				return l;
+			}
+
+			/**
+			 * Number of uncached sectors starting at 'sector', at most 'max'
+			 */
+			size_t _uncached(size_t const sector, size_t max)
+			{
+				if (sector >= _transport.block_count()) return 0;
+
+				max = min(max, _transport.block_count() - sector);
+				size_t cnt = 0;
+				while (cnt < max && !_lookup(sector + cnt)) cnt++;
+				return cnt;
+			}
+
+			/**
+			 * Learn the location of the meta data from a boot sector
+			 *
+			 * The file system reads the boot sector of the volume before
+			 * anything else, and 'f_mkfs' writes it.
+			 */
+			void _detect_volume(size_t const sector, char const *data)
+			{
+				unsigned char const * const b = (unsigned char const *)data;
+
+				if (_sector_size < 512 || _le16(b + 510) != 0xaa55)
+					return;
+
+				if (memcmp(b + 54, "FAT", 3) && memcmp(b + 82, "FAT32", 5))
+					return;
+
+				unsigned const      bytes_per_sector = _le16(b + 11);
+				unsigned long const fat_size = _le16(b + 22) ? _le16(b + 22)
+				                                             : _le32(b + 36);
+				if (!bytes_per_sector)
+					return;
+
+				_meta_start = sector;
+				_meta_end   = sector + _le16(b + 14) + b[16]*fat_size
+				            + (_le16(b + 17)*32 + bytes_per_sector - 1)
+				            / bytes_per_sector;
+			}
+
+		public:
+
+			/**
+			 * Constructor
+			 *
+			 * \param size  size of the cache in bytes
+			 */
+			Sector_cache(Transport &transport, size_t size)
+			:
+				_transport(transport), _sector_size(transport.block_size()),
+				_num_lines(max((size_t)MAX_READAHEAD + 1, size / _sector_size)),
+				_num_buckets(1), _free(0),
+				_max_meta(_num_lines * 3 / 4), _max_dirty(_num_lines / 2),
+				_num_dirty(0),
+				_coalesce(max((size_t)2, transport.max_sectors() / 2)),
+				_meta_start(0), _meta_end(0)
+			{
+				_next[DATA] = _next[META] = ~0UL;
+				_window[DATA] = _window[META] = 0;
+
+				while (_num_buckets < _num_lines) _num_buckets <<= 1;
+
+				char *data = (char *)env()->heap()->alloc(_num_lines * _sector_size);
+				_stage     = (char *)env()->heap()->alloc((MAX_READAHEAD + 1) * _sector_size);
+				_lines     = new (env()->heap()) Line[_num_lines];
+				_buckets   = new (env()->heap()) Line *[_num_buckets];
+				memset(_buckets, 0, _num_buckets * sizeof(Line *));
+
+				for (size_t i = 0; i < _num_lines; i++) {
+					Line &l = _lines[i];
+					l.data  = data + i * _sector_size;
+					l.prev  = l.hash_next = 0;
+					l.valid = l.dirty = l.writing = l.meta = false;
+					l.next  = _free;
+					_free   = &l;
+				}
+			}
+
+			Stats const &stats() const { return _stats; }
+
+			/**
+			 * Read sectors
+			 *
+			 * Sectors that are read one by one and continue the previous
+			 * read get read ahead. The readahead doubles with each such
+			 * read and drops to zero with any other read. Reads of meta
+			 * data and of file content are tracked separately because the
+			 * file system interleaves them.
+			 *
+			 * \throw Io_error
+			 */
+			void read(size_t const sector, size_t const count, char *dst)
+			{
+				bool const meta = _meta(sector);
+				size_t &window  = _window[meta];
+
+				window = sector != _next[meta] ? 0
+				       : window ? min(2*window, (size_t)MAX_READAHEAD) : 1;
+				_next[meta] = sector + count;
+
+				for (size_t i = 0; i < count; ) {
+
+					Line * const l = _lookup(sector + i);
+					if (l) {
+						memcpy(dst + i * _sector_size, l->data, _sector_size);
+						_touch(*l);
+						_stats.hits++;
+						i++;
+						continue;
+					}
+
+					/* bulk reads bypass the cache */
+					if (count > 1) {
+						size_t const miss = _uncached(sector + i, count - i);
+						if (!miss) throw Io_error();
+
+						_transport.read(sector + i, miss, dst + i * _sector_size);
+						_stats.misses += miss;
+						i += miss;
+						continue;
+					}
+
+					size_t const ahead = _uncached(sector + 1, window);
+					_transport.read(sector, 1 + ahead, _stage);
+					memcpy(dst, _stage, _sector_size);
+					_detect_volume(sector, _stage);
+
+					for (size_t j = 0; j <= ahead; j++)
+						memcpy(_insert(sector + j).data, _stage + j * _sector_size,
+						       _sector_size);
+
+					_stats.misses++;
+					_stats.readahead += ahead;
+					i++;
+				}
+			}
+
+			/**
+			 * Write sectors
+			 *
+			 * \throw Io_error
+			 */
+			void write(size_t const sector, size_t const count, char const *src)
+			{
+				_stats.writes += count;
+
+				if (count == 1)
+					_detect_volume(sector, src);
+
+				if (count < _coalesce) {
+					for (size_t i = 0; i < count; i++) {
+						Line *l = _lookup(sector + i);
+						if (!l) l = &_insert(sector + i);
+						else _touch(*l);
+
+						memcpy(l->data, src + i * _sector_size, _sector_size);
+						if (!l->dirty) {
+							l->dirty = true;
+							_num_dirty++;
+						}
+					}
+					if (_num_dirty > _max_dirty)
+						flush();
+					return;
+				}
+
+				/* keep cached copies up to date */
+				for (size_t i = 0; i < count; i++) {
+					Line * const l = _lookup(sector + i);
+					if (l) memcpy(l->data, src + i * _sector_size, _sector_size);
+				}
+
+				/*
+				 * The cached copies become clean if the device wrote the
+				 * sectors. Otherwise, they become dirty, so their content
+				 * gets written back later.
+				 */
+				bool success = true;
+				try {
+					_transport.write(sector, count, src);
+					_transport.complete();
+				} catch (Io_error) { success = false; }
+
+				for (size_t i = 0; i < count; i++) {
+					Line * const l = _lookup(sector + i);
+					if (!l || l->dirty == !success) continue;
+
+					l->dirty = !success;
+					if (success) _num_dirty--; else _num_dirty++;
+				}
+				if (!success) throw Io_error();
+			}
+
+			/**
+			 * Write all dirty sectors to the device
+			 *
+			 * Adjacent dirty sectors get written with one packet, and all
+			 * packets are submitted before waiting for the device. The
+			 * sectors become clean only if the device wrote all of them.
+			 *
+			 * \throw Io_error
+			 */
+			void flush()
+			{
+				try {
+					for (size_t i = 0; _num_dirty && i < _num_lines; i++) {
+						Line &l = _lines[i];
+						if (!l.valid || !l.dirty || l.writing) continue;
+
+						/* go back to the start of the dirty run */
+						size_t sector = l.sector;
+						while (sector && _unwritten(sector - 1)) sector--;
+
+						while (_unwritten(sector)) {
+							size_t cnt = 0;
+							while (cnt < _transport.max_sectors() &&
+							       _unwritten(sector + cnt))
+								cnt++;
+
+							Block::Packet_descriptor p = _transport.alloc_write(sector, cnt);
+							for (size_t j = 0; j < cnt; j++) {
+								Line &d = *_lookup(sector + j);
+								memcpy(_transport.content(p) + j * _sector_size,
+								       d.data, _sector_size);
+								d.writing = true;
+							}
+							_transport.submit(p);
+							sector += cnt;
+						}
+					}
+					_transport.complete();
+				} catch (Io_error) {
+					_written(false);
+					throw;
+				}
+				_written(true);
+			}
+	};
+}
+
+#endif /* _SECTOR_CACHE_H_ */
@@ -16,6 +16,7 @@
 #include <base/env.h>
 #include <base/printf.h>
 #include <base/slab.h>
+#include <base/native_types.h>
 #include <util/string.h>
 #include <util/misc_math.h>
 
@@ -28,9 +29,15 @@ namespace Genode {
 
 	class Slab_alloc : public Slab
 	{
+			/*
+			 * Blocks of small objects hold at least 8 objects, blocks
+			 * of large objects only 2 to limit the memory that an
+			 * almost empty block wastes.
+			 */
 			size_t _calculate_block_size(size_t object_size)
 			{
-				size_t block_size = 8 * (object_size + sizeof(Slab_entry)) + sizeof(Slab_block);
+				size_t const num = object_size > 2048 ? 2 : 8;
+				size_t block_size = num * (object_size + sizeof(Slab_entry)) + sizeof(Slab_block);
 				return align_addr(block_size, 12);
 			}
 
@@ -51,43 +58,244 @@ namespace Genode {
 
 /**
  * Allocator that uses slabs for small objects sizes
+ *
+ * Blocks up to 'MAX_CLASS_SIZE' bytes get rounded up to one of
+ * 'NUM_CLASSES' size classes. Classes are 16 bytes apart up to 128 bytes
+ * and four classes share each power of two beyond, which limits the
+ * internal fragmentation to 25 percent. Each thread owns a cache of free
+ * blocks per class, which it accesses without locking. Only when a cache
+ * runs empty or overfull, a batch of blocks is moved from or to the slab
+ * of the class under the central lock. Threads that run outside of the
+ * thread-context area, like the main thread, always use the slabs
+ * directly. Larger blocks get a dataspace of their own.
  */
 class Malloc : public Genode::Allocator
 {
 	private:
 
+		typedef Genode::addr_t        addr_t;
+		typedef Genode::Native_config Native_config;
+
 		enum {
-			SLAB_START = 2,  /* 4 Byte (log2) */
-			SLAB_STOP  = 11, /* 2048 Byte (log2) */
-			NUM_SLABS = (SLAB_STOP - SLAB_START) + 1
+			NUM_CLASSES    = 44,
+			MAX_CLASS_SIZE = 64*1024,
+			MAX_CACHES     = 256,       /* thread contexts with a cache */
+			CACHE_BYTES    = 32*1024,   /* bytes moved per refill or drain */
+			MAX_BATCH      = 32,        /* blocks moved per refill or drain */
 		};
 
-		Genode::Allocator  *_backing_store;        /* back-end allocator */
-		Genode::Slab_alloc *_allocator[NUM_SLABS]; /* slab allocators */
-		Genode::Lock        _lock;
+		/**
+		 * Free block within a thread cache
+		 */
+		struct Free_block { Free_block *next; };
+
+		/**
+		 * Per-thread cache of free blocks
+		 */
+		struct Thread_cache
+		{
+			struct List
+			{
+				Free_block *head;
+				unsigned    count;
+			} lists[NUM_CLASSES];
+
+			Thread_cache() { Genode::memset(lists, 0, sizeof(lists)); }
+		};
+
+		/**
+		 * Header of blocks with a dataspace of their own
+		 *
+		 * The size field is located directly in front of the block
+		 * like the 'Block_header' of all other blocks.
+		 */
+		struct Large_header
+		{
+			Genode::Ram_dataspace_capability ds;
+			Block_header                     size;
+		};
+
+		Genode::Allocator  *_backing_store;          /* back-end allocator */
+		Genode::Slab_alloc *_allocator[NUM_CLASSES]; /* slab allocators */
+		Genode::Lock        _lock;                   /* protects the slabs */
+		Thread_cache       *_caches[MAX_CACHES];     /* caches by context */
+
+		/**
+		 * Size class that fits blocks of 'size' bytes including header
+		 */
+		static unsigned _class(unsigned long size)
+		{
+			if (size <= 128)
+				return size ? (size - 1) / 16 : 0;
+
+			unsigned const msb = Genode::log2(size - 1);
+			return 8 + (msb - 7) * 4 + ((size - 1) >> (msb - 2)) - 4;
+		}
+
+		/**
+		 * Size of the blocks of class 'c'
+		 */
+		static unsigned long _class_size(unsigned c)
+		{
+			if (c < 8)
+				return (c + 1) * 16;
+
+			unsigned const msb = 7 + (c - 8) / 4;
+			return (1UL << msb) + ((c - 8) % 4 + 1) * (1UL << (msb - 2));
+		}
+
+		/**
+		 * Number of blocks moved between a cache and a slab at once
+		 */
+		static unsigned _batch(unsigned c)
+		{
+			unsigned long const n = CACHE_BYTES / _class_size(c);
+			return n < 1 ? 1 : (n > MAX_BATCH ? MAX_BATCH : n);
+		}
+
+		/**
+		 * Return cache of the calling thread, or 0 if it has none
+		 */
+		Thread_cache *_cache()
+		{
+			/* identify the thread through the context its stack is in */
+			int dummy;
+			addr_t const sp   = (addr_t)&dummy;
+			addr_t const base = Native_config::context_area_virtual_base();
+			if (sp < base || sp - base >= Native_config::context_area_virtual_size())
+				return 0;
+
+			addr_t const i = (sp - base) / Native_config::context_virtual_size();
+			if (i >= MAX_CACHES)
+				return 0;
+
+			/*
+			 * A thread that occupies the context of a vanished thread
+			 * inherits its cache, so caches are never freed.
+			 */
+			if (!_caches[i]) {
+				Genode::Lock::Guard lock_guard(_lock);
+				_caches[i] = new (_backing_store) Thread_cache;
+			}
+			return _caches[i];
+		}
+
+		/**
+		 * Move a batch of free blocks of class 'c' from the slab to 'list'
+		 */
+		void _refill(Thread_cache::List &list, unsigned c)
+		{
+			Genode::Lock::Guard lock_guard(_lock);
+			for (unsigned i = _batch(c); i; i--) {
+				Free_block * const b = (Free_block *)_allocator[c]->alloc();
+				if (!b) return;
+				b->next = list.head;
+				list.head = b;
+				list.count++;
+			}
+		}
 
-		unsigned long _slab_log2(unsigned long size)
+		/**
+		 * Move a batch of free blocks of class 'c' from 'list' to the slab
+		 */
+		void _drain(Thread_cache::List &list, unsigned c)
 		{
-			unsigned msb = Genode::log2(size);
-			/* size is greater than msb */
-			if (size > (1U << msb))
-				msb++;
+			Genode::Lock::Guard lock_guard(_lock);
+			for (unsigned i = _batch(c); i && list.head; i--) {
+				Free_block * const b = list.head;
+				list.head = b->next;
+				list.count--;
+				_allocator[c]->free(b);
+			}
+		}
+
+		/**
+		 * Allocate block of class 'c'
+		 */
+		void *_alloc_small(unsigned c)
+		{
+			Thread_cache * const cache = _cache();
+			if (!cache) {
+				Genode::Lock::Guard lock_guard(_lock);
+				return _allocator[c]->alloc();
+			}
+			Thread_cache::List &list = cache->lists[c];
+			if (!list.head)
+				_refill(list, c);
 
-			/* use smallest slab */
-			if (size < (1U << SLAB_START))
-				msb = SLAB_START;
+			Free_block * const b = list.head;
+			if (!b)
+				return 0;
 
-			return msb;
+			list.head = b->next;
+			list.count--;
+			return b;
+		}
+
+		/**
+		 * Free block of class 'c'
+		 */
+		void _free_small(void *addr, unsigned c)
+		{
+			Thread_cache * const cache = _cache();
+			if (!cache) {
+				Genode::Lock::Guard lock_guard(_lock);
+				_allocator[c]->free(addr);
+				return;
+			}
+			Thread_cache::List &list = cache->lists[c];
+			Free_block * const b = (Free_block *)addr;
+			b->next = list.head;
+			list.head = b;
+			if (++list.count >= 2 * _batch(c))
+				_drain(list, c);
+		}
+
+		/**
+		 * Allocate block with a dataspace of its own
+		 *
+		 * \return  address of the block header or 0
+		 */
+		void *_alloc_large(unsigned long size)
+		{
+			using namespace Genode;
+
+			size = align_addr(size + sizeof(Large_header), 12);
+			Ram_dataspace_capability ds;
+			Large_header *h = 0;
+			try {
+				ds = env()->ram_session()->alloc(size);
+				h  = env()->rm_session()->attach(ds);
+			} catch (...) {
+				if (ds.valid())
+					env()->ram_session()->free(ds);
+				return 0;
+			}
+			h->ds   = ds;
+			h->size = size - sizeof(Large_header) + sizeof(Block_header);
+			return &h->size;
+		}
+
+		void _free_large(void *addr)
+		{
+			using namespace Genode;
+
+			Large_header * const h = (Large_header *)
+				((addr_t)addr - (addr_t)&((Large_header *)0)->size);
+			Ram_dataspace_capability const ds = h->ds;
+			env()->rm_session()->detach(h);
+			env()->ram_session()->free(ds);
 		}
 
 	public:
 
 		Malloc(Genode::Allocator *backing_store) : _backing_store(backing_store)
 		{
-			for (unsigned i = SLAB_START; i <= SLAB_STOP; i++) {
-				_allocator[i - SLAB_START] = new (backing_store)
-				                                 Genode::Slab_alloc(1U << i, backing_store);
+			for (unsigned i = 0; i < NUM_CLASSES; i++) {
+				_allocator[i] = new (backing_store)
+				                    Genode::Slab_alloc(_class_size(i), backing_store);
 			}
+			Genode::memset(_caches, 0, sizeof(_caches));
 		}
 
 		/**
@@ -96,11 +304,6 @@ class Malloc : public Genode::Allocator
 
 		bool alloc(size_t size, void **out_addr)
 		{
-			Genode::Lock::Guard lock_guard(_lock);
-
-			/* enforce size to be a multiple of 4 bytes */
-			size = (size + 3) & ~3;
-
 			/*
 			 * We store the size of the allocation at the very
 			 * beginning of the allocated block and return
@@ -108,47 +311,45 @@ class Malloc : public Genode::Allocator
 			 * the size information when freeing the block.
 			 */
 			unsigned long real_size = size + sizeof(Block_header);
-			unsigned long msb = _slab_log2(real_size);
 			void *addr = 0;
 
-			/* use backing store if requested memory is larger than largest slab */
-			if (msb > SLAB_STOP) {
-
-				if (!(_backing_store->alloc(real_size, &addr)))
+			if (real_size > MAX_CLASS_SIZE) {
+				if (!(addr = _alloc_large(real_size)))
 					return false;
+				*out_addr = (Block_header *)addr + 1;
+				return true;
 			}
-			else
-				if (!(addr = _allocator[msb - SLAB_START]->alloc()))
-					return false;
 
-			*(Block_header *)addr = real_size;
+			unsigned const c = _class(real_size);
+			if (!(addr = _alloc_small(c)))
+				return false;
+
+			/* store the class size to let 'realloc' use the whole block */
+			*(Block_header *)addr = _class_size(c);
 			*out_addr = (Block_header *)addr + 1;
 			return true;
 		}
 
 		void free(void *ptr, size_t /* size */)
 		{
-			Genode::Lock::Guard lock_guard(_lock);
-
 			unsigned long *addr = ((unsigned long *)ptr) - 1;
 			unsigned long  real_size = *addr;
 
-			if (real_size > (1U << SLAB_STOP))
-				_backing_store->free(addr, real_size);
-			else {
-				unsigned long msb = _slab_log2(real_size);
-				_allocator[msb - SLAB_START]->free(addr);
-			}
+			if (real_size > MAX_CLASS_SIZE)
+				_free_large(addr);
+			else
+				_free_small(addr, _class(real_size));
 		}
 
 		size_t overhead(size_t size)
 		{
 			size += sizeof(Block_header);
 
-			if (size > (1U << SLAB_STOP))
-				return _backing_store->overhead(size);
+			if (size > MAX_CLASS_SIZE)
+				return Genode::align_addr(size + sizeof(Large_header), 12) - size;
 
-			return _allocator[_slab_log2(size) - SLAB_START]->overhead(size);
+			unsigned const c = _class(size);
+			return _class_size(c) - size + _allocator[c]->overhead(size);
 		}
 };
 
@@ -5,7 +5,7 @@
  */
 
 /*
- * Copyright (C) 2012 Genode Labs GmbH
+ * Copyright (C) 2012-2013 Genode Labs GmbH
  *
  * This file is part of the Genode OS framework, which is distributed
  * under the terms of the GNU General Public License version 2.
@@ -16,6 +16,7 @@
 #include <base/printf.h>
 #include <file_system_session/connection.h>
 #include <os/path.h>
+#include <util/list.h>
 
 /* libc includes */
 #include <errno.h>
@@ -65,9 +66,52 @@ struct Node_handle_guard
 };
 
 
+typedef File_system::Session::Tx::Source Source;
+
+
+class Plugin_context;
+
+static void wait_for_acknowledgement(Source &source);
+static void collect_acknowledgements(Source &source);
+
+
+/**
+ * Number of packets submitted to the file system and not yet acknowledged
+ */
+static unsigned packets_in_flight;
+
+
+/**
+ * Size of the packets used for streaming
+ *
+ * Readahead packets occupy the bulk buffer until they get consumed. The
+ * size is chosen such that the readahead of a file descriptor takes no more
+ * than half of the bulk buffer.
+ */
+static size_t stream_packet_size(Source &source)
+{
+	return source.bulk_buffer_size() / 8;
+}
+
+
+/**
+ * Contexts of all open nodes
+ */
+static Genode::List<Plugin_context> *contexts()
+{
+	static Genode::List<Plugin_context> contexts;
+	return &contexts;
+}
+
+
 class Plugin_context : public Libc::Plugin_context,
-                       public File_system::Packet_ref
+                       public File_system::Packet_ref,
+                       public Genode::List<Plugin_context>::Element
 {
+	public:
+
+		enum { MAX_READAHEAD = 4 /* packets */ };
+
 	private:
 
 		enum Type { TYPE_FILE, TYPE_DIR, TYPE_SYMLINK };
@@ -76,6 +120,8 @@ class Plugin_context : public Libc::Plugin_context,
 
 		File_system::Node_handle _node_handle;
 
+		Canonical_path _path; /* identifies the node among the contexts */
+
 		int _fd_flags;
 		int _status_flags;
 
@@ -84,21 +130,193 @@ class Plugin_context : public Libc::Plugin_context,
 		 */
 		off_t _seek_offset;
 
-	public:
+		/**
+		 * Read packet that got submitted to the file system
+		 */
+		struct Read_request
+		{
+			File_system::Packet_descriptor packet;
+			off_t                          position;
+			size_t                         requested; /* bytes */
+			bool                           acked;
+		};
+
+		/*
+		 * Queue of read requests for consecutive file ranges, the head
+		 * request refers to the current read position
+		 */
+		Read_request _reads[MAX_READAHEAD];
+		unsigned     _reads_head;
+		unsigned     _num_reads;
+		size_t       _consumed;  /* bytes of the head request consumed */
+		off_t        _read_end;  /* file position after the last request */
+
+		unsigned     _window;    /* readahead in packets */
+		off_t        _last_read; /* file position after the last 'read' */
 
-		bool in_flight;
+		/*
+		 * Write-behind buffer that collects consecutive writes
+		 */
+		char        *_write_buf;
+		size_t       _write_buf_size;
+		size_t       _write_len;
+		off_t        _write_pos; /* file position, or ~0 for append mode */
+
+		unsigned     _writes_in_flight;
+		bool         _write_failed;
+
+		Read_request &_read(unsigned i) {
+			return _reads[(_reads_head + i) % MAX_READAHEAD]; }
+
+		void _init()
+		{
+			_reads_head = _num_reads = 0;
+			_consumed   = 0;
+			_read_end   = 0;
+			_window     = 0;
+			_last_read  = 0;
+			_write_buf  = 0;
+			_write_buf_size = 0;
+			_write_len  = 0;
+			_write_pos  = 0;
+			_writes_in_flight = 0;
+			_write_failed     = false;
+
+			contexts()->insert(this);
+		}
+
+		/**
+		 * Allocate packet in the bulk buffer
+		 *
+		 * If the bulk buffer is exhausted, the function waits for
+		 * acknowledgements. If no packet is in flight, the buffer is
+		 * occupied by readahead packets, which get dropped.
+		 */
+		static File_system::Packet_descriptor _alloc_packet(Source &source,
+		                                                    size_t size)
+		{
+			for (;;) {
+				try { return source.alloc_packet(size); }
+				catch (Source::Packet_alloc_failed) {
+					if (!packets_in_flight) break;
+					wait_for_acknowledgement(source);
+				}
+			}
+
+			_drop_all_readahead(source);
+
+			return source.alloc_packet(size);
+		}
 
-		Plugin_context(File_system::File_handle handle)
-		: _type(TYPE_FILE), _node_handle(handle), _fd_flags(0),
-		  _status_flags(0), _seek_offset(~0), in_flight(false) { }
+		/**
+		 * Drop the readahead of all contexts
+		 */
+		static void _drop_all_readahead(Source &source)
+		{
+			for (Plugin_context *c = contexts()->first(); c; c = c->next())
+				c->drop_readahead(source);
+		}
 
-		Plugin_context(File_system::Dir_handle handle)
-		: _type(TYPE_DIR), _node_handle(handle), _fd_flags(0),
-		  _status_flags(0), _seek_offset(0), in_flight(false) { }
+		/**
+		 * Drop the readahead of all contexts of the node of this context
+		 *
+		 * Because several contexts may refer to the same file, a write
+		 * outdates their readahead. The readahead of other files stays.
+		 */
+		void _drop_node_readahead(Source &source)
+		{
+			for (Plugin_context *c = contexts()->first(); c; c = c->next())
+				if (!Genode::strcmp(c->_path.base(), _path.base()))
+					c->drop_readahead(source);
+		}
 
-		Plugin_context(File_system::Symlink_handle handle)
-		: _type(TYPE_SYMLINK), _node_handle(handle), _fd_flags(0),
-		  _status_flags(0), _seek_offset(~0), in_flight(false) { }
+		/**
+		 * Submit the write-behind buffers of all contexts but 'except'
+		 *
+		 * This way, the packets of different contexts are submitted in
+		 * the order of the corresponding calls.
+		 */
+		static void _flush_all(Source &source, Plugin_context *except = 0)
+		{
+			for (Plugin_context *c = contexts()->first(); c; c = c->next())
+				if (c != except)
+					c->flush(source);
+		}
+
+		void _submit(Source &source, File_system::Packet_descriptor packet)
+		{
+			/*
+			 * Keep the acknowledgement queue drained and do not block on a
+			 * full submit queue. Otherwise, the file system could block on
+			 * a full acknowledgement queue while we block on submitting.
+			 */
+			collect_acknowledgements(source);
+			while (!source.ready_to_submit())
+				wait_for_acknowledgement(source);
+
+			if (packet.operation() == File_system::Packet_descriptor::WRITE)
+				_writes_in_flight++;
+
+			packets_in_flight++;
+			source.submit_packet(packet);
+		}
+
+		/**
+		 * Submit read requests up to 'end' plus the readahead window
+		 */
+		void _request_reads(Source &source, off_t end)
+		{
+			size_t const max_size = _type == TYPE_FILE
+			                      ? stream_packet_size(source)
+			                      : source.bulk_buffer_size() / 2;
+
+			unsigned const max_reads = _type == TYPE_FILE ? MAX_READAHEAD : 1;
+
+			off_t const window_end = end + _window*max_size;
+
+			while (_num_reads < max_reads && _read_end < window_end) {
+
+				/* request whole packets only for reading ahead */
+				size_t const size = _read_end < end && !_window
+				                  ? Genode::min((size_t)(end - _read_end), max_size)
+				                  : max_size;
+
+				File_system::Packet_descriptor packet;
+				try { packet = source.alloc_packet(size); }
+				catch (Source::Packet_alloc_failed) {
+
+					/* consume the pending requests first */
+					if (_num_reads) return;
+					packet = _alloc_packet(source, size);
+				}
+
+				Read_request &r = _read(_num_reads++);
+				r.packet    = File_system::Packet_descriptor(packet,
+				                  static_cast<File_system::Packet_ref *>(this),
+				                  _node_handle, File_system::Packet_descriptor::READ,
+				                  size, _read_end);
+				r.position  = _read_end;
+				r.requested = size;
+				r.acked     = false;
+
+				_submit(source, r.packet);
+				_read_end += size;
+			}
+		}
+
+	public:
+
+		Plugin_context(File_system::File_handle handle, char const *path)
+		: _type(TYPE_FILE), _node_handle(handle), _path(path), _fd_flags(0),
+		  _status_flags(0), _seek_offset(~0) { _init(); }
+
+		Plugin_context(File_system::Dir_handle handle, char const *path)
+		: _type(TYPE_DIR), _node_handle(handle), _path(path), _fd_flags(0),
+		  _status_flags(0), _seek_offset(0) { _init(); }
+
+		Plugin_context(File_system::Symlink_handle handle, char const *path)
+		: _type(TYPE_SYMLINK), _node_handle(handle), _path(path), _fd_flags(0),
+		  _status_flags(0), _seek_offset(~0) { _init(); }
 
 		File_system::Node_handle node_handle() const { return _node_handle; }
 
@@ -145,7 +363,233 @@ class Plugin_context : public Libc::Plugin_context,
 			_seek_offset = ~0;
 		}
 
-		virtual ~Plugin_context() { }
+		/**
+		 * Called for each acknowledged packet of the context
+		 */
+		void acknowledged(Source &source, File_system::Packet_descriptor packet)
+		{
+			packets_in_flight--;
+
+			if (packet.operation() == File_system::Packet_descriptor::WRITE) {
+				_writes_in_flight--;
+				if (!packet.succeeded())
+					_write_failed = true;
+				source.release_packet(packet);
+				return;
+			}
+
+			/* keep read packet until its content gets consumed */
+			for (unsigned i = 0; i < _num_reads; i++) {
+				Read_request &r = _read(i);
+				if (!r.acked && r.packet.offset() == packet.offset()) {
+					r.packet = packet;
+					r.acked  = true;
+					return;
+				}
+			}
+			source.release_packet(packet);
+		}
+
+		/**
+		 * Read from the current seek position
+		 *
+		 * Sequential reads of a file increase the number of packets that
+		 * get requested ahead of the read position.
+		 */
+		size_t read(Source &source, char *dst, size_t count)
+		{
+			/*
+			 * The file system processes the packets in order, so the read
+			 * observes all writes submitted before.
+			 */
+			_flush_all(source);
+
+			off_t pos = _seek_offset;
+
+			/* drop readahead that does not match the read position */
+			if (_num_reads && _read(0).position + (off_t)_consumed != pos)
+				drop_readahead(source);
+
+			if (_type == TYPE_FILE && pos == _last_read)
+				_window = Genode::min(Genode::max(2*_window, 1U),
+				                      (unsigned)MAX_READAHEAD);
+			else
+				_window = 0;
+
+			if (!_num_reads)
+				_read_end = pos;
+
+			size_t done = 0;
+			bool   eof  = false;
+			while (done < count && !eof) {
+
+				_request_reads(source, pos + (count - done));
+
+				Read_request &r = _read(0);
+				while (!r.acked)
+					wait_for_acknowledgement(source);
+
+				size_t const length = r.packet.succeeded()
+				                    ? Genode::min(r.packet.length(), r.requested) : 0;
+
+				size_t const n = Genode::min(length - _consumed, count - done);
+				memcpy(dst + done, source.packet_content(r.packet) + _consumed, n);
+				_consumed += n;
+				done      += n;
+				pos       += n;
+
+				if (_consumed < length)
+					continue;
+
+				/* the file system returned less bytes than requested at the end */
+				eof = length < r.requested;
+
+				source.release_packet(r.packet);
+				_reads_head = (_reads_head + 1) % MAX_READAHEAD;
+				_num_reads--;
+				_consumed = 0;
+			}
+
+			/* the requests beyond the end of the file are useless */
+			if (eof)
+				drop_readahead(source);
+
+			_seek_offset = pos;
+			_last_read   = pos;
+			return done;
+		}
+
+		/**
+		 * Wait for the outstanding read requests and drop them
+		 */
+		void drop_readahead(Source &source)
+		{
+			while (_num_reads) {
+				Read_request &r = _read(0);
+				while (!r.acked)
+					wait_for_acknowledgement(source);
+
+				source.release_packet(r.packet);
+				_reads_head = (_reads_head + 1) % MAX_READAHEAD;
+				_num_reads--;
+			}
+			_consumed = 0;
+			_window   = 0;
+		}
+
+		/**
+		 * Write at the current seek position
+		 *
+		 * Small writes get collected in the write-behind buffer. Packets
+		 * are acknowledged asynchronously.
+		 */
+		void write(Source &source, char const *src, size_t count)
+		{
+			/* the readahead of the file may contain outdated content */
+			_drop_node_readahead(source);
+			_flush_all(source, this);
+
+			collect_acknowledgements(source);
+
+			size_t const packet_size = stream_packet_size(source);
+
+			/* flush buffer if the write does not continue it */
+			if (_write_len && (is_appending() ? _write_pos != ~0
+			                                  : _write_pos + (off_t)_write_len != _seek_offset))
+				flush(source);
+
+			/* large writes go directly to the packets */
+			if (count >= packet_size) {
+				flush(source);
+
+				while (count) {
+					size_t const n = Genode::min(count, source.bulk_buffer_size() / 2);
+
+					File_system::Packet_descriptor
+						packet(_alloc_packet(source, n),
+						       static_cast<File_system::Packet_ref *>(this),
+						       _node_handle, File_system::Packet_descriptor::WRITE,
+						       n, _seek_offset);
+
+					memcpy(source.packet_content(packet), src, n);
+					_submit(source, packet);
+
+					advance_seek_offset(n);
+					src   += n;
+					count -= n;
+				}
+				return;
+			}
+
+			if (!_write_buf) {
+				_write_buf      = (char *)Genode::env()->heap()->alloc(packet_size);
+				_write_buf_size = packet_size;
+			}
+
+			while (count) {
+				if (!_write_len)
+					_write_pos = _seek_offset;
+
+				size_t const n = Genode::min(count, packet_size - _write_len);
+				memcpy(_write_buf + _write_len, src, n);
+				_write_len += n;
+
+				advance_seek_offset(n);
+				src   += n;
+				count -= n;
+
+				if (_write_len == packet_size)
+					flush(source);
+			}
+		}
+
+		/**
+		 * Submit the content of the write-behind buffer
+		 */
+		void flush(Source &source)
+		{
+			if (!_write_len)
+				return;
+
+			File_system::Packet_descriptor
+				packet(_alloc_packet(source, _write_len),
+				       static_cast<File_system::Packet_ref *>(this),
+				       _node_handle, File_system::Packet_descriptor::WRITE,
+				       _write_len, _write_pos);
+
+			memcpy(source.packet_content(packet), _write_buf, _write_len);
+			_submit(source, packet);
+			_write_len = 0;
+		}
+
+		/**
+		 * Flush and wait until the file system processed all writes
+		 */
+		void sync(Source &source)
+		{
+			flush(source);
+
+			while (_writes_in_flight)
+				wait_for_acknowledgement(source);
+		}
+
+		/**
+		 * Return whether a write failed since the last call
+		 */
+		bool write_failed()
+		{
+			bool const failed = _write_failed;
+			_write_failed = false;
+			return failed;
+		}
+
+		virtual ~Plugin_context()
+		{
+			contexts()->remove(this);
+
+			if (_write_buf)
+				Genode::env()->heap()->free(_write_buf, _write_buf_size);
+		}
 };
 
 
@@ -155,16 +599,14 @@ static inline Plugin_context *context(Libc::File_descriptor *fd)
 }
 
 
-static void wait_for_acknowledgement(File_system::Session::Tx::Source &source)
+static void wait_for_acknowledgement(Source &source)
 {
 	::File_system::Packet_descriptor packet = source.get_acked_packet();
-	
+
 	if (verbose)
 		PDBG("got acknowledgement for packet of size %zd", packet.size());
 
-	static_cast<Plugin_context *>(packet.ref())->in_flight = false;
-
-	source.release_packet(packet);
+	static_cast<Plugin_context *>(packet.ref())->acknowledged(source, packet);
 }
 
 
@@ -175,7 +617,7 @@ static void wait_for_acknowledgement(File_system::Session::Tx::Source &source)
  * This function should be called prior enqueing new packets into the
  * packet stream to free up space in the bulk buffer.
  */
-static void collect_acknowledgements(File_system::Session::Tx::Source &source)
+static void collect_acknowledgements(Source &source)
 {
 	while (source.ack_avail())
 		wait_for_acknowledgement(source);
@@ -217,6 +659,21 @@ class Plugin : public Libc::Plugin
 {
 	private:
 
+		/**
+		 * File range that is locally attached as dataspace of the file system
+		 */
+		struct Mapping : Genode::List<Mapping>::Element
+		{
+			void                         *addr;
+			Genode::Dataspace_capability  ds;
+
+			Mapping(void *addr, Genode::Dataspace_capability ds)
+			: addr(addr), ds(ds) { }
+		};
+
+		Genode::Lock          _mappings_lock;
+		Genode::List<Mapping> _mappings;
+
 		::off_t _file_size(Libc::File_descriptor *fd)
 		{
 			struct stat stat_buf;
@@ -225,6 +682,42 @@ class Plugin : public Libc::Plugin
 			return stat_buf.st_size;
 		}
 
+		/**
+		 * Attach file range as dataspace provided by the file system
+		 *
+		 * \return local address, or 0 if the file system cannot provide
+		 *         the range as dataspace
+		 */
+		void *_attach(Libc::File_descriptor *fd, ::size_t length, bool writeable,
+		              ::off_t offset)
+		{
+			File_system::Node_handle node_handle = context(fd)->node_handle();
+			File_system::File_handle &file_handle =
+			    static_cast<File_system::File_handle&>(node_handle);
+
+			File_system::Mode const mode = writeable ? File_system::READ_WRITE
+			                                         : File_system::READ_ONLY;
+
+			/* the dataspace must cover the data of pending writes */
+			context(fd)->sync(*file_system()->tx());
+
+			Genode::Dataspace_capability ds =
+				file_system()->dataspace(file_handle, mode, offset, length);
+			if (!ds.valid())
+				return 0;
+
+			void *addr = 0;
+			try { addr = Genode::env()->rm_session()->attach(ds); }
+			catch (...) {
+				file_system()->release(ds);
+				return 0;
+			}
+
+			Genode::Lock::Guard guard(_mappings_lock);
+			_mappings.insert(new (Genode::env()->heap()) Mapping(addr, ds));
+			return addr;
+		}
+
 	public:
 
 		/**
@@ -288,17 +781,21 @@ class Plugin : public Libc::Plugin
 		int close(Libc::File_descriptor *fd)
 		{
 			/* wait for the completion of all operations of the context */
-			while (context(fd)->in_flight) {
-				if (verbose)
-					PDBG("wait_for_acknowledgement");
-				wait_for_acknowledgement(*file_system()->tx());
-			}
+			File_system::Session::Tx::Source &source = *file_system()->tx();
+			context(fd)->sync(source);
+			context(fd)->drop_readahead(source);
+
+			bool const write_failed = context(fd)->write_failed();
 
 			file_system()->close(context(fd)->node_handle());
 
 			Genode::destroy(Genode::env()->heap(), context(fd));
 			Libc::file_descriptor_allocator()->free(fd);
 
+			if (write_failed) {
+				errno = EIO;
+				return -1;
+			}
 			return 0;
 		}
 
@@ -314,6 +811,9 @@ class Plugin : public Libc::Plugin
 
 		int fstat(Libc::File_descriptor *fd, struct stat *buf)
 		{
+			/* the file size must account for the buffered writes */
+			context(fd)->sync(*file_system()->tx());
+
 			try {
 				obtain_stat_for_node(context(fd)->node_handle(), buf);
 				return 0;
@@ -335,9 +835,13 @@ class Plugin : public Libc::Plugin
 
 		int fsync(Libc::File_descriptor *fd)
 		{
-			if (verbose)
-				PDBG("not implemented");
-			return -1;
+			context(fd)->sync(*file_system()->tx());
+
+			if (context(fd)->write_failed()) {
+				errno = EIO;
+				return -1;
+			}
+			return 0;
 		}
 
 		int ftruncate(Libc::File_descriptor *fd, ::off_t length)
@@ -346,6 +850,10 @@ class Plugin : public Libc::Plugin
 			File_system::File_handle &file_handle =
 			    static_cast<File_system::File_handle&>(node_handle);
 
+			File_system::Session::Tx::Source &source = *file_system()->tx();
+			context(fd)->sync(source);
+			context(fd)->drop_readahead(source);
+
 			try {
 				file_system()->truncate(file_handle, length);
 			} catch (File_system::Invalid_handle) {
@@ -475,7 +983,7 @@ class Plugin : public Libc::Plugin
 					file_system()->dir(path.base(), false);
 
 				Plugin_context *context = new (Genode::env()->heap())
-					Plugin_context(handle);
+					Plugin_context(handle, path.base());
 
 				return Libc::file_descriptor_allocator()->alloc(this, context);
 			} catch (File_system::Lookup_failed) { }
@@ -524,7 +1032,7 @@ class Plugin : public Libc::Plugin
 				}
 
 				Plugin_context *context = new (Genode::env()->heap())
-					Plugin_context(handle);
+					Plugin_context(handle, path.base());
 
 				context->status_flags(flags);
 
@@ -547,71 +1055,10 @@ class Plugin : public Libc::Plugin
 
 		ssize_t read(Libc::File_descriptor *fd, void *buf, ::size_t count)
 		{
-			File_system::Session::Tx::Source &source = *file_system()->tx();
-
-			size_t const max_packet_size = source.bulk_buffer_size() / 2;
-
-			size_t remaining_count = count;
-
 			if (context(fd)->seek_offset() == ~0)
 				context(fd)->seek_offset(0);
 
-			while (remaining_count) {
-
-				collect_acknowledgements(source);
-
-				size_t curr_packet_size = Genode::min(remaining_count, max_packet_size);
-
-				/*
-				 * XXX handle 'Packet_alloc_failed' exception'
-				 */
-				File_system::Packet_descriptor
-					packet(source.alloc_packet(curr_packet_size),
-					       static_cast<File_system::Packet_ref *>(context(fd)),
-					       context(fd)->node_handle(),
-					       File_system::Packet_descriptor::READ,
-					       curr_packet_size,
-					       context(fd)->seek_offset());
-
-				/* mark context as having an operation in flight */
-				context(fd)->in_flight = true;
-
-				/* pass packet to server side */
-				source.submit_packet(packet);
-
-				do {
-					packet = source.get_acked_packet();
-					static_cast<Plugin_context *>(packet.ref())->in_flight = false;
-				} while (context(fd)->in_flight);
-
-				context(fd)->in_flight = false;
-
-				/*
-				 * XXX check if acked packet belongs to request,
-				 *     needed for thread safety
-				 */
-
-				size_t read_num_bytes = Genode::min(packet.length(), curr_packet_size);
-
-				/* copy-out payload into destination buffer */
-				memcpy(buf, source.packet_content(packet), read_num_bytes);
-
-				source.release_packet(packet);
-
-				/* prepare next iteration */
-				context(fd)->advance_seek_offset(read_num_bytes);
-				buf = (void *)((Genode::addr_t)buf + read_num_bytes);
-				remaining_count -= read_num_bytes;
-
-				/*
-				 * If we received less bytes than requested, we reached the end
-				 * of the file.
-				 */
-				if (read_num_bytes < curr_packet_size)
-					break;
-			}
-
-			return count - remaining_count;
+			return context(fd)->read(*file_system()->tx(), (char *)buf, count);
 		}
 
 		ssize_t readlink(const char *path, char *buf, size_t bufsiz)
@@ -637,7 +1084,7 @@ class Plugin : public Libc::Plugin
 				}
 
 				Plugin_context *context = new (Genode::env()->heap())
-					Plugin_context(symlink_handle);
+					Plugin_context(symlink_handle, Canonical_path(path).base());
 
 				Libc::File_descriptor *fd = Libc::file_descriptor_allocator()->alloc(this, context);
 
@@ -701,7 +1148,7 @@ class Plugin : public Libc::Plugin
 				}
 
 				Plugin_context *context = new (Genode::env()->heap())
-					Plugin_context(symlink_handle);
+					Plugin_context(symlink_handle, Canonical_path(newpath).base());
 
 				Libc::File_descriptor *fd =
 				    Libc::file_descriptor_allocator()->alloc(this, context);
@@ -729,46 +1176,7 @@ class Plugin : public Libc::Plugin
 
 		ssize_t write(Libc::File_descriptor *fd, const void *buf, ::size_t count)
 		{
-			File_system::Session::Tx::Source &source = *file_system()->tx();
-
-			size_t const max_packet_size = source.bulk_buffer_size() / 2;
-
-			size_t remaining_count = count;
-
-			while (remaining_count) {
-
-				collect_acknowledgements(source);
-
-				size_t curr_packet_size = Genode::min(remaining_count, max_packet_size);
-
-				try {
-					File_system::Packet_descriptor
-						packet(source.alloc_packet(curr_packet_size),
-							   static_cast<File_system::Packet_ref *>(context(fd)),
-							   context(fd)->node_handle(),
-							   File_system::Packet_descriptor::WRITE,
-							   curr_packet_size,
-							   context(fd)->seek_offset());
-
-					/* mark context as having an operation in flight */
-					context(fd)->in_flight = true;
-
-					/* copy-in payload into packet */
-					memcpy(source.packet_content(packet), buf, curr_packet_size);
-
-					/* pass packet to server side */
-					source.submit_packet(packet);
-
-					/* prepare next iteration */
-					context(fd)->advance_seek_offset(curr_packet_size);
-					buf = (void *)((Genode::addr_t)buf + curr_packet_size);
-					remaining_count -= curr_packet_size;
-				} catch (File_system::Session::Tx::Source::Packet_alloc_failed) {
-					do {
-						wait_for_acknowledgement(source);
-					} while (context(fd)->in_flight);
-				}
-			}
+			context(fd)->write(*file_system()->tx(), (char const *)buf, count);
 
 			if (verbose)
 				PDBG("write returns %zd", count);
@@ -778,7 +1186,7 @@ class Plugin : public Libc::Plugin
 		void *mmap(void *addr_in, ::size_t length, int prot, int flags,
 		           Libc::File_descriptor *fd, ::off_t offset)
 		{
-			if (prot != PROT_READ) {
+			if (prot & ~(PROT_READ | PROT_WRITE)) {
 				PERR("mmap for prot=%x not supported", prot);
 				errno = EACCES;
 				return (void *)-1;
@@ -790,6 +1198,31 @@ class Plugin : public Libc::Plugin
 				return (void *)-1;
 			}
 
+			bool const writeable = prot & PROT_WRITE;
+			bool const shared    = flags & MAP_SHARED;
+
+			/*
+			 * Shared mappings and read-only private mappings refer to the
+			 * file content directly if the file system supports it.
+			 * Writeable private mappings need a copy of the content.
+			 */
+			if (shared || !writeable) {
+				try {
+					void *addr = _attach(fd, length, shared && writeable, offset);
+					if (addr)
+						return addr;
+				}
+				catch (File_system::Permission_denied) { errno = EACCES; return (void *)-1; }
+				catch (File_system::Invalid_handle)    { errno = EBADF;  return (void *)-1; }
+				catch (File_system::No_space)          { errno = ENOMEM; return (void *)-1; }
+			}
+
+			if (shared && writeable) {
+				PERR("shared writeable mmap not supported by the file system");
+				errno = ENODEV;
+				return (void *)-1;
+			}
+
 			void *addr = Libc::mem_alloc()->alloc(length, PAGE_SHIFT);
 			if (addr == (void *)-1) {
 				errno = ENOMEM;
@@ -808,7 +1241,24 @@ class Plugin : public Libc::Plugin
 
 		int munmap(void *addr, ::size_t)
 		{
-			Libc::mem_alloc()->free(addr);
+			Mapping *mapping = 0;
+			{
+				Genode::Lock::Guard guard(_mappings_lock);
+				for (mapping = _mappings.first(); mapping; mapping = mapping->next())
+					if (mapping->addr == addr) {
+						_mappings.remove(mapping);
+						break;
+					}
+			}
+
+			if (!mapping) {
+				Libc::mem_alloc()->free(addr);
+				return 0;
+			}
+
+			Genode::env()->rm_session()->detach(addr);
+			file_system()->release(mapping->ds);
+			Genode::destroy(Genode::env()->heap(), mapping);
 			return 0;
 		}
 };
@@ -5,7 +5,7 @@
  */
 
 /*
- * Copyright (C) 2012 Genode Labs GmbH
+ * Copyright (C) 2012-2013 Genode Labs GmbH
  *
  * This file is part of the Genode OS framework, which is distributed
  * under the terms of the GNU General Public License version 2.
@@ -895,6 +895,12 @@ namespace File_system {
 				}
 
 			}
+
+			/* the file content is not available as dataspace */
+			Dataspace_capability dataspace(File_handle, Mode, seek_off_t, size_t) {
+				return Dataspace_capability(); }
+
+			void release(Dataspace_capability) { }
 	};
 
 
@@ -6,7 +6,7 @@
  */
 
 /*
- * Copyright (C) 2011-2012 Genode Labs GmbH
+ * Copyright (C) 2011-2013 Genode Labs GmbH
  *
  * This file is part of the Genode OS framework, which is distributed
  * under the terms of the GNU General Public License version 2.
@@ -14,11 +14,13 @@
 
 /* Genode includes */
 #include <os/config.h>
+#include <timer_session/connection.h>
 
 /* libc includes */
 #include <dirent.h>
 #include <fcntl.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <sys/stat.h>
 #include <sys/uio.h>
 #include <unistd.h>
@@ -37,6 +39,111 @@
 	}
 
 
+static unsigned long kib_per_s(unsigned long bytes, unsigned long ms)
+{
+	return ms ? (unsigned long)((unsigned long long)bytes * 1000 / 1024 / ms) : 0;
+}
+
+
+/**
+ * Measure the throughput of creating, writing, and reading files
+ *
+ * \param num_files      number of small files to create
+ * \param file_size_kib  size of the file that gets written and read with
+ *                       different block sizes
+ */
+static int benchmark(unsigned num_files, unsigned file_size_kib)
+{
+	static Timer::Connection timer;
+
+	enum { SMALL_FILE_SIZE = 4096, MAX_BLOCK_SIZE = 64*1024 };
+
+	char const *dir_name  = "/bench";
+	char const *file_name = "/bench/large.dat";
+	char        path[64];
+	int         ret, fd;
+	ssize_t     count;
+
+	unsigned long const file_size = file_size_kib * 1024UL;
+
+	char *buf = (char *)malloc(MAX_BLOCK_SIZE);
+	if (!buf) {
+		printf("Error: could not allocate buffer\n");
+		return -1;
+	}
+	memset(buf, 0x5a, MAX_BLOCK_SIZE);
+
+	printf("--- libc_ffat benchmark ---\n");
+
+	ret = mkdir(dir_name, 0777);
+	if ((ret != 0) && (errno != EEXIST)) {
+		printf("Error: could not create directory %s\n", dir_name);
+		return -1;
+	}
+
+	/* create small files, which mostly exercises the FAT and directories */
+	unsigned long start_ms = timer.elapsed_ms();
+	for (unsigned i = 0; i < num_files; i++) {
+		snprintf(path, sizeof(path), "%s/file%u.dat", dir_name, i);
+		fd = open(path, O_CREAT | O_WRONLY | O_TRUNC);
+		if (fd < 0 || write(fd, buf, SMALL_FILE_SIZE) != SMALL_FILE_SIZE) {
+			printf("Error: could not create %s\n", path);
+			return -1;
+		}
+		close(fd);
+	}
+	unsigned long ms = timer.elapsed_ms() - start_ms;
+	printf("created %u files of %u bytes in %lu ms, %lu files/s\n",
+	       num_files, (unsigned)SMALL_FILE_SIZE, ms,
+	       ms ? num_files * 1000UL / ms : 0);
+
+	static size_t const block_sizes[] = { 512, 4096, MAX_BLOCK_SIZE };
+
+	for (unsigned i = 0; i < sizeof(block_sizes)/sizeof(block_sizes[0]); i++) {
+
+		size_t const block_size = block_sizes[i];
+
+		start_ms = timer.elapsed_ms();
+		CALL_AND_CHECK(fd, open(file_name, O_CREAT | O_WRONLY | O_TRUNC), fd >= 0, "file_name=%s", file_name);
+		for (unsigned long offset = 0; offset < file_size; offset += block_size)
+			if (write(fd, buf, block_size) != (ssize_t)block_size) {
+				printf("Error: write at offset %lu failed\n", offset);
+				return -1;
+			}
+		CALL_AND_CHECK(ret, close(fd), ret == 0, "");
+		unsigned long const write_ms = timer.elapsed_ms() - start_ms;
+
+		start_ms = timer.elapsed_ms();
+		CALL_AND_CHECK(fd, open(file_name, O_RDONLY), fd >= 0, "file_name=%s", file_name);
+		unsigned long read_bytes = 0;
+		while ((count = read(fd, buf, block_size)) > 0)
+			read_bytes += count;
+		CALL_AND_CHECK(ret, close(fd), ret == 0, "");
+		unsigned long const read_ms = timer.elapsed_ms() - start_ms;
+
+		if (read_bytes != file_size) {
+			printf("Error: read %lu of %lu bytes\n", read_bytes, file_size);
+			return -1;
+		}
+
+		printf("block size %5zu: write %6lu KiB/s (%lu ms), read %6lu KiB/s (%lu ms)\n",
+		       block_size, kib_per_s(file_size, write_ms), write_ms,
+		       kib_per_s(file_size, read_ms), read_ms);
+	}
+
+	/* remove the files again */
+	for (unsigned i = 0; i < num_files; i++) {
+		snprintf(path, sizeof(path), "%s/file%u.dat", dir_name, i);
+		unlink(path);
+	}
+	unlink(file_name);
+	free(buf);
+
+	printf("--- end of libc_ffat benchmark ---\n");
+	return 0;
+}
+
+
 int main(int argc, char *argv[])
 {
 	int ret, fd;
@@ -224,5 +331,17 @@ int main(int argc, char *argv[])
 
 	printf("test finished\n");
 
+	/* run benchmark if configured */
+	try {
+		Genode::Xml_node bench = Genode::config()->xml_node().sub_node("benchmark");
+
+		unsigned num_files = 256, file_size_kib = 4096;
+		try { bench.attribute("files").value(&num_files); } catch (...) { }
+		try { bench.attribute("file_size_kib").value(&file_size_kib); } catch (...) { }
+
+		if (benchmark(num_files, file_size_kib) != 0)
+			return -1;
+	} catch (Genode::Xml_node::Nonexistent_sub_node) { }
+
 	return 0;
 }
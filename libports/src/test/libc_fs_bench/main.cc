@@ -0,0 +1,204 @@
+/*
+ * \brief  Throughput benchmark of the libc_fs plugin
+ * \author Martin Stein
+ * \date   2013-02-19
+ *
+ * A file is written, read, and copied sequentially with different block
+ * sizes. The copy interleaves reads of one file with writes of another
+ * one like 'cp' does. The benchmark reports the throughput of each pass
+ * and validates the content that was read back.
+ */
+
+/*
+ * Copyright (C) 2013 Genode Labs GmbH
+ *
+ * This file is part of the Genode OS framework, which is distributed
+ * under the terms of the GNU General Public License version 2.
+ */
+
+/* Genode includes */
+#include <timer_session/connection.h>
+
+/* libc includes */
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+enum {
+	FILE_SIZE      = 16*1024*1024,
+	MAX_BLOCK_SIZE = 256*1024,
+};
+
+static char const *file_name = "/bench.dat";
+static char const *copy_name = "/bench_copy.dat";
+
+
+/**
+ * Byte expected at 'offset' of the file
+ */
+static inline char pattern(unsigned long offset)
+{
+	return (char)(offset ^ (offset >> 9));
+}
+
+
+static unsigned long throughput_kib(unsigned long ms)
+{
+	return ms ? (unsigned long)((unsigned long long)FILE_SIZE * 1000 / 1024 / ms) : 0;
+}
+
+
+static bool write_file(size_t block_size, char *buf)
+{
+	int fd = open(file_name, O_CREAT | O_TRUNC | O_WRONLY);
+	if (fd < 0) {
+		printf("Error: could not create '%s'\n", file_name);
+		return false;
+	}
+
+	for (unsigned long offset = 0; offset < FILE_SIZE; offset += block_size) {
+		for (size_t i = 0; i < block_size; i++)
+			buf[i] = pattern(offset + i);
+
+		if (write(fd, buf, block_size) != (ssize_t)block_size) {
+			printf("Error: write at offset %lu failed\n", offset);
+			close(fd);
+			return false;
+		}
+	}
+
+	/* 'close' submits the buffered data and reports failed writes */
+	if (close(fd) != 0) {
+		printf("Error: close after writing failed\n");
+		return false;
+	}
+	return true;
+}
+
+
+static bool read_file(char const *name, size_t block_size, char *buf)
+{
+	int fd = open(name, O_RDONLY);
+	if (fd < 0) {
+		printf("Error: could not open '%s'\n", name);
+		return false;
+	}
+
+	bool ok = true;
+	for (unsigned long offset = 0; ok && offset < FILE_SIZE; offset += block_size) {
+
+		if (read(fd, buf, block_size) != (ssize_t)block_size) {
+			printf("Error: read at offset %lu failed\n", offset);
+			ok = false;
+			break;
+		}
+
+		for (size_t i = 0; i < block_size; i++)
+			if (buf[i] != pattern(offset + i)) {
+				printf("Error: unexpected content at offset %lu\n", offset + i);
+				ok = false;
+				break;
+			}
+	}
+
+	/* there must not be any content beyond the end of the file */
+	if (ok && read(fd, buf, block_size) != 0) {
+		printf("Error: read beyond the end of the file\n");
+		ok = false;
+	}
+
+	close(fd);
+	return ok;
+}
+
+
+static bool copy_file(size_t block_size, char *buf)
+{
+	int src = open(file_name, O_RDONLY);
+	if (src < 0) {
+		printf("Error: could not open '%s'\n", file_name);
+		return false;
+	}
+	int dst = open(copy_name, O_CREAT | O_TRUNC | O_WRONLY);
+	if (dst < 0) {
+		printf("Error: could not create '%s'\n", copy_name);
+		close(src);
+		return false;
+	}
+
+	bool ok = true;
+	for (unsigned long offset = 0; offset < FILE_SIZE; offset += block_size) {
+		if (read(src, buf, block_size) != (ssize_t)block_size) {
+			printf("Error: read for copy at offset %lu failed\n", offset);
+			ok = false;
+			break;
+		}
+		if (write(dst, buf, block_size) != (ssize_t)block_size) {
+			printf("Error: write of copy at offset %lu failed\n", offset);
+			ok = false;
+			break;
+		}
+	}
+
+	close(src);
+	if (close(dst) != 0) {
+		printf("Error: close after copying failed\n");
+		ok = false;
+	}
+	return ok;
+}
+
+
+int main(int, char **)
+{
+	printf("--- libc_fs benchmark ---\n");
+
+	static Timer::Connection timer;
+
+	char *buf = (char *)malloc(MAX_BLOCK_SIZE);
+	if (!buf) {
+		printf("Error: could not allocate buffer\n");
+		return -1;
+	}
+
+	static size_t const block_sizes[] = { 64, 512, 4096, 16*1024, 64*1024, 256*1024 };
+
+	for (unsigned i = 0; i < sizeof(block_sizes)/sizeof(block_sizes[0]); i++) {
+
+		size_t const block_size = block_sizes[i];
+
+		unsigned long start_ms = timer.elapsed_ms();
+		if (!write_file(block_size, buf))
+			return -1;
+		unsigned long const write_ms = timer.elapsed_ms() - start_ms;
+
+		start_ms = timer.elapsed_ms();
+		if (!read_file(file_name, block_size, buf))
+			return -1;
+		unsigned long const read_ms = timer.elapsed_ms() - start_ms;
+
+		start_ms = timer.elapsed_ms();
+		if (!copy_file(block_size, buf))
+			return -1;
+		unsigned long const copy_ms = timer.elapsed_ms() - start_ms;
+
+		/* the copy must have the content of the original */
+		if (!read_file(copy_name, block_size, buf))
+			return -1;
+
+		printf("block size %6zu: write %6lu KiB/s (%lu ms), read %6lu KiB/s (%lu ms), "
+		       "copy %6lu KiB/s (%lu ms)\n",
+		       block_size, throughput_kib(write_ms), write_ms,
+		       throughput_kib(read_ms), read_ms,
+		       throughput_kib(copy_ms), copy_ms);
+	}
+
+	unlink(file_name);
+	unlink(copy_name);
+	free(buf);
+
+	printf("--- end of libc_fs benchmark ---\n");
+	return 0;
+}
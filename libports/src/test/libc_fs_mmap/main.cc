@@ -0,0 +1,103 @@
+/*
+ * \brief  Test for memory-mapped files via the libc_fs plugin
+ * \author Martin Stein
+ * \date   2013-02-18
+ */
+
+/*
+ * Copyright (C) 2013 Genode Labs GmbH
+ *
+ * This file is part of the Genode OS framework, which is distributed
+ * under the terms of the GNU General Public License version 2.
+ */
+
+/* libc includes */
+#include <fcntl.h>
+#include <stdio.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <string.h>
+#include <errno.h>
+
+
+#define CALL_AND_CHECK(ret, operation, condition, info_string, ...) \
+	printf("calling " #operation " " info_string "\n", ##__VA_ARGS__); \
+	ret = operation; \
+	if (condition) { \
+		printf(#operation " succeeded\n"); \
+	} else { \
+		printf(#operation " failed, " #ret "=%ld, errno=%d\n", (long)ret, errno); \
+		return -1; \
+	}
+
+
+enum { FILE_SIZE = 1024*1024 + 123 };
+
+static char buf[FILE_SIZE];
+
+
+static char pattern(size_t i) { return (char)(i * 7 + i / 4096); }
+
+
+int main(int argc, char *argv[])
+{
+	int ret, fd;
+	ssize_t count;
+	char *addr;
+
+	char const *file_name = "/mmap.tst";
+
+	/* create file */
+	for (size_t i = 0; i < FILE_SIZE; i++)
+		buf[i] = pattern(i);
+
+	CALL_AND_CHECK(fd, open(file_name, O_CREAT | O_RDWR), fd >= 0, "file_name=%s", file_name);
+	CALL_AND_CHECK(count, write(fd, buf, FILE_SIZE), count == FILE_SIZE, "");
+
+	/* read-only mapping, the file descriptor gets closed before access */
+	CALL_AND_CHECK(addr, (char *)mmap(0, FILE_SIZE, PROT_READ, MAP_SHARED, fd, 0),
+	               addr != MAP_FAILED, "");
+	CALL_AND_CHECK(ret, close(fd), ret == 0, "");
+
+	for (size_t i = 0; i < FILE_SIZE; i++)
+		if (addr[i] != pattern(i)) {
+			printf("unexpected content of read-only mapping at %zu\n", i);
+			return -1;
+		}
+	CALL_AND_CHECK(ret, munmap(addr, FILE_SIZE), ret == 0, "");
+
+	/* shared writeable mapping of the second page */
+	CALL_AND_CHECK(fd, open(file_name, O_RDWR), fd >= 0, "file_name=%s", file_name);
+	CALL_AND_CHECK(addr, (char *)mmap(0, 4096, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 4096),
+	               addr != MAP_FAILED, "");
+	memset(addr, 'x', 4096);
+	CALL_AND_CHECK(ret, munmap(addr, 4096), ret == 0, "");
+
+	CALL_AND_CHECK(count, pread(fd, buf, 3*4096, 0), count == 3*4096, "");
+	for (size_t i = 0; i < 3*4096; i++) {
+		char const expected = (i >= 4096 && i < 2*4096) ? 'x' : pattern(i);
+		if (buf[i] != expected) {
+			printf("unexpected file content after shared mapping at %zu\n", i);
+			return -1;
+		}
+	}
+
+	/* changes of a private mapping must not apply to the file */
+	CALL_AND_CHECK(addr, (char *)mmap(0, 4096, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0),
+	               addr != MAP_FAILED, "");
+	memset(addr, 'y', 4096);
+	CALL_AND_CHECK(ret, munmap(addr, 4096), ret == 0, "");
+
+	CALL_AND_CHECK(count, pread(fd, buf, 4096, 0), count == 4096, "");
+	for (size_t i = 0; i < 4096; i++)
+		if (buf[i] != pattern(i)) {
+			printf("unexpected file content after private mapping at %zu\n", i);
+			return -1;
+		}
+
+	CALL_AND_CHECK(ret, close(fd), ret == 0, "");
+
+	printf("test finished\n");
+
+	return 0;
+}
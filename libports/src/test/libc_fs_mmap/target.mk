@@ -0,0 +1,3 @@
+TARGET = test-libc_fs_mmap
+LIBS   = cxx env libc libc_log libc_fs
+SRC_CC = main.cc
@@ -0,0 +1,153 @@
+/*
+ * \brief  Multi-threaded benchmark of the libc malloc
+ * \author Martin Stein
+ * \date   2013-02-08
+ *
+ * Each thread keeps a window of live blocks of pseudo-random sizes and
+ * replaces one of them per round. A part of the blocks gets handed over
+ * to the next thread, which frees them, to also exercise frees of
+ * foreign blocks. The benchmark reports the malloc/free pairs per second
+ * for an increasing number of threads.
+ */
+
+/*
+ * Copyright (C) 2013 Genode Labs GmbH
+ *
+ * This file is part of the Genode OS framework, which is distributed
+ * under the terms of the GNU General Public License version 2.
+ */
+
+/* Genode includes */
+#include <base/env.h>
+#include <base/thread.h>
+#include <base/semaphore.h>
+#include <timer_session/connection.h>
+
+/* libc includes */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+enum {
+	MAX_THREADS = 8,
+	ROUNDS      = 100*1000, /* malloc/free pairs per thread */
+	WINDOW      = 256,      /* live blocks per thread */
+	HANDOVER    = 16,       /* each n-th block gets freed by the neighbour */
+	STACK_SIZE  = 16*1024,
+};
+
+
+/**
+ * Thread that allocates and frees blocks
+ */
+class Worker : public Genode::Thread<STACK_SIZE>
+{
+	private:
+
+		void * volatile   _mailbox; /* block that awaits us for being freed */
+		unsigned          _seed;
+		void             *_window[WINDOW];
+		Genode::Semaphore _start;
+		Genode::Semaphore _done;
+
+		/**
+		 * Pseudo-random size, mostly small, sometimes up to 64 KiB
+		 */
+		Genode::size_t _size()
+		{
+			_seed ^= _seed << 13; _seed ^= _seed >> 17; _seed ^= _seed << 5;
+			switch (_seed % 16) {
+			case 0:  return _seed % (64*1024);
+			case 1:
+			case 2:  return _seed % 4096;
+			default: return _seed % 256;
+			}
+		}
+
+		void _free_mail()
+		{
+			void * const mail = _mailbox;
+			if (!mail) return;
+			free(mail);
+			_mailbox = 0;
+		}
+
+	public:
+
+		Worker *neighbour;
+
+		Worker(unsigned const seed)
+		:
+			Genode::Thread<STACK_SIZE>("worker"), _mailbox(0), _seed(seed),
+			neighbour(this)
+		{
+			memset(_window, 0, sizeof(_window));
+			start();
+		}
+
+		void run() { _start.up(); }
+
+		void wait_for_completion() { _done.down(); }
+
+		/**
+		 * Free a block that was handed over at the end of a run
+		 */
+		void free_mail() { _free_mail(); }
+
+		void entry()
+		{
+			while (1) {
+				_start.down();
+				for (unsigned i = 0; i < ROUNDS; i++) {
+					unsigned const slot = i % WINDOW;
+
+					/* hand over the old block if the neighbour is idle */
+					void * const old = _window[slot];
+					if (old && !(i % HANDOVER) && !neighbour->_mailbox)
+						neighbour->_mailbox = old;
+					else
+						free(old);
+
+					_window[slot] = malloc(_size());
+					*(char *)_window[slot] = 1;
+					_free_mail();
+				}
+				for (unsigned i = 0; i < WINDOW; i++) {
+					free(_window[i]);
+					_window[i] = 0;
+				}
+				_done.up();
+			}
+		}
+};
+
+
+int main(int, char **)
+{
+	printf("--- malloc benchmark ---\n");
+
+	static Timer::Connection timer;
+	static Worker *workers[MAX_THREADS];
+	for (unsigned i = 0; i < MAX_THREADS; i++)
+		workers[i] = new (Genode::env()->heap()) Worker(i * 7919 + 1);
+
+	for (unsigned threads = 1; threads <= MAX_THREADS; threads *= 2) {
+
+		for (unsigned i = 0; i < threads; i++)
+			workers[i]->neighbour = workers[(i + 1) % threads];
+
+		unsigned long const start_ms = timer.elapsed_ms();
+		for (unsigned i = 0; i < threads; i++) workers[i]->run();
+		for (unsigned i = 0; i < threads; i++) workers[i]->wait_for_completion();
+		unsigned long const ms = timer.elapsed_ms() - start_ms;
+
+		/* blocks left in the mailboxes get freed by the main thread */
+		for (unsigned i = 0; i < threads; i++) workers[i]->free_mail();
+
+		unsigned long const pairs = (unsigned long)threads * ROUNDS;
+		printf("%u threads: %lu malloc/free pairs in %lu ms, %lu pairs/s\n",
+		       threads, pairs, ms, ms ? pairs * 1000 / ms : 0);
+	}
+	printf("--- end of malloc benchmark ---\n");
+	return 0;
+}
@@ -0,0 +1,3 @@
+TARGET = test-malloc_bench
+SRC_CC = main.cc
+LIBS   = cxx env thread libc libc_log
@@ -5,7 +5,7 @@
  */
 
 /*
- * Copyright (C) 2011-2012 Genode Labs GmbH
+ * Copyright (C) 2011-2013 Genode Labs GmbH
  *
  * This file is part of the Genode OS framework, which is distributed
  * under the terms of the GNU General Public License version 2.
@@ -14,6 +14,7 @@
 #ifndef _INCLUDE__BLOCK__COMPONENT_H_
 #define _INCLUDE__BLOCK__COMPONENT_H_
 
+#include <base/semaphore.h>
 #include <root/component.h>
 #include <block_session/rpc_object.h>
 
@@ -26,80 +27,353 @@ namespace Block {
 
 	class Session_component : public Session_rpc_object
 	{
+		public:
+
+			/**
+			 * Statistics about the requests of a session
+			 */
+			struct Stats
+			{
+				unsigned long packets;       /* packets received */
+				unsigned long requests;      /* requests executed by the driver */
+				unsigned long merged;        /* packets merged into a request */
+				unsigned      in_flight;     /* outstanding requests */
+				unsigned      max_in_flight; /* maximum of outstanding requests */
+
+				Stats()
+				: packets(0), requests(0), merged(0), in_flight(0),
+				  max_in_flight(0) { }
+			};
+
 		private:
 
-			enum { RQ_STACK_SIZE = 8192 };
-			class Rq_thread : public Thread<RQ_STACK_SIZE>
+			/*
+			 * The limits keep the session object within the RAM quota
+			 * that 'Block::Connection' donates for it.
+			 */
+			enum {
+				RQ_STACK_SIZE = 8192,
+				MAX_BATCH     = 16, /* packets fetched from the client at once */
+				MAX_MERGE     = 8,  /* packets per request */
+				MAX_PENDING   = 16, /* outstanding requests */
+			};
+
+			/**
+			 * Driver request together with the packets it was made of
+			 */
+			struct Pending : Request
+			{
+				Packet_descriptor packets[MAX_MERGE];
+				unsigned          num_packets;
+				bool              used;
+
+				Pending() : num_packets(0), used(false) { }
+			};
+
+			/**
+			 * Thread that feeds the packets of the client to the driver
+			 *
+			 * The thread fetches all packets that are available at once,
+			 * sorts them by block number, and merges packets that address
+			 * adjacent blocks and adjacent payloads into one request. If
+			 * the driver is asynchronous, requests get submitted up to its
+			 * queue depth and the packets get acknowledged by 'complete'.
+			 * Otherwise, the thread executes one request after the other.
+			 */
+			class Rq_thread : public Thread<RQ_STACK_SIZE>,
+			                  public Request_completion
 			{
 				private:
 
-					Tx::Sink *_sink;
-					Driver   &_driver;
-					addr_t    _rq_phys; /* physical addr. of rq_ds */
+					Tx::Sink         *_sink;
+					Driver           &_driver;
+					addr_t            _rq_phys; /* physical addr. of rq_ds */
+					size_t const      _blk_size;
+					bool const        _async;
+					unsigned const    _depth;   /* max. outstanding requests */
+					Packet_descriptor _batch[MAX_BATCH];
+					Pending           _pending[MAX_PENDING];
+					Lock              _lock;    /* guards '_pending' and '_stats' */
+					Semaphore         _completed;
+					unsigned          _waiters; /* threads blocking at '_completed' */
+					Stats             _stats;
+					bool              _stopped;
+					Lock              _park;    /* never released */
+
+					static bool _write(Request::Operation op) {
+						return op == Request::WRITE; }
+
+					static bool _overlap(size_t a_nr, size_t a_cnt,
+					                     size_t b_nr, size_t b_cnt) {
+						return a_nr < b_nr + b_cnt && b_nr < a_nr + a_cnt; }
+
+					static Request::Operation _operation(Packet_descriptor const &p)
+					{
+						return p.operation() == Packet_descriptor::WRITE
+						       ? Request::WRITE : Request::READ;
+					}
+
+					/**
+					 * Whether the order of 'a' and 'b' must be preserved
+					 */
+					static bool _conflict(Packet_descriptor const &a,
+					                      Packet_descriptor const &b)
+					{
+						return (_write(_operation(a)) || _write(_operation(b))) &&
+						       _overlap(a.block_number(), a.block_count(),
+						                b.block_number(), b.block_count());
+					}
+
+					/**
+					 * Whether 'b' can be appended to the request ending with 'a'
+					 */
+					bool _mergeable(Packet_descriptor const &a,
+					                Packet_descriptor const &b) const
+					{
+						size_t const size = a.block_count() * _blk_size;
+						return a.operation() == b.operation() &&
+						       a.block_number() + a.block_count() == b.block_number() &&
+						       a.size() == size &&
+						       a.offset() + (off_t)size == b.offset();
+					}
+
+					/**
+					 * Whether 'r' must wait for an outstanding request
+					 *
+					 * Must be called with '_lock' taken.
+					 */
+					bool _blocked(Request const &r) const
+					{
+						for (unsigned i = 0; i < MAX_PENDING; i++) {
+							Pending const &p = _pending[i];
+							if (p.used && (_write(p.operation) || _write(r.operation)) &&
+							    _overlap(p.block_number, p.block_count,
+							             r.block_number, r.block_count))
+								return true;
+						}
+						return false;
+					}
+
+					/**
+					 * Block until the next request completes
+					 *
+					 * Must be called with '_lock' taken, returns with
+					 * '_lock' taken.
+					 */
+					void _wait_for_completion()
+					{
+						_waiters++;
+						_lock.unlock();
+						_completed.down();
+						_lock.lock();
+					}
+
+					/**
+					 * Block forever once the thread got stopped
+					 *
+					 * Must be called with '_lock' taken. The stopped thread
+					 * holds no lock and gets destroyed with the session.
+					 */
+					void _park_if_stopped()
+					{
+						if (!_stopped) return;
+
+						_lock.unlock();
+						while (true) _park.lock();
+					}
+
+					/**
+					 * Sort batch by block number
+					 *
+					 * This is an insertion sort that never moves a packet
+					 * past a conflicting one.
+					 */
+					void _sort(unsigned const n)
+					{
+						for (unsigned i = 1; i < n; i++)
+							for (unsigned j = i; j > 0; j--) {
+								Packet_descriptor &a = _batch[j - 1];
+								Packet_descriptor &b = _batch[j];
+								if (a.block_number() <= b.block_number() ||
+								    _conflict(a, b))
+									break;
+								Packet_descriptor const tmp = a; a = b; b = tmp;
+							}
+					}
+
+					/**
+					 * Allocate pending request for the 'n' packets at 'packets'
+					 *
+					 * Blocks until the queue of the driver has space and
+					 * no outstanding request conflicts with the new one.
+					 */
+					Pending &_alloc(Request const &r,
+					                Packet_descriptor const *packets,
+					                unsigned const n)
+					{
+						Lock::Guard guard(_lock);
+						_park_if_stopped();
+						while (_stats.in_flight >= _depth || _blocked(r)) {
+							_wait_for_completion();
+							_park_if_stopped();
+						}
+
+						for (unsigned i = 0; ; i++) {
+							Pending &p = _pending[i];
+							if (p.used) continue;
+
+							*static_cast<Request *>(&p) = r;
+							for (unsigned j = 0; j < n; j++)
+								p.packets[j] = packets[j];
+							p.num_packets = n;
+							p.used        = true;
+
+							_stats.requests++;
+							_stats.merged += n - 1;
+							if (++_stats.in_flight > _stats.max_in_flight)
+								_stats.max_in_flight = _stats.in_flight;
+							return p;
+						}
+					}
+
+					/**
+					 * Execute request via the blocking driver interface
+					 */
+					bool _execute(Request &r)
+					{
+						try {
+							if (r.operation == Request::READ) {
+								if (_driver.dma_enabled())
+									_driver.read_dma(r.block_number, r.block_count, r.phys);
+								else
+									_driver.read(r.block_number, r.block_count, r.buffer);
+							} else {
+								if (_driver.dma_enabled())
+									_driver.write_dma(r.block_number, r.block_count, r.phys);
+								else
+									_driver.write(r.block_number, r.block_count, r.buffer);
+							}
+						} catch (Driver::Io_error) { return false; }
+						return true;
+					}
+
+					/**
+					 * Acknowledge packets to the client
+					 *
+					 * Must be called with '_lock' taken.
+					 */
+					void _acknowledge(Packet_descriptor const *packets, unsigned n)
+					{
+						if (!_sink->ready_to_ack())
+							PDBG("need to wait until ready-for-ack");
+
+						_sink->acknowledge_packets(packets, n);
+					}
 
 				public:
 
 					Rq_thread(Tx::Sink *sink, Driver &driver, addr_t rq_phys)
 					:
 						Thread<RQ_STACK_SIZE>("rq"),
-						_sink(sink), _driver(driver), _rq_phys(rq_phys)
+						_sink(sink), _driver(driver), _rq_phys(rq_phys),
+						_blk_size(driver.block_size()),
+						_async(driver.queue_depth() > 0),
+						_depth(_async ? min(driver.queue_depth(), (unsigned)MAX_PENDING) : 1),
+						_waiters(0), _stopped(false), _park(Lock::LOCKED)
 					{ start(); }
 
-					void entry()
+					/**
+					 * Return snapshot of the request statistics
+					 */
+					Stats stats()
 					{
-						/* handle requests */
-						while (true) {
+						Lock::Guard guard(_lock);
+						return _stats;
+					}
 
-							/* blocking-get packet from client */
-							Packet_descriptor packet = _sink->get_packet();
-							if (!packet.valid()) {
-								PWRN("received invalid packet");
-								continue;
-							}
+					/**
+					 * Stop issuing requests and wait for the outstanding ones
+					 *
+					 * Afterwards, the thread does not touch the driver or
+					 * the packet stream anymore.
+					 */
+					void stop_and_drain()
+					{
+						Lock::Guard guard(_lock);
+						_stopped = true;
+						while (_stats.in_flight)
+							_wait_for_completion();
+					}
 
-							packet.succeeded(true);
 
-							switch (packet.operation()) {
+					/**************************************
+					 ** Request_completion interface **
+					 **************************************/
 
-								case Block::Packet_descriptor::READ:
+					void complete(Request &request, bool success)
+					{
+						Pending &p = static_cast<Pending &>(request);
 
-									try {
-										if (_driver.dma_enabled())
-											_driver.read_dma(packet.block_number(), packet.block_count(),
-											                 _rq_phys + packet.offset());
-										else
-											_driver.read(packet.block_number(), packet.block_count(),
-											             _sink->packet_content(packet));
-									} catch (Driver::Io_error) {
-										packet.succeeded(false);
-									}
-									break;
+						Lock::Guard guard(_lock);
+						for (unsigned i = 0; i < p.num_packets; i++)
+							p.packets[i].succeeded(success);
+						_acknowledge(p.packets, p.num_packets);
 
-								case Block::Packet_descriptor::WRITE:
-									try {
-										if (_driver.dma_enabled())
-											_driver.write_dma(packet.block_number(), packet.block_count(),
-											                  _rq_phys + packet.offset());
-										else
-											_driver.write(packet.block_number(), packet.block_count(),
-											              _sink->packet_content(packet));
-									} catch (Driver::Io_error) {
-										packet.succeeded(false);
-									}
-									break;
+						p.used = false;
+						_stats.in_flight--;
+						for (; _waiters; _waiters--)
+							_completed.up();
+					}
+
+					void entry()
+					{
+						/* handle requests */
+						while (true) {
+
+							/* blocking-get all packets available */
+							unsigned const n = _sink->get_packets(_batch, MAX_BATCH);
+							_sort(n);
 
-								default:
+							{
+								Lock::Guard guard(_lock);
+								_park_if_stopped();
+								_stats.packets += n;
+							}
+
+							for (unsigned i = 0, merged; i < n; i += merged) {
 
+								Packet_descriptor &packet = _batch[i];
+								if (packet.operation() != Packet_descriptor::READ &&
+								    packet.operation() != Packet_descriptor::WRITE) {
 									PWRN("received invalid packet");
 									packet.succeeded(false);
+									Lock::Guard guard(_lock);
+									_park_if_stopped();
+									_acknowledge(&packet, 1);
+									merged = 1;
+									continue;
+								}
+
+								Request r;
+								r.operation    = _operation(packet);
+								r.block_number = packet.block_number();
+								r.block_count  = packet.block_count();
+								r.buffer       = _sink->packet_content(packet);
+								r.phys         = _rq_phys + packet.offset();
+
+								for (merged = 1; merged < MAX_MERGE && i + merged < n &&
+								     _mergeable(_batch[i + merged - 1], _batch[i + merged]);
+								     merged++)
+									r.block_count += _batch[i + merged].block_count();
+
+								Pending &p = _alloc(r, &_batch[i], merged);
+								if (!_async) {
+									complete(p, _execute(p));
 									continue;
+								}
+								try { _driver.submit(p, *this); }
+								catch (Driver::Io_error) { complete(p, false); }
 							}
-
-							/* acknowledge packet to the client */
-							if (!_sink->ready_to_ack())
-								PDBG("need to wait until ready-for-ack");
-
-							_sink->acknowledge_packet(packet);
 						}
 					}
 			};
@@ -130,9 +404,22 @@ namespace Block {
 			 */
 			~Session_component()
 			{
+				/* the driver must not complete requests of a dead session */
+				_rq_thread.stop_and_drain();
+
+				Stats const s = stats();
+				PINF("block session closed: %lu packets, %lu requests, "
+				     "%lu merged, max. %u in flight",
+				     s.packets, s.requests, s.merged, s.max_in_flight);
+
 				_driver_factory.destroy(&_driver);
 			}
 
+			/**
+			 * Return statistics about the requests of the session
+			 */
+			Stats stats() { return _rq_thread.stats(); }
+
 			void info(size_t *blk_count, size_t *blk_size,
 			          Operations *ops)
 			{
@@ -6,7 +6,7 @@
  */
 
 /*
- * Copyright (C) 2011-2012 Genode Labs GmbH
+ * Copyright (C) 2011-2013 Genode Labs GmbH
  *
  * This file is part of the Genode OS framework, which is distributed
  * under the terms of the GNU General Public License version 2.
@@ -21,6 +21,39 @@
 
 namespace Block {
 
+	/**
+	 * Request that gets handed to an asynchronous driver
+	 *
+	 * A request may cover several packets of the client that the session
+	 * merged because they address adjacent blocks.
+	 */
+	struct Request
+	{
+		enum Operation { READ, WRITE };
+
+		Operation      operation;
+		Genode::size_t block_number; /* number of first block */
+		Genode::size_t block_count;  /* number of blocks */
+		char          *buffer;       /* local address of the payload */
+		Genode::addr_t phys;         /* physical address of the payload */
+	};
+
+
+	/**
+	 * Receiver of the completions of asynchronous requests
+	 */
+	struct Request_completion
+	{
+		/**
+		 * Called by the driver once it finished 'request'
+		 *
+		 * The function may be called from any thread of the driver,
+		 * also from within 'Driver::submit'.
+		 */
+		virtual void complete(Request &request, bool success) = 0;
+	};
+
+
 	/**
 	 * Interface to be implemented by the device-specific driver code
 	 */
@@ -91,6 +124,30 @@ namespace Block {
 		 * \return  true if DMA is enabled, false otherwise
 		 */
 		virtual bool dma_enabled() = 0;
+
+		/**
+		 * Number of requests the driver accepts at a time via 'submit'
+		 *
+		 * \return  0 if the driver supports the blocking interface only
+		 */
+		virtual unsigned queue_depth() { return 0; }
+
+		/**
+		 * Submit request for asynchronous execution
+		 *
+		 * \param request     request that stays valid until completed
+		 * \param completion  receiver that must be notified once the
+		 *                    request is done
+		 *
+		 * The session never has more than 'queue_depth' requests
+		 * outstanding and never two overlapping requests of which one
+		 * is a write. Thus, the driver may complete requests in any order.
+		 *
+		 * \throw Io_error  request could not be submitted and is not
+		 *                  going to be completed
+		 */
+		virtual void submit(Request &, Request_completion &) {
+			throw Io_error(); }
 	};
 
 
@@ -111,4 +168,4 @@ namespace Block {
 	};
 }
 
-#endif /* _BLOCK__DRIVER_H_ */
+#endif /* _INCLUDE__BLOCK__DRIVER_H_ */
@@ -129,6 +129,13 @@ namespace Block {
 		                  Genode::size_t *blk_size,
 		                  Operations     *ops) = 0;
 
+		/**
+		 * Write back data that the server buffers to the device
+		 *
+		 * Servers that don't buffer writes need not implement this.
+		 */
+		virtual void sync() { }
+
 		/**
 		 * Request packet-transmission channel
 		 */
@@ -146,7 +153,8 @@ namespace Block {
 
 		GENODE_RPC(Rpc_info, void, info, Genode::size_t *, Genode::size_t *, Operations *);
 		GENODE_RPC(Rpc_tx_cap, Genode::Capability<Tx>, _tx_cap);
-		GENODE_RPC_INTERFACE(Rpc_info, Rpc_tx_cap);
+		GENODE_RPC(Rpc_sync, void, sync);
+		GENODE_RPC_INTERFACE(Rpc_info, Rpc_tx_cap, Rpc_sync);
 	};
 }
 
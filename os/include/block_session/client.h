@@ -53,6 +53,8 @@ namespace Block {
 				call<Rpc_info>(blk_count, blk_size, ops);
 			}
 
+			void sync() { call<Rpc_sync>(); }
+
 			Tx *tx_channel() { return &_tx; }
 			Tx::Source *tx() { return _tx.source(); }
 
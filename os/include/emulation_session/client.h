@@ -49,6 +49,11 @@ namespace Emulation
 		bool irq_handler(unsigned const irq,
 		                 Signal_context_capability irq_edge)
 		{ return call<Rpc_irq_handler>(irq, irq_edge); }
+
+		bool fidelity(Fidelity const f) { return call<Rpc_fidelity>(f); }
+
+		bool data_window(addr_t const o, Dataspace_capability ds)
+		{ return call<Rpc_data_window>(o, ds); }
 	};
 }
 
@@ -0,0 +1,164 @@
+/*
+ * \brief   Shared ring buffers of an emulated data window
+ * \author  Martin Stein
+ * \date    2013-01-30
+ */
+
+/*
+ * Copyright (C) 2013 Genode Labs GmbH
+ *
+ * This file is part of the Genode OS framework, which is distributed
+ * under the terms of the GNU General Public License version 2.
+ */
+
+#ifndef _INCLUDE__EMULATION_SESSION__DATA_WINDOW_H_
+#define _INCLUDE__EMULATION_SESSION__DATA_WINDOW_H_
+
+/* Genode includes */
+#include <base/stdint.h>
+
+namespace Emulation
+{
+	using namespace Genode;
+
+	/**
+	 * Single-producer single-consumer ring of words in shared memory
+	 *
+	 * The ring is position independent as driver and emulator attach
+	 * it at different addresses. 'head' is written by the producer
+	 * only and 'tail' by the consumer only, both count words endlessly.
+	 * Thus the number of slots must be a power of two.
+	 */
+	class Data_ring
+	{
+		volatile unsigned _head;      /* words that were written so far */
+		volatile unsigned _tail;      /* words that were read so far */
+		unsigned          _size;      /* number of slots */
+		unsigned          _slots_off; /* offset of the slots from 'this' */
+
+		umword_t * _slots() {
+			return (umword_t *)((addr_t)this + _slots_off); }
+
+		static void _barrier() { __sync_synchronize(); }
+
+		public:
+
+			/**
+			 * Initialize an empty ring
+			 *
+			 * \param slots  address of the slot array
+			 * \param size   number of slots, must be a power of two
+			 */
+			void init(umword_t * const slots, unsigned const size)
+			{
+				_head = 0;
+				_tail = 0;
+				_size = size;
+				_slots_off = (addr_t)slots - (addr_t)this;
+			}
+
+			/**
+			 * Number of words that can be read
+			 */
+			unsigned avail() const { return _head - _tail; }
+
+			/**
+			 * Number of words that can be written
+			 */
+			unsigned space() const { return _size - avail(); }
+
+			/**
+			 * Write up to 'n' words from 'src', producer only
+			 *
+			 * \return  number of words written
+			 */
+			unsigned write(umword_t const * const src, unsigned n)
+			{
+				if (n > space()) n = space();
+				unsigned const head = _head;
+				umword_t * const slots = _slots();
+				for (unsigned i = 0; i < n; i++)
+					slots[(head + i) & (_size - 1)] = src[i];
+
+				/* publish the words not before they are in place */
+				_barrier();
+				_head = head + n;
+				return n;
+			}
+
+			/**
+			 * Read up to 'n' words to 'dst', consumer only
+			 *
+			 * \return  number of words read
+			 */
+			unsigned read(umword_t * const dst, unsigned n)
+			{
+				if (n > avail()) n = avail();
+				_barrier();
+				unsigned const tail = _tail;
+				umword_t * const slots = _slots();
+				for (unsigned i = 0; i < n; i++)
+					dst[i] = slots[(tail + i) & (_size - 1)];
+
+				/* release the slots not before they are read */
+				_barrier();
+				_tail = tail + n;
+				return n;
+			}
+
+			/**
+			 * Get the oldest word without removing it, consumer only
+			 *
+			 * \return  wether a word is available
+			 */
+			bool peek(umword_t & word)
+			{
+				if (!avail()) return 0;
+				_barrier();
+				word = _slots()[_tail & (_size - 1)];
+				return 1;
+			}
+
+			/**
+			 * Remove the oldest word, consumer only
+			 */
+			void drop()
+			{
+				if (!avail()) return;
+				_barrier();
+				_tail = _tail + 1;
+			}
+	};
+
+	/**
+	 * Layout of the dataspace behind an emulated data window
+	 *
+	 * The driver writes bursts to 'to_device' and reads bursts from
+	 * 'from_device' through plain memory accesses. The emulator moves
+	 * the words between the rings and the FIFOs of the design as their
+	 * ready/valid handshake allows. Doorbell and status registers stay
+	 * in a normal emulated IO_MEM region and thus keep trap semantics.
+	 */
+	struct Data_window
+	{
+		Data_ring to_device;
+		Data_ring from_device;
+
+		/**
+		 * Initialize both rings within a window of 'size' bytes
+		 */
+		void init(size_t const size)
+		{
+			/* split the space behind the header into two equal rings */
+			size_t const words = (size - sizeof(*this)) / sizeof(umword_t) / 2;
+			unsigned slots = 1;
+			while (slots * 2 <= words) slots *= 2;
+
+			umword_t * const base = (umword_t *)(this + 1);
+			to_device.init(base, slots);
+			from_device.init(base + slots, slots);
+		}
+	};
+}
+
+#endif /* _INCLUDE__EMULATION_SESSION__DATA_WINDOW_H_ */
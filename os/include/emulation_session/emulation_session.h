@@ -18,6 +18,7 @@
 #include <base/stdint.h>
 #include <session/session.h>
 #include <rm_session/rm_session.h>
+#include <dataspace/capability.h>
 
 namespace Emulation
 {
@@ -30,6 +31,11 @@ namespace Emulation
 	{
 		typedef Rm_session::Access_format Access;
 
+		/**
+		 * Modelling accuracy of an emulated device
+		 */
+		enum Fidelity { TRANSACTION_LEVEL, RTL };
+
 		/* exceptions */
 		class Invalid_mmio_address : public Exception { };
 
@@ -72,6 +78,30 @@ namespace Emulation
 		virtual bool irq_handler(unsigned const irq,
 		                         Signal_context_capability irq_edge) = 0;
 
+		/**
+		 * Select the model that emulates the device
+		 *
+		 * \param  f  targeted model fidelity
+		 * \return    wether the emulator provides a model of fidelity 'f'
+		 *
+		 * The register state and the IRQ listeners of the device get
+		 * carried over to the newly selected model.
+		 */
+		virtual bool fidelity(Fidelity const f) = 0;
+
+		/**
+		 * Back an emulated data window with a shared dataspace
+		 *
+		 * \param  off  MMIO offset of the window
+		 * \param  ds   dataspace that holds an 'Emulation::Data_window'
+		 * \return      wether the emulator streams through the window
+		 *
+		 * If the emulator declines, the window is emulated through
+		 * faults like any other MMIO.
+		 */
+		virtual bool data_window(addr_t const off, Dataspace_capability ds) {
+			return 0; }
+
 		/*********************
 		 ** RPC declaration **
 		 *********************/
@@ -80,8 +110,12 @@ namespace Emulation
 		GENODE_RPC(Rpc_read_mmio, umword_t, read_mmio, addr_t, Access);
 		GENODE_RPC(Rpc_irq_handler, bool, irq_handler,
 		           unsigned, Signal_context_capability);
+		GENODE_RPC(Rpc_fidelity, bool, fidelity, Fidelity);
+		GENODE_RPC(Rpc_data_window, bool, data_window,
+		           addr_t, Dataspace_capability);
 
-		GENODE_RPC_INTERFACE(Rpc_write_mmio, Rpc_read_mmio, Rpc_irq_handler);
+		GENODE_RPC_INTERFACE(Rpc_write_mmio, Rpc_read_mmio, Rpc_irq_handler,
+		                     Rpc_fidelity, Rpc_data_window);
 	};
 }
 
@@ -5,7 +5,7 @@
  */
 
 /*
- * Copyright (C) 2012 Genode Labs GmbH
+ * Copyright (C) 2012-2013 Genode Labs GmbH
  *
  * This file is part of the Genode OS framework, which is distributed
  * under the terms of the GNU General Public License version 2.
@@ -100,6 +100,17 @@ namespace File_system {
 				call<Rpc_move>(from_dir, from_name, to_dir, to_name);
 			}
 
+			Dataspace_capability dataspace(File_handle file, Mode mode,
+			                               seek_off_t offset, size_t size)
+			{
+				return call<Rpc_dataspace>(file, mode, offset, size);
+			}
+
+			void release(Dataspace_capability ds)
+			{
+				call<Rpc_release>(ds);
+			}
+
 	};
 }
 
@@ -5,7 +5,7 @@
  */
 
 /*
- * Copyright (C) 2012 Genode Labs GmbH
+ * Copyright (C) 2012-2013 Genode Labs GmbH
  *
  * This file is part of the Genode OS framework, which is distributed
  * under the terms of the GNU General Public License version 2.
@@ -15,6 +15,7 @@
 #define _INCLUDE__FILE_SYSTEM_SESSION__FILE_SYSTEM_SESSION_H_
 
 #include <base/exception.h>
+#include <dataspace/capability.h>
 #include <os/packet_stream.h>
 #include <packet_stream_tx/packet_stream_tx.h>
 #include <session/session.h>
@@ -273,6 +274,38 @@ namespace File_system {
 		virtual void move(Dir_handle, Name const &from,
 		                  Dir_handle, Name const &to) = 0;
 
+		/**
+		 * Request dataspace that refers to the content of a file range
+		 *
+		 * \param mode    'READ_ONLY' or 'READ_WRITE', changes of the
+		 *                dataspace content apply to the file in both cases
+		 *                but are permitted with 'READ_WRITE' only
+		 * \param offset  file offset, must be page-aligned
+		 * \param size    size of the range in bytes
+		 *
+		 * \throw Invalid_handle
+		 * \throw Permission_denied
+		 * \throw No_space
+		 *
+		 * \return dataspace, or an invalid capability if the file system
+		 *         cannot provide the range as dataspace
+		 *
+		 * The file content is shared between the dataspace and the file,
+		 * not copied. Only the pages within the file size at the time of
+		 * the request become part of the dataspace. The dataspace stays
+		 * valid until it gets passed to 'release' or the session is
+		 * closed. However, pages that drop out of the file because of
+		 * 'truncate' or 'unlink' become inaccessible.
+		 */
+		virtual Dataspace_capability dataspace(File_handle, Mode,
+		                                       seek_off_t offset,
+		                                       size_t size) = 0;
+
+		/**
+		 * Release dataspace obtained via 'dataspace'
+		 */
+		virtual void release(Dataspace_capability) = 0;
+
 
 		/*******************
 		 ** RPC interface **
@@ -307,6 +340,10 @@ namespace File_system {
 		GENODE_RPC_THROW(Rpc_move, void, move,
 		                 GENODE_TYPE_LIST(Permission_denied, Invalid_name, Lookup_failed),
 		                 Dir_handle, Name const &, Dir_handle, Name const &);
+		GENODE_RPC_THROW(Rpc_dataspace, Dataspace_capability, dataspace,
+		                 GENODE_TYPE_LIST(Invalid_handle, Permission_denied, No_space),
+		                 File_handle, Mode, seek_off_t, size_t);
+		GENODE_RPC(Rpc_release, void, release, Dataspace_capability);
 
 		/*
 		 * Manual type-list definition, needed because the RPC interface
@@ -324,8 +361,10 @@ namespace File_system {
 		        Meta::Type_tuple<Rpc_unlink,
 		        Meta::Type_tuple<Rpc_truncate,
 		        Meta::Type_tuple<Rpc_move,
+		        Meta::Type_tuple<Rpc_dataspace,
+		        Meta::Type_tuple<Rpc_release,
 		                         Meta::Empty>
-		        > > > > > > > > > > Rpc_functions;
+		        > > > > > > > > > > > > Rpc_functions;
 	};
 }
 
@@ -5,7 +5,7 @@
  */
 
 /*
- * Copyright (C) 2005-2012 Genode Labs GmbH
+ * Copyright (C) 2005-2013 Genode Labs GmbH
  *
  * This file is part of the Genode OS framework, which is distributed
  * under the terms of the GNU General Public License version 2.
@@ -34,14 +34,18 @@ namespace Genode {
 			Time             _deadline;       /* next deadline                */
 			Time             _period;         /* duration between alarms      */
 			int              _active;         /* set to one when active       */
-			Alarm           *_next;           /* next alarm in alarm list     */
+			Alarm           *_child;          /* leftmost child in heap       */
+			Alarm           *_next;           /* right sibling in heap        */
+			Alarm           *_prev;           /* left sibling or parent       */
 			Alarm_scheduler *_scheduler;      /* currently assigned scheduler */
 
 			void _assign(Time period, Time deadline, Alarm_scheduler *scheduler) {
 				_period = period, _deadline = deadline, _scheduler = scheduler; }
 
+			void _unlink() { _child = _next = _prev = 0; }
+
 			void _reset() {
-				_assign(0, 0, 0), _active = 0, _next = 0; }
+				_assign(0, 0, 0), _active = 0, _unlink(); }
 
 		protected:
 
@@ -62,28 +66,64 @@ namespace Genode {
 	};
 
 
+	/**
+	 * Scheduler of alarms
+	 *
+	 * The pending alarms form a pairing heap that is linked through the
+	 * alarms themselves. Scheduling an alarm takes constant time, firing
+	 * or discarding one takes amortized logarithmic time, and the next
+	 * deadline is always at the root.
+	 */
 	class Alarm_scheduler
 	{
 		private:
 
-			Lock         _lock;   /* protect alarm list                       */
-			Alarm       *_head;   /* head of alarm list                       */
+			Lock         _lock;   /* protect alarm heap                       */
+			Alarm       *_head;   /* root of alarm heap, earliest deadline    */
 			Alarm::Time  _now;    /* recent time (updated by handle function) */
 
 			/**
-			 * Enqueue alarm into alarm queue
+			 * Return wether alarm 'a' is due before alarm 'b'
+			 *
+			 * Deadlines are compared relative to the recent time, so the
+			 * comparison survives a wraparound of the time value.
+			 */
+			bool _earlier(Alarm *a, Alarm *b) const {
+				return (int)a->_deadline - (int)_now < (int)b->_deadline - (int)_now; }
+
+			/**
+			 * Meld two heaps, return the root of the result
+			 */
+			Alarm *_meld(Alarm *a, Alarm *b);
+
+			/**
+			 * Meld a list of sibling heaps pairwise, return the resulting root
+			 */
+			Alarm *_meld_siblings(Alarm *first);
+
+			/**
+			 * Enqueue alarm into alarm heap
 			 *
 			 * This is a helper function for 'schedule' and 'handle'.
 			 */
 			void _unsynchronized_enqueue(Alarm *alarm);
 
 			/**
-			 * Dequeue alarm from alarm queue
+			 * Dequeue alarm from alarm heap
+			 *
+			 * Alarms that are not pending at this scheduler are left alone.
 			 */
 			void _unsynchronized_dequeue(Alarm *alarm);
 
 			/**
-			 * Dequeue next pending alarm from alarm list
+			 * Remove alarm from alarm heap before it gets re-scheduled
+			 *
+			 * \return  false if the alarm is pending at another scheduler
+			 */
+			bool _unsynchronized_unschedule(Alarm *alarm);
+
+			/**
+			 * Dequeue next pending alarm from alarm heap
 			 *
 			 * \return  dequeued pending alarm
 			 * \retval  0  no alarm pending
@@ -61,12 +61,22 @@
  * acknowledge buffers using the functions 'packet_avail',
  * 'ready_to_submit', 'ready_to_ack', and 'ack_avail'.
  *
+ * To amortize the costs per packet, 'submit_packets', 'get_packets',
+ * 'acknowledge_packets', and 'get_acked_packets' move whole batches of
+ * packets at once. A party that actively polls one of the conditions
+ * above can announce this through the according 'poll_*' function. The
+ * other party then omits the signals for this condition.
+ *
+ * A sink that gets destroyed while the source may be unresponsive calls
+ * 'cancel' first. Afterwards, no local thread of the sink blocks for the
+ * source anymore.
+ *
  * If bidirectional data exchange between two processes is desired, two pairs
  * of 'Packet_stream_source' and 'Packet_stream_sink' should be instantiated.
  */
 
 /*
- * Copyright (C) 2009-2012 Genode Labs GmbH
+ * Copyright (C) 2009-2013 Genode Labs GmbH
  *
  * This file is part of the Genode OS framework, which is distributed
  * under the terms of the GNU General Public License version 2.
@@ -124,6 +134,16 @@ class Packet_descriptor
 /**
  * Ring buffer shared between source and sink, containing packet descriptors
  *
+ * The queue is a lock-free single-producer single-consumer ring. Head and
+ * tail count the packets endlessly and are masked when indexing the ring,
+ * hence 'QUEUE_SIZE' must be a power of two and all of the slots can be
+ * used. The producer publishes packets with a release store to '_head',
+ * the consumer frees slots with a release store to '_tail'.
+ *
+ * Each side can announce that it is actively polling the queue. As long
+ * as this is the case, the other side doesn't deliver the corresponding
+ * signal, similar to the notification suppression of virtio rings.
+ *
  * This class is private to the packet-stream interface.
  */
 template <typename PACKET_DESCRIPTOR, int QUEUE_SIZE>
@@ -131,10 +151,36 @@ class Packet_descriptor_queue
 {
 	private:
 
-		int               _head;
-		int               _tail;
+		/* reject queue sizes that can't be masked */
+		typedef char Queue_size_is_power_of_two
+			[(QUEUE_SIZE > 0 && !(QUEUE_SIZE & (QUEUE_SIZE - 1))) ? 1 : -1];
+
+		/* driven by the producer */
+		unsigned          _head;
+		unsigned          _producer_polls;
+
+		/* driven by the consumer */
+		unsigned          _tail;
+		unsigned          _consumer_polls;
+
 		PACKET_DESCRIPTOR _queue[QUEUE_SIZE];
 
+		static unsigned _acquire(unsigned const *v) {
+			return __atomic_load_n(v, __ATOMIC_ACQUIRE); }
+
+		static void _release(unsigned *v, unsigned const x) {
+			__atomic_store_n(v, x, __ATOMIC_RELEASE); }
+
+		/**
+		 * Order a preceding store before a subsequent load
+		 *
+		 * Needed when one side publishes something and then checks wether
+		 * the other side wants to be notified, or the other way around.
+		 */
+		static void _full_barrier() { __atomic_thread_fence(__ATOMIC_SEQ_CST); }
+
+		static unsigned _index(unsigned const i) { return i & (QUEUE_SIZE - 1); }
+
 	public:
 
 		typedef PACKET_DESCRIPTOR Packet_descriptor;
@@ -153,9 +199,30 @@ class Packet_descriptor_queue
 		{
 			if (role == PRODUCER) {
 				_head = 0;
+				_producer_polls = 0;
 				Genode::memset(_queue, 0, sizeof(_queue));
-			} else
+			} else {
 				_tail = 0;
+				_consumer_polls = 0;
+			}
+		}
+
+		/**
+		 * Place up to 'n' packet descriptors into the queue, producer only
+		 *
+		 * \return  number of packets that were added
+		 */
+		unsigned add(PACKET_DESCRIPTOR const *packets, unsigned n)
+		{
+			unsigned const head = _head;
+			unsigned const space = QUEUE_SIZE - (head - _acquire(&_tail));
+			if (n > space) n = space;
+
+			for (unsigned i = 0; i < n; i++)
+				_queue[_index(head + i)] = packets[i];
+
+			_release(&_head, head + n);
+			return n;
 		}
 
 		/**
@@ -164,13 +231,24 @@ class Packet_descriptor_queue
 		 * \return true on success, or
 		 *         false if queue is full
 		 */
-		bool add(PACKET_DESCRIPTOR packet)
+		bool add(PACKET_DESCRIPTOR packet) { return add(&packet, 1); }
+
+		/**
+		 * Take up to 'n' packet descriptors from the queue, consumer only
+		 *
+		 * \return  number of packets that were taken
+		 */
+		unsigned get(PACKET_DESCRIPTOR *packets, unsigned n)
 		{
-			if (full()) return false;
+			unsigned const tail = _tail;
+			unsigned const avail = _acquire(&_head) - tail;
+			if (n > avail) n = avail;
+
+			for (unsigned i = 0; i < n; i++)
+				packets[i] = _queue[_index(tail + i)];
 
-			_queue[_head%QUEUE_SIZE] = packet;
-			_head = (_head + 1)%QUEUE_SIZE;
-			return true;
+			_release(&_tail, tail + n);
+			return n;
 		}
 
 		/**
@@ -180,25 +258,72 @@ class Packet_descriptor_queue
 		 */
 		PACKET_DESCRIPTOR get()
 		{
-			PACKET_DESCRIPTOR packet = _queue[_tail%QUEUE_SIZE];
-			_tail = (_tail + 1)%QUEUE_SIZE;
+			PACKET_DESCRIPTOR packet;
+			get(&packet, 1);
 			return packet;
 		}
 
+		/**
+		 * Number of packets in the queue
+		 */
+		unsigned avail() { return _acquire(&_head) - _acquire(&_tail); }
+
 		/**
 		 * Return true if packet-descriptor queue is empty
 		 */
-		bool empty() { return _tail == _head; }
+		bool empty() { return !avail(); }
 
 		/**
 		 * Return true if packet-descriptor queue is full
 		 */
-		bool full() { return (_head + 1)%QUEUE_SIZE == _tail; }
+		bool full() { return avail() == QUEUE_SIZE; }
 
 		/**
-		 * Return true if a single element is stored in the queue
+		 * Announce wether the producer polls for free slots
 		 */
-		bool single_element() { return (_tail + 1)%QUEUE_SIZE == _head; }
+		void producer_polls(bool const polls)
+		{
+			_release(&_producer_polls, polls);
+			_full_barrier();
+		}
+
+		/**
+		 * Announce wether the consumer polls for packets
+		 */
+		void consumer_polls(bool const polls)
+		{
+			_release(&_consumer_polls, polls);
+			_full_barrier();
+		}
+
+		bool producer_polls() { return _acquire(&_producer_polls); }
+
+		bool consumer_polls() { return _acquire(&_consumer_polls); }
+
+		/**
+		 * Wether the producer must signal the addition of 'added' packets
+		 *
+		 * This is the case if the queue was empty before and the consumer
+		 * doesn't poll.
+		 */
+		bool notify_consumer(unsigned const added)
+		{
+			_full_barrier();
+			return added && !consumer_polls() && avail() <= added;
+		}
+
+		/**
+		 * Wether the consumer must signal the removal of 'taken' packets
+		 *
+		 * This is the case if the queue was full before and the producer
+		 * doesn't poll.
+		 */
+		bool notify_producer(unsigned const taken)
+		{
+			_full_barrier();
+			return taken && !producer_polls() &&
+			       QUEUE_SIZE - avail() <= taken;
+		}
 };
 
 
@@ -212,6 +337,8 @@ class Packet_descriptor_transmitter
 {
 	private:
 
+		typedef typename TX_QUEUE::Packet_descriptor Packet_descriptor;
+
 		/* facility to receive ready-to-transmit signals */
 		Genode::Signal_receiver           _tx_ready;
 		Genode::Signal_context            _tx_ready_context;
@@ -220,8 +347,32 @@ class Packet_descriptor_transmitter
 		/* facility to send ready-to-receive signals */
 		Genode::Signal_transmitter         _rx_ready;
 
+		/* serializes local threads that share the producer role */
 		Genode::Lock _tx_queue_lock;
 		TX_QUEUE    *_tx_queue;
+		bool         _polls;
+		bool volatile _canceled;
+
+		/**
+		 * Block until the queue has free slots
+		 *
+		 * While blocking, the consumer must signal new space regardless
+		 * of wether we poll otherwise.
+		 */
+		void _wait_for_space()
+		{
+			if (_polls) _tx_queue->producer_polls(false);
+
+			/*
+			 * It could happen that pending signals do not refer to the
+			 * current queue situation. Therefore, we need to double check
+			 * the queue after each signal.
+			 */
+			while (_tx_queue->full() && !_canceled)
+				_tx_ready.wait_for_signal();
+
+			if (_polls) _tx_queue->producer_polls(true);
+		}
 
 	public:
 
@@ -231,7 +382,7 @@ class Packet_descriptor_transmitter
 		Packet_descriptor_transmitter(TX_QUEUE *tx_queue)
 		:
 			_tx_ready_cap(_tx_ready.manage(&_tx_ready_context)),
-			_tx_queue(tx_queue)
+			_tx_queue(tx_queue), _polls(false), _canceled(false)
 		{ }
 
 		Genode::Signal_context_capability tx_ready_cap()
@@ -246,30 +397,54 @@ class Packet_descriptor_transmitter
 
 		bool ready_for_tx()
 		{
-			Genode::Lock::Guard lock_guard(_tx_queue_lock);
 			return !_tx_queue->full();
 		}
 
-		void tx(typename TX_QUEUE::Packet_descriptor packet)
+		/**
+		 * Suppress or re-enable ready-to-transmit signals
+		 */
+		void polls(bool const polls)
 		{
 			Genode::Lock::Guard lock_guard(_tx_queue_lock);
+			_polls = polls;
+			_tx_queue->producer_polls(polls);
+		}
 
-			do {
-				/* block for signal if tx queue is full */
-				if (_tx_queue->full())
-					_tx_ready.wait_for_signal();
+		/**
+		 * Stop blocking for the consumer for good
+		 *
+		 * This function may be called by any thread. Packets that do not
+		 * fit into the queue afterwards get dropped.
+		 */
+		void cancel()
+		{
+			_canceled = true;
+			Genode::Signal_transmitter(_tx_ready_cap).submit();
+		}
 
-				/*
-				 * It could happen that pending signals do not refer to the
-				 * current queue situation. Therefore, we need to double check
-				 * if the queue insertion succeeds and retry if needed.
-				 */
+		/**
+		 * Transmit 'n' packets, block while the queue is full
+		 */
+		void tx(Packet_descriptor const *packets, unsigned const n)
+		{
+			Genode::Lock::Guard lock_guard(_tx_queue_lock);
+
+			for (unsigned sent = 0; sent < n; ) {
 
-			} while (_tx_queue->add(packet) == false);
+				unsigned const added = _tx_queue->add(packets + sent, n - sent);
+				if (!added) {
+					if (_canceled) return;
+					_wait_for_space();
+					continue;
+				}
+				sent += added;
 
-			if (_tx_queue->single_element())
-				_rx_ready.submit();
+				if (_tx_queue->notify_consumer(added))
+					_rx_ready.submit();
+			}
 		}
+
+		void tx(Packet_descriptor packet) { tx(&packet, 1); }
 };
 
 
@@ -283,6 +458,8 @@ class Packet_descriptor_receiver
 {
 	private:
 
+		typedef typename RX_QUEUE::Packet_descriptor Packet_descriptor;
+
 		/* facility to receive ready-to-receive signals */
 		Genode::Signal_receiver           _rx_ready;
 		Genode::Signal_context            _rx_ready_context;
@@ -291,8 +468,27 @@ class Packet_descriptor_receiver
 		/* facility to send ready-to-transmit signals */
 		Genode::Signal_transmitter         _tx_ready;
 
+		/* serializes local threads that share the consumer role */
 		Genode::Lock _rx_queue_lock;
 		RX_QUEUE    *_rx_queue;
+		bool         _polls;
+		bool volatile _canceled;
+
+		/**
+		 * Block until the queue has packets
+		 *
+		 * While blocking, the producer must signal new packets regardless
+		 * of wether we poll otherwise.
+		 */
+		void _wait_for_packets()
+		{
+			if (_polls) _rx_queue->consumer_polls(false);
+
+			while (_rx_queue->empty() && !_canceled)
+				_rx_ready.wait_for_signal();
+
+			if (_polls) _rx_queue->consumer_polls(true);
+		}
 
 	public:
 
@@ -302,7 +498,7 @@ class Packet_descriptor_receiver
 		Packet_descriptor_receiver(RX_QUEUE *rx_queue)
 		:
 			_rx_ready_cap(_rx_ready.manage(&_rx_ready_context)),
-			_rx_queue(rx_queue)
+			_rx_queue(rx_queue), _polls(false), _canceled(false)
 		{ }
 
 		Genode::Signal_context_capability rx_ready_cap()
@@ -317,24 +513,55 @@ class Packet_descriptor_receiver
 
 		bool ready_for_rx()
 		{
-			Genode::Lock::Guard lock_guard(_rx_queue_lock);
 			return !_rx_queue->empty();
 		}
 
-		void rx(typename RX_QUEUE::Packet_descriptor *out_packet)
+		/**
+		 * Suppress or re-enable ready-to-receive signals
+		 */
+		void polls(bool const polls)
 		{
 			Genode::Lock::Guard lock_guard(_rx_queue_lock);
+			_polls = polls;
+			_rx_queue->consumer_polls(polls);
+		}
 
-			bool rx_queue_was_full = _rx_queue->full();
+		/**
+		 * Stop blocking for the producer for good
+		 *
+		 * This function may be called by any thread. Afterwards, 'rx'
+		 * returns zero instead of blocking.
+		 */
+		void cancel()
+		{
+			_canceled = true;
+			Genode::Signal_transmitter(_rx_ready_cap).submit();
+		}
 
-			while (_rx_queue->empty())
-				_rx_ready.wait_for_signal();
+		/**
+		 * Receive up to 'max' packets, block while the queue is empty
+		 *
+		 * \return  number of received packets, zero only if canceled
+		 */
+		unsigned rx(Packet_descriptor *packets, unsigned const max)
+		{
+			Genode::Lock::Guard lock_guard(_rx_queue_lock);
+
+			if (!max) return 0;
 
-			*out_packet = _rx_queue->get();
+			unsigned taken;
+			while (!(taken = _rx_queue->get(packets, max))) {
+				if (_canceled) return 0;
+				_wait_for_packets();
+			}
 
-			if (rx_queue_was_full)
+			if (_rx_queue->notify_producer(taken))
 				_tx_ready.submit();
+
+			return taken;
 		}
+
+		bool rx(Packet_descriptor *out_packet) { return rx(out_packet, 1); }
 };
 
 
@@ -612,6 +839,18 @@ class Packet_stream_source : private Packet_stream_base
 			_submit_transmitter.tx(packet);
 		}
 
+		/**
+		 * Tell sink about 'n' packets to process
+		 *
+		 * The packets get published in as few steps as the submit queue
+		 * allows, and the sink gets signalled at most once per step.
+		 * This function blocks if the submit queue is full.
+		 */
+		void submit_packets(Packet_descriptor const *packets, unsigned n)
+		{
+			_submit_transmitter.tx(packets, n);
+		}
+
 		/**
 		 * Returns true if one or more packet acknowledgements are available
 		 */
@@ -627,6 +866,35 @@ class Packet_stream_source : private Packet_stream_base
 			return packet;
 		}
 
+		/**
+		 * Get up to 'max' acknowledged packets
+		 *
+		 * This function blocks if no acknowledgements are available.
+		 *
+		 * \return  number of packets written to 'packets'
+		 */
+		unsigned get_acked_packets(Packet_descriptor *packets, unsigned max)
+		{
+			return _ack_receiver.rx(packets, max);
+		}
+
+		/**
+		 * Announce wether the source polls 'ready_to_submit'
+		 *
+		 * While polling, the sink omits 'ready_to_submit' signals.
+		 */
+		void poll_ready_to_submit(bool const poll) {
+			_submit_transmitter.polls(poll); }
+
+		/**
+		 * Announce wether the source polls 'ack_avail'
+		 *
+		 * While polling, the sink omits 'ack_avail' signals. When
+		 * stopping to poll, 'ack_avail' must be checked once more as
+		 * acknowledgements that came in meanwhile weren't signalled.
+		 */
+		void poll_ack_avail(bool const poll) { _ack_receiver.polls(poll); }
+
 		/**
 		 * Release bulk-buffer space consumed by the packet
 		 */
@@ -735,15 +1003,53 @@ class Packet_stream_sink : private Packet_stream_base
 		 * Get next packet from source
 		 *
 		 * This function blocks if no packets are available.
+		 *
+		 * \return  packet, or an invalid packet if the sink got canceled
 		 */
 		Packet_descriptor get_packet()
 		{
 			Packet_descriptor packet;
-			do { _submit_receiver.rx(&packet); }
-			while (!packet_valid(packet));
+			do {
+				if (!_submit_receiver.rx(&packet))
+					return Packet_descriptor();
+			} while (!packet_valid(packet));
 			return packet;
 		}
 
+		/**
+		 * Get up to 'max' packets from source
+		 *
+		 * Packets that don't refer to the bulk buffer are dropped. This
+		 * function blocks if no packets are available.
+		 *
+		 * \return  number of packets written to 'packets', zero only if
+		 *          the sink got canceled
+		 */
+		unsigned get_packets(Packet_descriptor *packets, unsigned max)
+		{
+			unsigned n = 0;
+			while (max && !n) {
+				unsigned const taken = _submit_receiver.rx(packets, max);
+				if (!taken) return 0;
+				for (unsigned i = 0; i < taken; i++)
+					if (packet_valid(packets[i])) packets[n++] = packets[i];
+			}
+			return n;
+		}
+
+		/**
+		 * Unblock all local threads that wait for the source for good
+		 *
+		 * Afterwards, 'get_packet' and 'get_packets' return no packets
+		 * once the submit queue is empty, and acknowledgements that do
+		 * not fit into the acknowledgement queue get dropped.
+		 */
+		void cancel()
+		{
+			_submit_receiver.cancel();
+			_ack_transmitter.cancel();
+		}
+
 		/**
 		 * Get pointer to the content of the specified packet
 		 *
@@ -772,6 +1078,32 @@ class Packet_stream_sink : private Packet_stream_base
 			_ack_transmitter.tx(packet);
 		}
 
+		/**
+		 * Tell the source that the processing of 'n' packets is completed
+		 *
+		 * This function blocks if the acknowledgement queue is full.
+		 */
+		void acknowledge_packets(Packet_descriptor const *packets, unsigned n)
+		{
+			_ack_transmitter.tx(packets, n);
+		}
+
+		/**
+		 * Announce wether the sink polls 'packet_avail'
+		 *
+		 * While polling, the source omits 'packet_avail' signals. When
+		 * stopping to poll, 'packet_avail' must be checked once more as
+		 * packets that came in meanwhile weren't signalled.
+		 */
+		void poll_packet_avail(bool const poll) { _submit_receiver.polls(poll); }
+
+		/**
+		 * Announce wether the sink polls 'ready_to_ack'
+		 *
+		 * While polling, the source omits 'ready_to_ack' signals.
+		 */
+		void poll_ready_to_ack(bool const poll) { _ack_transmitter.polls(poll); }
+
 		void debug_print_buffers() {
 			Packet_stream_base::_debug_print_buffers(); }
 
@@ -6,11 +6,12 @@
  * This semaphore implementation allows to block on a semaphore for a
  * given time instead of blocking indefinetely.
  *
- * For the timeout functionality the alarm framework is used.
+ * For the timeout functionality the alarm framework is used, driven by
+ * signal-based timeouts of the timer service.
  */
 
 /*
- * Copyright (C) 2010-2012 Genode Labs GmbH
+ * Copyright (C) 2010-2013 Genode Labs GmbH
  *
  * This file is part of the Genode OS framework, which is distributed
  * under the terms of the GNU General Public License version 2.
@@ -21,35 +22,150 @@
 
 #include <base/thread.h>
 #include <base/semaphore.h>
+#include <base/signal.h>
 #include <timer_session/connection.h>
+#include <timer_session/timeout_multiplexer.h>
 #include <os/alarm.h>
 
 namespace Genode {
 
 	/**
-	 * Alarm thread, which counts jiffies and triggers timeout events.
+	 * Alarm thread, which triggers timeout events
+	 *
+	 * The thread is tickless. The timeout of its timer session always gets
+	 * programmed to the earliest pending deadline, also when an earlier
+	 * alarm gets scheduled while the thread is blocking. Without pending
+	 * alarms, the thread does not wake up at all.
+	 *
+	 * The millisecond clock returned by 'time' is maintained locally, so
+	 * frequent callers like 'gettimeofday' do not issue an RPC to the timer
+	 * each time. While the clock is in use, the thread advances it every
+	 * 'CLOCK_PERIOD_US'. After 'CLOCK_IDLE_TICKS' ticks without a call of
+	 * 'time', it stops ticking and the next call resynchronizes the clock
+	 * with the timer session.
 	 */
-	class Timeout_thread : public Thread<4096>,
-	                       public Alarm_scheduler
+	class Timeout_thread : public Thread<4096>
 	{
+		public:
+
+			enum {
+				CLOCK_PERIOD_US  = 10*1000,
+
+				CLOCK_IDLE_TICKS = 10,
+
+				/*
+				 * The alarm framework compares deadlines relative to each
+				 * other as signed 32-bit values, so longer timeouts must be
+				 * split into steps of at most this size
+				 */
+				MAX_STEP_US      = 30*60*1000*1000UL,
+			};
+
 		private:
 
-			Timer::Connection   _timer;   /* timer session */
-			Genode::Alarm::Time _jiffies; /* jiffies counter */
+			/**
+			 * Periodic alarm that advances the clock while it is in use
+			 */
+			class Clock_tick : public Alarm
+			{
+				private:
+
+					Timeout_thread &_thread;
+
+				public:
+
+					Clock_tick(Timeout_thread &thread) : _thread(thread) { }
+
+				protected:
+
+					bool on_alarm()
+					{
+						_thread._tick();
+						return false;
+					}
+			};
+
+			Timer::Connection          _timer;       /* timer session */
+			Signal_receiver            _receiver;
+			Signal_context             _context;
+			Timer::Timeout_multiplexer _multiplexer;
+			unsigned long              _wakeups;
+
+			Lock                       _clock_lock;
+			Genode::uint64_t           _clock_us;    /* time of the last tick */
+			bool                       _ticking;
+			unsigned                   _idle_ticks;  /* ticks without 'time' call */
+			Clock_tick                 _clock_tick;
 
 			void entry(void);
 
-		public:
+			/**
+			 * Advance the clock, called by the clock-tick alarm
+			 */
+			void _tick()
+			{
+				Lock::Guard lock_guard(_clock_lock);
+
+				_clock_us = _timer.elapsed_us();
+				if (++_idle_ticks > CLOCK_IDLE_TICKS) {
+					_ticking = false;
+					return;
+				}
+				_multiplexer.schedule_us(&_clock_tick, CLOCK_PERIOD_US);
+			}
 
-			enum { GRANULARITY_MSECS = 10 };
+		public:
 
 			Timeout_thread()
-			: Thread<4096>("alarm-timer"), _jiffies(0)
+			:
+				Thread<4096>("alarm-timer"),
+				_multiplexer(_timer, _receiver.manage(&_context)),
+				_wakeups(0), _clock_us(0), _ticking(false), _idle_ticks(0),
+				_clock_tick(*this)
 			{
 				start();
 			}
 
-			Genode::Alarm::Time time(void) { return _jiffies; }
+			/**
+			 * Return current time in milliseconds
+			 *
+			 * The returned time has a granularity of 'CLOCK_PERIOD_US'.
+			 */
+			Genode::Alarm::Time time(void)
+			{
+				Lock::Guard lock_guard(_clock_lock);
+
+				_idle_ticks = 0;
+				if (!_ticking) {
+					_clock_us = _timer.elapsed_us();
+					_ticking  = true;
+					_multiplexer.schedule_us(&_clock_tick, CLOCK_PERIOD_US);
+				}
+				return _clock_us / 1000;
+			}
+
+			/**
+			 * Return current time in microseconds
+			 *
+			 * In contrast to 'time', this function requests the time from
+			 * the timer session.
+			 */
+			Genode::uint64_t time_us(void) { return _timer.elapsed_us(); }
+
+			/**
+			 * Schedule 'alarm' to trigger in 'us' microseconds
+			 *
+			 * \param us  timeout of at most 'MAX_STEP_US'
+			 */
+			void schedule_us(Alarm *alarm, Alarm::Time us) {
+				_multiplexer.schedule_us(alarm, us); }
+
+			void discard(Alarm *alarm) { _multiplexer.discard(alarm); }
+
+			/**
+			 * Return number of times the thread woke up
+			 */
+			unsigned long wakeups() const { return _wakeups; }
 
 			/*
 			 * Returns the singleton timeout-thread used for all timeouts.
@@ -126,31 +242,79 @@ namespace Genode {
 			/**
 			 * Represents a timeout associated with the blocking-
 			 * operation on a semaphore.
+			 *
+			 * Timeouts longer than 'Timeout_thread::MAX_STEP_US' expire in
+			 * several steps. The alarm re-schedules itself for the next step
+			 * from 'on_alarm'. The '_lock' makes 'discard' and re-scheduling
+			 * mutually exclusive, so 'discard' never holds the scheduler lock
+			 * while 'on_alarm' waits for it.
 			 */
 			class Timeout : public Alarm
 			{
 				private:
 
-					Timed_semaphore *_sem;       /* Semaphore we block on */
-					Element         *_element;   /* Queue element timeout belongs to */
-					bool             _triggered; /* Timeout expired */
+					Timed_semaphore  *_sem;       /* Semaphore we block on */
+					Element          *_element;   /* Queue element timeout belongs to */
+					bool              _triggered; /* Timeout expired */
+					Lock              _lock;
+					bool              _discarded;
+					Genode::uint64_t  _remaining_us;
+
+					/**
+					 * Schedule the next step of the timeout
+					 */
+					void _schedule_step()
+					{
+						Alarm::Time const step_us =
+							_remaining_us > Timeout_thread::MAX_STEP_US
+							? (Alarm::Time)Timeout_thread::MAX_STEP_US
+							: (Alarm::Time)_remaining_us;
+
+						_remaining_us -= step_us;
+						Timeout_thread::alarm_timer()->schedule_us(this, step_us);
+					}
 
 				public:
 
+					/**
+					 * Constructor
+					 *
+					 * \param duration  timeout in milliseconds
+					 */
 					Timeout(Time duration, Timed_semaphore *s, Element *e)
-					: _sem(s), _element(e), _triggered(false)
+					:
+						_sem(s), _element(e), _triggered(false), _discarded(false),
+						_remaining_us((Genode::uint64_t)duration * 1000)
 					{
-						Time t = duration + Timeout_thread::alarm_timer()->time();
-						Timeout_thread::alarm_timer()->schedule_absolute(this, t);
+						Lock::Guard lock_guard(_lock);
+						_schedule_step();
+					}
+
+					void discard(void)
+					{
+						{
+							Lock::Guard lock_guard(_lock);
+							_discarded = true;
+						}
+						Timeout_thread::alarm_timer()->discard(this);
 					}
 
-					void discard(void) { Timeout_thread::alarm_timer()->discard(this); }
 					bool triggered(void) { return _triggered; }
 
 				protected:
 
 					bool on_alarm()
 					{
+						Lock::Guard lock_guard(_lock);
+
+						if (_discarded)
+							return false;
+
+						if (_remaining_us) {
+							_schedule_step();
+							return false;
+						}
+
 						/* Abort blocking operation */
 						_triggered = _sem->_abort(_element);
 						return false;
@@ -177,8 +341,6 @@ namespace Genode {
 			 */
 			Alarm::Time down(Alarm::Time t)
 			{
-				/* Track start time */
-				Alarm::Time starttime = Timeout_thread::alarm_timer()->time();
 				Semaphore::_meta_lock.lock();
 
 				if (--Semaphore::_cnt < 0) {
@@ -190,11 +352,6 @@ namespace Genode {
 						throw Genode::Nonblocking_exception();
 					}
 
-					/* Warn if someone choose a undersized timeout */
-					if (t < Timeout_thread::GRANULARITY_MSECS && t > 0)
-						PWRN("We only support granularity of %d msecs, you choose %ld",
-						     Timeout_thread::GRANULARITY_MSECS, t);
-
 					/*
 					 * Create semaphore queue element representing the thread
 					 * in the wait queue.
@@ -203,6 +360,10 @@ namespace Genode {
 					Semaphore::_queue.enqueue(&queue_element);
 					Semaphore::_meta_lock.unlock();
 
+					/* Track start time */
+					Genode::uint64_t const start_us =
+						Timeout_thread::alarm_timer()->time_us();
+
 					/* Create the timeout */
 					Timeout to(t, this, &queue_element);
 
@@ -222,12 +383,14 @@ namespace Genode {
 					 */
 					if (to.triggered())
 						throw Genode::Timeout_exception();
-				} else {
-					Semaphore::_meta_lock.unlock();
+
+					/* return blocking time */
+					return (Timeout_thread::alarm_timer()->time_us() - start_us) / 1000;
 				}
 
-				/* return blocking time */
-				return Timeout_thread::alarm_timer()->time() - starttime;
+				/* not blocked at all */
+				Semaphore::_meta_lock.unlock();
+				return 0;
 			}
 
 
@@ -5,7 +5,7 @@
  */
 
 /*
- * Copyright (C) 2006-2012 Genode Labs GmbH
+ * Copyright (C) 2006-2013 Genode Labs GmbH
  *
  * This file is part of the Genode OS framework, which is distributed
  * under the terms of the GNU General Public License version 2.
@@ -27,6 +27,14 @@ namespace Timer {
 		void msleep(unsigned ms) { call<Rpc_msleep>(ms); }
 
 		unsigned long elapsed_ms() const { return call<Rpc_elapsed_ms>(); }
+
+		void trigger_once(unsigned us) { call<Rpc_trigger_once>(us); }
+
+		void trigger_periodic(unsigned us) { call<Rpc_trigger_periodic>(us); }
+
+		void sigh(Genode::Signal_context_capability sigh) { call<Rpc_sigh>(sigh); }
+
+		Genode::uint64_t elapsed_us() const { return call<Rpc_elapsed_us>(); }
 	};
 }
 
@@ -0,0 +1,98 @@
+/*
+ * \brief  Multiplexer of local alarms on the timeout of one timer session
+ * \author Martin Stein
+ * \date   2013-02-11
+ */
+
+/*
+ * Copyright (C) 2013 Genode Labs GmbH
+ *
+ * This file is part of the Genode OS framework, which is distributed
+ * under the terms of the GNU General Public License version 2.
+ */
+
+#ifndef _INCLUDE__TIMER_SESSION__TIMEOUT_MULTIPLEXER_H_
+#define _INCLUDE__TIMER_SESSION__TIMEOUT_MULTIPLEXER_H_
+
+#include <base/lock.h>
+#include <os/alarm.h>
+#include <timer_session/timer_session.h>
+
+namespace Timer {
+
+	/**
+	 * Scheduler of any number of local alarms driven by one timer session
+	 *
+	 * The multiplexer programs the one-shot timeout of the session for the
+	 * earliest deadline of its alarms. The component must call 'handle'
+	 * whenever it receives a signal for the context that was passed to the
+	 * constructor. Alarm times are microseconds since session creation.
+	 */
+	class Timeout_multiplexer : public Genode::Alarm_scheduler
+	{
+		private:
+
+			Session            &_timer;
+			Genode::Lock        _lock;       /* serializes '_program' */
+			Genode::Alarm::Time _programmed; /* deadline of the session */
+			bool                _armed;
+
+			/**
+			 * Program the session for the earliest deadline
+			 */
+			void _program()
+			{
+				Genode::Lock::Guard lock_guard(_lock);
+
+				Genode::Alarm::Time deadline;
+				if (!next_deadline(&deadline)) return;
+				if (_armed && deadline == _programmed) return;
+
+				Genode::Alarm::Time const now = _timer.elapsed_us();
+				long const timeout = (long)(deadline - now);
+				_timer.trigger_once(timeout > 0 ? timeout : 0);
+				_programmed = deadline;
+				_armed      = true;
+			}
+
+		public:
+
+			/**
+			 * Constructor
+			 *
+			 * \param sigh  context that receives the timeout signals
+			 */
+			Timeout_multiplexer(Session &timer,
+			                    Genode::Signal_context_capability sigh)
+			: _timer(timer), _programmed(0), _armed(false) { _timer.sigh(sigh); }
+
+			/**
+			 * Return current time in microseconds
+			 */
+			Genode::Alarm::Time now() { return _timer.elapsed_us(); }
+
+			/**
+			 * Schedule 'alarm' to trigger in 'us' microseconds
+			 */
+			void schedule_us(Genode::Alarm *alarm, Genode::Alarm::Time us)
+			{
+				schedule_absolute(alarm, now() + us);
+				_program();
+			}
+
+			/**
+			 * Trigger all due alarms, to be called on each timeout signal
+			 */
+			void handle()
+			{
+				{
+					Genode::Lock::Guard lock_guard(_lock);
+					_armed = false;
+				}
+				Genode::Alarm_scheduler::handle(now());
+				_program();
+			}
+	};
+}
+
+#endif /* _INCLUDE__TIMER_SESSION__TIMEOUT_MULTIPLEXER_H_ */
@@ -5,7 +5,7 @@
  */
 
 /*
- * Copyright (C) 2006-2012 Genode Labs GmbH
+ * Copyright (C) 2006-2013 Genode Labs GmbH
  *
  * This file is part of the Genode OS framework, which is distributed
  * under the terms of the GNU General Public License version 2.
@@ -14,6 +14,7 @@
 #ifndef _INCLUDE__TIMER_SESSION__TIMER_SESSION_H_
 #define _INCLUDE__TIMER_SESSION__TIMER_SESSION_H_
 
+#include <base/signal.h>
 #include <session/session.h>
 
 namespace Timer {
@@ -29,6 +30,40 @@ namespace Timer {
 		 */
 		virtual void msleep(unsigned ms) = 0;
 
+		/**
+		 * Program one-shot timeout
+		 *
+		 * \param us  timeout in microseconds
+		 *
+		 * When the timeout expires, the session submits a signal to the
+		 * context registered via 'sigh'. A new call of 'trigger_once' or
+		 * 'trigger_periodic' replaces the pending timeout.
+		 */
+		virtual void trigger_once(unsigned us) = 0;
+
+		/**
+		 * Program periodic timeout
+		 *
+		 * \param us  period in microseconds, 0 cancels the timeout
+		 *
+		 * A signal gets submitted each period. Periods that are missed
+		 * as a whole get skipped.
+		 */
+		virtual void trigger_periodic(unsigned us) = 0;
+
+		/**
+		 * Register signal handler for timeouts
+		 */
+		virtual void sigh(Genode::Signal_context_capability sigh) = 0;
+
+		/**
+		 * Return number of elapsed microseconds since session creation
+		 *
+		 * The value is 64 bit wide, so it does not wrap on 32-bit machines
+		 * after about 71 minutes.
+		 */
+		virtual Genode::uint64_t elapsed_us() const = 0;
+
 		/**
 		 * Return number of elapsed milliseconds since session creation
 		 */
@@ -47,8 +82,13 @@ namespace Timer {
 
 		GENODE_RPC(Rpc_msleep, void, msleep, unsigned);
 		GENODE_RPC(Rpc_elapsed_ms, unsigned long, elapsed_ms);
+		GENODE_RPC(Rpc_trigger_once, void, trigger_once, unsigned);
+		GENODE_RPC(Rpc_trigger_periodic, void, trigger_periodic, unsigned);
+		GENODE_RPC(Rpc_sigh, void, sigh, Genode::Signal_context_capability);
+		GENODE_RPC(Rpc_elapsed_us, Genode::uint64_t, elapsed_us);
 
-		GENODE_RPC_INTERFACE(Rpc_msleep, Rpc_elapsed_ms);
+		GENODE_RPC_INTERFACE(Rpc_msleep, Rpc_elapsed_ms, Rpc_trigger_once,
+		                     Rpc_trigger_periodic, Rpc_sigh, Rpc_elapsed_us);
 	};
 }
 
@@ -0,0 +1,161 @@
+/*
+ * \brief   Connect HDL FIFO ports to an emulated data window
+ * \author  Martin Stein
+ * \date    2013-01-30
+ */
+
+/*
+ * Copyright (C) 2013 Genode Labs GmbH
+ *
+ * This file is part of the Genode OS framework, which is distributed
+ * under the terms of the GNU General Public License version 2.
+ */
+
+#ifndef _INCLUDE__VERILATOR_ENV__DATA_WINDOW_H_
+#define _INCLUDE__VERILATOR_ENV__DATA_WINDOW_H_
+
+/* Genode includes */
+#include <base/env.h>
+#include <base/lock.h>
+#include <base/printf.h>
+#include <emulation_session/data_window.h>
+
+namespace Genode
+{
+	/**
+	 * HDL FIFO ports that stream through an emulated data window
+	 *
+	 * The sink port takes words from the driver, the source port hands
+	 * words to the driver, both with a ready/valid handshake. A word is
+	 * transfered at a clock edge where valid and ready are set. The
+	 * ports of one direction may be omitted by passing null pointers.
+	 *
+	 * \param DATA  type of the raw HDL data signals
+	 */
+	template <typename DATA>
+	class Data_window_port
+	{
+		addr_t    const _offset;       /* MMIO offset of the window */
+		uint8_t * const _sink_valid;   /* HDL input */
+		uint8_t * const _sink_ready;   /* HDL output */
+		DATA *    const _sink_data;    /* HDL input */
+		uint8_t * const _source_valid; /* HDL output */
+		uint8_t * const _source_ready; /* HDL input */
+		DATA *    const _source_data;  /* HDL output */
+
+		Emulation::Data_window * _window; /* local mapping of the window */
+		Lock                     _lock;
+
+		/* handshakes sampled before the current clock edge */
+		bool     _sink_fire;
+		bool     _source_fire;
+		umword_t _source_word;
+
+		public:
+
+			/**
+			 * Constructor
+			 *
+			 * \param offset  MMIO offset of the window the port serves
+			 */
+			Data_window_port(addr_t    const offset,
+			                 uint8_t * const sink_valid,
+			                 uint8_t * const sink_ready,
+			                 DATA *    const sink_data,
+			                 uint8_t * const source_valid,
+			                 uint8_t * const source_ready,
+			                 DATA *    const source_data)
+			:
+				_offset(offset), _sink_valid(sink_valid),
+				_sink_ready(sink_ready), _sink_data(sink_data),
+				_source_valid(source_valid), _source_ready(source_ready),
+				_source_data(source_data), _window(0),
+				_sink_fire(0), _source_fire(0), _source_word(0)
+			{ }
+
+			/**
+			 * Destructor
+			 */
+			~Data_window_port()
+			{
+				if (_window) env()->rm_session()->detach(_window);
+			}
+
+			/**
+			 * Start streaming through a data window
+			 *
+			 * \param off  MMIO offset of the window
+			 * \param ds   dataspace that holds the window
+			 * \return     wether the port took the window
+			 *
+			 * Windows at other offsets are declined, so an emulator with
+			 * several ports may offer the window to each of them.
+			 */
+			bool window(addr_t const off, Dataspace_capability ds)
+			{
+				if (off != _offset) return 0;
+
+				Lock::Guard guard(_lock);
+				if (_window) {
+					PERR("Port already streams through a data window");
+					return 0;
+				}
+				_window = env()->rm_session()->attach(ds);
+				return 1;
+			}
+
+			/**
+			 * Offer words to the HDL, to be called before a clock edge
+			 *
+			 * The handshakes get sampled here, so the ready and valid
+			 * outputs of the HDL must be up to date.
+			 */
+			void before_edge()
+			{
+				Lock::Guard guard(_lock);
+				_sink_fire   = 0;
+				_source_fire = 0;
+				if (!_window) return;
+				if (_sink_valid) {
+					umword_t word = 0;
+					*_sink_valid = _window->to_device.peek(word);
+					*_sink_data  = word;
+					_sink_fire   = *_sink_valid && *_sink_ready;
+				}
+				if (_source_ready) {
+					*_source_ready = _window->from_device.space() > 0;
+					_source_fire   = *_source_ready && *_source_valid;
+					_source_word   = *_source_data;
+				}
+			}
+
+			/**
+			 * Complete handshakes, to be called after a clock edge
+			 */
+			void after_edge()
+			{
+				Lock::Guard guard(_lock);
+				if (!_window) return;
+				if (_sink_fire) {
+					_window->to_device.drop();
+					*_sink_valid = 0;
+				}
+				if (_source_fire)
+					_window->from_device.write(&_source_word, 1);
+			}
+
+			/**
+			 * Number of words that await the HDL
+			 */
+			unsigned to_device() const {
+				return _window ? _window->to_device.avail() : 0; }
+
+			/**
+			 * Number of words that await the driver
+			 */
+			unsigned from_device() const {
+				return _window ? _window->from_device.avail() : 0; }
+	};
+}
+
+#endif /* _INCLUDE__VERILATOR_ENV__DATA_WINDOW_H_ */
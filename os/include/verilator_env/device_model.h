@@ -0,0 +1,189 @@
+/*
+ * \brief  Generic interface of a model that emulates a device
+ * \author Martin Stein
+ * \date   2013-01-14
+ */
+
+/*
+ * Copyright (C) 2013 Genode Labs GmbH
+ *
+ * This file is part of the Genode OS framework, which is distributed
+ * under the terms of the GNU General Public License version 2.
+ */
+
+#ifndef _INCLUDE__VERILATOR_ENV__DEVICE_MODEL_H_
+#define _INCLUDE__VERILATOR_ENV__DEVICE_MODEL_H_
+
+/* Genode includes */
+#include <base/signal.h>
+#include <base/printf.h>
+#include <rm_session/rm_session.h>
+
+namespace Genode
+{
+	/**
+	 * Snapshot of the architectural register state of a device
+	 */
+	class Register_state
+	{
+		public:
+
+			enum { MAX_REGS = 64 };
+
+			/**
+			 * Content of one register
+			 */
+			struct Reg
+			{
+				addr_t   off;   /* MMIO offset of the register */
+				umword_t value; /* register content */
+			};
+
+		private:
+
+			Reg      _regs[MAX_REGS];
+			unsigned _size;
+
+		public:
+
+			/**
+			 * Constructor
+			 */
+			Register_state() : _size(0) { }
+
+			/**
+			 * Append the content of a register
+			 *
+			 * \param off    MMIO offset of the register
+			 * \param value  register content
+			 */
+			void add(addr_t const off, umword_t const value)
+			{
+				if (_size >= MAX_REGS) {
+					PERR("%s:%d: Register state exhausted", __FILE__, __LINE__);
+					return;
+				}
+				_regs[_size].off   = off;
+				_regs[_size].value = value;
+				_size++;
+			}
+
+			/**
+			 * Look up the content of a register
+			 *
+			 * \param off    MMIO offset of the register
+			 * \param value  holds the register content if this returns 1
+			 * \return       wether the register is contained
+			 */
+			bool get(addr_t const off, umword_t & value) const
+			{
+				for (unsigned i = 0; i < _size; i++) {
+					if (_regs[i].off != off) continue;
+					value = _regs[i].value;
+					return 1;
+				}
+				return 0;
+			}
+
+			/***************
+			 ** Accessors **
+			 ***************/
+
+			unsigned size() const { return _size; }
+			Reg const & reg(unsigned const i) const { return _regs[i]; }
+	};
+
+	/**
+	 * Generic interface of a model that emulates a device
+	 *
+	 * A device may be emulated by models of different fidelity, e.g. a
+	 * verilated RTL design and a C++ transaction-level model. As long as
+	 * they agree on the architectural register state, they can replace
+	 * each other at runtime.
+	 */
+	class Device_model
+	{
+		public:
+
+			typedef Rm_session::Access_format Access;
+
+		private:
+
+			addr_t const * const _regs;      /* offsets of all registers
+			                                  * that form the device state */
+			unsigned const       _regs_size; /* number of registers */
+
+		public:
+
+			/**
+			 * Constructor
+			 *
+			 * \param regs       offsets of all registers that form the
+			 *                   architectural state in the order they
+			 *                   shall be restored
+			 * \param regs_size  number of registers
+			 */
+			Device_model(addr_t const * const regs, unsigned const regs_size)
+			: _regs(regs), _regs_size(regs_size) { }
+
+			/**
+			 * Destructor
+			 */
+			virtual ~Device_model() { }
+
+			/**
+			 * Stop advancing the model state autonomously
+			 */
+			virtual void pause() { }
+
+			/**
+			 * Continue advancing the model state autonomously
+			 */
+			virtual void resume() { }
+
+			/**
+			 * Fetch the architectural register state of the device
+			 *
+			 * By default, all registers are read through the MMIO
+			 * interface. Models that have side effects on register
+			 * reads should override this.
+			 */
+			virtual void save_state(Register_state & s)
+			{
+				for (unsigned i = 0; i < _regs_size; i++)
+					s.add(_regs[i], read_mmio(_regs[i], Rm_session::LSB32));
+			}
+
+			/**
+			 * Apply an architectural register state to the device
+			 *
+			 * By default, all registers are written through the MMIO
+			 * interface in the order they were declared.
+			 */
+			virtual void load_state(Register_state const & s)
+			{
+				for (unsigned i = 0; i < _regs_size; i++) {
+					umword_t value;
+					if (!s.get(_regs[i], value)) continue;
+					write_mmio(_regs[i], Rm_session::LSB32, value);
+				}
+			}
+
+
+			/**********************************
+			 ** Emulation::Session_component **
+			 **********************************/
+
+			virtual void initialize() { }
+
+			virtual umword_t read_mmio(addr_t const off, Access const a) = 0;
+
+			virtual void write_mmio(addr_t const off, Access const a,
+			                        umword_t const value) = 0;
+
+			virtual bool irq_handler(unsigned const irq,
+			                         Signal_context_capability irq_edge) = 0;
+	};
+}
+
+#endif /* _INCLUDE__VERILATOR_ENV__DEVICE_MODEL_H_ */
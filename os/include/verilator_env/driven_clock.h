@@ -33,6 +33,7 @@ namespace Genode
 		unsigned const _interval_ms;
 		unsigned const _interval_cnt;
 		Timer::Connection _timer;
+		bool _enabled;
 
 		protected:
 
@@ -54,7 +55,8 @@ namespace Genode
 			                  unsigned const freq_ms,
 			                  unsigned const interval_ms, Lock * const lock) :
 				_lock(lock), _interval_ms(interval_ms),
-				_interval_cnt(_interval_ms * freq_ms), _clk(raw, up), _cnt(0)
+				_interval_cnt(_interval_ms * freq_ms), _enabled(1),
+				_clk(raw, up), _cnt(0)
 			{
 				Thread::start();
 			}
@@ -64,6 +66,18 @@ namespace Genode
 			 */
 			virtual ~Driven_clock_base() { }
 
+			/**
+			 * Enable or disable the periodic clock updates
+			 *
+			 * While disabled, the clock advances only through explicit
+			 * calls of 'cycle', e.g. from a bus protocol.
+			 */
+			void enable(bool const e)
+			{
+				Lock::Guard guard(*_lock);
+				_enabled = e;
+			}
+
 
 			/***********
 			 ** Clock **
@@ -82,6 +96,7 @@ namespace Genode
 				{
 					_timer.msleep(_interval_ms);
 					Lock::Guard guard(*_lock);
+					if (!_enabled) { _cnt = 0; continue; }
 					while (_cnt < _interval_cnt) cycle();
 					_cnt = 0;
 				}
@@ -108,6 +123,8 @@ namespace Genode
 			             unsigned const interval_ms, Lock * const lock) :
 				Driven_clock_base(raw, up, freq_ms, interval_ms, lock) { }
 
+			using Driven_clock_base::enable;
+
 
 			/***********************
 			 ** Driven_clock_base **
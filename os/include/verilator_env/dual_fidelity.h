@@ -0,0 +1,167 @@
+/*
+ * \brief  Device that is emulated by models of different fidelity
+ * \author Martin Stein
+ * \date   2013-01-14
+ */
+
+/*
+ * Copyright (C) 2013 Genode Labs GmbH
+ *
+ * This file is part of the Genode OS framework, which is distributed
+ * under the terms of the GNU General Public License version 2.
+ */
+
+#ifndef _INCLUDE__VERILATOR_ENV__DUAL_FIDELITY_H_
+#define _INCLUDE__VERILATOR_ENV__DUAL_FIDELITY_H_
+
+/* Genode includes */
+#include <base/lock.h>
+#include <emulation_session/emulation_session.h>
+
+/* verilator_env includes */
+#include <verilator_env/device_model.h>
+
+namespace Genode
+{
+	/**
+	 * Device that is emulated by models of different fidelity
+	 *
+	 * Only one of both models is active at a time. The other one is
+	 * paused and doesn't cost any CPU time. On a switch, the register
+	 * state and the IRQ listeners are carried over to the newly active
+	 * model. Besides the 'fidelity' call of the emulation session, the
+	 * switch can be triggered in-band by the driver through an
+	 * emulator-local control register outside the device registers.
+	 */
+	class Dual_fidelity_device
+	{
+		public:
+
+			typedef Emulation::Session::Fidelity Fidelity;
+			typedef Rm_session::Access_format Access;
+
+			enum { MAX_IRQS = 32, NO_CONTROL_REG = ~0UL };
+
+		private:
+
+			Device_model * const      _tlm;              /* transaction-level model */
+			Device_model * const      _rtl;              /* RTL model */
+			addr_t const              _control_off;      /* offset of the control
+			                                              * register */
+			Device_model *            _active;           /* currently active model */
+			Signal_context_capability _irqs[MAX_IRQS];   /* IRQ listeners */
+			Lock                      _lock;             /* sync model access */
+
+			Device_model * _model(Fidelity const f) const {
+				return f == Emulation::Session::RTL ? _rtl : _tlm; }
+
+			Fidelity _fidelity() const {
+				return _active == _rtl ? Emulation::Session::RTL
+				                       : Emulation::Session::TRANSACTION_LEVEL; }
+
+			/**
+			 * Switch to another model, the caller must hold '_lock'
+			 */
+			void _switch(Fidelity const f)
+			{
+				Device_model * const next = _model(f);
+				if (next == _active) return;
+
+				/* freeze the old model and carry over its register state */
+				_active->pause();
+				Register_state state;
+				_active->save_state(state);
+				next->load_state(state);
+
+				/* move IRQ listeners and reflect IRQ changes as edge */
+				for (unsigned i = 0; i < MAX_IRQS; i++) {
+					if (!_irqs[i].valid()) continue;
+					bool const old_irq =
+						_active->irq_handler(i, Signal_context_capability());
+					bool const new_irq = next->irq_handler(i, _irqs[i]);
+					if (old_irq != new_irq) Signal_transmitter(_irqs[i]).submit();
+				}
+				_active = next;
+				_active->resume();
+			}
+
+		public:
+
+			/**
+			 * Constructor
+			 *
+			 * \param tlm          transaction-level model
+			 * \param rtl          RTL model
+			 * \param control_off  offset of the in-band control register,
+			 *                     writing 1 selects RTL, 0 selects TLM
+			 */
+			Dual_fidelity_device(Device_model * const tlm,
+			                     Device_model * const rtl,
+			                     addr_t const control_off = NO_CONTROL_REG)
+			:
+				_tlm(tlm), _rtl(rtl), _control_off(control_off), _active(tlm)
+			{ }
+
+			/**
+			 * Initialize both models and activate one of them
+			 *
+			 * \param f  fidelity to start with
+			 */
+			void initialize(Fidelity const f)
+			{
+				Lock::Guard guard(_lock);
+				_tlm->initialize();
+				_rtl->initialize();
+				_tlm->pause();
+				_rtl->pause();
+				_active = _model(f);
+				_active->resume();
+			}
+
+
+			/**********************************
+			 ** Emulation::Session_component **
+			 **********************************/
+
+			bool fidelity(Fidelity const f)
+			{
+				Lock::Guard guard(_lock);
+				_switch(f);
+				return 1;
+			}
+
+			umword_t read_mmio(addr_t const off, Access const a)
+			{
+				Lock::Guard guard(_lock);
+				if (off == _control_off)
+					return _fidelity() == Emulation::Session::RTL;
+				return _active->read_mmio(off, a);
+			}
+
+			void write_mmio(addr_t const off, Access const a,
+			                umword_t const value)
+			{
+				Lock::Guard guard(_lock);
+				if (off == _control_off) {
+					_switch(value ? Emulation::Session::RTL
+					              : Emulation::Session::TRANSACTION_LEVEL);
+					return;
+				}
+				_active->write_mmio(off, a, value);
+			}
+
+			bool irq_handler(unsigned const irq,
+			                 Signal_context_capability irq_edge)
+			{
+				Lock::Guard guard(_lock);
+				if (irq >= MAX_IRQS) {
+					PERR("%s:%d: Invalid IRQ", __FILE__, __LINE__);
+					return 0;
+				}
+				_irqs[irq] = irq_edge;
+				return _active->irq_handler(irq, irq_edge);
+			}
+	};
+}
+
+#endif /* _INCLUDE__VERILATOR_ENV__DUAL_FIDELITY_H_ */
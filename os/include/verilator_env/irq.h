@@ -37,11 +37,14 @@ namespace Genode
 
 			/**
 			 * Set the IRQ-handler signal
+			 *
+			 * The current line state is the reference for subsequent edges.
 			 */
 			void signal(Signal_context_capability signal)
 			{
 				Lock::Guard guard(_lock);
 				_signal = signal;
+				_state = *_raw;
 			}
 
 			/**
@@ -127,6 +130,8 @@ namespace Genode
 				Driven_clock_base(raw, up, freq_ms, interval_ms, lock),
 				_irqs(irqs), _irqs_size(irqs_size) { }
 
+			using Driven_clock_base::enable;
+
 
 			/***********************
 			 ** Driven_clock_base **
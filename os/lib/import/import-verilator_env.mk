@@ -105,6 +105,135 @@ $(VERILATOR_DST_DIR)/$(VERILATOR_EXE): $(VERILATOR_DST_DIR)
 $(VERILATOR_DST_DIR):
 	$(VERBOSE)mkdir -p $(VERILATOR_DST_DIR)
 
+#
+# Profile-driven optimization
+#
+# If 'VERILATOR_PROFILE' is set, the design gets verilated and compiled for
+# the build host in three flavors before the Genode emulator is built:
+#
+#   instr  instrumented via '--profile-cfuncs' and gprof, the profile that
+#          results from a benchmark run gets condensed to a per-function
+#          report by 'verilator_profcfunc'
+#   base   verilator defaults, measures the reference speed
+#   opt    verilated with the output-split and inline settings below,
+#          compiled with the gcc profile of a training run
+#
+# Each flavor is clocked by the benchmark in 'host_bench.cc' for
+# 'VERILATOR_BENCH_CYCLES' cycles at the input 'VERILATOR_BENCH_CLK'. The
+# speedup of 'opt' over 'base' gets printed together with the hottest
+# functions. Only if 'opt' turned out faster, the Genode emulator gets
+# verilated and compiled with its settings. The gcc profile is used on the
+# host only as it doesn't match the code of the cross compiler.
+#
+
+VERILATOR_BENCH_CLK        ?= clk
+VERILATOR_BENCH_CYCLES     ?= 1000000
+VERILATOR_PROFILE_SPLIT    ?= 20000
+VERILATOR_PROFILE_CFUNCS   ?= 2000
+VERILATOR_PROFILE_INLINE   ?= 20000
+VERILATOR_PROFILE_OPT_FAST ?= -O3
+VERILATOR_PROFILE_REPORT   ?= 30
+
+VERILATOR_PROFCFUNC = $(call select_from_repositories,tool/verilator/bin/verilator_profcfunc)
+VERILATOR_TUNE_OPT  = --output-split $(VERILATOR_PROFILE_SPLIT) \
+                      --output-split-cfuncs $(VERILATOR_PROFILE_CFUNCS) \
+                      --inline-mult $(VERILATOR_PROFILE_INLINE)
+
+VPROF_DIR       = verilated_profile
+VPROF_TOOL_INC  = $(call select_from_repositories,$(TOOL_INC))
+VPROF_BENCH_SRC = $(call select_from_repositories,src/lib/verilator_env/host_bench.cc)
+VPROF_CXX_OPT   = -O2 -I$(VPROF_TOOL_INC)
+VPROF_VOPT      = -Wall -Wno-lint --cc $(VERILATOR_SRC) -y $(PRG_DIR)
+
+# stage-specific options for verilator and the host compiler
+VPROF_VOPT_instr = --profile-cfuncs
+VPROF_VOPT_opt   = $(VERILATOR_TUNE_OPT)
+VPROF_CXX_instr  = -pg
+VPROF_CXX_opt    = $(VERILATOR_PROFILE_OPT_FAST)
+
+# make options to compile a stage '$(1)' with additional flags '$(2)'
+vprof_make_opt = GENODE_CXX_OPT="$(VPROF_CXX_OPT) $(VPROF_CXX_$(1)) $(2)" \
+                 GENODE_PERL="$(VMAKE_PERL)" \
+                 GENODE_VERBOSE="$(VERBOSE)" \
+                 GENODE_GCC_PREFIX=""
+
+#
+# Compile the emulation library of stage '$(1)' with additional flags '$(2)'
+# and link the benchmark against it
+#
+define vprof_build
+	$(VERBOSE)cd $(VPROF_DIR)/$(1); \
+		$(MAKE) -f $(VMAKE_PATCHED) $(VMAKE_TARGET) $(call vprof_make_opt,$(1),$(2))
+	$(MSG_LINK)$(VPROF_DIR)/$(1)/bench
+	$(VERBOSE)g++ $(VPROF_CXX_OPT) $(VPROF_CXX_$(1)) $(2) -I$(VPROF_DIR)/$(1) \
+		-DEMU_TOP=V$(EMU_NAME) -DEMU_HEADER='"$(EMU_HEADER)"' \
+		-DEMU_CLK=$(VERILATOR_BENCH_CLK) $(VPROF_BENCH_SRC) \
+		$(VPROF_DIR)/$(1)/verilated.o $(VPROF_DIR)/$(1)/$(EMU_LIB) \
+		-o $(VPROF_DIR)/$(1)/bench
+endef
+
+# run the benchmark of stage '$(1)' and keep the consumed time in '$(2)'
+vprof_run = cd $(VPROF_DIR)/$(1); ./bench $(VERILATOR_BENCH_CYCLES) > $(2)
+
+# generate C++ sources of one stage
+$(VPROF_DIR)/%/$(VMAKE): $(VERILATOR_SRC) $(VMAKE_PERL)
+	$(VERBOSE)mkdir -p $(VPROF_DIR)/$*
+	$(VERBOSE)touch $(VPROF_DIR)/$*/$(VERILATOR_EXE)
+	$(MSG_CONVERT)$(VERILATOR_SRC) "($*)"
+	$(VERBOSE)$(VERILATOR) $(VPROF_VOPT) $(VPROF_VOPT_$*) \
+		--Mdir $(VPROF_DIR)/$* --exe $(VPROF_DIR)/$*/$(VERILATOR_EXE)
+
+$(VPROF_DIR)/%/$(VMAKE_PATCHED): $(VPROF_DIR)/%/$(VMAKE)
+	$(VERBOSE)cd $(VPROF_DIR)/$*; \
+		sed -e 's/^\t\$$(LINK).*/\t/' $(VMAKE) > $(VMAKE_PATCHED)
+
+# per-function profile of the instrumented stage
+$(VPROF_DIR)/instr/profile.txt: $(VPROF_DIR)/instr/$(VMAKE_PATCHED)
+	$(call check_tool,gprof)
+	$(call vprof_build,instr)
+	$(VERBOSE)$(call vprof_run,instr,time.txt)
+	$(VERBOSE)cd $(VPROF_DIR)/instr; gprof bench gmon.out > gprof.txt
+	$(VERBOSE)$(VERILATOR_PROFCFUNC) $(VPROF_DIR)/instr/gprof.txt > $@
+
+# reference speed
+$(VPROF_DIR)/base/time.txt: $(VPROF_DIR)/base/$(VMAKE_PATCHED)
+	$(call vprof_build,base)
+	$(VERBOSE)$(call vprof_run,base,time.txt)
+
+# tuned speed, the first run trains the compiler for the second build
+$(VPROF_DIR)/opt/time.txt: $(VPROF_DIR)/opt/$(VMAKE_PATCHED)
+	$(call vprof_build,opt,-fprofile-generate)
+	$(VERBOSE)$(call vprof_run,opt,train.txt)
+	$(VERBOSE)cd $(VPROF_DIR)/opt; rm -f *.o *.a bench
+	$(call vprof_build,opt,-fprofile-use -fprofile-correction)
+	$(VERBOSE)$(call vprof_run,opt,time.txt)
+
+$(VPROF_DIR)/report.txt: $(VPROF_DIR)/instr/profile.txt \
+                         $(VPROF_DIR)/base/time.txt \
+                         $(VPROF_DIR)/opt/time.txt
+	$(VERBOSE)head -n $(VERILATOR_PROFILE_REPORT) $(VPROF_DIR)/instr/profile.txt > $@
+	$(VERBOSE)awk 'NR == FNR { base = $$1; next } \
+	               { printf "speedup of tuned emulator: %.2f (%u us -> %u us)\n", \
+	                        base / ($$1 ? $$1 : 1), base, $$1; \
+	                 exit !($$1 < base) }' \
+		$(VPROF_DIR)/base/time.txt $(VPROF_DIR)/opt/time.txt >> $@ && \
+	( echo "$(VERILATOR_TUNE_OPT)"         > $(VPROF_DIR)/tuned_vopt.txt; \
+	  echo "$(VERILATOR_PROFILE_OPT_FAST)" > $(VPROF_DIR)/tuned_cxx.txt; \
+	  echo "adopting tuned settings" >> $@ ) || \
+	( : > $(VPROF_DIR)/tuned_vopt.txt; : > $(VPROF_DIR)/tuned_cxx.txt; \
+	  echo "keeping default settings" >> $@ )
+	$(VERBOSE)cat $@
+
+ifneq ($(VERILATOR_PROFILE),)
+ifneq ($(EMU_NAME),)
+
+  # build the Genode emulator with the settings the rating has approved
+  VERILATOR_OPT += $$(cat $(VPROF_DIR)/tuned_vopt.txt)
+  VMAKE_CXX_OPT += $$(cat $(shell pwd)/$(VPROF_DIR)/tuned_cxx.txt)
+  $(VERILATOR_DST_DIR)/$(VMAKE): $(VPROF_DIR)/report.txt
+endif
+endif
+
 # include imports of implied libraries
 include $(call select_from_repositories,lib/import/import-libc.mk)
 include $(call select_from_repositories,lib/import/import-stdcxx.mk)
@@ -116,7 +245,7 @@ include $(call select_from_repositories,lib/import/import-stdcxx.mk)
 clean_prg_objects: clean_verilator_env_build_dir
 
 clean_verilator_env_build_dir:
-	$(VERBOSE)rm -rf $(VERILATOR_DST_DIR)
+	$(VERBOSE)rm -rf $(VERILATOR_DST_DIR) $(VPROF_DIR)
 
 #
 # Tool dependencies
@@ -1,4 +1,4 @@
 SRC_CC = timed_semaphore.cc
-LIBS   = thread alarm
+LIBS   = thread alarm signal
 
 vpath timed_semaphore.cc $(REP_DIR)/src/lib/timed_semaphore
@@ -57,7 +57,7 @@ namespace Timer {
 				if (!args.is_valid_string()) throw Invalid_args();
 
 				size_t ram_quota = Arg_string::find_arg(args.string(), "ram_quota").ulong_value(0);
-				size_t require = sizeof(Session_component) + STACK_SIZE;
+				size_t require = sizeof(Session_component) + 2*STACK_SIZE;
 				if (ram_quota < require) {
 					PWRN("Insufficient donated ram_quota (%zd bytes), require %zd bytes",
 					     ram_quota, require);
@@ -6,7 +6,7 @@
  */
 
 /*
- * Copyright (C) 2010-2012 Genode Labs GmbH
+ * Copyright (C) 2010-2013 Genode Labs GmbH
  *
  * This file is part of the Genode OS framework, which is distributed
  * under the terms of the GNU General Public License version 2.
@@ -17,12 +17,16 @@
 
 /* Genode includes */
 #include <base/rpc_server.h>
+#include <base/signal.h>
+#include <base/thread.h>
 #include <timer_session/capability.h>
 #include <os/attached_rom_dataspace.h>
+#include <foc_cpu_session/client.h>
 
 /* Fiasco.OC includes */
 namespace Fiasco {
 #include <l4/sys/ipc.h>
+#include <l4/sys/irq.h>
 #include <l4/sys/kip.h>
 }
 
@@ -57,6 +61,113 @@ namespace Timer {
 
 	enum { STACK_SIZE = 1024 * sizeof(Genode::addr_t) };
 
+	/**
+	 * Thread that signals one-shot and periodic timeouts of a session
+	 *
+	 * Fiasco.OC lacks a timer interrupt that we could multiplex. Hence,
+	 * each session with a pending timeout sleeps in a thread of its own.
+	 * The thread sleeps by receiving from an IRQ object of its own, with a
+	 * timeout of the remaining time. A re-programmed timeout triggers the
+	 * IRQ and thereby interrupts the sleep. Because a triggered IRQ stays
+	 * pending until received, no wake-up gets lost. The IRQ object that the
+	 * kernel attached to each thread is not used because 'Genode::Lock'
+	 * blocks on it.
+	 */
+	class Signal_timeout_thread : public Genode::Thread<STACK_SIZE>
+	{
+		private:
+
+			enum { MAX_SLEEP_US = 1000*1000 };
+
+			Fiasco::l4_kernel_info_t * const  _kip;
+			Genode::Native_capability const   _irq;
+			Genode::Lock                      _attached; /* unlocked by 'entry' */
+			Genode::Lock                      _lock;
+			Genode::Signal_context_capability _sigh;
+			Fiasco::l4_cpu_time_t             _deadline;
+			unsigned long                     _period; /* 0 if one-shot */
+			bool                              _armed;
+
+			static Genode::Native_capability _alloc_irq()
+			{
+				Genode::Foc_cpu_session_client cpu(Genode::env()->cpu_session_cap());
+				return cpu.alloc_irq();
+			}
+
+			void entry()
+			{
+				using namespace Fiasco;
+
+				if (l4_error(l4_irq_attach(_irq.dst(), 0, tid())))
+					PERR("could not attach timeout IRQ");
+				_attached.unlock();
+
+				while (true) {
+
+					l4_timeout_s timeout = L4_IPC_TIMEOUT_NEVER;
+					{
+						Genode::Lock::Guard lock_guard(_lock);
+						l4_cpu_time_t const now = _kip->clock;
+
+						if (_armed && (Genode::int64_t)(_deadline - now) <= 0) {
+
+							if (_sigh.valid())
+								Genode::Signal_transmitter(_sigh).submit();
+
+							/* skip periods that were missed as a whole */
+							if (_period)
+								_deadline += ((now - _deadline) / _period + 1) * _period;
+							else
+								_armed = false;
+						}
+						if (_armed)
+							timeout = mus_to_timeout(Genode::min(_deadline - now,
+							                         (l4_cpu_time_t)MAX_SLEEP_US));
+					}
+
+					/* sleep until the deadline or until 'schedule' wakes us up */
+					l4_irq_receive(_irq.dst(), l4_timeout(L4_IPC_TIMEOUT_NEVER, timeout));
+				}
+			}
+
+		public:
+
+			Signal_timeout_thread(Fiasco::l4_kernel_info_t *kip)
+			:
+				Genode::Thread<STACK_SIZE>("timer_signal"),
+				_kip(kip), _irq(_alloc_irq()), _attached(Genode::Lock::LOCKED),
+				_deadline(0), _period(0), _armed(false)
+			{
+				start();
+
+				/* 'schedule' must not trigger the IRQ before it is attached */
+				_attached.lock();
+			}
+
+			void sigh(Genode::Signal_context_capability sigh)
+			{
+				Genode::Lock::Guard lock_guard(_lock);
+				_sigh = sigh;
+			}
+
+			/**
+			 * Replace pending timeout
+			 *
+			 * \param armed  false to cancel the pending timeout
+			 */
+			void schedule(unsigned long timeout, unsigned long period, bool armed)
+			{
+				{
+					Genode::Lock::Guard lock_guard(_lock);
+					_deadline = _kip->clock + timeout;
+					_period   = period;
+					_armed    = armed;
+				}
+				Fiasco::l4_irq_trigger(_irq.dst());
+			}
+	};
+
+
 	/**
 	 * Timer session
 	 */
@@ -70,6 +181,7 @@ namespace Timer {
 			Genode::Attached_rom_dataspace   _kip_ds;
 			Fiasco::l4_kernel_info_t * const _kip;
 			Fiasco::l4_cpu_time_t const      _initial_clock_value;
+			Signal_timeout_thread            _signal_timeout_thread;
 
 		public:
 
@@ -82,7 +194,8 @@ namespace Timer {
 				_session_cap(_entrypoint.manage(this)),
 				_kip_ds("l4v2_kip"),
 				_kip(_kip_ds.local_addr<Fiasco::l4_kernel_info_t>()),
-				_initial_clock_value(_kip->clock)
+				_initial_clock_value(_kip->clock),
+				_signal_timeout_thread(_kip)
 			{ }
 
 			/**
@@ -122,6 +235,20 @@ namespace Timer {
 			{
 				return (_kip->clock - _initial_clock_value) / 1000;
 			}
+
+			Genode::uint64_t elapsed_us() const
+			{
+				return _kip->clock - _initial_clock_value;
+			}
+
+			void trigger_once(unsigned us) {
+				_signal_timeout_thread.schedule(us, 0, true); }
+
+			void trigger_periodic(unsigned us) {
+				_signal_timeout_thread.schedule(us, us, us); }
+
+			void sigh(Genode::Signal_context_capability sigh) {
+				_signal_timeout_thread.sigh(sigh); }
 	};
 }
 
@@ -5,7 +5,7 @@
  */
 
 /*
- * Copyright (C) 2006-2012 Genode Labs GmbH
+ * Copyright (C) 2006-2013 Genode Labs GmbH
  *
  * This file is part of the Genode OS framework, which is distributed
  * under the terms of the GNU General Public License version 2.
@@ -18,6 +18,7 @@
 #include <util/list.h>
 #include <os/alarm.h>
 #include <base/rpc_server.h>
+#include <base/signal.h>
 #include <timer_session/timer_session.h>
 
 /* local includes */
@@ -29,6 +30,42 @@ namespace Timer {
 	enum { STACK_SIZE = 32*1024 };
 
 
+	/**
+	 * Microsecond clock that does not wrap
+	 *
+	 * The platform time wraps at the range of 'Alarm::Time', which is only
+	 * about 71 minutes on 32-bit machines. The clock accumulates the
+	 * progress of the platform time. This is correct as long as the clock
+	 * gets sampled more often than the platform time wraps, which the
+	 * timer-interrupt handler ensures by sampling the clock at least each
+	 * 'max_timeout'. The clock is used by the server activation only.
+	 */
+	class Clock
+	{
+		private:
+
+			Platform_timer      *_platform_timer;
+			Genode::uint64_t     _time;      /* accumulated time */
+			Genode::Alarm::Time  _last_time; /* platform time at last sample */
+
+		public:
+
+			Clock(Platform_timer *pt)
+			: _platform_timer(pt), _time(0), _last_time(pt->curr_time()) { }
+
+			/**
+			 * Return current time in microseconds
+			 */
+			Genode::uint64_t curr_time()
+			{
+				Genode::Alarm::Time const now = _platform_timer->curr_time();
+				_time     += (Genode::Alarm::Time)(now - _last_time);
+				_last_time = now;
+				return _time;
+			}
+	};
+
+
 	struct Irq_dispatcher {
 		GENODE_RPC(Rpc_do_dispatch, void, do_dispatch);
 		GENODE_RPC_INTERFACE(Rpc_do_dispatch);
@@ -52,6 +89,7 @@ namespace Timer {
 
 			Genode::Alarm_scheduler *_alarm_scheduler;
 			Platform_timer          *_platform_timer;
+			Clock                   *_clock;
 
 		public:
 
@@ -59,8 +97,9 @@ namespace Timer {
 			 * Constructor
 			 */
 			Irq_dispatcher_component(Genode::Alarm_scheduler *as,
-			                         Platform_timer          *pt)
-			: _alarm_scheduler(as), _platform_timer(pt) { }
+			                         Platform_timer          *pt,
+			                         Clock                   *clock)
+			: _alarm_scheduler(as), _platform_timer(pt), _clock(clock) { }
 
 
 			/******************************
@@ -74,6 +113,9 @@ namespace Timer {
 				Alarm::Time now = _platform_timer->curr_time();
 				Alarm::Time sleep_time;
 
+				/* keep the clock from missing a wrap of the platform time */
+				_clock->curr_time();
+
 				/* trigger timeout alarms */
 				_alarm_scheduler->handle(now);
 
@@ -141,6 +183,7 @@ namespace Timer {
 			        Irq_dispatcher_capability;
 
 			Platform_timer           *_platform_timer;
+			Clock                     _clock;
 			Irq_dispatcher_component  _irq_dispatcher_component;
 			Irq_dispatcher_capability _irq_dispatcher_cap;
 
@@ -174,7 +217,8 @@ namespace Timer {
 			Timeout_scheduler(Platform_timer *pt, Genode::Rpc_entrypoint *ep)
 			:
 				_platform_timer(pt),
-				_irq_dispatcher_component(this, pt),
+				_clock(pt),
+				_irq_dispatcher_component(this, pt, &_clock),
 				_irq_dispatcher_cap(ep->manage(&_irq_dispatcher_component))
 			{
 				_platform_timer->schedule_timeout(0);
@@ -182,16 +226,109 @@ namespace Timer {
 			}
 
 			/**
-			 * Called from the 'msleep' function executed by the server activation
+			 * Return current time in microseconds
 			 */
-			void schedule_timeout(Genode::Alarm *alarm, Genode::Alarm::Time timeout)
+			Genode::Alarm::Time curr_time() { return _platform_timer->curr_time(); }
+
+			/**
+			 * Return current time in microseconds, not wrapping
+			 */
+			Genode::uint64_t curr_time_64() { return _clock.curr_time(); }
+
+			/**
+			 * Schedule alarm at absolute 'deadline' with the slack of 'timeout'
+			 *
+			 * Deadlines get rounded up to a granularity of about 1/64 of the
+			 * timeout but at most 'MAX_SLACK_US'. So, deadlines that are close
+			 * to each other relative to their timeouts fall onto the same
+			 * point in time, also across sessions, and get handled by one
+			 * timer interrupt.
+			 */
+			void schedule_deadline(Genode::Alarm *alarm, Genode::Alarm::Time deadline,
+			                       Genode::Alarm::Time timeout)
 			{
-				Genode::Alarm::Time now = _platform_timer->curr_time();
-				schedule_absolute(alarm, now + timeout);
+				enum { SLACK_SHIFT = 6, MAX_SLACK_US = 1024 };
+
+				Genode::Alarm::Time slack = 1;
+				while (slack < MAX_SLACK_US && slack << (SLACK_SHIFT + 1) <= timeout)
+					slack <<= 1;
+
+				schedule_absolute(alarm, (deadline + slack - 1) & ~(slack - 1));
 
 				/* interrupt current 'wait_for_timeout' */
 				_platform_timer->schedule_timeout(0);
 			}
+
+			/**
+			 * Called from the 'msleep' function executed by the server activation
+			 */
+			void schedule_timeout(Genode::Alarm *alarm, Genode::Alarm::Time timeout) {
+				schedule_deadline(alarm, curr_time() + timeout, timeout); }
+	};
+
+
+	/**
+	 * Alarm for signalling one-shot and periodic timeouts
+	 *
+	 * The alarm gets scheduled by session requests and dispatched by
+	 * 'Irq_dispatcher_component::do_dispatch'. Both get executed by the
+	 * server activation. Hence, the alarm can re-schedule itself from
+	 * 'on_alarm'.
+	 */
+	class Signal_alarm : public Genode::Alarm
+	{
+		private:
+
+			Timeout_scheduler                 *_scheduler;
+			Genode::Signal_context_capability  _sigh;
+			Genode::Alarm::Time                _deadline; /* not rounded */
+			Genode::Alarm::Time                _period;   /* 0 if one-shot */
+
+		public:
+
+			Signal_alarm(Timeout_scheduler *ts)
+			: _scheduler(ts), _deadline(0), _period(0) { }
+
+			void sigh(Genode::Signal_context_capability sigh) { _sigh = sigh; }
+
+			/**
+			 * Replace pending timeout
+			 *
+			 * \param period  0 for a one-shot timeout
+			 */
+			void schedule(Genode::Alarm::Time timeout, Genode::Alarm::Time period)
+			{
+				_scheduler->discard(this);
+				_period   = period;
+				_deadline = _scheduler->curr_time() + timeout;
+				_scheduler->schedule_deadline(this, _deadline, timeout);
+			}
+
+			void cancel() { _scheduler->discard(this); }
+
+
+			/*********************
+			 ** Alarm interface **
+			 *********************/
+
+			bool on_alarm()
+			{
+				if (_sigh.valid())
+					Genode::Signal_transmitter(_sigh).submit();
+
+				if (!_period) return false;
+
+				/* skip periods that were missed as a whole */
+				Genode::Alarm::Time const now = _scheduler->curr_time();
+				_deadline += _period;
+				if ((long)(_deadline - now) <= 0)
+					_deadline += ((now - _deadline) / _period + 1) * _period;
+
+				_scheduler->schedule_deadline(this, _deadline, _period);
+
+				/* we re-scheduled ourself */
+				return false;
+			}
 	};
 
 
@@ -203,9 +340,11 @@ namespace Timer {
 	{
 		private:
 
-			Timeout_scheduler      *_timeout_scheduler;
-			Genode::Rpc_entrypoint *_entrypoint;
-			Wake_up_alarm           _wake_up_alarm;
+			Timeout_scheduler         *_timeout_scheduler;
+			Genode::Rpc_entrypoint    *_entrypoint;
+			Wake_up_alarm              _wake_up_alarm;
+			Signal_alarm               _signal_alarm;
+			Genode::uint64_t const     _initial_time;
 
 		public:
 
@@ -217,7 +356,9 @@ namespace Timer {
 			:
 				_timeout_scheduler(ts),
 				_entrypoint(ep),
-				_wake_up_alarm(ep)
+				_wake_up_alarm(ep),
+				_signal_alarm(ts),
+				_initial_time(ts->curr_time_64())
 			{ }
 
 			/**
@@ -226,6 +367,7 @@ namespace Timer {
 			~Session_component()
 			{
 				_timeout_scheduler->discard(&_wake_up_alarm);
+				_signal_alarm.cancel();
 			}
 
 
@@ -246,6 +388,24 @@ namespace Timer {
 				 */
 				_entrypoint->omit_reply();
 			}
+
+			void trigger_once(unsigned us) { _signal_alarm.schedule(us, 0); }
+
+			void trigger_periodic(unsigned us)
+			{
+				if (us)
+					_signal_alarm.schedule(us, us);
+				else
+					_signal_alarm.cancel();
+			}
+
+			void sigh(Genode::Signal_context_capability sigh) {
+				_signal_alarm.sigh(sigh); }
+
+			Genode::uint64_t elapsed_us() const {
+				return _timeout_scheduler->curr_time_64() - _initial_time; }
+
+			unsigned long elapsed_ms() const { return elapsed_us() / 1000; }
 	};
 }
 
@@ -16,6 +16,7 @@
 
 /* Genode inludes **/
 #include <base/thread.h>
+#include <util/misc_math.h>
 
 
 class Platform_timer
@@ -71,9 +72,17 @@ class Platform_timer
 			unsigned long last_time = curr_time();
 			_lock.lock();
 			while (_next_timeout_usec) {
+
+				/*
+				 * Sleep for short timeouts as a whole to keep their
+				 * microsecond resolution
+				 */
+				unsigned long const sleep_usec =
+					Genode::min(_next_timeout_usec, (unsigned long)SLEEP_GRANULARITY_USEC);
+
 				_lock.unlock();
 
-				try { _usleep(SLEEP_GRANULARITY_USEC); }
+				try { _usleep(sleep_usec); }
 				catch (Genode::Blocking_canceled) { }
 
 				unsigned long now_time       = curr_time();
@@ -5,7 +5,7 @@
  */
 
 /*
- * Copyright (C) 2010-2012 Genode Labs GmbH
+ * Copyright (C) 2010-2013 Genode Labs GmbH
  *
  * This file is part of the Genode OS framework, which is distributed
  * under the terms of the GNU General Public License version 2.
@@ -17,6 +17,7 @@
 /* Genode includes */
 #include <os/alarm.h>
 #include <base/rpc_server.h>
+#include <base/signal.h>
 #include <timer_session/capability.h>
 
 /* local includes */
@@ -58,11 +59,142 @@ namespace Timer {
 	};
 
 
+	/**
+	 * Alarm for signalling one-shot and periodic timeouts
+	 *
+	 * Session requests and periodic re-schedules get recorded at the alarm
+	 * and applied by the 'Timeout_scheduler' thread. Thus, the alarm never
+	 * gets scheduled or discarded while it is dispatched.
+	 */
+	class Signal_alarm : public Genode::Alarm,
+	                     public Genode::List<Signal_alarm>::Element
+	{
+		private:
+
+			Genode::Lock                      _lock;
+			Genode::Signal_context_capability _sigh;
+			Genode::Alarm::Time               _deadline;  /* not rounded */
+			Genode::Alarm::Time               _timeout;   /* determines slack */
+			Genode::Alarm::Time               _period;    /* 0 if one-shot */
+			bool                              _armed;
+			bool                              _requested;
+
+		public:
+
+			Signal_alarm()
+			:
+				_deadline(0), _timeout(0), _period(0),
+				_armed(false), _requested(false)
+			{ }
+
+			void sigh(Genode::Signal_context_capability sigh)
+			{
+				Genode::Lock::Guard lock_guard(_lock);
+				_sigh = sigh;
+			}
+
+			/**
+			 * Record request to replace the pending timeout
+			 *
+			 * \param armed  false to cancel the pending timeout
+			 */
+			void request(Genode::Alarm::Time now, Genode::Alarm::Time timeout,
+			             Genode::Alarm::Time period, bool armed)
+			{
+				Genode::Lock::Guard lock_guard(_lock);
+				_deadline  = now + timeout;
+				_timeout   = timeout;
+				_period    = period;
+				_armed     = armed;
+				_requested = true;
+			}
+
+			/**
+			 * Fetch recorded request
+			 *
+			 * \return  true if the alarm must be re-scheduled
+			 */
+			bool fetch(Genode::Alarm::Time now, Genode::Alarm::Time *deadline,
+			           Genode::Alarm::Time *timeout, bool *armed)
+			{
+				Genode::Lock::Guard lock_guard(_lock);
+				if (!_requested) return false;
+
+				/* skip periods that were missed as a whole */
+				if (_period && (long)(_deadline - now) <= 0)
+					_deadline += ((now - _deadline) / _period + 1) * _period;
+
+				*deadline  = _deadline;
+				*timeout   = _timeout;
+				*armed     = _armed;
+				_requested = false;
+				return true;
+			}
+
+
+			/*********************
+			 ** Alarm interface **
+			 *********************/
+
+			bool on_alarm()
+			{
+				Genode::Lock::Guard lock_guard(_lock);
+
+				if (_sigh.valid())
+					Genode::Signal_transmitter(_sigh).submit();
+
+				/* let the scheduler thread re-schedule periodic timeouts */
+				if (_period && !_requested) {
+					_deadline += _period;
+					_timeout   = _period;
+					_requested = true;
+				}
+				return false;
+			}
+	};
+
+
 	class Timeout_scheduler : public Genode::Alarm_scheduler, Genode::Thread<STACK_SIZE>
 	{
 		private:
 
-			Platform_timer *_platform_timer;
+			Platform_timer            *_platform_timer;
+			Genode::Lock               _signal_alarms_lock;
+			Genode::List<Signal_alarm> _signal_alarms;
+
+			/*
+			 * Held by the scheduler thread while it dispatches alarms, so
+			 * that alarms can be withdrawn from the dispatching
+			 */
+			Genode::Lock               _dispatch_lock;
+
+			/*
+			 * The platform time wraps at the range of 'Alarm::Time', which
+			 * is only about 71 minutes on 32-bit machines. So, we
+			 * accumulate its progress. The scheduler thread samples it at
+			 * least each 'max_timeout', which is more often than it wraps.
+			 */
+			Genode::Lock               _time_lock;
+			Genode::uint64_t           _time;
+			Genode::Alarm::Time        _last_time;
+
+			/**
+			 * Apply requests recorded at the signal alarms
+			 */
+			void _apply_requests(Genode::Alarm::Time now)
+			{
+				Genode::Lock::Guard lock_guard(_signal_alarms_lock);
+
+				Signal_alarm *a = _signal_alarms.first();
+				for (; a; a = a->next()) {
+					Genode::Alarm::Time deadline, timeout;
+					bool armed;
+					if (!a->fetch(now, &deadline, &timeout, &armed)) continue;
+
+					discard(a);
+					if (armed) schedule_deadline(a, deadline, timeout);
+				}
+			}
 
 			/**
 			 * Timer-interrupt thread
@@ -78,8 +210,14 @@ namespace Timer {
 					Alarm::Time now = _platform_timer->curr_time();
 					Alarm::Time sleep_time;
 
+					curr_time_64();
+
 					/* trigger timeout alarms */
-					handle(now);
+					{
+						Lock::Guard lock_guard(_dispatch_lock);
+						handle(now);
+						_apply_requests(now);
+					}
 
 					/* determine duration for next one-shot timer event */
 					Alarm::Time deadline;
@@ -101,23 +239,96 @@ namespace Timer {
 			 * Constructor
 			 */
 			Timeout_scheduler(Platform_timer *pt, Genode::Rpc_entrypoint *ep)
-			: Genode::Thread<STACK_SIZE>("irq"), _platform_timer(pt)
+			:
+				Genode::Thread<STACK_SIZE>("irq"), _platform_timer(pt),
+				_time(0), _last_time(pt->curr_time())
 			{
 				_platform_timer->schedule_timeout(0);
 				PDBG("starting timeout scheduler");
 				start();
 			}
 
+			/**
+			 * Return current time in microseconds
+			 */
+			Genode::Alarm::Time curr_time() { return _platform_timer->curr_time(); }
+
+			/**
+			 * Return current time in microseconds, not wrapping
+			 */
+			Genode::uint64_t curr_time_64()
+			{
+				Genode::Lock::Guard lock_guard(_time_lock);
+				Genode::Alarm::Time const now = _platform_timer->curr_time();
+				_time     += (Genode::Alarm::Time)(now - _last_time);
+				_last_time = now;
+				return _time;
+			}
+
+			/**
+			 * Interrupt current 'wait_for_timeout'
+			 */
+			void wake_up() { _platform_timer->schedule_timeout(0); }
+
+			void register_signal_alarm(Signal_alarm *alarm)
+			{
+				Genode::Lock::Guard lock_guard(_signal_alarms_lock);
+				_signal_alarms.insert(alarm);
+			}
+
+			/**
+			 * Withdraw signal alarm, which may get destructed afterwards
+			 *
+			 * Waits until the scheduler thread has left the dispatching,
+			 * which might execute 'on_alarm' or apply a request of 'alarm'.
+			 */
+			void unregister_signal_alarm(Signal_alarm *alarm)
+			{
+				Genode::Lock::Guard dispatch_guard(_dispatch_lock);
+				{
+					Genode::Lock::Guard lock_guard(_signal_alarms_lock);
+					_signal_alarms.remove(alarm);
+				}
+				discard(alarm);
+			}
+
+			/**
+			 * Withdraw alarm, synchronized with the scheduler thread
+			 */
+			void discard_synchronized(Genode::Alarm *alarm)
+			{
+				Genode::Lock::Guard dispatch_guard(_dispatch_lock);
+				discard(alarm);
+			}
+
+			/**
+			 * Schedule alarm at absolute 'deadline' with the slack of 'timeout'
+			 *
+			 * Deadlines get rounded up to a granularity of about 1/64 of the
+			 * timeout but at most 'MAX_SLACK_US'. So, deadlines that are close
+			 * to each other relative to their timeouts fall onto the same
+			 * point in time, also across sessions, and get handled by one
+			 * timer interrupt.
+			 */
+			void schedule_deadline(Genode::Alarm *alarm, Genode::Alarm::Time deadline,
+			                       Genode::Alarm::Time timeout)
+			{
+				enum { SLACK_SHIFT = 6, MAX_SLACK_US = 1024 };
+
+				Genode::Alarm::Time slack = 1;
+				while (slack < MAX_SLACK_US && slack << (SLACK_SHIFT + 1) <= timeout)
+					slack <<= 1;
+
+				schedule_absolute(alarm, (deadline + slack - 1) & ~(slack - 1));
+			}
+
 			/**
 			 * Called from the 'msleep' function executed by the server activation
 			 */
 			void schedule_timeout(Genode::Alarm *alarm, Genode::Alarm::Time timeout)
 			{
-				Genode::Alarm::Time now = _platform_timer->curr_time();
-				schedule_absolute(alarm, now + timeout);
-
-				/* interrupt current 'wait_for_timeout' */
-				_platform_timer->schedule_timeout(0);
+				schedule_deadline(alarm, curr_time() + timeout, timeout);
+				wake_up();
 			}
 	};
 
@@ -135,6 +346,8 @@ namespace Timer {
 			Session_capability      _session_cap;
 			Genode::Cancelable_lock _barrier;
 			Wake_up_alarm           _wake_up_alarm;
+			Signal_alarm            _signal_alarm;
+			Genode::uint64_t const  _initial_time;
 
 		public:
 
@@ -148,8 +361,11 @@ namespace Timer {
 				_entrypoint(cap, STACK_SIZE, "timer_session_ep"),
 				_session_cap(_entrypoint.manage(this)),
 				_barrier(Genode::Cancelable_lock::LOCKED),
-				_wake_up_alarm(&_barrier)
-			{ }
+				_wake_up_alarm(&_barrier),
+				_initial_time(ts->curr_time_64())
+			{
+				_timeout_scheduler->register_signal_alarm(&_signal_alarm);
+			}
 
 			/**
 			 * Destructor
@@ -157,7 +373,8 @@ namespace Timer {
 			~Session_component()
 			{
 				_entrypoint.dissolve(this);
-				_timeout_scheduler->discard(&_wake_up_alarm);
+				_timeout_scheduler->discard_synchronized(&_wake_up_alarm);
+				_timeout_scheduler->unregister_signal_alarm(&_signal_alarm);
 			}
 
 			/**
@@ -189,6 +406,26 @@ namespace Timer {
 				 */
 				_barrier.lock();
 			}
+
+			void trigger_once(unsigned us)
+			{
+				_signal_alarm.request(_timeout_scheduler->curr_time(), us, 0, true);
+				_timeout_scheduler->wake_up();
+			}
+
+			void trigger_periodic(unsigned us)
+			{
+				_signal_alarm.request(_timeout_scheduler->curr_time(), us, us, us);
+				_timeout_scheduler->wake_up();
+			}
+
+			void sigh(Genode::Signal_context_capability sigh) {
+				_signal_alarm.sigh(sigh); }
+
+			Genode::uint64_t elapsed_us() const {
+				return _timeout_scheduler->curr_time_64() - _initial_time; }
+
+			unsigned long elapsed_ms() const { return elapsed_us() / 1000; }
 	};
 }
 
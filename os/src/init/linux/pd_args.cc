@@ -5,7 +5,7 @@
  */
 
 /*
- * Copyright (C) 2012 Genode Labs GmbH
+ * Copyright (C) 2012-2013 Genode Labs GmbH
  *
  * This file is part of the Genode OS framework, which is distributed
  * under the terms of the GNU General Public License version 2.
@@ -43,11 +43,23 @@ static unsigned id_value(char const *attr, Genode::Xml_node node)
 }
 
 
+/**
+ * Read boolean attribute from XML node
+ */
+static bool bool_value(char const *attr, Genode::Xml_node node)
+{
+	try { return node.attribute(attr).has_value("yes"); }
+	catch (Genode::Xml_node::Nonexistent_attribute) { }
+	return false;
+}
+
+
 Init::Child::Pd_args::Pd_args(Genode::Xml_node start_node)
 :
 	Genode::Native_pd_args(Root(start_node).path,
 	                       id_value("uid", start_node),
-	                       id_value("gid", start_node))
+	                       id_value("gid", start_node),
+	                       bool_value("ipc_fast_path", start_node))
 { }
 
 
@@ -95,5 +107,11 @@ void Init::Child_policy_pd_args::filter_session_args(char const    *session,
 
 	if (_pd_args->gid())
 		Arg_string::set_arg(args, args_len, "gid", _pd_args->gid());
+
+	/*
+	 * Let the PD sessions of the child use the IPC fast path, too
+	 */
+	if (_pd_args->ipc_fast_path())
+		Arg_string::set_arg(args, args_len, "ipc_fast_path", "yes");
 }
 
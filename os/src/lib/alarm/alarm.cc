@@ -5,7 +5,7 @@
  */
 
 /*
- * Copyright (C) 2005-2012 Genode Labs GmbH
+ * Copyright (C) 2005-2013 Genode Labs GmbH
  *
  * This file is part of the Genode OS framework, which is distributed
  * under the terms of the GNU General Public License version 2.
@@ -17,65 +17,89 @@
 using namespace Genode;
 
 
-void Alarm_scheduler::_unsynchronized_enqueue(Alarm *alarm)
+Alarm *Alarm_scheduler::_meld(Alarm *a, Alarm *b)
 {
-	/* do not enqueue twice */
-	if (alarm->_active)
-		return;
+	if (!a) return b;
+	if (!b) return a;
 
-	alarm->_active++;
+	if (_earlier(b, a)) {
+		Alarm *t = a;
+		a = b;
+		b = t;
+	}
 
-	/* if alarmlist is empty add first element */
-	if (!_head) {
-		alarm->_next = 0;
-		_head = alarm;
-		return;
+	/* make 'b' the leftmost child of 'a' */
+	b->_prev = a;
+	b->_next = a->_child;
+	if (a->_child)
+		a->_child->_prev = b;
+	a->_child = b;
+	return a;
+}
+
+
+Alarm *Alarm_scheduler::_meld_siblings(Alarm *first)
+{
+	/* meld pairs from left to right, collect them in reverse order */
+	Alarm *pairs = 0;
+	while (first) {
+		Alarm *a = first;
+		Alarm *b = a->_next;
+		first = b ? b->_next : 0;
+
+		a->_next = a->_prev = 0;
+		if (b) b->_next = b->_prev = 0;
+
+		Alarm *pair = _meld(a, b);
+		pair->_next = pairs;
+		pairs       = pair;
 	}
 
-	/* if deadline is smaller than any other deadline, put it on the head */
-	if ((int)alarm->_deadline - (int)_now < (int)_head->_deadline - (int)_now) {
-		alarm->_next = _head;
-		_head = alarm;
-		return;
+	/* meld the pairs from right to left */
+	Alarm *root = 0;
+	while (pairs) {
+		Alarm *pair = pairs;
+		pairs       = pair->_next;
+		pair->_next = 0;
+		root        = _meld(root, pair);
 	}
+	return root;
+}
 
-	/* find list element with a higher deadline */
-	Alarm *curr = _head;
-	while (curr->_next &&
-	       (int)curr->_next->_deadline - (int)_now < (int)alarm->_deadline - (int)_now)
-		curr = curr->_next;
 
-	/* if end of list is reached, append new element */
-	if (curr->_next == 0) {
-		curr->_next = alarm;
+void Alarm_scheduler::_unsynchronized_enqueue(Alarm *alarm)
+{
+	/* do not enqueue twice */
+	if (alarm->_active)
 		return;
-	}
 
-	/* insert element in middle of list */
-	alarm->_next = curr->_next;
-	curr->_next  = alarm;
+	alarm->_active++;
+	alarm->_unlink();
+	_head = _meld(_head, alarm);
 }
 
 
 void Alarm_scheduler::_unsynchronized_dequeue(Alarm *alarm)
 {
-	if (!_head) return;
+	/* alarm is not enqueued in the heap of this scheduler */
+	if (!alarm->_active || alarm->_scheduler != this) return;
 
-	if (_head == alarm) {
-		_head = alarm->_next;
-		alarm->_reset();
-		return;
-	}
+	if (alarm == _head)
+		_head = _meld_siblings(alarm->_child);
+	else {
 
-	/* find predecessor in alarm queue */
-	Alarm *curr;
-	for (curr = _head; curr && (curr->_next != alarm); curr = curr->_next);
+		/* cut subtree of alarm from its parent or left sibling */
+		if (alarm->_prev->_child == alarm)
+			alarm->_prev->_child = alarm->_next;
+		else
+			alarm->_prev->_next = alarm->_next;
 
-	/* alarm is not enqueued */
-	if (!curr) return;
+		if (alarm->_next)
+			alarm->_next->_prev = alarm->_prev;
 
-	/* remove alarm from alarm queue */
-	curr->_next = alarm->_next;
+		/* re-insert the children of the alarm */
+		_head = _meld(_head, _meld_siblings(alarm->_child));
+	}
 	alarm->_reset();
 }
 
@@ -87,9 +111,9 @@ Alarm *Alarm_scheduler::_get_pending_alarm()
 	if (!_head || ((int)_head->_deadline - (int)_now >= 0))
 		return 0;
 
-	/* remove alarm from head of the list */
+	/* remove alarm from the root of the heap */
 	Alarm *pending_alarm = _head;
-	_head = _head->_next;
+	_head = _meld_siblings(_head->_child);
 
 	/*
 	 * Acquire dispatch lock to defer destruction until the call of 'on_alarm'
@@ -98,7 +122,7 @@ Alarm *Alarm_scheduler::_get_pending_alarm()
 	pending_alarm->_dispatch_lock.lock();
 
 	/* reset alarm object */
-	pending_alarm->_next = 0;
+	pending_alarm->_unlink();
 	pending_alarm->_active--;
 
 	return pending_alarm;
@@ -134,10 +158,29 @@ void Alarm_scheduler::handle(Alarm::Time curr_time)
 }
 
 
+bool Alarm_scheduler::_unsynchronized_unschedule(Alarm *alarm)
+{
+	/*
+	 * The heap position of an active alarm depends on its deadline, so
+	 * the alarm must leave the heap before its deadline changes.
+	 */
+	_unsynchronized_dequeue(alarm);
+
+	if (alarm->_active) {
+		PERR("alarm is scheduled by another scheduler");
+		return false;
+	}
+	return true;
+}
+
+
 void Alarm_scheduler::schedule_absolute(Alarm *alarm, Alarm::Time timeout)
 {
 	Lock::Guard alarm_list_lock_guard(_lock);
 
+	if (!_unsynchronized_unschedule(alarm))
+		return;
+
 	alarm->_assign(0, timeout, this);
 	_unsynchronized_enqueue(alarm);
 }
@@ -147,6 +190,9 @@ void Alarm_scheduler::schedule(Alarm *alarm, Alarm::Time period)
 {
 	Lock::Guard alarm_list_lock_guard(_lock);
 
+	if (!_unsynchronized_unschedule(alarm))
+		return;
+
 	/* first deadline is overdue */
 	alarm->_assign(period, _now, this);
 	_unsynchronized_enqueue(alarm);
@@ -190,16 +236,9 @@ Alarm_scheduler::~Alarm_scheduler()
 {
 	Lock::Guard lock_guard(_lock);
 
-	while (_head) {
-
-		Alarm *next = _head->_next;
-
-		/* reset alarm object */
-		_head->_reset();
-
-		/* remove from list */
-		_head = next;
-	}
+	/* reset all alarms */
+	while (_head)
+		_unsynchronized_dequeue(_head);
 }
 
 
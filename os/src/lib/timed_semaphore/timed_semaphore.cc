@@ -17,11 +17,11 @@
 void Genode::Timeout_thread::entry()
 {
 	while (true) {
-		_timer.msleep(GRANULARITY_MSECS);
-		_jiffies += GRANULARITY_MSECS;
+		_receiver.wait_for_signal();
+		_wakeups++;
 
-		/* handle timouts of this point in time */
-		Genode::Alarm_scheduler::handle(_jiffies);
+		/* handle timeouts of this point in time and program the next one */
+		_multiplexer.handle();
 	}
 }
 
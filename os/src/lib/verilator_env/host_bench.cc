@@ -0,0 +1,59 @@
+/*
+ * \brief   Host benchmark that clocks a verilated design
+ * \author  Martin Stein
+ * \date    2013-01-28
+ *
+ * This program gets compiled for the build host by the profile-driven
+ * build mode of 'import-verilator_env.mk'. It evaluates a given number
+ * of clock cycles of the design and prints the consumed microseconds to
+ * stdout. The design and its clock input are selected through the
+ * macros 'EMU_TOP', 'EMU_HEADER', and 'EMU_CLK'.
+ */
+
+/*
+ * Copyright (C) 2013 Genode Labs GmbH
+ *
+ * This file is part of the Genode OS framework, which is distributed
+ * under the terms of the GNU General Public License version 2.
+ */
+
+/* libc includes */
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/time.h>
+
+/* Verilator includes */
+#include "verilated.h"
+#include EMU_HEADER
+
+double sc_time_stamp() { return 0; }
+
+
+static unsigned long long now_us()
+{
+	timeval t;
+	gettimeofday(&t, 0);
+	return (unsigned long long)t.tv_sec * 1000 * 1000 + t.tv_usec;
+}
+
+
+int main(int argc, char **argv)
+{
+	unsigned long const cycles = argc > 1 ? strtoul(argv[1], 0, 0) : 1000000;
+	Verilated::commandArgs(argc, argv);
+	static EMU_TOP hdl;
+
+	unsigned long long const start = now_us();
+	for (unsigned long i = 0; i < cycles && !Verilated::gotFinish(); i++) {
+		hdl.EMU_CLK = 0;
+		hdl.eval();
+		hdl.EMU_CLK = 1;
+		hdl.eval();
+	}
+	unsigned long long const time = now_us() - start;
+	hdl.final();
+
+	fprintf(stderr, "%s: %lu cycles in %llu us\n", argv[0], cycles, time);
+	printf("%llu\n", time);
+	return 0;
+}
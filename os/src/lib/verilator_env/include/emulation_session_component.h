@@ -43,6 +43,10 @@ namespace Emulation
 			umword_t read_mmio(addr_t const, Access const);
 
 			bool irq_handler(unsigned const, Signal_context_capability);
+
+			bool fidelity(Fidelity const);
+
+			bool data_window(addr_t const, Dataspace_capability);
 	};
 }
 
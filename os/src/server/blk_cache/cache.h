@@ -0,0 +1,399 @@
+/*
+ * \brief  Block cache shared by all clients of the server
+ * \author Martin Stein
+ * \date   2013-02-13
+ */
+
+/*
+ * Copyright (C) 2013 Genode Labs GmbH
+ *
+ * This file is part of the Genode OS framework, which is distributed
+ * under the terms of the GNU General Public License version 2.
+ */
+
+#ifndef _CACHE_H_
+#define _CACHE_H_
+
+/* Genode includes */
+#include <base/allocator_avl.h>
+#include <base/exception.h>
+#include <base/lock.h>
+#include <block_session/connection.h>
+#include <util/string.h>
+
+namespace Blk_cache {
+
+	using namespace Genode;
+
+	class Io_error : public Exception { };
+
+	/**
+	 * Statistics about the cache accesses of one client
+	 */
+	struct Stats
+	{
+		unsigned long hits;       /* blocks read from the cache */
+		unsigned long misses;     /* blocks read from the device */
+		unsigned long readahead;  /* blocks read ahead from the device */
+		unsigned long writes;     /* blocks written by the client */
+
+		Stats() : hits(0), misses(0), readahead(0), writes(0) { }
+	};
+
+
+	/**
+	 * Block session to the device
+	 */
+	class Backend
+	{
+		private:
+
+			enum { TX_BUF_SIZE = 1024*1024 };
+
+			Allocator_avl              _alloc;
+			Block::Connection          _blk;
+			size_t                     _blk_cnt;
+			size_t                     _blk_size;
+			Block::Session::Operations _ops;
+
+		public:
+
+			enum { MAX_TRANSFER = 128*1024 }; /* bytes per request */
+
+			Backend()
+			: _alloc(env()->heap()), _blk(&_alloc, TX_BUF_SIZE),
+			  _blk_cnt(0), _blk_size(0) { _blk.info(&_blk_cnt, &_blk_size, &_ops); }
+
+			size_t block_count() const { return _blk_cnt; }
+			size_t block_size()  const { return _blk_size; }
+
+			Block::Session::Operations operations() const { return _ops; }
+
+			/**
+			 * Maximum number of blocks per transfer
+			 */
+			size_t max_blocks() const { return max((size_t)1, MAX_TRANSFER / _blk_size); }
+
+			void sync() { _blk.sync(); }
+
+			/**
+			 * Request to the device
+			 *
+			 * The caller must serialize all transfers of a back end.
+			 */
+			class Transfer
+			{
+				private:
+
+					Block::Session::Tx::Source &_source;
+					Block::Packet_descriptor    _p;
+
+				public:
+
+					Transfer(Backend &backend, size_t nr, size_t cnt, bool write)
+					:
+						_source(*backend._blk.tx()),
+						_p(backend._blk.dma_alloc_packet(cnt * backend._blk_size),
+						   write ? Block::Packet_descriptor::WRITE
+						         : Block::Packet_descriptor::READ, nr, cnt)
+					{ }
+
+					~Transfer() { _source.release_packet(_p); }
+
+					char *data() { return _source.packet_content(_p); }
+
+					/**
+					 * \throw Io_error
+					 */
+					void submit()
+					{
+						_source.submit_packet(_p);
+						_p = _source.get_acked_packet();
+						if (!_p.succeeded()) {
+							PERR("could not access blocks %zu-%zu", _p.block_number(),
+							     _p.block_number() + _p.block_count() - 1);
+							throw Io_error();
+						}
+					}
+			};
+	};
+
+
+	/**
+	 * LRU cache of single blocks
+	 */
+	class Cache
+	{
+		private:
+
+			struct Line
+			{
+				size_t  block;
+				char   *data;
+				Line   *prev;      /* neighbour towards most recently used */
+				Line   *next;      /* neighbour towards least recently used */
+				Line   *hash_next; /* next line in the same hash bucket */
+				bool    valid;
+				bool    dirty;
+			};
+
+			Backend       &_backend;
+			size_t const   _blk_size;
+			bool const     _write_back;
+			size_t         _num_lines;
+			size_t         _num_buckets; /* power of two */
+			Line          *_lines;
+			Line         **_buckets;
+			Line          *_mru;
+			Line          *_lru;
+			Lock           _lock;
+			unsigned long  _evictions;
+
+			Line *&_bucket(size_t const block) {
+				return _buckets[block & (_num_buckets - 1)]; }
+
+			Line *_lookup(size_t const block)
+			{
+				for (Line *l = _bucket(block); l; l = l->hash_next)
+					if (l->block == block) return l;
+				return 0;
+			}
+
+			bool _dirty(size_t const block)
+			{
+				Line const * const l = _lookup(block);
+				return l && l->dirty;
+			}
+
+			void _unlink(Line &l)
+			{
+				if (l.prev) l.prev->next = l.next; else _mru = l.next;
+				if (l.next) l.next->prev = l.prev; else _lru = l.prev;
+				l.prev = l.next = 0;
+			}
+
+			void _push_mru(Line &l)
+			{
+				l.next = _mru;
+				if (_mru) _mru->prev = &l; else _lru = &l;
+				_mru = &l;
+			}
+
+			/**
+			 * Mark line as most recently used
+			 */
+			void _touch(Line &l)
+			{
+				_unlink(l);
+				_push_mru(l);
+			}
+
+			void _unhash(Line &l)
+			{
+				for (Line **p = &_bucket(l.block); *p; p = &(*p)->hash_next)
+					if (*p == &l) { *p = l.hash_next; break; }
+				l.valid = false;
+			}
+
+			/**
+			 * Write dirty run of blocks that starts at 'block' to the device
+			 *
+			 * \return  number of blocks written
+			 */
+			size_t _write_run(size_t const block)
+			{
+				size_t cnt = 0;
+				while (cnt < _backend.max_blocks() && _dirty(block + cnt)) cnt++;
+
+				Backend::Transfer t(_backend, block, cnt, true);
+				for (size_t i = 0; i < cnt; i++)
+					memcpy(t.data() + i * _blk_size, _lookup(block + i)->data, _blk_size);
+				t.submit();
+
+				/* the blocks stay dirty if the device failed to write them */
+				for (size_t i = 0; i < cnt; i++)
+					_lookup(block + i)->dirty = false;
+				return cnt;
+			}
+
+			/**
+			 * Return line for 'block' that isn't cached yet
+			 *
+			 * The least recently used line gets evicted and, if dirty,
+			 * written back together with its dirty successors.
+			 */
+			Line &_insert(size_t const block)
+			{
+				Line &l = *_lru;
+				if (l.valid) {
+					if (l.dirty) _write_run(l.block);
+					_unhash(l);
+					_evictions++;
+				}
+				l.block     = block;
+				l.valid     = true;
+				l.dirty     = false;
+				l.hash_next = _bucket(block);
+				_bucket(block) = &l;
+				_touch(l);
+				return l;
+			}
+
+			/**
+			 * Read 'cnt' uncached blocks from the device into the cache
+			 *
+			 * The first 'dst_cnt' blocks also get copied to 'dst'.
+			 */
+			void _fill(size_t const nr, size_t const cnt,
+			           char *dst, size_t const dst_cnt)
+			{
+				Backend::Transfer t(_backend, nr, cnt, false);
+				t.submit();
+				for (size_t i = 0; i < cnt; i++) {
+					char const * const src = t.data() + i * _blk_size;
+					memcpy(_insert(nr + i).data, src, _blk_size);
+					if (i < dst_cnt)
+						memcpy(dst + i * _blk_size, src, _blk_size);
+				}
+			}
+
+			/**
+			 * Number of uncached blocks starting at 'nr', at most 'max'
+			 */
+			size_t _uncached(size_t const nr, size_t max)
+			{
+				max = min(max, _backend.block_count() - nr);
+				size_t cnt = 0;
+				while (cnt < max && !_lookup(nr + cnt)) cnt++;
+				return cnt;
+			}
+
+		public:
+
+			/**
+			 * Constructor
+			 *
+			 * \param data        backing store of the cache
+			 * \param size        size of the backing store in bytes
+			 * \param write_back  keep written blocks until they get flushed
+			 *                    or evicted instead of writing them through
+			 */
+			Cache(Backend &backend, char *data, size_t size, bool write_back)
+			:
+				_backend(backend), _blk_size(backend.block_size()),
+				_write_back(write_back),
+				_num_lines(max((size_t)1, size / _blk_size)), _num_buckets(1),
+				_mru(0), _lru(0), _evictions(0)
+			{
+				while (_num_buckets < _num_lines) _num_buckets <<= 1;
+
+				_lines   = new (env()->heap()) Line[_num_lines];
+				_buckets = new (env()->heap()) Line *[_num_buckets];
+				memset(_buckets, 0, _num_buckets * sizeof(Line *));
+
+				for (size_t i = 0; i < _num_lines; i++) {
+					Line &l = _lines[i];
+					l.data  = data + i * _blk_size;
+					l.prev  = l.next = l.hash_next = 0;
+					l.valid = l.dirty = false;
+					_push_mru(l);
+				}
+			}
+
+			size_t        lines()      const { return _num_lines; }
+			unsigned long evictions()  const { return _evictions; }
+			bool          write_back() const { return _write_back; }
+
+			/**
+			 * Read blocks
+			 *
+			 * \param readahead  number of blocks to read beyond the request
+			 *                   if they are missing
+			 *
+			 * \throw Io_error
+			 */
+			void read(size_t const nr, size_t const cnt, char *dst,
+			          size_t const readahead, Stats &stats)
+			{
+				Lock::Guard guard(_lock);
+				for (size_t i = 0; i < cnt; ) {
+
+					Line * const l = _lookup(nr + i);
+					if (l) {
+						memcpy(dst + i * _blk_size, l->data, _blk_size);
+						_touch(*l);
+						stats.hits++;
+						i++;
+						continue;
+					}
+					/* read the missing blocks at once, plus the readahead */
+					size_t const miss  = _uncached(nr + i, min(cnt - i, _backend.max_blocks()));
+					size_t const ahead = i + miss < cnt ? 0 :
+						_uncached(nr + cnt, min(readahead, _backend.max_blocks() - miss));
+
+					_fill(nr + i, miss + ahead, dst + i * _blk_size, miss);
+					stats.misses    += miss;
+					stats.readahead += ahead;
+					i += miss;
+				}
+			}
+
+			/**
+			 * Write blocks
+			 *
+			 * \throw Io_error
+			 */
+			void write(size_t const nr, size_t const cnt, char const *src,
+			           Stats &stats)
+			{
+				Lock::Guard guard(_lock);
+				stats.writes += cnt;
+
+				/* write through before the cache holds the new data */
+				for (size_t i = 0; !_write_back && i < cnt; ) {
+					size_t const n = min(cnt - i, _backend.max_blocks());
+					Backend::Transfer t(_backend, nr + i, n, true);
+					memcpy(t.data(), src + i * _blk_size, n * _blk_size);
+					t.submit();
+					i += n;
+				}
+				for (size_t i = 0; i < cnt; i++) {
+					Line *l = _lookup(nr + i);
+					if (!l) l = &_insert(nr + i);
+					else _touch(*l);
+					memcpy(l->data, src + i * _blk_size, _blk_size);
+					l->dirty = _write_back;
+				}
+			}
+
+			/**
+			 * Write all dirty blocks to the device
+			 *
+			 * Adjacent dirty blocks get written with one request.
+			 *
+			 * \return  number of blocks written
+			 * \throw   Io_error
+			 */
+			size_t flush()
+			{
+				Lock::Guard guard(_lock);
+				size_t written = 0;
+				for (size_t i = 0; i < _num_lines; i++) {
+					Line &l = _lines[i];
+					if (!l.valid || !l.dirty) continue;
+
+					/* go back to the start of the dirty run */
+					size_t block = l.block;
+					while (block && _dirty(block - 1)) block--;
+					while (_dirty(block)) {
+						size_t const n = _write_run(block);
+						written += n;
+						block   += n;
+					}
+				}
+				return written;
+			}
+	};
+}
+
+#endif /* _CACHE_H_ */
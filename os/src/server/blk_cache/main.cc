@@ -0,0 +1,319 @@
+/*
+ * \brief  Block server that caches the blocks of another block server
+ * \author Martin Stein
+ * \date   2013-02-13
+ */
+
+/*
+ * Copyright (C) 2013 Genode Labs GmbH
+ *
+ * This file is part of the Genode OS framework, which is distributed
+ * under the terms of the GNU General Public License version 2.
+ */
+
+/* Genode includes */
+#include <base/printf.h>
+#include <base/sleep.h>
+#include <block_session/rpc_object.h>
+#include <cap_session/connection.h>
+#include <os/config.h>
+#include <root/component.h>
+#include <timer_session/connection.h>
+
+/* local includes */
+#include "cache.h"
+
+using namespace Genode;
+
+namespace Blk_cache {
+
+	class Session_component : public Block::Session_rpc_object
+	{
+		private:
+
+			class Tx_thread : public Thread<8192>
+			{
+				private:
+
+					Session_component &_session;
+
+				public:
+
+					Tx_thread(Session_component &session)
+					: Thread<8192>("tx"), _session(session) { }
+
+					void entry()
+					{
+						Session_component::Tx::Sink *tx_sink = _session.tx_sink();
+
+						/* handle requests */
+						while (true) {
+
+							/* blocking get packet from client */
+							Block::Packet_descriptor packet = tx_sink->get_packet();
+							if (_session._stopped)
+								return;
+
+							_session.handle(packet);
+
+							/* acknowledge packet to the client */
+							if (!tx_sink->ready_to_ack())
+								PDBG("need to wait until ready-for-ack");
+							tx_sink->acknowledge_packet(packet);
+						}
+					}
+			};
+
+			Cache        &_cache;
+			Backend      &_backend;
+			size_t const  _max_readahead;
+			char          _label[64];
+			Stats         _stats;
+			size_t        _next_block; /* block following the last read */
+			size_t        _window;     /* current readahead in blocks */
+			bool volatile _stopped;    /* session is about to close */
+			Tx_thread     _tx_thread;
+
+			/**
+			 * Readahead for a read of 'cnt' blocks at 'nr'
+			 *
+			 * The readahead doubles with each read that continues the
+			 * previous one and drops to zero with any other read.
+			 */
+			size_t _readahead(size_t const nr, size_t const cnt)
+			{
+				bool const sequential = nr == _next_block;
+				_next_block = nr + cnt;
+				_window = sequential ? min(max(2 * _window, cnt), _max_readahead) : 0;
+				return _window;
+			}
+
+		public:
+
+			Session_component(Dataspace_capability  tx_ds,
+			                  Rpc_entrypoint       &ep,
+			                  Cache                &cache,
+			                  Backend              &backend,
+			                  size_t                max_readahead,
+			                  char const           *label)
+			:
+				Session_rpc_object(tx_ds, ep),
+				_cache(cache), _backend(backend), _max_readahead(max_readahead),
+				_next_block(0), _window(0), _stopped(false), _tx_thread(*this)
+			{
+				strncpy(_label, label, sizeof(_label));
+				_tx_thread.start();
+			}
+
+			~Session_component()
+			{
+				/*
+				 * Let the tx thread finish its current request. A request
+				 * completes all of its transfers at the back end and
+				 * releases the cache lock, so the other clients are not
+				 * affected by the closing session.
+				 */
+				_stopped = true;
+				tx_sink()->cancel();
+				_tx_thread.join();
+
+				printf("blk_cache: client \"%s\": %lu hits, %lu misses, "
+				       "%lu blocks read ahead, %lu blocks written\n", _label,
+				       _stats.hits, _stats.misses, _stats.readahead,
+				       _stats.writes);
+			}
+
+			/**
+			 * Execute request of the client
+			 */
+			void handle(Block::Packet_descriptor &packet)
+			{
+				packet.succeeded(false);
+
+				size_t const nr  = packet.block_number();
+				size_t const cnt = packet.block_count();
+				if (nr >= _backend.block_count() || cnt > _backend.block_count() - nr ||
+				    packet.size() < cnt * _backend.block_size()) {
+					PWRN("invalid request for blocks %zu-%zu", nr, nr + cnt - 1);
+					return;
+				}
+
+				char * const data = tx_sink()->packet_content(packet);
+				try {
+					switch (packet.operation()) {
+
+					case Block::Packet_descriptor::READ:
+						_cache.read(nr, cnt, data, _readahead(nr, cnt), _stats);
+						break;
+
+					case Block::Packet_descriptor::WRITE:
+						if (!_backend.operations().supported(Block::Packet_descriptor::WRITE))
+							return;
+						_cache.write(nr, cnt, data, _stats);
+						break;
+
+					default:
+						PWRN("received invalid packet");
+						return;
+					}
+					packet.succeeded(true);
+				}
+				catch (Io_error) { }
+			}
+
+			Stats const &stats() const { return _stats; }
+
+
+			/*****************************
+			 ** Block session interface **
+			 *****************************/
+
+			void info(size_t *blk_count, size_t *blk_size, Operations *ops)
+			{
+				*blk_count = _backend.block_count();
+				*blk_size  = _backend.block_size();
+				*ops       = _backend.operations();
+			}
+
+			void sync()
+			{
+				try {
+					_cache.flush();
+					_backend.sync();
+				} catch (Io_error) { PERR("failed to flush the cache"); }
+			}
+	};
+
+
+	/**
+	 * Root component, handling new session requests
+	 */
+	class Root : public Root_component<Session_component>
+	{
+		private:
+
+			Rpc_entrypoint &_ep;
+			Cache          &_cache;
+			Backend        &_backend;
+			size_t const    _max_readahead;
+
+		protected:
+
+			Session_component *_create_session(const char *args)
+			{
+				size_t ram_quota =
+					Arg_string::find_arg(args, "ram_quota"  ).ulong_value(0);
+				size_t tx_buf_size =
+					Arg_string::find_arg(args, "tx_buf_size").ulong_value(0);
+
+				/* delete ram quota by the memory needed for the session */
+				size_t session_size = max((size_t)4096,
+				                          sizeof(Session_component)
+				                          + sizeof(Allocator_avl));
+				if (ram_quota < session_size)
+					throw Root::Quota_exceeded();
+
+				/*
+				 * Check if donated ram quota suffices for both
+				 * communication buffers. Also check both sizes separately
+				 * to handle a possible overflow of the sum of both sizes.
+				 */
+				if (tx_buf_size > ram_quota - session_size) {
+					PERR("insufficient 'ram_quota', got %zd, need %zd",
+					     ram_quota, tx_buf_size + session_size);
+					throw Root::Quota_exceeded();
+				}
+
+				char label[64];
+				Arg_string::find_arg(args, "label").string(label, sizeof(label),
+				                                           "<unlabeled>");
+
+				return new (md_alloc())
+					Session_component(env()->ram_session()->alloc(tx_buf_size),
+					                  _ep, _cache, _backend, _max_readahead,
+					                  label);
+			}
+
+		public:
+
+			Root(Rpc_entrypoint *session_ep, Allocator *md_alloc,
+			     Cache &cache, Backend &backend, size_t max_readahead)
+			:
+				Root_component<Session_component>(session_ep, md_alloc),
+				_ep(*session_ep), _cache(cache), _backend(backend),
+				_max_readahead(max_readahead)
+			{ }
+	};
+
+
+	/**
+	 * Thread that periodically writes back the dirty blocks
+	 */
+	class Flusher : public Thread<8192>
+	{
+		private:
+
+			Timer::Connection _timer;
+			Cache            &_cache;
+			unsigned const    _interval_ms;
+
+		public:
+
+			Flusher(Cache &cache, unsigned interval_ms)
+			:
+				Thread<8192>("flusher"),
+				_cache(cache), _interval_ms(interval_ms)
+			{ start(); }
+
+			void entry()
+			{
+				while (true) {
+					_timer.msleep(_interval_ms);
+					try { _cache.flush(); }
+					catch (Io_error) { PERR("failed to flush the cache"); }
+				}
+			}
+	};
+}
+
+
+int main(int, char **)
+{
+	using namespace Blk_cache;
+
+	Number_of_bytes cache_size        = 1024*1024;
+	size_t          readahead         = 32;
+	bool            write_back        = false;
+	unsigned        flush_interval_ms = 1000;
+
+	try { config()->xml_node().attribute("cache_size").value(&cache_size); } catch (...) { }
+	try { config()->xml_node().attribute("readahead").value(&readahead); } catch (...) { }
+	try { write_back = config()->xml_node().attribute("write_back").has_value("yes"); } catch (...) { }
+	try { config()->xml_node().attribute("flush_interval_ms").value(&flush_interval_ms); } catch (...) { }
+
+	static Backend backend;
+
+	/* blocks per request are limited by the packet size at the back end */
+	readahead = min(readahead, backend.max_blocks());
+
+	Ram_dataspace_capability const cache_ds = env()->ram_session()->alloc(cache_size);
+	static Cache cache(backend, env()->rm_session()->attach(cache_ds),
+	                   cache_size, write_back);
+
+	printf("--- block cache: %zu blocks of %zu bytes, %zu lines, readahead %zu, "
+	       "%s ---\n", backend.block_count(), backend.block_size(), cache.lines(),
+	       readahead, write_back ? "write-back" : "write-through");
+
+	if (write_back && flush_interval_ms)
+		new (env()->heap()) Flusher(cache, flush_interval_ms);
+
+	enum { STACK_SIZE = 8192 };
+	static Cap_connection cap;
+	static Rpc_entrypoint ep(&cap, STACK_SIZE, "blk_cache_ep");
+	static Blk_cache::Root block_root(&ep, env()->heap(), cache, backend,
+	                                  readahead);
+
+	env()->parent()->announce(ep.manage(&block_root));
+	sleep_forever();
+	return 0;
+}
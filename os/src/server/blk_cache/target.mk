@@ -0,0 +1,3 @@
+TARGET = blk_cache
+LIBS   = env cxx server signal
+SRC_CC = main.cc
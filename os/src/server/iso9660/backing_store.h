@@ -5,7 +5,7 @@
  */
 
 /*
- * Copyright (C) 2010-2012 Genode Labs GmbH
+ * Copyright (C) 2010-2013 Genode Labs GmbH
  *
  * This file is part of the Genode OS framework, which is distributed
  * under the terms of the GNU General Public License version 2.
@@ -208,6 +208,11 @@ class Backing_store
 		 */
 		Genode::Dataspace_capability dataspace() const { return _ds; }
 
+		/**
+		 * Return number of blocks of the backing store
+		 */
+		Genode::size_t num_blocks() const { return _num_blocks; }
+
 		/**
 		 * Return block size used by the backing store
 		 */
@@ -218,6 +223,11 @@ class Backing_store
 		 */
 		Genode::off_t index(const Block *b) const { return b - _blocks; }
 
+		/**
+		 * Return block with specified index
+		 */
+		Block *block(unsigned long index) const { return &_blocks[index]; }
+
 		/**
 		 * Return offset of block within physical backing store
 		 */
@@ -242,6 +252,15 @@ class Backing_store
 			block->assign_user(user, user_meta_data);
 		}
 
+		/**
+		 * Release block that was allocated but not assigned to a user
+		 */
+		void free(Block *block)
+		{
+			Genode::Lock::Guard guard(_alloc_lock);
+			block->assign_pseudo_user(0);
+		}
+
 		/**
 		 * Evict all blocks currently in use by the specified user
 		 */
@@ -5,7 +5,7 @@
  */
 
 /*
- * Copyright (C) 2010-2012 Genode Labs GmbH
+ * Copyright (C) 2010-2013 Genode Labs GmbH
  *
  * This file is part of the Genode OS framework, which is distributed
  * under the terms of the GNU General Public License version 2.
@@ -17,25 +17,40 @@
 #include <base/printf.h>
 #include <base/stdint.h>
 #include <block_session/connection.h>
+#include <util/avl_string.h>
 #include <util/misc_math.h>
 #include <util/token.h>
 
 #include "iso9660.h"
+#include "backing_store.h"
 
 using namespace Genode;
 
 namespace Iso {
 
-	/*
-	 *  Sector reads one or more packets from the block interface
+	/**
+	 * Read of consecutive sectors into one buffer
 	 */
-	class Sector {
+	struct Read_request
+	{
+		unsigned long  blk_nr;
+		unsigned long  count;
+		void          *buf;
+	};
+
 
+	/**
+	 * Access to the block device
+	 */
+	class Device
+	{
 		public:
 
 			enum {
-				MAX_SECTORS = 32, /* max. number sectors that can be read in one
-				                     transaction */
+				MAX_SECTORS   = 32, /* max. number sectors that can be read in one
+				                       transaction */
+				MAX_IN_FLIGHT = 8,  /* max. number of outstanding transactions */
+				TX_BUF_SIZE   = MAX_IN_FLIGHT * MAX_SECTORS * 2048,
 			};
 
 			static Block::Connection          *_blk;
@@ -43,52 +58,241 @@ namespace Iso {
 			static size_t                      _blk_size;
 			static Lock                        _lock;
 
+			static size_t blk_size() { return 2048; }
+
+			static unsigned long to_blk(unsigned long bytes) {
+				return ((bytes + blk_size() - 1) & ~(blk_size() - 1)) / blk_size(); }
+
+			/**
+			 * Read sector ranges
+			 *
+			 * The ranges get split into transactions of at most
+			 * 'MAX_SECTORS' that are submitted back to back, so the
+			 * device always has the next transaction at hand.
+			 *
+			 * \throw Io_error
+			 */
+			static void read(Read_request const *requests, unsigned num)
+			{
+				Lock::Guard lock_guard(_lock);
+
+				struct Slot
+				{
+					Block::Packet_descriptor p;
+					char                    *dst;
+					bool                     used;
+				} slots[MAX_IN_FLIGHT];
+				for (unsigned i = 0; i < MAX_IN_FLIGHT; i++) slots[i].used = false;
+
+				size_t   const factor    = blk_size() / _blk_size;
+				unsigned       r         = 0; /* current request */
+				unsigned long  done      = 0; /* sectors submitted of request 'r' */
+				unsigned       in_flight = 0;
+				bool           error     = false;
+
+				while (true) {
+
+					/* submit as many transactions as possible */
+					while (!error && in_flight < MAX_IN_FLIGHT) {
+
+						while (r < num && done == requests[r].count) { r++; done = 0; }
+						if (r == num) break;
+
+						Read_request const &rq = requests[r];
+						unsigned long const cnt =
+							min<unsigned long>(MAX_SECTORS, rq.count - done);
+
+						Block::Packet_descriptor p;
+						try {
+							p = Block::Packet_descriptor(
+								_blk->dma_alloc_packet(blk_size() * cnt),
+								Block::Packet_descriptor::READ,
+								(rq.blk_nr + done) * factor, cnt * factor);
+						} catch (Block::Session::Tx::Source::Packet_alloc_failed) {
+							if (in_flight) break;
+							PERR("Packet overrun!");
+							throw Io_error();
+						}
+
+						Slot *slot = slots;
+						while (slot->used) slot++;
+						slot->p    = p;
+						slot->dst  = (char *)rq.buf + done * blk_size();
+						slot->used = true;
+
+						_source->submit_packet(p);
+						in_flight++;
+						done += cnt;
+					}
+					if (!in_flight) break;
+
+					/* transactions may get completed in any order */
+					Block::Packet_descriptor const p = _source->get_acked_packet();
+					Slot *slot = slots;
+					while (slot < slots + MAX_IN_FLIGHT &&
+					       !(slot->used && slot->p.offset() == p.offset()))
+						slot++;
+					if (slot == slots + MAX_IN_FLIGHT) {
+						PERR("unexpected acknowledgement");
+						continue;
+					}
+
+					if (!p.succeeded()) {
+						PERR("Could not read block %zu", p.block_number() / factor);
+						error = true;
+					} else
+						memcpy(slot->dst, _source->packet_content(p),
+						       p.block_count() / factor * blk_size());
+
+					_source->release_packet(p);
+					slot->used = false;
+					in_flight--;
+				}
+				if (error) throw Io_error();
+			}
+	};
+
+
+	/**
+	 * Cache of single sectors, used for descriptors and directories
+	 *
+	 * The cache is built upon a backing store with sector-sized blocks
+	 * that get replaced in FIFO order. The sectors get looked up via a
+	 * hash table. The cache lock is held while the backing store evicts
+	 * blocks, so 'detach_block' doesn't take it.
+	 */
+	class Sector_cache : public ::Backing_store<unsigned long>::User
+	{
 		private:
 
-			Block::Packet_descriptor _p;
+			typedef ::Backing_store<unsigned long> Store;
+
+			enum {
+				SIZE    = 512*1024,
+				BUCKETS = 128,
+				NONE    = ~0UL,
+			};
+
+			Store          _store;
+			unsigned long *_sector;  /* sector of each block */
+			unsigned long *_next;    /* next block of the same bucket */
+			unsigned long  _buckets[BUCKETS];
+			Lock           _lock;
+			unsigned long  _hits;
+			unsigned long  _misses;
+
+			unsigned long &_bucket(unsigned long sector) {
+				return _buckets[sector % BUCKETS]; }
+
+			unsigned long _lookup(unsigned long sector)
+			{
+				unsigned long i = _bucket(sector);
+				for (; i != NONE && _sector[i] != sector; i = _next[i]);
+				return i;
+			}
 
 		public:
 
-			Sector(unsigned long blk_nr, unsigned long count)
+			Sector_cache() : _store(SIZE, Device::blk_size()), _hits(0), _misses(0)
 			{
-				Lock::Guard lock_guard(_lock);
+				_sector = new (env()->heap()) unsigned long[_store.num_blocks()];
+				_next   = new (env()->heap()) unsigned long[_store.num_blocks()];
+				for (unsigned i = 0; i < BUCKETS; i++) _buckets[i] = NONE;
+			}
 
-				try {
-					_p = Block::Packet_descriptor(
-						_blk->dma_alloc_packet(blk_size() * count),
-						Block::Packet_descriptor::READ,
-						blk_nr * ((float)blk_size() / _blk_size),
-						count * ((float)blk_size() / _blk_size));
-					_source->submit_packet(_p);
-					_p = _source->get_acked_packet();
-
-					if (!_p.succeeded()) {
-						PERR("Could not read block %lu", blk_nr);
-						throw Io_error();
-					}
+			static Sector_cache *cache()
+			{
+				static Sector_cache _cache;
+				return &_cache;
+			}
 
-				} catch (Block::Session::Tx::Source::Packet_alloc_failed) {
-					PERR("Packet overrun!");
-					_p = _source->get_acked_packet();
-					throw Io_error();
+			/**
+			 * Return sector content, the cache must be locked by the caller
+			 *
+			 * \throw Io_error
+			 */
+			void *sector(unsigned long nr)
+			{
+				unsigned long const i = _lookup(nr);
+				if (i != NONE) {
+					_hits++;
+					return _store.local_addr(_store.block(i));
 				}
+
+				_misses++;
+				Store::Block *block = _store.alloc();
+				void * const  data  = _store.local_addr(block);
+				Read_request  rq    = { nr, 1, data };
+				try { Device::read(&rq, 1); }
+				catch (...) {
+					/* leave the block unused */
+					_store.assign(block, 0, 0);
+					throw;
+				}
+
+				unsigned long const idx = _store.index(block);
+				_sector[idx] = nr;
+				_next[idx]   = _bucket(nr);
+				_bucket(nr)  = idx;
+				_store.assign(block, this, nr);
+				return data;
 			}
 
-			~Sector() { 
-				Lock::Guard lock_guard(_lock);
-				_source->release_packet(_p);
+			Lock &lock() { return _lock; }
+
+
+			/***********************************
+			 ** Backing_store::User interface **
+			 ***********************************/
+
+			void detach_block(unsigned long nr)
+			{
+				unsigned long *i = &_bucket(nr);
+				for (; *i != NONE; i = &_next[*i])
+					if (_sector[*i] == nr) { *i = _next[*i]; return; }
 			}
+	};
+
+
+	/*
+	 *  Sector provides the content of one sector from the sector cache
+	 */
+	class Sector {
+
+		private:
+
+			Sector_cache &_cache;
+			void         *_data;
+
+		public:
+
+			/**
+			 * Constructor
+			 *
+			 * The cache stays locked until the sector gets destructed.
+			 */
+			Sector(unsigned long blk_nr) : _cache(*Sector_cache::cache())
+			{
+				_cache.lock().lock();
+				try { _data = _cache.sector(blk_nr); }
+				catch (...) {
+					_cache.lock().unlock();
+					throw;
+				}
+			}
+
+			~Sector() { _cache.lock().unlock(); }
 
 			/**
-			 * Return address of packet content
+			 * Return address of sector content
 			 */
 			template <typename T>
-			T addr() { return reinterpret_cast<T>(_source->packet_content(_p)); }
+			T addr() { return reinterpret_cast<T>(_data); }
 
-			static size_t blk_size() { return 2048; }
+			static size_t blk_size() { return Device::blk_size(); }
 
 			static unsigned long to_blk(unsigned long bytes) {
-				return ((bytes + blk_size() - 1) & ~(blk_size() - 1)) / blk_size(); }
+				return Device::to_blk(bytes); }
 	};
 
 	/**
@@ -328,7 +532,7 @@ namespace Iso {
 	{
 		/* volume descriptors in ISO9660 start at block 16 */
 		for (unsigned long blk_nr = 16;; blk_nr++) {
-			Sector sec(blk_nr, 1);
+			Sector sec(blk_nr);
 			Volume_descriptor *vol = sec.addr<Volume_descriptor *>();
 
 			if (verbose)
@@ -359,40 +563,121 @@ namespace Iso {
 	}
 
 
-	unsigned long read_file(File_info *info, off_t file_offset, uint32_t length, void *buf_ptr)
+	unsigned long read_file(File_info *info, off_t file_offset,
+	                        uint32_t chunk_size, void **bufs, unsigned num)
 	{
-		uint8_t *buf = (uint8_t *)buf_ptr;
-		if (info->size() <= (size_t)(length + file_offset))
-			length = info->size() - file_offset - 1;
+		enum { MAX_REQUESTS = 16 };
+		Read_request  requests[MAX_REQUESTS];
+		unsigned long ret = 0;
+
+		for (unsigned i = 0; i < num; ) {
+
+			/* submit the reads of up to 'MAX_REQUESTS' chunks at once */
+			unsigned n = 0;
+			for (; n < MAX_REQUESTS && i + n < num; n++) {
+				off_t const  offset = file_offset + (i + n) * chunk_size;
+				size_t const length = (size_t)offset < info->size()
+				                    ? min<size_t>(chunk_size, info->size() - offset)
+				                    : 0;
+
+				requests[n].blk_nr = info->blk_nr() + offset / Sector::blk_size();
+				requests[n].count  = Sector::to_blk(length);
+				requests[n].buf    = bufs[i + n];
+
+				/* zero out the part of the chunk beyond the sectors read */
+				size_t const read = requests[n].count * Sector::blk_size();
+				if (read < chunk_size)
+					memset((char *)bufs[i + n] + read, 0, chunk_size - read);
+
+				ret += read;
+			}
 
-		unsigned long total_blk_count = ((length + (Sector::blk_size() - 1)) &
-		                                 ~((Sector::blk_size()) - 1)) / Sector::blk_size();
-		unsigned long ret = total_blk_count;
-		unsigned long blk_count;
-		unsigned long blk_nr = info->blk_nr() + (file_offset / Sector::blk_size());
+			if (verbose)
+				PDBG("Read %u chunks from blk %lu, file_offset: %08lx",
+				     n, requests[0].blk_nr, file_offset + i * chunk_size);
 
-		if (verbose)
-			PDBG("Read blk %lu count %lu, file_offset: %08lx length %u", blk_nr, total_blk_count, file_offset, length);
+			Device::read(requests, n);
+			i += n;
+		}
+		return ret;
+	}
 
-		while ((blk_count = min<unsigned long>(Sector::MAX_SECTORS, total_blk_count))) {
-			Sector sec(blk_nr, blk_count);
 
-			total_blk_count -= blk_count;
-			blk_nr          += blk_count;
+	/**
+	 * Cache of the directory records that were found for a path
+	 */
+	class Path_cache
+	{
+		private:
 
-			unsigned long copy_length = blk_count * Sector::blk_size();
-			memcpy(buf, sec.addr<void *>(), copy_length);
+			enum { MAX_ENTRIES = 512 };
 
-			length -= copy_length;
-			buf    += copy_length;
+			struct Entry : Avl_string<PATH_LENGTH>
+			{
+				uint32_t const blk_nr;
+				uint32_t const data_length;
+				bool     const directory;
+
+				Entry(char const *path, uint32_t blk_nr, uint32_t data_length,
+				      bool directory)
+				:
+					Avl_string<PATH_LENGTH>(path), blk_nr(blk_nr),
+					data_length(data_length), directory(directory)
+				{ }
+			};
 
-			/* zero out rest of page */
-			if (!total_blk_count && (blk_count % 2))
-				memset(buf, 0, Sector::blk_size());
-		}
-	
-		return ret * Sector::blk_size();
-	}
+			Avl_tree<Avl_string_base> _tree;
+			unsigned                  _num_entries;
+			Lock                      _lock;
+
+		public:
+
+			Path_cache() : _num_entries(0) { }
+
+			static Path_cache *cache()
+			{
+				static Path_cache _cache;
+				return &_cache;
+			}
+
+			/**
+			 * Look up directory record of 'path'
+			 *
+			 * \return  true if the path is cached
+			 */
+			bool lookup(char const *path, uint32_t *blk_nr,
+			            uint32_t *data_length, bool *directory)
+			{
+				Lock::Guard lock_guard(_lock);
+
+				Entry *e = static_cast<Entry *>(_tree.first() ?
+				                                _tree.first()->find_by_name(path) : 0);
+				if (!e) return false;
+
+				*blk_nr      = e->blk_nr;
+				*data_length = e->data_length;
+				*directory   = e->directory;
+				return true;
+			}
+
+			/**
+			 * Remember directory record of 'path'
+			 *
+			 * Once the cache is full, further paths are not cached.
+			 */
+			void insert(char const *path, uint32_t blk_nr,
+			            uint32_t data_length, bool directory)
+			{
+				Lock::Guard lock_guard(_lock);
+
+				if (_num_entries == MAX_ENTRIES) return;
+				if (_tree.first() && _tree.first()->find_by_name(path)) return;
+
+				_tree.insert(new (env()->heap())
+				             Entry(path, blk_nr, data_length, directory));
+				_num_entries++;
+			}
+	};
 
 
 	struct Scanner_policy_file
@@ -412,52 +697,63 @@ namespace Iso {
 	File_info *file_info(char *path)
 	{
 		char level[PATH_LENGTH];
+		char prefix[PATH_LENGTH];
+		size_t prefix_len = 0;
 
 		Token t(path);
-		Directory_record *dir = root_dir();
-		uint32_t blk_nr = 0, data_length = 0;
+
+		/* directory record of the current level */
+		uint32_t blk_nr      = root_dir()->blk_nr();
+		uint32_t data_length = root_dir()->data_length();
+		bool     directory   = true;
 
 		/* determine block nr and file length on disk, parse directory records */
-		while (t) {
+		for (; t; t = t.next()) {
 
-			if (t.type() != Token::IDENT) {
-				t = t.next();
+			if (t.type() != Token::IDENT)
 				continue;
-			}
 
 			t.string(level, PATH_LENGTH);
 
-			/* load extent of directory record and search for level */
-			for (unsigned long i = 0; i < Sector::to_blk(dir->data_length()); i++) {
-				Sector sec(dir->blk_nr() + i, 1);
-				Directory_record *tmp = sec.addr<Directory_record *>()->locate(level);
-
-				if (!tmp && i == Sector::to_blk(dir->data_length()) - 1) {
-					PERR("File not found: %s", path);
-					throw File_not_found();
-				}
-
-				if (!tmp) continue;
+			if (!directory || prefix_len + 1 + strlen(level) >= PATH_LENGTH) {
+				PERR("File not found: %s", path);
+				throw File_not_found();
+			}
 
-				dir = tmp;
+			/* path of the current level, normalized for the path cache */
+			prefix[prefix_len++] = '/';
+			strncpy(prefix + prefix_len, level, PATH_LENGTH - prefix_len);
+			prefix_len += strlen(level);
 
-				if (verbose)
-					PDBG("Found %s", level);
+			if (Path_cache::cache()->lookup(prefix, &blk_nr, &data_length,
+			                                &directory))
+				continue;
 
-				if (!dir->is_directory()) {
-					blk_nr      = dir->blk_nr();
-					data_length = dir->data_length();
-				}
+			/* load extent of directory record and search for level */
+			bool found = false;
+			for (unsigned long i = 0; !found && i < Sector::to_blk(data_length); i++) {
+				Sector sec(blk_nr + i);
+				Directory_record *dir = sec.addr<Directory_record *>()->locate(level);
+				if (!dir) continue;
+
+				blk_nr      = dir->blk_nr();
+				data_length = dir->data_length();
+				directory   = dir->is_directory();
+				found       = true;
+			}
 
-				break;
+			if (!found) {
+				PERR("File not found: %s", path);
+				throw File_not_found();
 			}
 
-			t = t.next();
-		}
+			if (verbose)
+				PDBG("Found %s", level);
 
-		/* Warning: Don't access 'dir' after this point, since the sector is gone */
+			Path_cache::cache()->insert(prefix, blk_nr, data_length, directory);
+		}
 
-		if (!blk_nr && !data_length) {
+		if (directory) {
 			PERR("File not found: %s", path);
 			throw File_not_found();
 		}
@@ -470,12 +766,12 @@ namespace Iso {
 
 
 	/*
-	 * Static members of Sector
+	 * Static members of Device
 	 */
-	Block::Connection *Sector::_blk;
-	Block::Session::Tx::Source *Sector::_source;
-	size_t Sector::_blk_size;
-	Lock Sector::_lock;
+	Block::Connection *Device::_blk;
+	Block::Session::Tx::Source *Device::_source;
+	size_t Device::_blk_size;
+	Lock Device::_lock;
 
 
 	/**
@@ -484,13 +780,13 @@ namespace Iso {
 	void __attribute__((constructor)) init()
 	{
 		static Allocator_avl block_alloc(env()->heap());
-		static Block::Connection _blk(&block_alloc);
+		static Block::Connection _blk(&block_alloc, Device::TX_BUF_SIZE);
 
-		Sector::_blk    = &_blk;
-		Sector::_source  = _blk.tx();
+		Device::_blk    = &_blk;
+		Device::_source = _blk.tx();
 
 		size_t blk_cnt = 0;
 		Block::Session::Operations ops;
-		_blk.info(&blk_cnt, &Sector::_blk_size, &ops);
+		_blk.info(&blk_cnt, &Device::_blk_size, &ops);
 	}
 } /* end of namespace Iso */
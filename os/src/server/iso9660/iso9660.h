@@ -5,7 +5,7 @@
  */
 
 /*
- * Copyright (C) 2010-2012 Genode Labs GmbH
+ * Copyright (C) 2010-2013 Genode Labs GmbH
  *
  * This file is part of the Genode OS framework, which is distributed
  * under the terms of the GNU General Public License version 2.
@@ -65,17 +65,23 @@ namespace Iso {
 	File_info *file_info(char *path);
 
 	/**
-	 * Read data from ISO
+	 * Read consecutive chunks of a file into separate buffers
 	 *
-	 * \param info File    Info of file to read the data from
-	 * \param file_offset  Offset in file
-	 * \param length       Number of bytes to read
-	 * \param buf          Output buffer
+	 * The sectors of all chunks get requested back to back. Each buffer
+	 * is filled with 'chunk_size' bytes, zero-padded beyond the end of
+	 * the file.
+	 *
+	 * \param info         File info of file to read the data from
+	 * \param file_offset  Offset of first chunk in file
+	 * \param chunk_size   Size of each chunk, a multiple of the sector size
+	 * \param bufs         Output buffers, one per chunk
+	 * \param num          Number of chunks
 	 *
 	 * \throw Io_error
 	 *
 	 * \return Number of bytes read
 	 */
 	unsigned long read_file(File_info *info, Genode::off_t file_offset,
-	                        Genode::uint32_t length, void *buf);
+	                        Genode::uint32_t chunk_size, void **bufs,
+	                        unsigned num);
 }
@@ -5,7 +5,7 @@
  */
 
 /*
- * Copyright (C) 2010-2012 Genode Labs GmbH
+ * Copyright (C) 2010-2013 Genode Labs GmbH
  *
  * This file is part of the Genode OS framework, which is distributed
  * under the terms of the GNU General Public License version 2.
@@ -49,10 +49,60 @@ namespace Iso {
 
 		private:
 
+			enum { MAX_READAHEAD = 8 }; /* max. blocks read ahead of a fault */
+
 			File_info                *_info;
 			Rm_connection            *_rm;
 			Signal_receiver          *_receiver;
 			Backing_store            *_backing_store;
+			size_t                    _num_blocks;
+			bool                     *_attached;   /* blocks backed by the store */
+			size_t                    _next_block; /* block following the last read */
+			size_t                    _window;     /* current readahead in blocks */
+
+			/**
+			 * Attach backing-store block at 'file_offset'
+			 */
+			void _attach(Backing_store::Block *block, Genode::off_t file_offset)
+			{
+				bool try_again;
+				do {
+					try_again = false;
+					try {
+						_rm->attach_at(_backing_store->dataspace(), file_offset,
+						               _backing_store->block_size(),
+						               _backing_store->offset(block)); }
+
+					catch (Genode::Rm_session::Region_conflict) {
+						PERR("Region conflict - this should not happen"); }
+
+					catch (Genode::Rm_session::Out_of_metadata) {
+
+						/* give up if the error occurred a second time */
+						if (try_again)
+							break;
+
+						PINF("upgrade quota donation for RM session");
+						Genode::env()->parent()->upgrade(_rm->cap(), "ram_quota=32K");
+						try_again = true;
+					}
+				} while (try_again);
+			}
+
+			/**
+			 * Readahead for a fault at block 'nr'
+			 *
+			 * The readahead doubles with each fault at the block that
+			 * follows the previous read and drops to zero with any other
+			 * fault.
+			 */
+			size_t _readahead(size_t nr)
+			{
+				bool const sequential = nr == _next_block;
+				_window = sequential ? min(max(2 * _window, (size_t)1),
+				                           (size_t)MAX_READAHEAD) : 0;
+				return _window;
+			}
 
 		public:
 
@@ -60,11 +110,17 @@ namespace Iso {
 			: File_base(path),
 				_info(Iso::file_info(path)),
 				_receiver(receiver),
-				_backing_store(backing_store)
+				_backing_store(backing_store),
+				_next_block(0), _window(0)
 			{
 				size_t rm_size = align_addr(_info->page_sized(),
 				                            log2(_backing_store->block_size()));
-				
+
+				_num_blocks = rm_size / _backing_store->block_size();
+				if (!env()->heap()->alloc(_num_blocks * sizeof(bool), &_attached))
+					throw Root::Quota_exceeded();
+				memset(_attached, 0, _num_blocks * sizeof(bool));
+
 				_rm = new(env()->heap()) Rm_connection(0, rm_size);
 				_rm->fault_handler(receiver->manage(this));
 			}
@@ -75,6 +131,7 @@ namespace Iso {
 				_backing_store->flush(this);
 				destroy(env()->heap(), _rm);
 				destroy(env()->heap(), _info);
+				env()->heap()->free(_attached, _num_blocks * sizeof(bool));
 			}
 
 			Rm_connection *rm() { return _rm; }
@@ -93,56 +150,68 @@ namespace Iso {
 				if (state.type == Rm_session::READY)
 					return;
 
-				Backing_store::Block *block = _backing_store->alloc();
-
 				/*
 				 * Calculate backing-store-block-aligned file offset from
 				 * page-fault address.
 				 */
-				Genode::off_t file_offset = state.addr;
-				file_offset &= ~(_backing_store->block_size() - 1);
+				size_t const block_size = _backing_store->block_size();
+				size_t const nr         = state.addr / block_size;
+				if (nr >= _num_blocks) {
+					PERR("fault at 0x%lx beyond end of file", state.addr);
+					return;
+				}
 
-				/* re-initialize block content */
-				Genode::memset(_backing_store->local_addr(block), 0,
-				               _backing_store->block_size());
+				/*
+				 * Read the faulting block together with the readahead of
+				 * the consecutive blocks that are not attached yet.
+				 */
+				size_t cnt = 1;
+				for (size_t const max = 1 + _readahead(nr);
+				     cnt < max && nr + cnt < _num_blocks && !_attached[nr + cnt]; cnt++);
+
+				Backing_store::Block *blocks[1 + MAX_READAHEAD];
+				void                 *bufs[1 + MAX_READAHEAD];
+				for (size_t i = 0; i < cnt; i++) {
+					blocks[i] = _backing_store->alloc();
+					bufs[i]   = _backing_store->local_addr(blocks[i]);
+				}
 
-				/* read file content to block */
-				unsigned long bytes = Iso::read_file(_info, file_offset,
-				                                     _backing_store->block_size(),
-				                                     _backing_store->local_addr(block));
+				/* read file content to blocks */
+				Genode::off_t const file_offset = nr * block_size;
+				unsigned long bytes = 0;
+				try {
+					bytes = Iso::read_file(_info, file_offset, block_size, bufs, cnt);
+				} catch (Io_error) {
+
+					/*
+					 * Don't hand out blocks that lack the file content. The
+					 * fault stays unresolved, so the client does not
+					 * proceed with wrong data.
+					 */
+					PERR("could not read file at offset 0x%lx, fault at 0x%lx "
+					     "stays unresolved", file_offset, state.addr);
+					for (size_t i = 0; i < cnt; i++)
+						_backing_store->free(blocks[i]);
+					_window = 0;
+					return;
+				}
 
 				if (verbose)
-					PDBG("[%ld] ATTACH: rm=%p, a=%08lx s=%lx",
-					     _backing_store->index(block), _rm, file_offset, bytes);
-
-				bool try_again;
-				do {
-					try_again = false;
-					try {
-						_rm->attach_at(_backing_store->dataspace(), file_offset,
-						               _backing_store->block_size(),
-						               _backing_store->offset(block)); }
-
-					catch (Genode::Rm_session::Region_conflict) {
-						PERR("Region conflict - this should not happen"); }
-
-					catch (Genode::Rm_session::Out_of_metadata) {
-
-						/* give up if the error occurred a second time */
-						if (try_again)
-							break;
-
-						PINF("upgrade quota donation for RM session");
-						Genode::env()->parent()->upgrade(_rm->cap(), "ram_quota=32K");
-						try_again = true;
-					}
-				} while (try_again);
-
-				/*
-				 * Register ourself as user of the block and thereby enable
-				 * future eviction.
-				 */
-				_backing_store->assign(block, this, file_offset);
+					PDBG("[%ld] ATTACH: rm=%p, a=%08lx s=%lx blocks=%zu",
+					     _backing_store->index(blocks[0]), _rm, file_offset,
+					     bytes, cnt);
+
+				for (size_t i = 0; i < cnt; i++) {
+					_attach(blocks[i], file_offset + i * block_size);
+					_attached[nr + i] = true;
+
+					/*
+					 * Register ourself as user of the block and thereby enable
+					 * future eviction.
+					 */
+					_backing_store->assign(blocks[i], this, file_offset + i * block_size);
+				}
+				_next_block = nr + cnt;
 			}
 
 			/**************************
@@ -175,6 +244,7 @@ namespace Iso {
 			 */
 			void detach_block(Genode::off_t file_offset)
 			{
+				_attached[file_offset / _backing_store->block_size()] = false;
 				_rm->detach((void *)file_offset);
 			}
 	};
@@ -5,7 +5,7 @@
  */
 
 /*
- * Copyright (C) 2010-2012 Genode Labs GmbH
+ * Copyright (C) 2010-2013 Genode Labs GmbH
  *
  * This file is part of the Genode OS framework, which is distributed
  * under the terms of the GNU General Public License version 2.
@@ -209,7 +209,7 @@ namespace Net {
 				}
 
 				try {
-					return new (md_alloc()) Session_component(env()->heap(),
+					return new (md_alloc()) Session_component(md_alloc(),
 					                                          ram_quota - session_size,
 					                                          tx_buf_size,
 					                                          rx_buf_size,
@@ -5,7 +5,7 @@
  */
 
 /*
- * Copyright (C) 2010-2012 Genode Labs GmbH
+ * Copyright (C) 2010-2013 Genode Labs GmbH
  *
  * This file is part of the Genode OS framework, which is distributed
  * under the terms of the GNU General Public License version 2.
@@ -13,6 +13,7 @@
 
 /* Genode */
 #include <base/env.h>
+#include <base/heap.h>
 #include <base/sleep.h>
 #include <cap_session/connection.h>
 #include <nic_session/connection.h>
@@ -32,7 +33,14 @@ int main(int, char **)
 	static Cap_connection cap;
 	static Rpc_entrypoint ep(&cap, STACK_SIZE, "nic_bridge_ep");
 
-	static Nic::Packet_allocator tx_block_alloc(env()->heap());
+	/*
+	 * Heap for the sessions and packet allocators, which get used by the
+	 * entrypoint and the packet-handler threads concurrently
+	 */
+	static Heap heap(env()->ram_session(), env()->rm_session());
+	heap.enable_magazines();
+
+	static Nic::Packet_allocator tx_block_alloc(&heap);
 
 	enum {
 		PACKET_SIZE = Nic::Packet_allocator::DEFAULT_PACKET_SIZE,
@@ -52,7 +60,7 @@ int main(int, char **)
 	try {
 		static Nic::Connection nic(&tx_block_alloc, TX_BUF_SIZE, RX_BUF_SIZE);
 		static Net::Rx_handler rx_handler(&nic);
-		static Net::Root       nic_root(&ep, env()->heap(), &nic);
+		static Net::Root       nic_root(&ep, &heap, &nic);
 
 		/* start receiver thread handling packets from the NIC driver */
 		rx_handler.start();
@@ -5,14 +5,18 @@
  */
 
 /*
- * Copyright (C) 2011-2012 Genode Labs GmbH
+ * Copyright (C) 2011-2013 Genode Labs GmbH
  *
  * This file is part of the Genode OS framework, which is distributed
  * under the terms of the GNU General Public License version 2.
  */
 #include <base/allocator_avl.h>
+#include <base/heap.h>
 #include <base/semaphore.h>
 #include <block_session/connection.h>
+#include <os/config.h>
+#include <rm_session/connection.h>
+#include <util/misc_math.h>
 #include "part_blk.h"
 
 using namespace Genode;
@@ -27,8 +31,35 @@ namespace Partition {
 	size_t _blk_cnt;
 	size_t _blk_size;
 
-	Allocator_avl        _block_alloc(env()->heap());
-	Block::Connection    _blk(&_block_alloc, 4 * MAX_PACKET_SIZE);
+	/**
+	 * Size of the packet-stream buffer at the back end
+	 *
+	 * Besides the packets that get copied, the buffer holds the buffers
+	 * that are shared with clients.
+	 */
+	static size_t _buffer_size()
+	{
+		Number_of_bytes size = 4 * MAX_PACKET_SIZE;
+		try { config()->xml_node().attribute("buffer_size").value(&size); }
+		catch (...) { }
+		return size;
+	}
+
+	/**
+	 * Heap for the meta data of the packet allocator
+	 *
+	 * The threads of all sessions allocate packets concurrently, so the
+	 * heap caches freed blocks per thread.
+	 */
+	struct Md_heap : Heap
+	{
+		Md_heap() : Heap(env()->ram_session(), env()->rm_session()) {
+			enable_magazines(); }
+	};
+
+	Md_heap              _md_heap;
+	Allocator_avl        _block_alloc(&_md_heap);
+	Block::Connection    _blk(&_block_alloc, _buffer_size());
 
 	Partition           *_part_list[MAX_PARTITIONS]; /* contains pointers to valid partittions or 0 */
 
@@ -193,52 +224,202 @@ namespace Partition {
 	}
 
 
-	void _io(unsigned long lba, unsigned long count, uint8_t *buf, bool write)
+	/**
+	 * Requests that await their acknowledgement by the back end
+	 *
+	 * An acknowledgement carries nothing but the packet that got submitted,
+	 * so it belongs to the oldest request with exactly this packet. The
+	 * back-end offset alone does not identify a request because a client
+	 * may submit several packets for the same part of its shared buffer.
+	 * Requests with identical packets are interchangeable as they belong
+	 * to the same client, clients have disjoint shared buffers, and copied
+	 * payloads have packets of their own.
+	 */
+	class In_flight
 	{
-		unsigned long bytes;
+		private:
 
-		while (count) {
+			Request *_head; /* oldest request */
+			Request *_tail; /* latest request */
 
-			unsigned long curr_count = min<unsigned long>(count, max_packets());
-			bytes                    = curr_count * _blk_size;
-			bool alloc = false;
-			while (!alloc) {
-				try {
-					Sector sec(lba, curr_count, write);
-		
-					if (!write) {
-						sec.submit_request();
-						memcpy(buf, sec.addr<void *>(), bytes);
+			static bool _equal(Block::Packet_descriptor const &a,
+			                   Block::Packet_descriptor const &b)
+			{
+				return a.offset()       == b.offset()       &&
+				       a.size()         == b.size()         &&
+				       a.operation()    == b.operation()    &&
+				       a.block_number() == b.block_number() &&
+				       a.block_count()  == b.block_count();
+			}
+
+		public:
+
+			In_flight() : _head(0), _tail(0) { }
+
+			void insert(Request &r)
+			{
+				r.next = 0;
+				if (_tail) _tail->next = &r; else _head = &r;
+				_tail = &r;
+			}
+
+			/**
+			 * Remove the request that got acknowledged with packet 'p'
+			 *
+			 * \return  request, or 0 if no request matches
+			 */
+			Request *remove(Block::Packet_descriptor const &p)
+			{
+				for (Request *r = _head, *prev = 0; r; prev = r, r = r->next) {
+					if (!_equal(r->backend, p)) continue;
+
+					if (prev) prev->next = r->next; else _head = r->next;
+					if (_tail == r) _tail = prev;
+					return r;
+				}
+				return 0;
+			}
+	};
+
+
+	/*
+	 * The back-end packet stream is shared by the threads of all sessions,
+	 * which submit packets, and the completion thread, which is the only
+	 * one to get acknowledgements. '_lock' guards the packet allocator and
+	 * the in-flight requests, whereas '_submit_lock' serializes the
+	 * submissions. The latter may block on a full submit queue and thus
+	 * must not be taken by the completion thread.
+	 */
+	Lock      _lock;
+	Lock      _submit_lock;
+	In_flight _in_flight;
+
+
+	/**
+	 * Thread that hands the acknowledgements of the back end to the clients
+	 */
+	class Completion_thread : public Thread<8192>
+	{
+		public:
+
+			Completion_thread() : Thread<8192>("completion") { }
+
+			void entry()
+			{
+				Block::Session::Tx::Source &source = *_blk.tx();
+				while (true) {
+					Block::Packet_descriptor const p = source.get_acked_packet();
+
+					Request *r;
+					{
+						Lock::Guard guard(_lock);
+						r = _in_flight.remove(p);
 					}
-					else {
-						memcpy(sec.addr<void *>(), buf, bytes);
-						sec.submit_request();
+					if (!r) {
+						PWRN("acknowledgement of unknown request");
+						continue;
 					}
 
-					alloc = true;
+					bool const success = p.succeeded();
+					if (r->payload) {
+						if (success && p.operation() == Block::Packet_descriptor::READ)
+							memcpy(r->payload, source.packet_content(p), p.size());
+
+						Lock::Guard guard(_lock);
+						source.release_packet(p);
+
+						/* unblock clients that possibly wait for packet stream allocations */
+						if (_alloc_sem.cnt() < 0)
+							_alloc_sem.up();
+					}
+					r->client->complete(*r, success);
+				}
+			}
+	};
+
+
+	void start()
+	{
+		static Completion_thread completion_thread;
+		completion_thread.start();
+	}
+
+
+	void submit(Request &r)
+	{
+		Block::Session::Tx::Source &source = *_blk.tx();
+		size_t const size = r.backend.block_count() * _blk_size;
+
+		/* allocate a packet of our own if the payload must be copied */
+		if (r.payload) {
+			if (size > source.bulk_buffer_size())
+				throw Io_error();
+
+			while (true) {
+				try {
+					Lock::Guard guard(_lock);
+					r.backend = Block::Packet_descriptor(_blk.dma_alloc_packet(size),
+					                                     r.backend.operation(),
+					                                     r.backend.block_number(),
+					                                     r.backend.block_count());
+					break;
 				} catch (Block::Session::Tx::Source::Packet_alloc_failed) {
 					/* block */
 					_alloc_sem.down();
 				}
 			}
+			if (r.backend.operation() == Block::Packet_descriptor::WRITE)
+				memcpy(source.packet_content(r.backend), r.payload, size);
+		}
 
-			lba   += curr_count;
-			count -= curr_count;
-			buf   += bytes;
+		/* the acknowledgement may arrive as soon as the packet is submitted */
+		{
+			Lock::Guard guard(_lock);
+			_in_flight.insert(r);
 		}
+		Lock::Guard guard(_submit_lock);
+		source.submit_packet(r.backend);
+	}
+
+
+	Shared_buffer::Shared_buffer(size_t size) : _offset(0), _size(0), _rm(0)
+	{
+		enum { PAGE_SIZE_LOG2 = 12 };
+		_size = align_addr(size, PAGE_SIZE_LOG2);
 
-		/* zero out rest of page */
-		bytes = (count * _blk_size) % 4096;
-		if (bytes)
-			memset(buf, 0, bytes);
+		/* keep space for the packets that get copied */
+		{
+			Lock::Guard guard(_lock);
+			void *offset = 0;
+			if (_block_alloc.avail() < _size + MAX_PACKET_SIZE ||
+			    _block_alloc.alloc_aligned(_size, &offset, PAGE_SIZE_LOG2).is_error())
+				return;
+			_offset = (off_t)offset;
+		}
+		try {
+			_rm = new (env()->heap()) Rm_connection(0, _size);
+			_rm->attach_at(_blk.tx()->dataspace(), 0, _size, _offset);
+			if (_rm->dataspace().valid())
+				return;
+		} catch (...) { }
+
+		/* managed dataspaces are not supported, e.g., on Linux */
+		if (_rm) destroy(env()->heap(), _rm);
+		_rm = 0;
+		Lock::Guard guard(_lock);
+		_block_alloc.free((void *)_offset, _size);
 	}
 
 
-	void Partition::io(unsigned long block_nr, unsigned long count, void *buf, bool write)
+	Shared_buffer::~Shared_buffer()
 	{
-		if (block_nr + count > _sectors)
-			throw Io_error();
+		if (!_rm) return;
 
-		_io(_lba + block_nr, count, (uint8_t *)buf, write);
+		destroy(env()->heap(), _rm);
+		Lock::Guard guard(_lock);
+		_block_alloc.free((void *)_offset, _size);
 	}
+
+
+	Dataspace_capability Shared_buffer::dataspace() { return _rm->dataspace(); }
 }
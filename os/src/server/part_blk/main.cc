@@ -5,12 +5,13 @@
  */
 
 /*
- * Copyright (C) 2011-2012 Genode Labs GmbH
+ * Copyright (C) 2011-2013 Genode Labs GmbH
  *
  * This file is part of the Genode OS framework, which is distributed
  * under the terms of the GNU General Public License version 2.
  */
 
+#include <base/semaphore.h>
 #include <base/sleep.h>
 #include <block_session/rpc_object.h>
 #include <cap_session/connection.h>
@@ -46,10 +47,13 @@ namespace Block {
 	}
 
 
-	class Session_component : public Session_rpc_object
+	class Session_component : public Session_rpc_object,
+	                          public Partition::Client
 	{
 		private:
 
+			enum { MAX_REQUESTS = 32 }; /* in-flight requests per session */
+
 			class Tx_thread : public Genode::Thread<8192>
 			{
 				private:
@@ -63,72 +67,161 @@ namespace Block {
 
 					void entry()
 					{
-						using namespace Genode;
-
 						Session_component::Tx::Sink *tx_sink = _session->tx_sink();
-						Block::Packet_descriptor packet;
 
 						/* handle requests */
 						while (true) {
 
 							/* blocking get packet from client */
-							packet = tx_sink->get_packet();
+							Block::Packet_descriptor packet = tx_sink->get_packet();
+							if (_session->stopped())
+								return;
+
 							if (!packet.valid()) {
 								PWRN("received invalid packet");
 								continue;
 							}
+							_session->forward(packet);
+						}
+					}
+			};
 
-							packet.succeeded(false);
-							bool write = false;
-
-							switch (packet.operation()) {
+			struct Partition::Partition  *_partition; /* partition belonging to this session */
+			Partition::Shared_buffer     *_shared;    /* buffer shared with the back end or 0 */
+			Partition::Request            _requests[MAX_REQUESTS];
+			Partition::Request           *_free;      /* unused requests */
+			unsigned                      _in_flight;
+			Genode::Lock                  _lock;      /* guards requests and acknowledgements */
+			Genode::Semaphore             _completed;
+			unsigned                      _waiters;   /* threads blocking at '_completed' */
+			bool                          _stopped;   /* session is about to close */
+			Tx_thread                     _tx_thread;
 
-							case Block::Packet_descriptor::WRITE:
-								write  = true;
+			/**
+			 * Block until a request completes, '_lock' must be taken
+			 */
+			void _wait_for_completion()
+			{
+				_waiters++;
+				_lock.unlock();
+				_completed.down();
+				_lock.lock();
+			}
 
-							case Block::Packet_descriptor::READ:
+			/**
+			 * Allocate request, block while all requests are in flight
+			 *
+			 * \return  request, or 0 if the session got stopped
+			 */
+			Partition::Request *_alloc_request()
+			{
+				Genode::Lock::Guard guard(_lock);
+				while (!_free && !_stopped)
+					_wait_for_completion();
 
-								try {
-									_session->partition()->io(packet.block_number(),
-									                          packet.block_count(),
-									                          tx_sink->packet_content(packet),
-									                          write);
-									packet.succeeded(true);
-								}
-								catch (Partition::Io_error) {
-									PWRN("Io error!");
-								}
-								break;
+				if (_stopped) return 0;
 
-							default:
-								PWRN("received invalid packet");
-								continue;
-							}
+				Partition::Request &r = *_free;
+				_free = r.next;
+				_in_flight++;
+				return &r;
+			}
 
-							/* acknowledge packet to the client */
-							if (!tx_sink->ready_to_ack())
-								PDBG("need to wait until ready-for-ack");
-							tx_sink->acknowledge_packet(packet);
-						}
-					}
-			};
+			void _acknowledge(Block::Packet_descriptor packet, bool success)
+			{
+				packet.succeeded(success);
 
-			struct Partition::Partition  *_partition; /* partition belonging to this session */
-			Genode::Dataspace_capability  _tx_ds;     /* buffer for tx channel */
-			Tx_thread                     _tx_thread;
+				/* acknowledge packet to the client */
+				if (!tx_sink()->ready_to_ack())
+					PDBG("need to wait until ready-for-ack");
+				tx_sink()->acknowledge_packet(packet);
+			}
 
 		public:
 
 			Session_component(Genode::Dataspace_capability tx_ds,
 			                  Partition::Partition        *partition,
+			                  Partition::Shared_buffer    *shared,
 			                  Genode::Rpc_entrypoint      &ep)
 			:
 				Session_rpc_object(tx_ds, ep),
-				_partition(partition), _tx_ds(tx_ds), _tx_thread(this)
+				_partition(partition), _shared(shared), _free(0),
+				_in_flight(0), _waiters(0), _stopped(false), _tx_thread(this)
 			{
+				for (unsigned i = 0; i < MAX_REQUESTS; i++) {
+					_requests[i].next = _free;
+					_free = &_requests[i];
+				}
 				_tx_thread.start();
 			}
 
+			~Session_component()
+			{
+				/* stop the tx thread, so it submits no further requests */
+				{
+					Genode::Lock::Guard guard(_lock);
+					_stopped = true;
+					for (; _waiters; _waiters--)
+						_completed.up();
+				}
+				tx_sink()->cancel();
+				_tx_thread.join();
+
+				/* the back end must not complete requests of a dead session */
+				Genode::Lock::Guard guard(_lock);
+				while (_in_flight)
+					_wait_for_completion();
+			}
+
+			bool stopped()
+			{
+				Genode::Lock::Guard guard(_lock);
+				return _stopped;
+			}
+
+			/**
+			 * Forward packet of the client to the back end
+			 *
+			 * If the client uses a buffer shared with the back end, the
+			 * back end accesses the payload of the packet directly.
+			 * Otherwise, the payload gets copied.
+			 */
+			void forward(Block::Packet_descriptor const &packet)
+			{
+				bool const write = packet.operation() == Packet_descriptor::WRITE;
+				Genode::size_t const size = packet.block_count() * Partition::blk_size();
+				if ((!write && packet.operation() != Packet_descriptor::READ) ||
+				    !_partition->contains(packet.block_number(), packet.block_count()) ||
+				    packet.block_count() > packet.size() / Partition::blk_size() ||
+				    !tx_sink()->packet_valid(packet) ||
+				    (_shared && !_shared->contains(packet.offset(), size))) {
+					PWRN("received invalid packet");
+					Genode::Lock::Guard guard(_lock);
+					_acknowledge(packet, false);
+					return;
+				}
+
+				Partition::Request * const request = _alloc_request();
+				if (!request) return;
+
+				Partition::Request &r = *request;
+				r.client  = this;
+				r.packet  = packet;
+				r.payload = _shared ? 0 : tx_sink()->packet_content(packet);
+
+				Genode::off_t const offset = _shared ? _shared->backend_offset(packet.offset()) : 0;
+				r.backend = Block::Packet_descriptor(
+					Block::Packet_descriptor(offset, size),
+					packet.operation(), _partition->_lba + packet.block_number(),
+					packet.block_count());
+
+				try { Partition::submit(r); }
+				catch (Partition::Io_error) {
+					PWRN("Io error!");
+					complete(r, false);
+				}
+			}
+
 			void info(Genode::size_t *blk_count, Genode::size_t *blk_size, Operations *ops)
 			{
 				*blk_count = _partition->_sectors;
@@ -138,6 +231,25 @@ namespace Block {
 			}
 
 			Partition::Partition *partition() { return _partition; }
+
+			Partition::Shared_buffer *shared_buffer() { return _shared; }
+
+
+			/*********************************
+			 ** Partition::Client interface **
+			 *********************************/
+
+			void complete(Partition::Request &r, bool success)
+			{
+				Genode::Lock::Guard guard(_lock);
+				_acknowledge(r.packet, success);
+
+				r.next = _free;
+				_free  = &r;
+				_in_flight--;
+				for (; _waiters; _waiters--)
+					_completed.up();
+			}
 	};
 
 
@@ -201,9 +313,35 @@ namespace Block {
 					throw Root::Unavailable();
 				}
 
+				/*
+				 * Let the client use a part of the back-end buffer if
+				 * possible, which spares copying the payload.
+				 */
+				Partition::Shared_buffer *shared = new (env()->heap())
+					Partition::Shared_buffer(tx_buf_size);
+				if (!shared->valid()) {
+					destroy(env()->heap(), shared);
+					shared = 0;
+				}
+
+				Dataspace_capability tx_ds;
+				if (shared)
+					tx_ds = shared->dataspace();
+				else
+					tx_ds = env()->ram_session()->alloc(tx_buf_size);
+
 				return new (md_alloc())
-				       Session_component(env()->ram_session()->alloc(tx_buf_size),
-				                         Partition::partition(num), _ep);
+				       Session_component(tx_ds, Partition::partition(num),
+				                         shared, _ep);
+			}
+
+			void _destroy_session(Session_component *session)
+			{
+				Partition::Shared_buffer * const shared = session->shared_buffer();
+				Root_component::_destroy_session(session);
+
+				/* the buffer is still attached until the session is gone */
+				if (shared) Genode::destroy(Genode::env()->heap(), shared);
 			}
 
 		public:
@@ -223,6 +361,7 @@ int main()
 	} catch (Partition::Io_error) {
 		return -1;
 	}
+	Partition::start();
 
 	enum { STACK_SIZE = 16384 };
 	static Cap_connection cap;
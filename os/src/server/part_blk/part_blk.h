@@ -5,7 +5,7 @@
  */
 
 /*
- * Copyright (C) 2011-2012 Genode Labs GmbH
+ * Copyright (C) 2011-2013 Genode Labs GmbH
  *
  * This file is part of the Genode OS framework, which is distributed
  * under the terms of the GNU General Public License version 2.
@@ -16,6 +16,10 @@
 
 #include <base/exception.h>
 #include <base/stdint.h>
+#include <block_session/block_session.h>
+#include <dataspace/capability.h>
+
+namespace Genode { class Rm_connection; }
 
 namespace Partition {
 
@@ -34,16 +38,13 @@ namespace Partition {
 		: _lba(lba), _sectors(sectors) { }
 
 		/**
-		 * Write/read blocks
+		 * Check if blocks lie within the partition
 		 *
 		 * \param block_nr block number of partition to access
-		 * \param count    number of blocks to read/write
-		 * \param buf      buffer which containing the data to write or which is
-		 *                 filled by reads
-		 * \param write    true for a write operations, false for a read
-		 * \throw Io_error
+		 * \param count    number of blocks to access
 		 */
-		void io(unsigned long block_nr, unsigned long count, void *buf, bool write = false);
+		bool contains(unsigned long block_nr, unsigned long count) const {
+			return block_nr < _sectors && count <= _sectors - block_nr; }
 	};
 
 	/**
@@ -51,6 +52,79 @@ namespace Partition {
 	 */
 	class Io_error : public Genode::Exception {};
 
+	struct Request;
+
+	/**
+	 * Front-end session that receives the completions of its requests
+	 */
+	struct Client
+	{
+		/**
+		 * Called by the completion thread of the back end
+		 *
+		 * \param success  whether the back end executed the request
+		 */
+		virtual void complete(Request &request, bool success) = 0;
+	};
+
+	/**
+	 * Request of a client that got forwarded to the back end
+	 */
+	struct Request
+	{
+		Client                   *client;
+		Block::Packet_descriptor  packet;  /* packet of the client */
+		Block::Packet_descriptor  backend; /* packet at the back end */
+		char                     *payload; /* client payload to copy, 0 if shared */
+		Request                  *next;    /* next free or in-flight request */
+	};
+
+	/**
+	 * Buffer of the back end that is shared with one client
+	 *
+	 * The buffer is a region of the bulk buffer of the back end that gets
+	 * mapped to a managed dataspace. If a client uses this dataspace as
+	 * its packet-stream buffer, the back end can access the payload of
+	 * the client directly.
+	 */
+	class Shared_buffer
+	{
+		private:
+
+			Genode::off_t          _offset; /* offset within back-end buffer */
+			Genode::size_t         _size;
+			Genode::Rm_connection *_rm;
+
+		public:
+
+			/**
+			 * Constructor
+			 *
+			 * If the back end has no space left or the platform doesn't
+			 * support managed dataspaces, the buffer is invalid.
+			 */
+			Shared_buffer(Genode::size_t size);
+
+			~Shared_buffer();
+
+			bool valid() const { return _rm != 0; }
+
+			Genode::Dataspace_capability dataspace();
+
+			/**
+			 * Return whether the shared buffer contains the given range
+			 */
+			bool contains(Genode::off_t offset, Genode::size_t size) const {
+				return offset >= 0 && (Genode::size_t)offset <= _size &&
+				       size <= _size - offset; }
+
+			/**
+			 * Translate offset within the shared buffer to the back end
+			 */
+			Genode::off_t backend_offset(Genode::off_t offset) const {
+				return _offset + offset; }
+	};
+
 	/**
 	 * Initialize the back-end and parse partitions information
 	 *
@@ -58,6 +132,22 @@ namespace Partition {
 	 */
 	void init();
 
+	/**
+	 * Start the completion of requests, to be called after 'init'
+	 */
+	void start();
+
+	/**
+	 * Forward request to the back end
+	 *
+	 * The packet 'backend' must be set up except for its payload if
+	 * 'payload' is set. Requests may get completed in any order and even
+	 * before this function returns.
+	 *
+	 * \throw Io_error  request is too large for the back end
+	 */
+	void submit(Request &request);
+
 	/**
 	 * Return partition information
 	 *
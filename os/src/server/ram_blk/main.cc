@@ -0,0 +1,269 @@
+/*
+ * \brief  Provide a RAM dataspace as asynchronous block device
+ * \author Martin Stein
+ * \date   2013-02-12
+ *
+ * The driver serves as reference for the asynchronous driver interface.
+ * It accepts up to 'queue_depth' requests at a time. If the 'latency_us'
+ * attribute is configured, each request completes that many microseconds
+ * after its submission, independent from other outstanding requests, which
+ * models a device with internal parallelism. Otherwise, requests complete
+ * immediately.
+ */
+
+/*
+ * Copyright (C) 2013 Genode Labs GmbH
+ *
+ * This file is part of the Genode OS framework, which is distributed
+ * under the terms of the GNU General Public License version 2.
+ */
+
+/* Genode includes */
+#include <base/printf.h>
+#include <base/sleep.h>
+#include <base/signal.h>
+#include <cap_session/connection.h>
+#include <block/component.h>
+#include <os/config.h>
+#include <timer_session/connection.h>
+#include <timer_session/timeout_multiplexer.h>
+
+using namespace Genode;
+
+
+class Ram_blk : public Block::Driver
+{
+	private:
+
+		enum { MAX_JOBS = 32, STACK_SIZE = 8192 };
+
+		/**
+		 * Submitted request that waits for its latency to expire
+		 */
+		struct Job : Alarm
+		{
+			Ram_blk                   *driver;
+			Block::Request            *request;
+			Block::Request_completion *completion;
+			bool                       used;
+
+			Job() : driver(0), request(0), completion(0), used(false) { }
+
+			bool on_alarm()
+			{
+				driver->_finish(*this);
+				return false;
+			}
+		};
+
+		/**
+		 * Thread that completes jobs when their latency expired
+		 */
+		struct Completer : Thread<STACK_SIZE>
+		{
+			Timer::Connection          timer;
+			Signal_receiver            receiver;
+			Signal_context             context;
+			Timer::Timeout_multiplexer multiplexer;
+
+			Completer()
+			:
+				Thread<STACK_SIZE>("ram_blk_completer"),
+				multiplexer(timer, receiver.manage(&context))
+			{ start(); }
+
+			void entry()
+			{
+				while (true) {
+					receiver.wait_for_signal();
+					multiplexer.handle();
+				}
+			}
+		};
+
+		Ram_dataspace_capability  _ds;
+		char                     *_addr;
+		size_t const              _blk_size;
+		size_t const              _blk_cnt;
+		unsigned const            _depth;
+		unsigned const            _latency_us;
+		Job                       _jobs[MAX_JOBS];
+		Lock                      _lock;     /* guards '_jobs' and statistics */
+		Completer                *_completer;
+		unsigned long             _requests;
+		unsigned long             _blocks;
+		unsigned                  _outstanding;
+		unsigned                  _max_outstanding;
+
+		bool _valid(size_t const nr, size_t const cnt) const {
+			return nr < _blk_cnt && cnt <= _blk_cnt - nr; }
+
+		/**
+		 * Copy payload of request 'r'
+		 */
+		bool _copy(Block::Request const &r)
+		{
+			if (!_valid(r.block_number, r.block_count)) {
+				PWRN("requested blocks %zd-%zd out of range!", r.block_number,
+				     r.block_number + r.block_count);
+				return false;
+			}
+			char * const blocks = _addr + r.block_number * _blk_size;
+			size_t const size   = r.block_count * _blk_size;
+			if (r.operation == Block::Request::READ)
+				memcpy(r.buffer, blocks, size);
+			else
+				memcpy(blocks, r.buffer, size);
+			return true;
+		}
+
+		/**
+		 * Execute job and notify the session of the completion
+		 */
+		void _finish(Job &job)
+		{
+			Block::Request            &request    = *job.request;
+			Block::Request_completion &completion = *job.completion;
+			bool const success = _copy(request);
+
+			/* release the job first, 'complete' may lead to a new submit */
+			{
+				Lock::Guard guard(_lock);
+				job.used = false;
+				_outstanding--;
+			}
+			completion.complete(request, success);
+		}
+
+	public:
+
+		Ram_blk(size_t const size, size_t const blk_size,
+		        unsigned const depth, unsigned const latency_us)
+		:
+			_ds(env()->ram_session()->alloc(size)),
+			_addr(env()->rm_session()->attach(_ds)),
+			_blk_size(blk_size), _blk_cnt(size / blk_size),
+			_depth(min(depth, (unsigned)MAX_JOBS)), _latency_us(latency_us),
+			_completer(latency_us ? new (env()->heap()) Completer : 0),
+			_requests(0), _blocks(0), _outstanding(0), _max_outstanding(0)
+		{
+			for (unsigned i = 0; i < MAX_JOBS; i++) _jobs[i].driver = this;
+		}
+
+		~Ram_blk()
+		{
+			printf("ram_blk: %lu requests, %lu blocks, max. %u outstanding\n",
+			       _requests, _blocks, _max_outstanding);
+
+			/* the session drained all requests before destructing us */
+			if (_completer) destroy(env()->heap(), _completer);
+			env()->rm_session()->detach(_addr);
+			env()->ram_session()->free(_ds);
+		}
+
+
+		/*****************************
+		 ** Block::Driver interface **
+		 *****************************/
+
+		size_t block_size()  { return _blk_size; }
+		size_t block_count() { return _blk_cnt; }
+
+		void read(size_t block_number, size_t block_count, char *out_buffer)
+		{
+			Block::Request r = { Block::Request::READ, block_number,
+			                     block_count, out_buffer, 0 };
+			if (!_copy(r)) throw Io_error();
+		}
+
+		void write(size_t block_number, size_t block_count, char const *buffer)
+		{
+			Block::Request r = { Block::Request::WRITE, block_number,
+			                     block_count, const_cast<char *>(buffer), 0 };
+			if (!_copy(r)) throw Io_error();
+		}
+
+		void read_dma(size_t, size_t, addr_t)  { throw Io_error(); }
+		void write_dma(size_t, size_t, addr_t) { throw Io_error(); }
+		bool dma_enabled() { return false; }
+
+		unsigned queue_depth() { return _depth; }
+
+		void submit(Block::Request &request, Block::Request_completion &completion)
+		{
+			Job *job = 0;
+			{
+				Lock::Guard guard(_lock);
+				for (unsigned i = 0; i < _depth && !job; i++)
+					if (!_jobs[i].used) job = &_jobs[i];
+				if (!job) {
+					PERR("queue depth exceeded");
+					throw Io_error();
+				}
+				job->used       = true;
+				job->request    = &request;
+				job->completion = &completion;
+
+				_requests++;
+				_blocks += request.block_count;
+				if (++_outstanding > _max_outstanding)
+					_max_outstanding = _outstanding;
+			}
+			if (_completer)
+				_completer->multiplexer.schedule_us(job, _latency_us);
+			else
+				_finish(*job);
+		}
+};
+
+
+int main(int, char **)
+{
+	Number_of_bytes size        = 16*1024*1024;
+	size_t          block_size  = 512;
+	unsigned        queue_depth = 8;
+	unsigned        latency_us  = 0;
+
+	try { config()->xml_node().attribute("size").value(&size); } catch (...) { }
+	try { config()->xml_node().attribute("block_size").value(&block_size); } catch (...) { }
+	try { config()->xml_node().attribute("queue_depth").value(&queue_depth); } catch (...) { }
+	try { config()->xml_node().attribute("latency_us").value(&latency_us); } catch (...) { }
+
+	printf("--- RAM block device: %zu blocks of %zu bytes, queue depth %u, "
+	       "latency %u us ---\n", (size_t)size / block_size, block_size,
+	       queue_depth, latency_us);
+
+	/**
+	 * Factory used by 'Block::Root' at session creation/destruction time
+	 */
+	struct Ram_blk_factory : Block::Driver_factory
+	{
+		size_t   size, block_size;
+		unsigned queue_depth, latency_us;
+
+		Block::Driver *create()
+		{
+			return new (env()->heap())
+				Ram_blk(size, block_size, queue_depth, latency_us);
+		}
+
+		void destroy(Block::Driver *driver) {
+			Genode::destroy(env()->heap(), static_cast<Ram_blk *>(driver)); }
+
+	} driver_factory;
+
+	driver_factory.size        = size;
+	driver_factory.block_size  = block_size;
+	driver_factory.queue_depth = queue_depth;
+	driver_factory.latency_us  = latency_us;
+
+	enum { STACK_SIZE = 8192 };
+	static Cap_connection cap;
+	static Rpc_entrypoint ep(&cap, STACK_SIZE, "ram_blk_ep");
+
+	static Block::Root block_root(&ep, env()->heap(), driver_factory);
+	env()->parent()->announce(ep.manage(&block_root));
+
+	sleep_forever();
+	return 0;
+}
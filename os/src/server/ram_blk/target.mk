@@ -0,0 +1,3 @@
+TARGET = ram_blk
+LIBS   = env cxx server signal alarm
+SRC_CC = main.cc
@@ -5,7 +5,7 @@
  */
 
 /*
- * Copyright (C) 2012 Genode Labs GmbH
+ * Copyright (C) 2012-2013 Genode Labs GmbH
  *
  * This file is part of the Genode OS framework, which is distributed
  * under the terms of the GNU General Public License version 2.
@@ -166,6 +166,21 @@ namespace File_system {
 
 				_num_entries = local_offset;
 			}
+
+			/**
+			 * Make range part of the used size without changing its content
+			 *
+			 * \param fn  functor called with the chunk as argument
+			 */
+			template <typename FUNC>
+			void populate(size_t len, seek_off_t seek_offset, FUNC &fn)
+			{
+				assert_valid_range(seek_offset, len, SIZE);
+
+				_num_entries = max(_num_entries,
+				                   (size_t)(seek_offset - base_offset()) + len);
+				fn(*this);
+			}
 	};
 
 
@@ -402,6 +417,35 @@ namespace File_system {
 				_range_op(*this, dst, len, seek_offset, Read_func());
 			}
 
+			/**
+			 * Allocate the sub chunks of a range without changing its content
+			 *
+			 * The range becomes part of the used size of the chunk. The
+			 * functor 'fn' gets called for each leaf chunk of the range.
+			 */
+			template <typename FUNC>
+			void populate(size_t len, seek_off_t seek_offset, FUNC &fn)
+			{
+				assert_valid_range(seek_offset, len, SIZE);
+
+				while (len > 0) {
+
+					unsigned const index = _index_by_offset(seek_offset);
+
+					/* byte offset relative to the sub chunk */
+					seek_off_t const local_seek_offset =
+						seek_offset - base_offset() - index*ENTRY_SIZE;
+
+					size_t const curr_len =
+						min(len, (size_t)(ENTRY_SIZE - local_seek_offset));
+
+					_entry_for_writing(index).populate(curr_len, seek_offset, fn);
+
+					len         -= curr_len;
+					seek_offset += curr_len;
+				}
+			}
+
 			/**
 			 * Truncate chunk to specified size in bytes
 			 *
@@ -8,6 +8,7 @@
 #define _DIRECTORY_H_
 
 /* local includes */
+#include <lookup_cache.h>
 #include <node.h>
 #include <util.h>
 #include <file.h>
@@ -19,39 +20,114 @@ namespace File_system {
 	{
 		private:
 
-			List<Node> _entries;
+			enum { NONE = ~0U };
+
+			Allocator &_alloc;
+
+			/*
+			 * The entries are kept in an array for positional access by
+			 * 'read'. A hash table of their names refers to the array
+			 * indices, chained via '_next'. The number of buckets equals
+			 * the capacity of the array.
+			 */
+			Node     **_nodes;
+			unsigned  *_next;
+			unsigned  *_buckets;
+			unsigned   _capacity; /* power of two */
 			size_t     _num_entries;
 
-		public:
+			static unsigned _hash(char const *name, size_t len)
+			{
+				/* FNV-1a */
+				unsigned h = 2166136261U;
+				for (size_t i = 0; i < len && name[i]; i++)
+					h = (h ^ (unsigned char)name[i]) * 16777619U;
+				return h;
+			}
 
-			Directory(char const *name) : _num_entries(0) { Node::name(name); }
+			unsigned &_bucket(char const *name, size_t len) {
+				return _buckets[_hash(name, len) & (_capacity - 1)]; }
 
-			bool has_sub_node_unsynchronized(char const *name) const
+			unsigned &_bucket(Node const *node) {
+				return _bucket(node->name(), strlen(node->name())); }
+
+			/**
+			 * Return index of the entry named by the first 'len' characters
+			 * of 'name', or 'NONE'
+			 */
+			unsigned _find(char const *name, size_t len)
 			{
-				Node *sub_node = _entries.first();
-				for (; sub_node; sub_node = sub_node->next())
-					if (strcmp(sub_node->name(), name) == 0)
-						return true;
+				if (!_capacity) return NONE;
 
-				return false;
+				unsigned i = _bucket(name, len);
+				for (; i != NONE; i = _next[i])
+					if (strlen(_nodes[i]->name()) == len &&
+					    strcmp(_nodes[i]->name(), name, len) == 0)
+						break;
+				return i;
 			}
 
-			void adopt_unsynchronized(Node *node)
+			void _hash_insert(unsigned i)
 			{
-				/*
-				 * XXX inc ref counter
-				 */
-				_entries.insert(node);
-				_num_entries++;
+				unsigned &bucket = _bucket(_nodes[i]);
+				_next[i] = bucket;
+				bucket   = i;
 			}
 
-			void discard_unsynchronized(Node *node)
+			/**
+			 * Remove entry 'i' from the hash table
+			 */
+			void _hash_remove(unsigned i)
 			{
-				_entries.remove(node);
-				_num_entries--;
+				for (unsigned *p = &_bucket(_nodes[i]); *p != NONE; p = &_next[*p])
+					if (*p == i) { *p = _next[i]; return; }
 			}
 
-			Node *lookup_and_lock(char const *path, bool return_parent = false)
+			/**
+			 * Return index of 'node'
+			 */
+			unsigned _index(Node const *node)
+			{
+				unsigned i = _bucket(node);
+				for (; i != NONE && _nodes[i] != node; i = _next[i]);
+				return i;
+			}
+
+			void _free_arrays()
+			{
+				if (!_capacity) return;
+				_alloc.free(_nodes,   _capacity * sizeof(Node *));
+				_alloc.free(_next,    _capacity * sizeof(unsigned));
+				_alloc.free(_buckets, _capacity * sizeof(unsigned));
+			}
+
+			/**
+			 * Double the capacity and rebuild the hash table
+			 */
+			void _grow()
+			{
+				unsigned const capacity = _capacity ? 2 * _capacity : 4;
+
+				Node     **nodes   = new (&_alloc) Node *[capacity];
+				unsigned  *next    = new (&_alloc) unsigned[capacity];
+				unsigned  *buckets = new (&_alloc) unsigned[capacity];
+
+				for (unsigned i = 0; i < _num_entries; i++)
+					nodes[i] = _nodes[i];
+
+				_free_arrays();
+				_nodes    = nodes;
+				_next     = next;
+				_buckets  = buckets;
+				_capacity = capacity;
+
+				for (unsigned i = 0; i < _capacity; i++)
+					_buckets[i] = NONE;
+				for (unsigned i = 0; i < _num_entries; i++)
+					_hash_insert(i);
+			}
+
+			Node *_lookup_and_lock(char const *path, bool return_parent)
 			{
 				if (strcmp(path, "") == 0) {
 					lock();
@@ -81,15 +157,12 @@ namespace File_system {
 				 */
 
 				/* try to find entry that matches the first path element */
-				Node *sub_node = _entries.first();
-				for (; sub_node; sub_node = sub_node->next())
-					if ((strlen(sub_node->name()) == i) &&
-						(strcmp(sub_node->name(), path, i) == 0))
-						break;
-
-				if (!sub_node)
+				unsigned const index = _find(path, i);
+				if (index == NONE)
 					throw Lookup_failed();
 
+				Node *sub_node = _nodes[index];
+
 				if (is_basename(path)) {
 
 					/*
@@ -115,7 +188,109 @@ namespace File_system {
 				if (!sub_dir)
 					throw Lookup_failed();
 
-				return sub_dir->lookup_and_lock(path + i + 1, return_parent);
+				return sub_dir->_lookup_and_lock(path + i + 1, return_parent);
+			}
+
+		public:
+
+			Directory(Allocator &alloc, char const *name)
+			:
+				_alloc(alloc), _nodes(0), _next(0), _buckets(0), _capacity(0),
+				_num_entries(0)
+			{ Node::name(name); }
+
+			~Directory() { _free_arrays(); }
+
+			bool has_sub_node_unsynchronized(char const *name)
+			{
+				return _find(name, strlen(name)) != NONE;
+			}
+
+			void adopt_unsynchronized(Node *node)
+			{
+				/*
+				 * XXX inc ref counter
+				 */
+				if (_num_entries == _capacity)
+					_grow();
+
+				_nodes[_num_entries] = node;
+				_hash_insert(_num_entries);
+				_num_entries++;
+
+				Lookup_cache::invalidate();
+			}
+
+			/**
+			 * Remove entry
+			 *
+			 * The last entry takes the position of the removed one.
+			 */
+			void discard_unsynchronized(Node *node)
+			{
+				unsigned const i = _capacity ? _index(node) : NONE;
+				if (i == NONE) return;
+
+				_hash_remove(i);
+				unsigned const last = _num_entries - 1;
+				if (i != last) {
+					_hash_remove(last);
+					_nodes[i] = _nodes[last];
+					_hash_insert(i);
+				}
+				_num_entries--;
+
+				Lookup_cache::invalidate();
+			}
+
+			/**
+			 * Assign new name to entry
+			 */
+			void rename_unsynchronized(Node *node, char const *name)
+			{
+				unsigned const i = _capacity ? _index(node) : NONE;
+				if (i == NONE) return;
+
+				_hash_remove(i);
+				node->name(name);
+				_hash_insert(i);
+
+				Lookup_cache::invalidate();
+			}
+
+			/**
+			 * Lookup and lock node of the specified path
+			 *
+			 * \throw Lookup_failed
+			 */
+			Node *lookup_and_lock(char const *path, bool return_parent = false)
+			{
+				Lookup_cache * const cache = Lookup_cache::cache();
+				if (!cache)
+					return _lookup_and_lock(path, return_parent);
+
+				Node *node = 0;
+				unsigned long generation = 0;
+				switch (cache->lookup(this, path, return_parent, &node, &generation)) {
+
+				case Lookup_cache::FOUND:
+					node->lock();
+					return node;
+
+				case Lookup_cache::NOT_FOUND:
+					throw Lookup_failed();
+
+				case Lookup_cache::UNKNOWN:
+					break;
+				}
+
+				try { node = _lookup_and_lock(path, return_parent); }
+				catch (Lookup_failed) {
+					cache->insert(this, path, return_parent, 0, generation);
+					throw;
+				}
+				cache->insert(this, path, return_parent, node, generation);
+				return node;
 			}
 
 			Directory *lookup_and_lock_dir(char const *path)
@@ -178,14 +353,12 @@ namespace File_system {
 					return 0;
 				}
 
-				/* find list element */
-				Node *node = _entries.first();
-				for (unsigned i = 0; i < index && node; node = node->next(), i++);
-
 				/* index out of range */
-				if (!node)
+				if (index >= _num_entries)
 					return 0;
 
+				Node *node = _nodes[index];
+
 				Directory_entry *e = (Directory_entry *)(dst);
 
 				if (dynamic_cast<File      *>(node)) e->type = Directory_entry::TYPE_FILE;
@@ -13,6 +13,7 @@
 /* local includes */
 #include <node.h>
 #include <chunk.h>
+#include <mapping.h>
 
 namespace File_system {
 
@@ -20,7 +21,7 @@ namespace File_system {
 	{
 		private:
 
-			typedef Chunk<4096>                     Chunk_level_3;
+			typedef Page_chunk                      Chunk_level_3;
 			typedef Chunk_index<128, Chunk_level_3> Chunk_level_2;
 			typedef Chunk_index<64,  Chunk_level_2> Chunk_level_1;
 			typedef Chunk_index<64,  Chunk_level_1> Chunk_level_0;
@@ -29,10 +30,31 @@ namespace File_system {
 
 			file_size_t _length;
 
+			bool _mapped; /* file has been mapped at least once */
+
+			/**
+			 * Functor for adding the pages of the file to a mapping
+			 */
+			struct Add_page
+			{
+				Mapping &mapping;
+
+				Add_page(Mapping &mapping) : mapping(mapping) { }
+
+				void operator () (Chunk_level_3 &chunk) {
+					mapping.add(chunk.base_offset(), chunk.page()); }
+			};
+
 		public:
 
 			File(Allocator &alloc, char const *name)
-			: _chunk(alloc, 0), _length(0) { Node::name(name); }
+			: _chunk(alloc, 0), _length(0), _mapped(false) { Node::name(name); }
+
+			~File()
+			{
+				if (_mapped)
+					Mapping_registry::registry().dissolve(this);
+			}
 
 			size_t read(char *dst, size_t len, seek_off_t seek_offset)
 			{
@@ -84,13 +106,48 @@ namespace File_system {
 				 * by zero chunks, which do not contribute to 'used_size()'.
 				 */
 				_length = max(_length, seek_offset + len);
-				return 0;
+				return len;
 			}
 
 			file_size_t length() const { return _length; }
 
+			/**
+			 * Create mapping of the file range at the page-aligned 'offset'
+			 *
+			 * The pages of the range get allocated if needed. Only the pages
+			 * that lie within the current file length become part of the
+			 * mapping.
+			 *
+			 * \throw Allocator::Out_of_memory
+			 */
+			Mapping *map(void const *owner, seek_off_t offset, size_t size)
+			{
+				Mapping *mapping = new (&Mapping::heap())
+					Mapping(owner, this, offset, size, _length);
+
+				try {
+					if (offset < _length) {
+						Add_page add_page(*mapping);
+						_chunk.populate(min((file_size_t)size, _length - offset),
+						                offset, add_page);
+					}
+					mapping->attach();
+				} catch (...) {
+					destroy(&Mapping::heap(), mapping);
+					throw;
+				}
+
+				_mapped = true;
+				Mapping_registry::registry().insert(mapping);
+				return mapping;
+			}
+
 			void truncate(file_size_t size)
 			{
+				/* the pages beyond 'size' must not be accessed via mappings */
+				if (_mapped && size < _length)
+					Mapping_registry::registry().truncate(this, size);
+
 				if (size < _chunk.used_size())
 					_chunk.truncate(size);
 
@@ -0,0 +1,161 @@
+/*
+ * \brief  Cache of path lookups
+ * \author Martin Stein
+ * \date   2013-02-15
+ */
+
+/*
+ * Copyright (C) 2013 Genode Labs GmbH
+ *
+ * This file is part of the Genode OS framework, which is distributed
+ * under the terms of the GNU General Public License version 2.
+ */
+
+#ifndef _LOOKUP_CACHE_H_
+#define _LOOKUP_CACHE_H_
+
+/* Genode includes */
+#include <base/lock.h>
+#include <util/string.h>
+
+/* local includes */
+#include <node.h>
+
+namespace File_system {
+
+	/**
+	 * Direct-mapped cache of the results of path lookups
+	 *
+	 * Each entry holds the node found for a path relative to a directory,
+	 * or the failure of the lookup. Any change of a directory invalidates
+	 * all entries at once by advancing the generation of the cache.
+	 */
+	class Lookup_cache
+	{
+		public:
+
+			enum Result { UNKNOWN, FOUND, NOT_FOUND };
+
+		private:
+
+			enum { MAX_PATH_LEN = 128 }; /* longer paths are not cached */
+
+			struct Entry
+			{
+				Node const    *dir;
+				bool           parent;
+				unsigned long  generation;
+				Node          *node;     /* 0 if the lookup failed */
+				char           path[MAX_PATH_LEN];
+			};
+
+			Entry         *_entries;
+			unsigned       _num_entries; /* power of two */
+			unsigned long  _generation;
+			Lock           _lock;
+
+			static Lookup_cache *&_cache()
+			{
+				static Lookup_cache *cache;
+				return cache;
+			}
+
+			Entry &_entry(Node const *dir, char const *path, bool parent)
+			{
+				/* FNV-1a */
+				unsigned h = 2166136261U ^ (unsigned)(addr_t)dir ^ parent;
+				for (; *path; path++)
+					h = (h ^ (unsigned char)*path) * 16777619U;
+				return _entries[h & (_num_entries - 1)];
+			}
+
+		public:
+
+			/**
+			 * Constructor
+			 *
+			 * \param num_entries  number of entries, rounded down to a
+			 *                     power of two
+			 */
+			Lookup_cache(Allocator &alloc, unsigned num_entries)
+			: _num_entries(1), _generation(1)
+			{
+				while (2 * _num_entries <= num_entries) _num_entries *= 2;
+
+				_entries = new (&alloc) Entry[_num_entries];
+				for (unsigned i = 0; i < _num_entries; i++)
+					_entries[i].generation = 0;
+			}
+
+			/**
+			 * Return cache used by all directories, 0 if disabled
+			 */
+			static Lookup_cache *cache() { return _cache(); }
+
+			/**
+			 * Enable cache for all directories
+			 */
+			static void cache(Lookup_cache *cache) { _cache() = cache; }
+
+			/**
+			 * Invalidate all entries, to be called on each directory change
+			 */
+			static void invalidate()
+			{
+				Lookup_cache * const cache = _cache();
+				if (!cache) return;
+
+				Lock::Guard guard(cache->_lock);
+				cache->_generation++;
+			}
+
+			/**
+			 * Look up result of a path lookup
+			 *
+			 * \param node        found node if the result is 'FOUND'
+			 * \param generation  generation to pass to 'insert' if the
+			 *                    result is 'UNKNOWN'
+			 */
+			Result lookup(Node const *dir, char const *path, bool parent,
+			              Node **node, unsigned long *generation)
+			{
+				Lock::Guard guard(_lock);
+
+				*generation = _generation;
+
+				Entry const &e = _entry(dir, path, parent);
+				if (e.generation != _generation || e.dir != dir ||
+				    e.parent != parent || strcmp(e.path, path) != 0)
+					return UNKNOWN;
+
+				*node = e.node;
+				return e.node ? FOUND : NOT_FOUND;
+			}
+
+			/**
+			 * Remember result of a path lookup
+			 *
+			 * The result is dropped if a directory changed since the
+			 * 'lookup' that returned 'generation'.
+			 *
+			 * \param node  found node, or 0 if the lookup failed
+			 */
+			void insert(Node const *dir, char const *path, bool parent,
+			            Node *node, unsigned long generation)
+			{
+				Lock::Guard guard(_lock);
+
+				if (generation != _generation || strlen(path) >= MAX_PATH_LEN)
+					return;
+
+				Entry &e = _entry(dir, path, parent);
+				e.dir        = dir;
+				e.parent     = parent;
+				e.generation = generation;
+				e.node       = node;
+				strncpy(e.path, path, sizeof(e.path));
+			}
+	};
+}
+
+#endif /* _LOOKUP_CACHE_H_ */
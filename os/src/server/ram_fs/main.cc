@@ -5,7 +5,7 @@
  */
 
 /*
- * Copyright (C) 2012 Genode Labs GmbH
+ * Copyright (C) 2012-2013 Genode Labs GmbH
  *
  * This file is part of the Genode OS framework, which is distributed
  * under the terms of the GNU General Public License version 2.
@@ -217,6 +217,9 @@ namespace File_system {
 			 */
 			~Session_component()
 			{
+				while (Mapping *mapping = Mapping_registry::registry().remove(this))
+					destroy(&Mapping::heap(), mapping);
+
 				Dataspace_capability ds = tx_sink()->dataspace();
 				env()->ram_session()->free(static_cap_cast<Ram_dataspace>(ds));
 			}
@@ -318,7 +321,7 @@ namespace File_system {
 						throw Node_already_exists();
 
 					try {
-						parent->adopt_unsynchronized(new (env()->heap()) Directory(name));
+						parent->adopt_unsynchronized(new (env()->heap()) Directory(*env()->heap(), name));
 					} catch (Allocator::Out_of_memory) {
 						throw No_space();
 					}
@@ -426,15 +429,48 @@ namespace File_system {
 
 				Node *node = from_dir->lookup_and_lock(from_name.string());
 				Node_lock_guard node_guard(*node);
-				node->name(to_name.string());
 
 				if (!_handle_registry.refer_to_same_node(from_dir_handle, to_dir_handle)) {
 					Directory *to_dir = _handle_registry.lookup_and_lock(to_dir_handle);
 					Node_lock_guard to_dir_guard(*to_dir);
 
 					from_dir->discard_unsynchronized(node);
+					node->name(to_name.string());
 					to_dir->adopt_unsynchronized(node);
+				} else
+					from_dir->rename_unsynchronized(node, to_name.string());
+			}
+
+			Dataspace_capability dataspace(File_handle file_handle, Mode mode,
+			                               seek_off_t offset, size_t size)
+			{
+				if (mode != READ_ONLY && !_writable)
+					throw Permission_denied();
+
+				/*
+				 * The dataspace cannot be write-protected. So, sessions
+				 * without write permission have to read via packets.
+				 */
+				if (!_writable || !size || offset % Page_pool::PAGE_SIZE)
+					return Dataspace_capability();
+
+				File *file = _handle_registry.lookup_and_lock(file_handle);
+				Node_lock_guard file_guard(*file);
+
+				try {
+					return file->map(this, offset, size)->dataspace();
 				}
+				catch (Allocator::Out_of_memory) { throw No_space(); }
+
+				/* the platform does not support managed dataspaces */
+				catch (...) { return Dataspace_capability(); }
+			}
+
+			void release(Dataspace_capability ds)
+			{
+				Mapping *mapping = Mapping_registry::registry().remove(this, ds);
+				if (mapping)
+					destroy(&Mapping::heap(), mapping);
 			}
 	};
 
@@ -604,7 +640,7 @@ static void preload_content(Genode::Allocator      &alloc,
 		 */
 		if (sub_node.has_type("dir")) {
 
-			Directory *sub_dir = new (&alloc) Directory(name);
+			Directory *sub_dir = new (&alloc) Directory(alloc, name);
 
 			/* traverse into the new directory */
 			preload_content(alloc, sub_node, *sub_dir);
@@ -655,7 +691,18 @@ int main(int, char **)
 	static Rpc_entrypoint ep(&cap, STACK_SIZE, "ram_fs_ep");
 	static Sliced_heap sliced_heap(env()->ram_session(), env()->rm_session());
 	static Signal_receiver sig_rec;
-	static Directory root_dir("");
+	static Directory root_dir(*env()->heap(), "");
+
+	/* enable cache of path lookups if configured */
+	try {
+		unsigned entries = 0;
+		config()->xml_node().sub_node("lookup_cache").attribute("entries").value(&entries);
+		if (entries)
+			Lookup_cache::cache(new (env()->heap()) Lookup_cache(*env()->heap(), entries));
+	}
+	catch (Xml_node::Nonexistent_sub_node) { }
+	catch (Xml_node::Nonexistent_attribute) { }
+	catch (Config::Invalid) { }
 
 	/* preload RAM file system with content as declared in the config */
 	try {
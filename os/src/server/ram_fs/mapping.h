@@ -0,0 +1,286 @@
+/*
+ * \brief  Dataspace that refers to the content of a file
+ * \author Martin Stein
+ * \date   2013-02-18
+ */
+
+/*
+ * Copyright (C) 2013 Genode Labs GmbH
+ *
+ * This file is part of the Genode OS framework, which is distributed
+ * under the terms of the GNU General Public License version 2.
+ */
+
+#ifndef _MAPPING_H_
+#define _MAPPING_H_
+
+/* Genode includes */
+#include <base/heap.h>
+#include <rm_session/connection.h>
+#include <util/list.h>
+
+/* local includes */
+#include <page_chunk.h>
+
+namespace File_system {
+
+	/**
+	 * Managed dataspace with the pages of a file range attached
+	 *
+	 * The pages of the file are attached in runs of pages that are
+	 * contiguous within the same dataspace of the 'Page_pool'.
+	 */
+	class Mapping : public List<Mapping>::Element
+	{
+		private:
+
+			enum { PAGE_SIZE = Page_pool::PAGE_SIZE };
+
+			struct Run
+			{
+				seek_off_t      offset; /* file offset */
+				size_t          size;
+				Page_pool::Page page;   /* first page */
+			};
+
+			void const    *_owner;
+			void const    *_file;
+			seek_off_t     _offset;
+			size_t         _size;
+			Rm_connection  _rm;
+			size_t const   _max_runs;
+			Run           *_runs;
+			unsigned       _num_runs;
+
+			static size_t _num_pages(seek_off_t offset, size_t size,
+			                         file_size_t file_size)
+			{
+				if (offset >= file_size)
+					return 0;
+
+				return align_addr(min((file_size_t)size, file_size - offset), 12)
+				       / PAGE_SIZE;
+			}
+
+			void _attach(Run const &run)
+			{
+				_rm.attach_at(run.page.dataspace(), run.offset - _offset,
+				              run.size, run.page.offset());
+			}
+
+			void _detach(Run const &run) { _rm.detach(run.offset - _offset); }
+
+		public:
+
+			/**
+			 * Return heap for mappings and their runs
+			 *
+			 * Mappings get created and destroyed per request by the
+			 * entrypoint, which allocates from its magazines without
+			 * taking the heap lock.
+			 */
+			static Allocator &heap()
+			{
+				struct Mapping_heap : Heap
+				{
+					Mapping_heap() : Heap(env()->ram_session(), env()->rm_session()) {
+						enable_magazines(); }
+				};
+
+				static Mapping_heap heap;
+				return heap;
+			}
+
+			/**
+			 * Constructor
+			 *
+			 * \param owner   session that requested the mapping
+			 * \param file    file that gets mapped
+			 * \param offset  page-aligned file offset of the mapping
+			 * \param size       size of the mapping in bytes
+			 * \param file_size  current size of the file
+			 */
+			Mapping(void const *owner, void const *file,
+			        seek_off_t offset, size_t size, file_size_t file_size)
+			:
+				_owner(owner), _file(file), _offset(offset),
+				_size(align_addr(size, 12)), _rm(0, _size),
+				_max_runs(_num_pages(offset, size, file_size)),
+				_runs(_max_runs ? (Run *)heap().alloc(_max_runs*sizeof(Run)) : 0),
+				_num_runs(0)
+			{ }
+
+			~Mapping()
+			{
+				if (_runs)
+					heap().free(_runs, _max_runs*sizeof(Run));
+			}
+
+			void const *owner() const { return _owner; }
+			void const *file()  const { return _file; }
+
+			/**
+			 * Add page at file offset 'offset' to the mapping
+			 *
+			 * The pages must be added in ascending order and become
+			 * accessible with the next call of 'attach'.
+			 */
+			void add(seek_off_t offset, Page_pool::Page page)
+			{
+				if (offset < _offset || offset - _offset >= _size)
+					return;
+
+				Run *last = _num_runs ? &_runs[_num_runs - 1] : 0;
+				if (last && last->offset + last->size == offset
+				 && last->page.block == page.block
+				 && last->page.addr + last->size == page.addr) {
+					last->size += PAGE_SIZE;
+					return;
+				}
+
+				if (_num_runs == _max_runs)
+					return;
+
+				Run &run = _runs[_num_runs++];
+				run.offset = offset;
+				run.size   = PAGE_SIZE;
+				run.page   = page;
+			}
+
+			/**
+			 * Attach all added pages to the managed dataspace
+			 */
+			void attach()
+			{
+				for (unsigned i = 0; i < _num_runs; i++)
+					_attach(_runs[i]);
+			}
+
+			/**
+			 * Detach the pages that are not within the file size anymore
+			 *
+			 * Must be called before the pages get released.
+			 */
+			void truncate(file_size_t size)
+			{
+				seek_off_t const end = align_addr(size, 12);
+
+				while (_num_runs) {
+					Run &run = _runs[_num_runs - 1];
+
+					if (run.offset + run.size <= end)
+						return;
+
+					_detach(run);
+
+					if (run.offset >= end) {
+						_num_runs--;
+						continue;
+					}
+
+					/* keep the leading pages of the run */
+					run.size = end - run.offset;
+					_attach(run);
+					return;
+				}
+			}
+
+			/**
+			 * Detach all pages of a file that gets destroyed
+			 */
+			void dissolve()
+			{
+				truncate(0);
+				_file = 0;
+			}
+
+			Dataspace_capability dataspace() { return _rm.dataspace(); }
+	};
+
+
+	/**
+	 * Mappings of all sessions
+	 */
+	class Mapping_registry
+	{
+		private:
+
+			Lock          _lock;
+			List<Mapping> _mappings;
+
+		public:
+
+			static Mapping_registry &registry()
+			{
+				static Mapping_registry registry;
+				return registry;
+			}
+
+			void insert(Mapping *mapping)
+			{
+				Lock::Guard guard(_lock);
+				_mappings.insert(mapping);
+			}
+
+			/**
+			 * Remove mapping of 'owner' that provides 'ds'
+			 *
+			 * \return removed mapping or 0 if there is none
+			 */
+			Mapping *remove(void const *owner, Dataspace_capability ds)
+			{
+				Lock::Guard guard(_lock);
+
+				for (Mapping *m = _mappings.first(); m; m = m->next())
+					if (m->owner() == owner
+					 && m->dataspace().local_name() == ds.local_name()) {
+						_mappings.remove(m);
+						return m;
+					}
+				return 0;
+			}
+
+			/**
+			 * Remove any mapping of 'owner'
+			 *
+			 * \return removed mapping or 0 if there is none
+			 */
+			Mapping *remove(void const *owner)
+			{
+				Lock::Guard guard(_lock);
+
+				for (Mapping *m = _mappings.first(); m; m = m->next())
+					if (m->owner() == owner) {
+						_mappings.remove(m);
+						return m;
+					}
+				return 0;
+			}
+
+			/**
+			 * Adapt the mappings of 'file' to a new file size
+			 */
+			void truncate(void const *file, file_size_t size)
+			{
+				Lock::Guard guard(_lock);
+
+				for (Mapping *m = _mappings.first(); m; m = m->next())
+					if (m->file() == file)
+						m->truncate(size);
+			}
+
+			/**
+			 * Detach all pages of 'file' from the mappings
+			 */
+			void dissolve(void const *file)
+			{
+				Lock::Guard guard(_lock);
+
+				for (Mapping *m = _mappings.first(); m; m = m->next())
+					if (m->file() == file)
+						m->dissolve();
+			}
+	};
+}
+
+#endif /* _MAPPING_H_ */
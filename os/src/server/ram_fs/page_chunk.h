@@ -0,0 +1,240 @@
+/*
+ * \brief  Chunk of file content that occupies a page of a RAM dataspace
+ * \author Martin Stein
+ * \date   2013-02-18
+ */
+
+/*
+ * Copyright (C) 2013 Genode Labs GmbH
+ *
+ * This file is part of the Genode OS framework, which is distributed
+ * under the terms of the GNU General Public License version 2.
+ */
+
+#ifndef _PAGE_CHUNK_H_
+#define _PAGE_CHUNK_H_
+
+/* Genode includes */
+#include <base/env.h>
+#include <base/lock.h>
+
+/* local includes */
+#include <chunk.h>
+
+namespace File_system {
+
+	/**
+	 * Pool of pages that are backed by RAM dataspaces
+	 *
+	 * Because each page is part of a dataspace, the pages can be attached
+	 * to managed dataspaces that are handed out to clients.
+	 */
+	class Page_pool
+	{
+		public:
+
+			enum { PAGE_SIZE  = 4096,
+			       BLOCK_SIZE = 256*PAGE_SIZE /* size of one RAM dataspace */ };
+
+			struct Block
+			{
+				Ram_dataspace_capability  ds;
+				char                     *base; /* local address */
+			};
+
+			struct Page
+			{
+				char  *addr;
+				Block *block;
+
+				Page() : addr(0), block(0) { }
+
+				Page(char *addr, Block *block) : addr(addr), block(block) { }
+
+				Dataspace_capability dataspace() const { return block->ds; }
+
+				/**
+				 * Return offset of page within its dataspace
+				 */
+				off_t offset() const { return addr - block->base; }
+			};
+
+		private:
+
+			/**
+			 * Meta data of a free page, stored within the page
+			 */
+			struct Free_page
+			{
+				Free_page *next;
+				Block     *block;
+			};
+
+			Lock        _lock;
+			Allocator  &_md_alloc;
+			Free_page  *_free;    /* pages released by 'free' */
+			Block      *_current; /* block that gets handed out page by page */
+			size_t      _used;    /* bytes handed out from '_current' */
+
+		public:
+
+			Page_pool(Allocator &md_alloc)
+			: _md_alloc(md_alloc), _free(0), _current(0), _used(0) { }
+
+			/**
+			 * Return pool used for the content of all files
+			 */
+			static Page_pool &pool()
+			{
+				static Page_pool pool(*env()->heap());
+				return pool;
+			}
+
+			/**
+			 * Allocate page
+			 *
+			 * Pages of a fresh block are handed out in ascending order, so
+			 * that the pages of a sequentially written file are likely
+			 * contiguous within the dataspace.
+			 *
+			 * \throw Allocator::Out_of_memory
+			 */
+			Page alloc()
+			{
+				Lock::Guard guard(_lock);
+
+				if (_free) {
+					Free_page * const page = _free;
+					_free = page->next;
+					return Page((char *)page, page->block);
+				}
+
+				if (!_current || _used == BLOCK_SIZE) {
+					Block *block = new (&_md_alloc) Block;
+					try {
+						block->ds   = env()->ram_session()->alloc(BLOCK_SIZE);
+						block->base = env()->rm_session()->attach(block->ds);
+					} catch (...) {
+						if (block->ds.valid())
+							env()->ram_session()->free(block->ds);
+						destroy(&_md_alloc, block);
+						throw Allocator::Out_of_memory();
+					}
+					_current = block;
+					_used    = 0;
+				}
+
+				Page page(_current->base + _used, _current);
+				_used += PAGE_SIZE;
+				return page;
+			}
+
+			void free(Page page)
+			{
+				Lock::Guard guard(_lock);
+
+				Free_page * const free_page = (Free_page *)page.addr;
+				free_page->next  = _free;
+				free_page->block = page.block;
+				_free = free_page;
+			}
+	};
+
+
+	/**
+	 * Chunk of bytes used as leaf in hierarchy of chunk indices
+	 *
+	 * In contrast to 'Chunk', the content is stored in a page of the
+	 * 'Page_pool'.
+	 */
+	class Page_chunk : public Chunk_base
+	{
+		private:
+
+			Page_pool::Page _page;
+
+		public:
+
+			enum { SIZE = Page_pool::PAGE_SIZE };
+
+			/**
+			 * Construct byte chunk
+			 *
+			 * \param base_offset  absolute offset of chunk in bytes
+			 *
+			 * \throw Allocator::Out_of_memory
+			 */
+			Page_chunk(Allocator &, seek_off_t base_offset)
+			:
+				Chunk_base(base_offset), _page(Page_pool::pool().alloc())
+			{
+				memset(_page.addr, 0, SIZE);
+			}
+
+			/**
+			 * Construct zero chunk
+			 */
+			Page_chunk() { }
+
+			~Page_chunk()
+			{
+				if (_page.addr)
+					Page_pool::pool().free(_page);
+			}
+
+			Page_pool::Page page() const { return _page; }
+
+			/**
+			 * Return number of used bytes, see 'Chunk::used_size'
+			 */
+			file_size_t used_size() const { return _num_entries; }
+
+			void write(char const *src, size_t len, seek_off_t seek_offset)
+			{
+				assert_valid_range(seek_offset, len, SIZE);
+
+				/* offset relative to this chunk */
+				seek_off_t const local_offset = seek_offset - base_offset();
+
+				memcpy(_page.addr + local_offset, src, len);
+
+				_num_entries = max(_num_entries, local_offset + len);
+			}
+
+			void read(char *dst, size_t len, seek_off_t seek_offset) const
+			{
+				assert_valid_range(seek_offset, len, SIZE);
+
+				memcpy(dst, _page.addr + (seek_offset - base_offset()), len);
+			}
+
+			void truncate(file_size_t size)
+			{
+				assert_valid_range(size, 0, SIZE);
+
+				seek_off_t const local_offset = size - base_offset();
+
+				if (local_offset >= _num_entries)
+					return;
+
+				memset(_page.addr + local_offset, 0, _num_entries - local_offset);
+
+				_num_entries = local_offset;
+			}
+
+			/**
+			 * Make range part of the used size, see 'Chunk::populate'
+			 */
+			template <typename FUNC>
+			void populate(size_t len, seek_off_t seek_offset, FUNC &fn)
+			{
+				assert_valid_range(seek_offset, len, SIZE);
+
+				_num_entries = max(_num_entries,
+				                   (size_t)(seek_offset - base_offset()) + len);
+				fn(*this);
+			}
+	};
+}
+
+#endif /* _PAGE_CHUNK_H_ */
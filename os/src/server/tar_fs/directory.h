@@ -6,7 +6,7 @@
  */
 
 /*
- * Copyright (C) 2012 Genode Labs GmbH
+ * Copyright (C) 2012-2013 Genode Labs GmbH
  *
  * This file is part of the Genode OS framework, which is distributed
  * under the terms of the GNU General Public License version 2.
@@ -47,8 +47,7 @@ namespace File_system {
 
 				int64_t index = seek_offset / sizeof(Directory_entry);
 
-				Lookup_member_of_path lookup_criterion(_record->name(), index);
-				Record *record = _lookup(&lookup_criterion);
+				Record *record = _index->member(_record->name(), index);
 				if (!record)
 					return 0;
 
@@ -1,12 +1,12 @@
 /*
- * \brief  TAR record lookup function
+ * \brief  TAR record lookup
  * \author Norman Feske
  * \author Christian Prochaska
  * \date   2012-08-20
  */
 
 /*
- * Copyright (C) 2012 Genode Labs GmbH
+ * Copyright (C) 2012-2013 Genode Labs GmbH
  *
  * This file is part of the Genode OS framework, which is distributed
  * under the terms of the GNU General Public License version 2.
@@ -16,6 +16,7 @@
 #define _LOOKUP_H_
 
 /* Genode includes */
+#include <base/env.h>
 #include <os/path.h>
 
 /* local includes */
@@ -23,102 +24,292 @@
 
 namespace File_system {
 
-	extern char  *_tar_base;
-	extern size_t _tar_size;
-
 	typedef Genode::Path<File_system::MAX_PATH_LEN> Absolute_path;
 
-	struct Lookup_criterion { virtual bool match(char const *path) = 0; };
-
-	struct Lookup_exact : public Lookup_criterion
-	{
-		Absolute_path _match_path;
-
-		Lookup_exact(char const *match_path)
-		: _match_path(match_path)
-		{
-			_match_path.remove_trailing('/');
-		}
-
-		bool match(char const *path)
-		{
-			Absolute_path test_path(path);
-			test_path.remove_trailing('/');
-			return _match_path.equals(test_path);
-		}
-	};
-
-
 	/**
-	 * Lookup the Nth record in the specified path
+	 * Index of the records of a TAR archive by their path
+	 *
+	 * The index is built once when the archive gets attached. Records are
+	 * found via a hash table of their normalized paths. Each record refers
+	 * to an array of the records within its directory, in archive order.
 	 */
-	struct Lookup_member_of_path : public Lookup_criterion
+	class Index
 	{
-		Absolute_path _dir_path;
-		int const index;
-		int cnt;
-
-		Lookup_member_of_path(char const *dir_path, int index)
-		: _dir_path(dir_path), index(index), cnt(0)
-		{
-			_dir_path.remove_trailing('/');
-		}
-
-		bool match(char const *path)
-		{
-			Absolute_path test_path(path);
-
-			if (!test_path.strip_prefix(_dir_path.base()))
-				return false;
-
-			if (!test_path.has_single_element())
-				return false;
-
-			cnt++;
-
-			/* match only if index is reached */
-			if (cnt - 1 != index)
-				return false;
-
-			return true;
-		}
+		private:
+
+			struct Entry
+			{
+				Record       *record;
+				char const   *path;          /* normalized path */
+				Entry        *hash_next;     /* next entry of the same bucket */
+				Entry        *parent;
+				Entry       **children;
+				unsigned      num_children;
+			};
+
+			Entry     *_entries;
+			unsigned   _num_entries;
+			Entry    **_buckets;
+			unsigned   _num_buckets;   /* power of two */
+			Entry    **_children;      /* child arrays of all entries */
+			char      *_paths;         /* path strings of all entries */
+			size_t     _meta_size;     /* bytes allocated for the index */
+
+			/**
+			 * Normalize path, the result starts with '/' and has no
+			 * trailing '/'
+			 */
+			static void _normalize(Absolute_path &path) {
+				path.remove_trailing('/'); }
+
+			static unsigned _hash(char const *path)
+			{
+				/* FNV-1a */
+				unsigned h = 2166136261U;
+				for (; *path; path++)
+					h = (h ^ (unsigned char)*path) * 16777619U;
+				return h;
+			}
+
+			Entry *&_bucket(char const *path) {
+				return _buckets[_hash(path) & (_num_buckets - 1)]; }
+
+			Entry *_find(char const *path)
+			{
+				for (Entry *e = _bucket(path); e; e = e->hash_next)
+					if (strcmp(e->path, path) == 0)
+						return e;
+				return 0;
+			}
+
+			Entry *_find_normalized(char const *path)
+			{
+				Absolute_path p(path);
+				_normalize(p);
+				return _find(p.base());
+			}
+
+			/**
+			 * Return entry of the directory that contains 'e'
+			 */
+			Entry *_find_parent(Entry const &e)
+			{
+				char const *last = e.path;
+				for (char const *p = e.path; *p; p++)
+					if (*p == '/') last = p;
+
+				size_t const len = last == e.path ? 1 : last - e.path;
+
+				char parent[MAX_PATH_LEN];
+				strncpy(parent, e.path, len + 1);
+				return _find(parent);
+			}
+
+			template <typename T>
+			T *_alloc(size_t num)
+			{
+				T *ptr = 0;
+				if (num && !Genode::env()->heap()->alloc(num * sizeof(T), &ptr))
+					throw Genode::Allocator::Out_of_memory();
+				_meta_size += num * sizeof(T);
+				return ptr;
+			}
+
+			/**
+			 * Call 'fn' for each record of the archive
+			 */
+			template <typename FUNC>
+			static void _for_each_record(char *tar_base, size_t tar_size, FUNC &fn)
+			{
+				/* measure size of archive in blocks */
+				size_t block_id = 0, block_cnt = tar_size/Record::BLOCK_LEN;
+
+				/* scan metablocks of archive */
+				while (block_id < block_cnt) {
+
+					Record *record = (Record *)(tar_base + block_id*Record::BLOCK_LEN);
+
+					fn(record);
+
+					size_t file_size = record->size();
+
+					/* some datablocks */       /* one metablock */
+					block_id = block_id + (file_size / Record::BLOCK_LEN) + 1;
+
+					/* round up */
+					if (file_size % Record::BLOCK_LEN != 0) block_id++;
+
+					/* check for end of tar archive */
+					if (block_id*Record::BLOCK_LEN >= tar_size)
+						break;
+
+					/* lookout for empty eof-blocks */
+					if (*(tar_base + (block_id*Record::BLOCK_LEN)) == 0x00)
+						if (*(tar_base + (block_id*Record::BLOCK_LEN + 1)) == 0x00)
+							break;
+				}
+			}
+
+			struct Count
+			{
+				unsigned records;
+				size_t   path_bytes;
+
+				Count() : records(0), path_bytes(0) { }
+
+				void operator () (Record *record)
+				{
+					records++;
+
+					/* the name field is not zero-terminated if it is full */
+					size_t len = 0;
+					while (len < 100 && record->name()[len]) len++;
+
+					/* a leading slash and the terminating zero get added */
+					path_bytes += len + 2;
+				}
+			};
+
+			struct Insert
+			{
+				Index &index;
+				char  *path_buf;
+
+				Insert(Index &index, char *path_buf)
+				: index(index), path_buf(path_buf) { }
+
+				void operator () (Record *record)
+				{
+					/* the name field is not zero-terminated if it is full */
+					char name[100 + 1];
+					strncpy(name, record->name(), sizeof(name));
+
+					Absolute_path path(name);
+					_normalize(path);
+
+					Entry &e = index._entries[index._num_entries++];
+					e.record       = record;
+					e.path         = path_buf;
+					e.hash_next    = 0;
+					e.parent       = 0;
+					e.children     = 0;
+					e.num_children = 0;
+
+					size_t const len = strlen(path.base()) + 1;
+					strncpy(path_buf, path.base(), len);
+					path_buf += len;
+
+					/* the first record of a path wins */
+					Entry *&bucket = index._bucket(e.path);
+					if (index._find(e.path)) {
+						e.record = 0;
+						return;
+					}
+					e.hash_next = bucket;
+					bucket      = &e;
+				}
+			};
+
+		public:
+
+			Index(char *tar_base, size_t tar_size)
+			:
+				_entries(0), _num_entries(0), _buckets(0), _num_buckets(1),
+				_children(0), _paths(0), _meta_size(0)
+			{
+				Count count;
+				_for_each_record(tar_base, tar_size, count);
+
+				while (_num_buckets < count.records + 1) _num_buckets <<= 1;
+
+				_entries = _alloc<Entry>(count.records + 1);
+				_buckets = _alloc<Entry *>(_num_buckets);
+				_paths   = _alloc<char>(count.path_bytes);
+				for (unsigned i = 0; i < _num_buckets; i++) _buckets[i] = 0;
+
+				Insert insert(*this, _paths);
+				_for_each_record(tar_base, tar_size, insert);
+
+				/*
+				 * The root directory may be missing in the archive but its
+				 * members must be listed anyway.
+				 */
+				if (!_find("/")) {
+					Entry &root = _entries[_num_entries++];
+					root.record       = 0;
+					root.path         = "/";
+					root.parent       = 0;
+					root.children     = 0;
+					root.num_children = 0;
+					root.hash_next    = _bucket(root.path);
+					_bucket(root.path) = &root;
+				}
+
+				/* count the members of each directory */
+				unsigned num_children = 0;
+				for (unsigned i = 0; i < _num_entries; i++) {
+					Entry &e = _entries[i];
+					if (!e.record || strcmp(e.path, "/") == 0) continue;
+
+					e.parent = _find_parent(e);
+					if (!e.parent) continue;
+
+					e.parent->num_children++;
+					num_children++;
+				}
+
+				/* assign the child arrays */
+				_children = _alloc<Entry *>(num_children);
+				Entry **children = _children;
+				for (unsigned i = 0; i < _num_entries; i++) {
+					Entry &e = _entries[i];
+					e.children     = children;
+					children      += e.num_children;
+					e.num_children = 0;
+				}
+				for (unsigned i = 0; i < _num_entries; i++) {
+					Entry &e = _entries[i];
+					if (e.parent)
+						e.parent->children[e.parent->num_children++] = &e;
+				}
+			}
+
+			/**
+			 * Return record of 'path', or 0 if the archive has none
+			 */
+			Record *lookup(char const *path)
+			{
+				Entry const *e = _find_normalized(path);
+				return e ? e->record : 0;
+			}
+
+			/**
+			 * Return the Nth record in directory 'dir_path'
+			 */
+			Record *member(char const *dir_path, unsigned index)
+			{
+				Entry const *e = _find_normalized(dir_path);
+				return e && index < e->num_children ? e->children[index]->record : 0;
+			}
+
+			/**
+			 * Return number of records in directory 'dir_path'
+			 */
+			unsigned num_members(char const *dir_path)
+			{
+				Entry const *e = _find_normalized(dir_path);
+				return e ? e->num_children : 0;
+			}
+
+			unsigned num_entries() const { return _num_entries; }
+
+			/**
+			 * Return number of bytes allocated for the index
+			 */
+			size_t meta_size() const { return _meta_size; }
 	};
 
-	Record *_lookup(Lookup_criterion *criterion)
-	{
-		/* measure size of archive in blocks */
-		unsigned block_id = 0, block_cnt = _tar_size/Record::BLOCK_LEN;
-
-		/* scan metablocks of archive */
-		while (block_id < block_cnt) {
-
-			Record *record = (Record *)(_tar_base + block_id*Record::BLOCK_LEN);
-
-			/* get infos about current file */
-			if (criterion->match(record->name()))
-				return record;
-
-			size_t file_size = record->size();
-
-			/* some datablocks */       /* one metablock */
-			block_id = block_id + (file_size / Record::BLOCK_LEN) + 1;
-
-			/* round up */
-			if (file_size % Record::BLOCK_LEN != 0) block_id++;
-
-			/* check for end of tar archive */
-			if (block_id*Record::BLOCK_LEN >= _tar_size)
-				break;
-
-			/* lookout for empty eof-blocks */
-			if (*(_tar_base + (block_id*Record::BLOCK_LEN)) == 0x00)
-				if (*(_tar_base + (block_id*Record::BLOCK_LEN + 1)) == 0x00)
-					break;
-		}
-
-		return 0;
-	}
-
+	extern Index *_index;
 }
 
 #endif /* _LOOKUP_H_ */
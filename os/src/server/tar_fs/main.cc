@@ -6,7 +6,7 @@
  */
 
 /*
- * Copyright (C) 2012 Genode Labs GmbH
+ * Copyright (C) 2012-2013 Genode Labs GmbH
  *
  * This file is part of the Genode OS framework, which is distributed
  * under the terms of the GNU General Public License version 2.
@@ -18,6 +18,7 @@
 #include <cap_session/connection.h>
 #include <os/config.h>
 #include <os/session_policy.h>
+#include <timer_session/connection.h>
 #include <util/xml_node.h>
 
 /* local includes */
@@ -89,8 +90,7 @@ namespace Genode {
 
 namespace File_system {
 
-	char  *_tar_base;
-	size_t _tar_size;
+	Index *_index;
 
 	class Session_component : public Session_rpc_object
 	{
@@ -264,8 +264,7 @@ namespace File_system {
 
 				PDBGV("abs_path = %s", abs_path.base());
 
-				Lookup_exact lookup_criterion(abs_path.base());
-				Record *record = _lookup(&lookup_criterion);
+				Record *record = _index->lookup(abs_path.base());
 
 				if (!record) {
 					PERR("Could not find record for %s", abs_path.base());
@@ -305,8 +304,7 @@ namespace File_system {
 
 				PDBGV("abs_path = %s", abs_path.base());
 
-				Lookup_exact lookup_criterion(abs_path.base());
-				Record *record = _lookup(&lookup_criterion);
+				Record *record = _index->lookup(abs_path.base());
 
 				if (!record) {
 					PERR("Could not find record for %s", abs_path.base());
@@ -337,8 +335,7 @@ namespace File_system {
 					throw Name_too_long();
 				}
 
-				Lookup_exact lookup_criterion(abs_path.base());
-				Record *record = _lookup(&lookup_criterion);
+				Record *record = _index->lookup(abs_path.base());
 
 				if (!record) {
 					PERR("Could not find record for %s", path.string());
@@ -370,8 +367,7 @@ namespace File_system {
 
 				PDBGV("abs_path = %s", abs_path.base());
 
-				Lookup_exact lookup_criterion(abs_path.base());
-				Record *record = _lookup(&lookup_criterion);
+				Record *record = _index->lookup(abs_path.base());
 
 				if (!record) {
 					PERR("Could not find record for %s", path.string());
@@ -430,7 +426,11 @@ namespace File_system {
 
 				/* convert TAR record modes to stat modes */
 				switch (node->record()->type()) {
-					case Record::TYPE_DIR:     status.mode |= Status::MODE_DIRECTORY; break;
+					case Record::TYPE_DIR:
+						status.mode |= Status::MODE_DIRECTORY;
+						status.size  = _index->num_members(node->record()->name())
+						             * sizeof(Directory_entry);
+						break;
 					case Record::TYPE_FILE:    status.mode |= Status::MODE_FILE; break;
 					case Record::TYPE_SYMLINK: status.mode |= Status::MODE_SYMLINK; break;
 					default:
@@ -466,6 +466,12 @@ namespace File_system {
 
 				throw Permission_denied();
 			}
+
+			/* the file content is not available as dataspace */
+			Dataspace_capability dataspace(File_handle, Mode, seek_off_t, size_t) {
+				return Dataspace_capability(); }
+
+			void release(Dataspace_capability) { }
 	};
 
 
@@ -511,9 +517,7 @@ namespace File_system {
 							if (root[0] != '/')
 								throw Lookup_failed();
 
-							/* TODO: lookup root directory */
-							Lookup_exact lookup_criterion(root);
-							Record *record = _lookup(&lookup_criterion);
+							Record *record = _index->lookup(root);
 							if (!record) {
 								PERR("Could not find record for %s", root);
 								throw Lookup_failed();
@@ -601,20 +605,44 @@ int main(int, char **)
 	}
 
 	/* obtain dataspace of tar archive from ROM service */
+	char  *tar_base = 0;
+	size_t tar_size = 0;
 	try {
 		static Rom_connection tar_rom(tar_filename);
-		_tar_base = env()->rm_session()->attach(tar_rom.dataspace());
-		_tar_size = Dataspace_client(tar_rom.dataspace()).size();
+		tar_base = env()->rm_session()->attach(tar_rom.dataspace());
+		tar_size = Dataspace_client(tar_rom.dataspace()).size();
 	} catch (...) {
 		PERR("Could not obtain tar archive from ROM service");
 		return -2;
 	}
 
-	PINF("using tar archive '%s' with size %zd", tar_filename, _tar_size);
+	PINF("using tar archive '%s' with size %zd", tar_filename, tar_size);
 
 	static Record root_record; /* every member is 0 */
 	static Directory root_dir(&root_record);
 
+	/* the timer is optional and used for reporting the indexing time only */
+	Timer::Connection *timer = 0;
+	try { timer = new (env()->heap()) Timer::Connection(); } catch (...) { }
+	unsigned long const start_ms = timer ? timer->elapsed_ms() : 0;
+
+	try {
+		static Index index(tar_base, tar_size);
+		_index = &index;
+	} catch (Allocator::Out_of_memory) {
+		PERR("Could not allocate index of tar archive");
+		return -3;
+	}
+
+	if (timer) {
+		PINF("indexed %u records in %lu ms, index size %zu KiB",
+		     _index->num_entries(), timer->elapsed_ms() - start_ms,
+		     _index->meta_size() / 1024);
+		destroy(env()->heap(), timer);
+	} else
+		PINF("indexed %u records, index size %zu KiB",
+		     _index->num_entries(), _index->meta_size() / 1024);
+
 	static File_system::Root root(ep, sliced_heap, sig_rec, root_dir);
 
 	env()->parent()->announce(ep.manage(&root));
@@ -6,7 +6,7 @@
  */
 
 /*
- * Copyright (C) 2010-2012 Genode Labs GmbH
+ * Copyright (C) 2010-2013 Genode Labs GmbH
  *
  * This file is part of the Genode OS framework, which is distributed
  * under the terms of the GNU General Public License version 2.
@@ -17,61 +17,161 @@
 #include <root/component.h>
 #include <cap_session/connection.h>
 #include <util/arg_string.h>
+#include <util/avl_string.h>
 #include <base/rpc_server.h>
 #include <base/sleep.h>
 #include <base/env.h>
 #include <base/printf.h>
 #include <os/config.h>
+#include <rm_session/connection.h>
+
+enum { FILENAME_MAX_LEN = 128 };
 
 
 /**
- * A 'Rom_session_component' exports a single file of the tar archive
+ * File of the tar archive
+ *
+ * A managed dataspace that maps the file from the archive is read-only and
+ * thereby shared by all ROM sessions of the file. It exists as long as
+ * there are such sessions. A copy of the file, however, is a RAM dataspace
+ * that is writeable by the client. So each session gets a copy of its own.
  */
-class Rom_session_component : public Genode::Rpc_object<Genode::Rom_session>
+class Rom_file : public Genode::Avl_string<FILENAME_MAX_LEN>
 {
 	private:
 
-		const char *_tar_addr, *_filename, *_file_addr;
-		Genode::size_t _file_size, _tar_size;
-		Genode::Ram_dataspace_capability _file_ds;
+		const char                  *_file_addr;
+		Genode::size_t const         _file_size;
+		unsigned                     _users; /* sessions of the managed dataspace */
+		Genode::Rm_connection       *_rm;
 
-		enum {
-			/* length of on data block in tar */
-			_BLOCK_LEN = 512,
+		/**
+		 * Create managed dataspace that maps the file content of the archive
+		 *
+		 * \return  invalid capability if the file data is not page-aligned
+		 *          within the archive or the platform does not support
+		 *          managed dataspaces
+		 */
+		Genode::Dataspace_capability _map(Genode::Dataspace_capability tar_ds,
+		                                  char const *tar_addr,
+		                                  Genode::size_t tar_size)
+		{
+			using namespace Genode;
 
-			/* length of the header field "file-size" in tar */
-			_FIELD_SIZE_LEN = 124
-		};
+			enum { PAGE_SIZE_LOG2 = 12, PAGE_SIZE = 1 << PAGE_SIZE_LOG2 };
+
+			off_t  const offset  = _file_addr - tar_addr;
+			size_t const ds_size = align_addr(_file_size, PAGE_SIZE_LOG2);
+			if (!_file_size || offset % PAGE_SIZE || offset + ds_size > tar_size)
+				return Dataspace_capability();
+
+			try {
+				_rm = new (env()->heap()) Rm_connection(0, ds_size);
+				_rm->attach_at(tar_ds, 0, ds_size, offset);
+				if (_rm->dataspace().valid())
+					return _rm->dataspace();
+			} catch (...) { }
+
+			if (_rm)
+				destroy(env()->heap(), _rm);
+			_rm = 0;
+			return Dataspace_capability();
+		}
+
+	public:
+
+		Rom_file(const char *name, const char *file_addr, Genode::size_t file_size)
+		:
+			Genode::Avl_string<FILENAME_MAX_LEN>(name),
+			_file_addr(file_addr), _file_size(file_size), _users(0), _rm(0)
+		{ }
 
 		/**
-		 * Copy file content into dataspace
+		 * Create dataspace with a copy of the file content
 		 *
-		 * \param dst  destination dataspace
+		 * The dataspace is owned by the caller.
 		 */
-		void _copy_content_to_dataspace(Genode::Dataspace_capability dst)
+		Genode::Dataspace_capability copy()
 		{
 			using namespace Genode;
 
-			/* map dataspace locally */
-			char *dst_addr = env()->rm_session()->attach(dst);
-			Dataspace_client dst_client(dst);
+			/* try to allocate memory for file */
+			Ram_dataspace_capability file_ds;
+			try {
+				file_ds = env()->ram_session()->alloc(_file_size);
+
+				/* map dataspace locally and copy content */
+				char *dst_addr = env()->rm_session()->attach(file_ds);
+				memcpy(dst_addr, _file_addr, _file_size);
+				env()->rm_session()->detach(dst_addr);
+			} catch (...) {
+				PERR("couldn't allocate memory for file, empty result\n");
+				if (file_ds.valid())
+					env()->ram_session()->free(file_ds);
+				return Dataspace_capability();
+			}
+			return file_ds;
+		}
 
-			/* copy content */
-			size_t dst_ds_size   = Dataspace_client(dst).size();
-			size_t bytes_to_copy = min(_file_size, dst_ds_size);
-			memcpy(dst_addr, _file_addr, bytes_to_copy);
+		/**
+		 * Return shared managed dataspace that maps the file from the archive
+		 *
+		 * \return  invalid capability if the file cannot be mapped
+		 */
+		Genode::Dataspace_capability acquire_mapped(Genode::Dataspace_capability tar_ds,
+		                                            char const *tar_addr,
+		                                            Genode::size_t tar_size)
+		{
+			if (!_users && !_map(tar_ds, tar_addr, tar_size).valid())
+				return Genode::Dataspace_capability();
 
-			/* unmap dataspace */
-			env()->rm_session()->detach(dst_addr);
+			_users++;
+			return _rm->dataspace();
 		}
 
 		/**
-		 * Initialize dataspace containing the content of the archived file
+		 * Release managed dataspace of a session of the file
 		 */
-		Genode::Ram_dataspace_capability _init_file_ds()
+		void release_mapped()
 		{
-			bool file_found = false;
+			if (!_users || --_users) return;
+
+			Genode::destroy(Genode::env()->heap(), _rm);
+			_rm = 0;
+		}
+};
 
+
+/**
+ * Tar archive with an index of its files by name
+ */
+class Archive
+{
+	private:
+
+		char                            *_tar_addr;
+		Genode::size_t const             _tar_size;
+		Genode::Dataspace_capability     _tar_ds;
+		bool const                       _zero_copy;
+		Genode::Avl_tree<Genode::Avl_string_base> _files;
+		unsigned                         _num_files;
+
+		enum {
+			/* length of on data block in tar */
+			_BLOCK_LEN = 512,
+
+			/* length of the header field "file-size" in tar */
+			_FIELD_SIZE_LEN = 124,
+
+			/* length of the header field "name" in tar */
+			_FIELD_NAME_LEN = 100,
+		};
+
+		/**
+		 * Insert all files of the archive into the index
+		 */
+		void _index()
+		{
 			/* measure size of archive in blocks */
 			unsigned block_id = 0, block_cnt = _tar_size/_BLOCK_LEN;
 
@@ -82,19 +182,22 @@ class Rom_session_component : public Genode::Rpc_object<Genode::Rom_session>
 				Genode::ascii_to(_tar_addr + block_id*_BLOCK_LEN + _FIELD_SIZE_LEN,
 				                 &file_size, 8);
 
-				/* get name of tar record */
-				char const *record_filename = _tar_addr + block_id*_BLOCK_LEN;
+				/* get name of tar record, which is not zero-terminated if full */
+				char record_filename[_FIELD_NAME_LEN + 1];
+				Genode::strncpy(record_filename, _tar_addr + block_id*_BLOCK_LEN,
+				                sizeof(record_filename));
 
 				/* skip leading dot of path if present */
-				if (record_filename[0] == '.' && record_filename[1] == '/')
-					record_filename++;
-
-				/* get infos about current file */
-				if (Genode::strcmp(_filename, record_filename) == 0) {
-					_file_size = file_size;
-					_file_addr = _tar_addr + (block_id+1) * _BLOCK_LEN;
-					file_found = true;
-					break;
+				char const *name = record_filename;
+				if (name[0] == '.' && name[1] == '/')
+					name++;
+
+				/* the first record of a name wins */
+				if (!lookup(name)) {
+					_files.insert(new (Genode::env()->heap())
+					              Rom_file(name, _tar_addr + (block_id+1) * _BLOCK_LEN,
+					                       file_size));
+					_num_files++;
 				}
 
 				/* some datablocks */       /* one metablock */
@@ -112,57 +215,112 @@ class Rom_session_component : public Genode::Rpc_object<Genode::Rom_session>
 					if (*(_tar_addr + (block_id*_BLOCK_LEN + 1)) == 0x00)
 						break;
 			}
+		}
 
-			if (!file_found) {
-				PERR("couldn't find file '%s', empty result", _filename);
-				return Genode::Ram_dataspace_capability();
-			}
+	public:
 
-			/* try to allocate memory for file */
-			Genode::Ram_dataspace_capability file_ds;
-			try {
-				file_ds = Genode::env()->ram_session()->alloc(_file_size);
+		/**
+		 * Constructor
+		 *
+		 * \param zero_copy  hand out page-aligned files as managed
+		 *                   dataspaces instead of copies
+		 */
+		Archive(char *tar_addr, Genode::size_t tar_size,
+		        Genode::Dataspace_capability tar_ds, bool zero_copy)
+		:
+			_tar_addr(tar_addr), _tar_size(tar_size), _tar_ds(tar_ds),
+			_zero_copy(zero_copy), _num_files(0)
+		{
+			_index();
+		}
 
-				/* get content of file copied into dataspace and return */
-				_copy_content_to_dataspace(file_ds);
-			} catch (...) {
-				PERR("couldn't allocate memory for file, empty result\n");
-				return file_ds;
-			}
+		Rom_file *lookup(char const *name)
+		{
+			return static_cast<Rom_file *>(_files.first() ?
+			                               _files.first()->find_by_name(name) : 0);
+		}
 
-			return file_ds;
+		/**
+		 * Return dataspace for a new session of 'file'
+		 *
+		 * \param mapped  gets true if the dataspace is the shared managed
+		 *                dataspace of the file, false if it is a copy
+		 */
+		Genode::Dataspace_capability acquire(Rom_file &file, bool &mapped)
+		{
+			Genode::Dataspace_capability ds;
+			if (_zero_copy)
+				ds = file.acquire_mapped(_tar_ds, _tar_addr, _tar_size);
+
+			mapped = ds.valid();
+			return mapped ? ds : file.copy();
+		}
+
+		/**
+		 * Release dataspace of a session of 'file'
+		 */
+		void release(Rom_file &file, Genode::Dataspace_capability ds,
+		             bool mapped)
+		{
+			if (mapped)
+				file.release_mapped();
+			else
+				Genode::env()->ram_session()->free(
+					Genode::static_cap_cast<Genode::Ram_dataspace>(ds));
 		}
 
+		unsigned num_files() const { return _num_files; }
+};
+
+
+/**
+ * A 'Rom_session_component' exports a single file of the tar archive
+ */
+class Rom_session_component : public Genode::Rpc_object<Genode::Rom_session>
+{
+	private:
+
+		Archive                      &_archive;
+		Rom_file                     *_file;
+		Genode::Dataspace_capability  _file_ds;
+		bool                          _mapped;
+
 	public:
 
 		/**
-		 * Constructor scans and seeks to file
+		 * Constructor
 		 *
-		 * \param  tar_addr  local address to tar archive
-		 * \param  tar_size  size of tar archive in bytes
+		 * \param  archive   tar archive
 		 * \param  filename  name of the requested file
 		 */
-		Rom_session_component(const char *tar_addr, unsigned tar_size,
-		                      const char *filename)
+		Rom_session_component(Archive &archive, const char *filename)
 		:
-			_tar_addr(tar_addr), _filename(filename), _file_addr(0), _file_size(0),
-			_tar_size(tar_size),
-			_file_ds(_init_file_ds())
-		{ }
+			_archive(archive), _file(archive.lookup(filename)), _mapped(false)
+		{
+			if (!_file) {
+				PERR("couldn't find file '%s', empty result", filename);
+				return;
+			}
+
+			_file_ds = archive.acquire(*_file, _mapped);
+			if (!_file_ds.valid())
+				_file = 0;
+		}
 
 		/**
 		 * Destructor
 		 */
-		~Rom_session_component() { Genode::env()->ram_session()->free(_file_ds); }
+		~Rom_session_component()
+		{
+			if (_file)
+				_archive.release(*_file, _file_ds, _mapped);
+		}
 
 		/**
 		 * Return dataspace with content of file
 		 */
-		Genode::Rom_dataspace_capability dataspace()
-		{
-			Genode::Dataspace_capability ds = _file_ds;
-			return Genode::static_cap_cast<Genode::Rom_dataspace>(ds);
-		}
+		Genode::Rom_dataspace_capability dataspace() {
+			return Genode::static_cap_cast<Genode::Rom_dataspace>(_file_ds); }
 
 		void sigh(Genode::Signal_context_capability) { }
 };
@@ -172,19 +330,21 @@ class Rom_root : public Genode::Root_component<Rom_session_component>
 {
 	private:
 
-		char    *_tar_addr;
-		unsigned _tar_size;
+		Archive &_archive;
 
+		/*
+		 * Sessions are created and destroyed by the entrypoint only, so
+		 * the files need no locking.
+		 */
 		Rom_session_component *_create_session(const char *args)
 		{
-			enum { FILENAME_MAX_LEN = 128 };
 			char filename[FILENAME_MAX_LEN];
 			Genode::Arg_string::find_arg(args, "filename").string(filename, sizeof(filename), "");
 
 			PINF("connection for file '%s' requested\n", filename);
 
 			/* create new session for the requested file */
-			return new (md_alloc()) Rom_session_component(_tar_addr, _tar_size, filename);
+			return new (md_alloc()) Rom_session_component(_archive, filename);
 		}
 
 	public:
@@ -194,15 +354,14 @@ class Rom_root : public Genode::Root_component<Rom_session_component>
 		 *
 		 * \param  entrypoint  entrypoint to be used for ROM sessions
 		 * \param  md_alloc    meta-data allocator used for ROM sessions
-		 * \param  tar_base    local address of tar archive
-		 * \param  tar_size    size of tar archive in bytes
+		 * \param  archive     tar archive
 		 */
 		Rom_root(Genode::Rpc_entrypoint *entrypoint,
 		         Genode::Allocator      *md_alloc,
-		         char *tar_addr, Genode::size_t tar_size)
+		         Archive                &archive)
 		:
 			Genode::Root_component<Rom_session_component>(entrypoint, md_alloc),
-			_tar_addr(tar_addr), _tar_size(tar_size)
+			_archive(archive)
 		{ }
 };
 
@@ -214,10 +373,13 @@ int main(void)
 	/* read name of tar archive from config */
 	enum { TAR_FILENAME_MAX_LEN = 64 };
 	static char tar_filename[TAR_FILENAME_MAX_LEN];
+	bool zero_copy = false;
 	try {
 		Xml_node archive_node =
 			config()->xml_node().sub_node("archive");
 		archive_node.attribute("name").value(tar_filename, sizeof(tar_filename));
+		try { zero_copy = archive_node.attribute("zero_copy").has_value("yes"); }
+		catch (...) { }
 	} catch (...) {
 		PERR("Could not read 'filename' argument from config");
 		return -1;
@@ -226,16 +388,21 @@ int main(void)
 	/* obtain dataspace of tar archive from ROM service */
 	static char  *tar_base = 0;
 	static size_t tar_size = 0;
+	static Dataspace_capability tar_ds;
 	try {
 		static Rom_connection tar_rom(tar_filename);
-		tar_base = env()->rm_session()->attach(tar_rom.dataspace());
-		tar_size = Dataspace_client(tar_rom.dataspace()).size();
+		tar_ds   = tar_rom.dataspace();
+		tar_base = env()->rm_session()->attach(tar_ds);
+		tar_size = Dataspace_client(tar_ds).size();
 	} catch (...) {
 		PERR("Could not obtain tar archive from ROM service");
 		return -2;
 	}
 
-	PINF("using tar archive '%s' with size %zd", tar_filename, tar_size);
+	static Archive archive(tar_base, tar_size, tar_ds, zero_copy);
+
+	PINF("using tar archive '%s' with size %zd, %u files%s", tar_filename,
+	     tar_size, archive.num_files(), zero_copy ? ", zero-copy" : "");
 
 	/* connection to capability service needed to create capabilities */
 	static Cap_connection cap;
@@ -246,7 +413,7 @@ int main(void)
 
 	enum { STACK_SIZE = 8*1024 };
 	static Rpc_entrypoint ep(&cap, STACK_SIZE, "tar_rom_ep");
-	static Rom_root rom_root(&ep, &sliced_heap, tar_base, tar_size);
+	static Rom_root rom_root(&ep, &sliced_heap, archive);
 
 	/* announce server*/
 	env()->parent()->announce(ep.manage(&rom_root));
@@ -0,0 +1,98 @@
+/*
+ * \brief  Benchmark of the alarm scheduler against the number of alarms
+ * \author Martin Stein
+ * \date   2013-02-12
+ *
+ * For an increasing number of alarms, the benchmark schedules all alarms
+ * with pseudo-random deadlines, discards every second one and fires the
+ * rest. It reports the average duration of each kind of operation, which
+ * should grow at most logarithmically with the number of alarms.
+ */
+
+/*
+ * Copyright (C) 2013 Genode Labs GmbH
+ *
+ * This file is part of the Genode OS framework, which is distributed
+ * under the terms of the GNU General Public License version 2.
+ */
+
+/* Genode includes */
+#include <base/printf.h>
+#include <base/env.h>
+#include <os/alarm.h>
+#include <timer_session/connection.h>
+
+using namespace Genode;
+
+enum {
+	MAX_ALARMS = 100*1000,
+	MAX_DELAY  = 1000*1000, /* deadlines lie within this range */
+};
+
+
+struct Bench_alarm : Alarm
+{
+	static unsigned long fired;
+
+	bool on_alarm()
+	{
+		fired++;
+		return false;
+	}
+};
+
+
+unsigned long Bench_alarm::fired;
+
+
+static unsigned random()
+{
+	static unsigned seed = 1;
+	seed ^= seed << 13; seed ^= seed >> 17; seed ^= seed << 5;
+	return seed;
+}
+
+
+static void print_result(char const *op, unsigned long ops, unsigned long us) {
+	printf(", %s %lu ns", op, ops ? us * 1000 / ops : 0); }
+
+
+int main(int, char **)
+{
+	printf("--- alarm benchmark ---\n");
+
+	static Timer::Connection timer;
+	static Bench_alarm *alarms;
+	alarms = new (env()->heap()) Bench_alarm[MAX_ALARMS];
+
+	for (unsigned n = 10; n <= MAX_ALARMS; n *= 10) {
+
+		Alarm_scheduler scheduler;
+		Bench_alarm::fired = 0;
+
+		unsigned long start = timer.elapsed_us();
+		for (unsigned i = 0; i < n; i++)
+			scheduler.schedule_absolute(&alarms[i], 1 + random() % MAX_DELAY);
+		unsigned long const schedule_us = timer.elapsed_us() - start;
+
+		start = timer.elapsed_us();
+		for (unsigned i = 0; i < n; i += 2)
+			scheduler.discard(&alarms[i]);
+		unsigned long const discard_us = timer.elapsed_us() - start;
+
+		start = timer.elapsed_us();
+		scheduler.handle(MAX_DELAY + 1);
+		unsigned long const fire_us = timer.elapsed_us() - start;
+
+		printf("%u alarms: schedule/discard/fire per alarm", n);
+		print_result("schedule", n, schedule_us);
+		print_result("discard", (n + 1) / 2, discard_us);
+		print_result("fire", Bench_alarm::fired, fire_us);
+		printf("\n");
+
+		if (Bench_alarm::fired != n / 2)
+			PERR("%lu alarms fired, expected %u", Bench_alarm::fired, n / 2);
+	}
+	printf("--- end of alarm benchmark ---\n");
+	return 0;
+}
@@ -0,0 +1,3 @@
+TARGET = test-alarm_bench
+SRC_CC = main.cc
+LIBS   = cxx env alarm
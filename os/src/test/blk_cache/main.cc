@@ -0,0 +1,158 @@
+/*
+ * \brief  Test for the block cache
+ * \author Martin Stein
+ * \date   2013-02-13
+ *
+ * The test writes a pattern to the device, reads it back sequentially and
+ * at random, overwrites parts of it, and compares each read with the
+ * expected content. Between the passes, it asks the cache to write back
+ * the dirty blocks.
+ */
+
+/*
+ * Copyright (C) 2013 Genode Labs GmbH
+ *
+ * This file is part of the Genode OS framework, which is distributed
+ * under the terms of the GNU General Public License version 2.
+ */
+
+/* Genode includes */
+#include <base/allocator_avl.h>
+#include <base/printf.h>
+#include <block_session/connection.h>
+
+using namespace Genode;
+
+enum {
+	TEST_BLOCKS  = 1024, /* blocks of the device that the test uses */
+	CHUNK        = 8,    /* blocks per write request */
+	RANDOM_READS = 2048,
+};
+
+
+class Test
+{
+	private:
+
+		Allocator_avl               _alloc;
+		Block::Connection           _blk;
+		Block::Session::Tx::Source &_source;
+		size_t                      _blk_cnt;
+		size_t                      _blk_size;
+		unsigned                    _seed;
+		unsigned                    _generation; /* changes with each overwrite */
+
+		unsigned _random()
+		{
+			_seed ^= _seed << 13; _seed ^= _seed >> 17; _seed ^= _seed << 5;
+			return _seed;
+		}
+
+		/**
+		 * Expected content of the word 'i' of block 'nr'
+		 */
+		unsigned _pattern(size_t nr, size_t i) const {
+			return (unsigned)(nr * 0x9e3779b1) ^ (unsigned)i ^ (_generation << 24); }
+
+		bool _io(size_t nr, size_t cnt, bool write)
+		{
+			Block::Packet_descriptor p(_source.alloc_packet(cnt * _blk_size),
+			                           write ? Block::Packet_descriptor::WRITE
+			                                 : Block::Packet_descriptor::READ,
+			                           nr, cnt);
+
+			unsigned * const words = (unsigned *)_source.packet_content(p);
+			size_t     const per_blk = _blk_size / sizeof(unsigned);
+			if (write)
+				for (size_t b = 0; b < cnt; b++)
+					for (size_t i = 0; i < per_blk; i++)
+						words[b * per_blk + i] = _pattern(nr + b, i);
+
+			_source.submit_packet(p);
+			p = _source.get_acked_packet();
+
+			bool ok = p.succeeded();
+			if (!ok)
+				PERR("could not access blocks %zu-%zu", nr, nr + cnt - 1);
+
+			for (size_t b = 0; ok && !write && b < cnt; b++)
+				for (size_t i = 0; i < per_blk; i++)
+					if (words[b * per_blk + i] != _pattern(nr + b, i)) {
+						PERR("block %zu differs at word %zu", nr + b, i);
+						ok = false;
+						break;
+					}
+
+			_source.release_packet(p);
+			return ok;
+		}
+
+	public:
+
+		Test()
+		:
+			_alloc(env()->heap()), _blk(&_alloc), _source(*_blk.tx()),
+			_blk_cnt(0), _blk_size(0), _seed(1), _generation(0)
+		{
+			Block::Session::Operations ops;
+			_blk.info(&_blk_cnt, &_blk_size, &ops);
+		}
+
+		bool write_all()
+		{
+			_generation++;
+			for (size_t nr = 0; nr < TEST_BLOCKS; nr += CHUNK)
+				if (!_io(nr, CHUNK, true)) return false;
+			return true;
+		}
+
+		bool read_sequential()
+		{
+			for (size_t nr = 0; nr < TEST_BLOCKS; nr++)
+				if (!_io(nr, 1, false)) return false;
+			return true;
+		}
+
+		bool read_random()
+		{
+			for (unsigned i = 0; i < RANDOM_READS; i++)
+				if (!_io(_random() % TEST_BLOCKS, 1, false)) return false;
+			return true;
+		}
+
+		void sync() { _blk.sync(); }
+
+		size_t block_count() const { return _blk_cnt; }
+};
+
+
+int main(int, char **)
+{
+	printf("--- blk_cache test ---\n");
+
+	Test &test = *new (env()->heap()) Test;
+	if (test.block_count() < TEST_BLOCKS) {
+		PERR("device too small");
+		return -1;
+	}
+
+	bool ok = test.write_all()  && test.read_sequential() &&
+	          test.read_random();
+	test.sync();
+	ok = ok && test.read_sequential();
+
+	/* overwrite the cached content and check it with and without sync */
+	ok = ok && test.write_all() && test.read_random();
+	test.sync();
+	ok = ok && test.read_random();
+
+	/* closing the session lets the server print its statistics */
+	destroy(env()->heap(), &test);
+
+	if (!ok) {
+		PERR("test failed");
+		return -1;
+	}
+	printf("--- blk_cache test finished ---\n");
+	return 0;
+}
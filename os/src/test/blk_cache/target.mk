@@ -0,0 +1,3 @@
+TARGET = test-blk_cache
+LIBS   = env cxx signal
+SRC_CC = main.cc
@@ -0,0 +1,123 @@
+/*
+ * \brief  Benchmark of a block service for different queue depths
+ * \author Martin Stein
+ * \date   2013-02-12
+ *
+ * The client keeps a fixed number of single-block requests outstanding
+ * and reports the requests per second that the service completes. A
+ * random pass issues reads and writes of random blocks, which the service
+ * can't merge. A sequential pass reads adjacent blocks into adjacent
+ * payloads, which the service can merge.
+ */
+
+/*
+ * Copyright (C) 2013 Genode Labs GmbH
+ *
+ * This file is part of the Genode OS framework, which is distributed
+ * under the terms of the GNU General Public License version 2.
+ */
+
+/* Genode includes */
+#include <base/allocator_avl.h>
+#include <base/printf.h>
+#include <block_session/connection.h>
+#include <timer_session/connection.h>
+
+using namespace Genode;
+
+enum {
+	REQUESTS    = 20*1000, /* requests per measurement */
+	MAX_DEPTH   = 32,
+	TX_BUF_SIZE = 512*1024,
+};
+
+
+class Bench
+{
+	private:
+
+		Allocator_avl               _alloc;
+		Block::Connection           _blk;
+		Block::Session::Tx::Source &_source;
+		Timer::Connection           _timer;
+		size_t                      _blk_cnt;
+		size_t                      _blk_size;
+		int                         _blk_align;
+		unsigned                    _seed;
+
+		size_t _random_block()
+		{
+			_seed ^= _seed << 13; _seed ^= _seed >> 17; _seed ^= _seed << 5;
+			return _seed % _blk_cnt;
+		}
+
+	public:
+
+		Bench()
+		:
+			_alloc(env()->heap()), _blk(&_alloc, TX_BUF_SIZE),
+			_source(*_blk.tx()), _blk_cnt(0), _blk_size(0), _blk_align(0),
+			_seed(1)
+		{
+			Block::Session::Operations ops;
+			_blk.info(&_blk_cnt, &_blk_size, &ops);
+			while ((1UL << _blk_align) < _blk_size) _blk_align++;
+			printf("%zu blocks of %zu bytes\n", _blk_cnt, _blk_size);
+		}
+
+		/**
+		 * Run one measurement with 'depth' requests outstanding
+		 *
+		 * \return  false if a request failed
+		 */
+		bool measure(char const *name, unsigned const depth, bool const sequential)
+		{
+			unsigned long const start_ms = _timer.elapsed_ms();
+			unsigned submitted = 0, completed = 0;
+			size_t   block = 0;
+			bool     success = true;
+			while (completed < REQUESTS) {
+
+				for (; submitted < REQUESTS && submitted - completed < depth; submitted++) {
+
+					Block::Packet_descriptor::Opcode op = Block::Packet_descriptor::READ;
+					if (sequential)
+						block = (block + 1) % _blk_cnt;
+					else {
+						block = _random_block();
+						if (!(submitted % 4)) op = Block::Packet_descriptor::WRITE;
+					}
+					Block::Packet_descriptor const p(
+						_source.alloc_packet(_blk_size, _blk_align), op, block);
+					_source.submit_packet(p);
+				}
+				Block::Packet_descriptor const p = _source.get_acked_packet();
+				success &= p.succeeded();
+				_source.release_packet(p);
+				completed++;
+			}
+			unsigned long const ms = _timer.elapsed_ms() - start_ms;
+
+			printf("%s, depth %2u: %u requests in %lu ms, %lu requests/s\n",
+			       name, depth, REQUESTS, ms, ms ? REQUESTS * 1000UL / ms : 0);
+			return success;
+		}
+};
+
+
+int main(int, char **)
+{
+	printf("--- block benchmark ---\n");
+
+	static Bench bench;
+	for (unsigned sequential = 0; sequential < 2; sequential++)
+		for (unsigned depth = 1; depth <= MAX_DEPTH; depth *= 2)
+			if (!bench.measure(sequential ? "sequential" : "random",
+			                   depth, sequential)) {
+				PERR("request failed");
+				return -1;
+			}
+
+	printf("--- end of block benchmark ---\n");
+	return 0;
+}
@@ -0,0 +1,3 @@
+TARGET = test-block_bench
+LIBS   = env cxx signal
+SRC_CC = main.cc
@@ -0,0 +1,133 @@
+/*
+ * \brief  Test for streaming HDL FIFO ports through a data window
+ * \author Martin Stein
+ * \date   2013-01-30
+ *
+ * The design is a loopback register with a ready/valid sink and source
+ * that is clocked by the test itself, while the test also acts as the
+ * driver that writes to and reads from the rings of the window.
+ */
+
+/*
+ * Copyright (C) 2013 Genode Labs GmbH
+ *
+ * This file is part of the Genode OS framework, which is distributed
+ * under the terms of the GNU General Public License version 2.
+ */
+
+/* Genode includes */
+#include <base/env.h>
+#include <base/printf.h>
+#include <verilator_env/data_window.h>
+
+using namespace Genode;
+
+enum { WINDOW_OFFSET = 0x1000, WINDOW_SIZE = 4096, WORDS = 1000 };
+
+
+/**
+ * Loopback register in the role of a verilated design
+ */
+struct Loopback
+{
+	/* signals */
+	uint8_t  sink_valid;
+	uint8_t  sink_ready;
+	unsigned sink_data;
+	uint8_t  source_valid;
+	uint8_t  source_ready;
+	unsigned source_data;
+
+	/* state */
+	bool     full;
+	unsigned reg;
+
+	Loopback()
+	: sink_valid(0), sink_ready(0), sink_data(0), source_valid(0),
+	  source_ready(0), source_data(0), full(0), reg(0) { outputs(); }
+
+	void outputs()
+	{
+		sink_ready   = !full;
+		source_valid = full;
+		source_data  = reg;
+	}
+
+	void edge()
+	{
+		bool const take = sink_valid && sink_ready;
+		bool const give = source_valid && source_ready;
+		if (give) full = 0;
+		if (take) { reg = sink_data; full = 1; }
+		outputs();
+	}
+};
+
+
+static int test()
+{
+	Loopback design;
+	Data_window_port<unsigned> port(WINDOW_OFFSET,
+	                                &design.sink_valid, &design.sink_ready,
+	                                &design.sink_data, &design.source_valid,
+	                                &design.source_ready, &design.source_data);
+
+	/* set up the window like vinit does */
+	Ram_dataspace_capability ds = env()->ram_session()->alloc(WINDOW_SIZE);
+	Emulation::Data_window * const w = env()->rm_session()->attach(ds);
+	w->init(WINDOW_SIZE);
+
+	if (port.window(WINDOW_OFFSET + 0x100, ds)) {
+		PERR("port took window at foreign offset");
+		return -1;
+	}
+	if (!port.window(WINDOW_OFFSET, ds)) {
+		PERR("port declined its window");
+		return -2;
+	}
+
+	/* stream words through the design, in bursts that exceed the rings */
+	unsigned written = 0, read = 0;
+	for (unsigned cycle = 0; read < WORDS; cycle++) {
+
+		if (cycle > 100 * WORDS) {
+			PERR("stream stalled after %u words", read);
+			return -3;
+		}
+		if (written < WORDS && !(cycle % 64)) {
+			umword_t burst[64];
+			unsigned n = 0;
+			for (; n < 64 && written + n < WORDS; n++)
+				burst[n] = 3 * (written + n) + 1;
+			written += w->to_device.write(burst, n);
+		}
+
+		port.before_edge();
+		design.edge();
+		port.after_edge();
+
+		umword_t word;
+		while (w->from_device.read(&word, 1)) {
+			if (word != 3 * read + 1) {
+				PERR("word %u is %lx, expected %x", read, word, 3 * read + 1);
+				return -4;
+			}
+			read++;
+		}
+	}
+	if (port.to_device() || port.from_device()) {
+		PERR("words left in the window");
+		return -5;
+	}
+	printf("%u words streamed\n", read);
+	return 0;
+}
+
+
+int main()
+{
+	printf("--- data-window test ---\n");
+	int const ret = test();
+	printf("--- end of data-window test (%s) ---\n", ret ? "failed" : "ok");
+	return ret;
+}
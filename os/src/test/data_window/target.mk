@@ -0,0 +1,3 @@
+TARGET = test-data_window
+SRC_CC = main.cc
+LIBS   = env cxx
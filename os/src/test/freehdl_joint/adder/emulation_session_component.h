@@ -58,6 +58,8 @@ namespace Emulation
 				PERR("%s:%d: Invalid IRQ", __FILE__, __LINE__);
 				return 0;
 			}
+
+			bool fidelity(Fidelity const f) { return f == RTL; }
 	};
 }
 
@@ -0,0 +1,133 @@
+/*
+ * \brief  Multi-threaded benchmark of the heap and its magazine layer
+ * \author Martin Stein
+ * \date   2013-02-09
+ *
+ * Threads allocate and free small blocks at a shared heap, first without
+ * and then with magazines. The benchmark reports the alloc/free pairs per
+ * second for an increasing number of threads as well as the counters of
+ * the magazine layer.
+ */
+
+/*
+ * Copyright (C) 2013 Genode Labs GmbH
+ *
+ * This file is part of the Genode OS framework, which is distributed
+ * under the terms of the GNU General Public License version 2.
+ */
+
+/* Genode includes */
+#include <base/printf.h>
+#include <base/env.h>
+#include <base/heap.h>
+#include <base/thread.h>
+#include <base/semaphore.h>
+#include <timer_session/connection.h>
+
+using namespace Genode;
+
+enum {
+	MAX_THREADS = 8,
+	ROUNDS      = 200*1000, /* alloc/free pairs per thread */
+	WINDOW      = 64,       /* live blocks per thread */
+	STACK_SIZE  = 8*1024,
+};
+
+
+/**
+ * Thread that allocates and frees blocks
+ */
+class Worker : public Thread<STACK_SIZE>
+{
+	private:
+
+		Heap     *_heap;
+		unsigned  _seed;
+		void     *_window[WINDOW];
+		size_t    _sizes[WINDOW];
+		Semaphore _start;
+		Semaphore _done;
+
+		/**
+		 * Pseudo-random size of the typical per-request objects
+		 */
+		size_t _size()
+		{
+			_seed ^= _seed << 13; _seed ^= _seed >> 17; _seed ^= _seed << 5;
+			return 8 + _seed % 512;
+		}
+
+	public:
+
+		Worker(unsigned const seed)
+		: Thread<STACK_SIZE>("worker"), _heap(0), _seed(seed)
+		{
+			for (unsigned i = 0; i < WINDOW; i++) _window[i] = 0, _sizes[i] = 0;
+			start();
+		}
+
+		void run(Heap * const heap)
+		{
+			_heap = heap;
+			_start.up();
+		}
+
+		void wait_for_completion() { _done.down(); }
+
+		void entry()
+		{
+			while (1) {
+				_start.down();
+				for (unsigned i = 0; i < ROUNDS; i++) {
+					unsigned const slot = i % WINDOW;
+					if (_window[slot]) _heap->free(_window[slot], _sizes[slot]);
+					_sizes[slot] = _size();
+					_heap->alloc(_sizes[slot], &_window[slot]);
+				}
+				for (unsigned i = 0; i < WINDOW; i++) {
+					_heap->free(_window[i], _sizes[i]);
+					_window[i] = 0;
+				}
+				_done.up();
+			}
+		}
+};
+
+
+int main(int, char **)
+{
+	printf("--- heap benchmark ---\n");
+
+	static Timer::Connection timer;
+	static Worker *workers[MAX_THREADS];
+	for (unsigned i = 0; i < MAX_THREADS; i++)
+		workers[i] = new (env()->heap()) Worker(i * 7919 + 1);
+
+	for (unsigned magazines = 0; magazines < 2; magazines++) {
+
+		Heap heap(env()->ram_session(), env()->rm_session());
+		if (magazines) heap.enable_magazines();
+
+		for (unsigned threads = 1; threads <= MAX_THREADS; threads *= 2) {
+
+			Heap::Magazine_stats const old = heap.magazine_stats();
+
+			unsigned long const start_ms = timer.elapsed_ms();
+			for (unsigned i = 0; i < threads; i++) workers[i]->run(&heap);
+			for (unsigned i = 0; i < threads; i++) workers[i]->wait_for_completion();
+			unsigned long const ms = timer.elapsed_ms() - start_ms;
+
+			Heap::Magazine_stats const s = heap.magazine_stats();
+			unsigned long const pairs = (unsigned long)threads * ROUNDS;
+			unsigned long const hits  = s.hits - old.hits;
+			unsigned long const ops   = hits + s.misses - old.misses;
+			printf("%s, %u threads: %lu pairs in %lu ms, %lu pairs/s, "
+			       "%lu%% hits, %lu exchanges, %lu contended\n",
+			       magazines ? "magazines" : "plain", threads, pairs, ms,
+			       ms ? pairs * 1000 / ms : 0, ops ? hits * 100 / ops : 0,
+			       s.exchanges - old.exchanges, s.contended - old.contended);
+		}
+	}
+	printf("--- end of heap benchmark ---\n");
+	return 0;
+}
@@ -0,0 +1,277 @@
+/*
+ * \brief  Benchmark for the packet-streaming interface
+ * \author Martin Stein
+ * \date   2013-02-04
+ *
+ * A source and a sink thread stream a fixed number of small packets
+ * through a packet stream. The benchmark compares single-packet calls
+ * against batched calls with polling peers and reports the packet
+ * throughput and the number of 'packet_avail' and 'ack_avail' signals
+ * that were needed per packet.
+ */
+
+/*
+ * Copyright (C) 2013 Genode Labs GmbH
+ *
+ * This file is part of the Genode OS framework, which is distributed
+ * under the terms of the GNU General Public License version 2.
+ */
+
+/* Genode includes */
+#include <base/printf.h>
+#include <base/env.h>
+#include <base/thread.h>
+#include <base/semaphore.h>
+#include <base/allocator_avl.h>
+#include <timer_session/connection.h>
+#include <os/packet_stream.h>
+
+using namespace Genode;
+
+typedef Packet_stream_policy<Packet_descriptor, 256, 256, char>
+        Bench_packet_stream_policy;
+
+enum {
+	STACK_SIZE  = 8*1024,
+	PACKETS     = 200*1000,
+	PACKET_SIZE = 64,
+	MAX_BATCH   = 32,
+	POLL_ROUNDS = 100, /* queue checks before a polling peer blocks */
+};
+
+
+void Packet_stream_base::_debug_print_buffers() { }
+
+
+/**
+ * Parameters of one benchmark run
+ */
+struct Mode
+{
+	char const * name;
+	unsigned     batch; /* packets per call */
+	bool         poll;  /* wether the peers poll before blocking */
+};
+
+
+/**
+ * Block on 'receiver' until 'avail' holds
+ *
+ * \return  number of received signals
+ */
+template <typename AVAIL>
+static unsigned long wait_for(Signal_receiver * const receiver, AVAIL avail)
+{
+	unsigned long signals = 0;
+	while (!avail()) signals += receiver->wait_for_signal().num();
+	return signals;
+}
+
+
+/**
+ * Count signals that arrived while the peer was busy anyway
+ */
+static unsigned long drain(Signal_receiver * const receiver)
+{
+	unsigned long signals = 0;
+	while (receiver->pending()) signals += receiver->wait_for_signal().num();
+	return signals;
+}
+
+
+/**
+ * Thread that consumes and acknowledges packets
+ */
+class Sink : public  Thread<STACK_SIZE>,
+             public  Packet_stream_sink<Bench_packet_stream_policy>
+{
+	private:
+
+		Mode            _mode;
+		Signal_receiver _receiver;
+		Signal_context  _packet_avail;
+		Semaphore       _start;
+		Semaphore       _done;
+
+		struct Packet_avail
+		{
+			Sink * const s;
+			bool operator () () { return s->packet_avail(); }
+		};
+
+		void _run()
+		{
+			Packet_descriptor packets[MAX_BATCH];
+			Packet_avail const avail = { this };
+			for (unsigned long left = PACKETS; left; ) {
+
+				/* poll first, let the source signal us only while blocking */
+				if (_mode.poll) poll_packet_avail(true);
+				for (unsigned i = 0; _mode.poll && !packet_avail() &&
+				                     i < POLL_ROUNDS; i++);
+				if (_mode.poll) poll_packet_avail(false);
+
+				if (!packet_avail()) signals += wait_for(&_receiver, avail);
+
+				unsigned const n = get_packets(packets, _mode.batch);
+				acknowledge_packets(packets, n);
+				left -= n;
+			}
+			signals += drain(&_receiver);
+		}
+
+	public:
+
+		unsigned long signals;
+
+		Sink(Dataspace_capability ds_cap)
+		:
+			Thread<STACK_SIZE>("sink"),
+			Packet_stream_sink<Bench_packet_stream_policy>(ds_cap),
+			signals(0)
+		{ start(); }
+
+		Signal_context_capability packet_avail_cap() {
+			return _receiver.manage(&_packet_avail); }
+
+		void run(Mode const mode)
+		{
+			_mode = mode;
+			signals = 0;
+			_start.up();
+		}
+
+		void wait_for_completion() { _done.down(); }
+
+		void entry()
+		{
+			while (1) {
+				_start.down();
+				_run();
+				_done.up();
+			}
+		}
+};
+
+
+/**
+ * Producer of packets, runs in the main thread
+ */
+class Source : private Allocator_avl,
+               public  Packet_stream_source<Bench_packet_stream_policy>
+{
+	private:
+
+		Signal_receiver _receiver;
+		Signal_context  _ack_avail;
+
+		struct Ack_avail
+		{
+			Source * const s;
+			bool operator () () { return s->ack_avail(); }
+		};
+
+		/**
+		 * Release a batch of acknowledged packets
+		 *
+		 * \return  number of released packets
+		 */
+		unsigned long _collect(Mode const &mode, bool const block)
+		{
+			Ack_avail const avail = { this };
+			if (!ack_avail()) {
+				if (!block) return 0;
+				if (mode.poll) poll_ack_avail(true);
+				for (unsigned i = 0; mode.poll && !ack_avail() &&
+				                     i < POLL_ROUNDS; i++);
+				if (mode.poll) poll_ack_avail(false);
+				if (!ack_avail()) signals += wait_for(&_receiver, avail);
+			}
+			Packet_descriptor packets[MAX_BATCH];
+			unsigned const n = get_acked_packets(packets, mode.batch);
+			for (unsigned i = 0; i < n; i++) release_packet(packets[i]);
+			return n;
+		}
+
+	public:
+
+		unsigned long signals;
+
+		Source(Dataspace_capability ds_cap)
+		:
+			Allocator_avl(env()->heap()),
+			Packet_stream_source<Bench_packet_stream_policy>(this, ds_cap),
+			signals(0)
+		{ }
+
+		Signal_context_capability ack_avail_cap() {
+			return _receiver.manage(&_ack_avail); }
+
+		/**
+		 * Stream all packets of a run
+		 */
+		void run(Mode const &mode)
+		{
+			signals = 0;
+			unsigned long submitted = 0, released = 0;
+			Packet_descriptor packets[MAX_BATCH];
+			while (released < PACKETS) {
+
+				/* submit as many packets as the bulk buffer allows */
+				unsigned n = 0;
+				for (; n < mode.batch && submitted + n < PACKETS; n++) {
+					try { packets[n] = alloc_packet(PACKET_SIZE); }
+					catch (Packet_alloc_failed) { break; }
+				}
+				submit_packets(packets, n);
+				submitted += n;
+
+				/* block for acknowledgements only if we can't submit */
+				released += _collect(mode, !n);
+			}
+			signals += drain(&_receiver);
+		}
+};
+
+
+int main(int, char **)
+{
+	printf("--- packet stream benchmark ---\n");
+
+	static Mode const modes[] = {
+		{ "single packets",        1,         false },
+		{ "batches",               MAX_BATCH, false },
+		{ "batches, polling peers", MAX_BATCH, true  } };
+
+	Timer::Connection timer;
+
+	enum { TRANSPORT_DS_SIZE = 128*1024 };
+	Dataspace_capability ds_cap = env()->ram_session()->alloc(TRANSPORT_DS_SIZE);
+
+	Source source(ds_cap);
+	Sink   sink(ds_cap);
+
+	/* the peers handle the avail signals on their own like servers do */
+	source.register_sigh_packet_avail(sink.packet_avail_cap());
+	source.register_sigh_ready_to_ack(sink.sigh_ready_to_ack());
+	sink.register_sigh_ready_to_submit(source.sigh_ready_to_submit());
+	sink.register_sigh_ack_avail(source.ack_avail_cap());
+
+	for (unsigned i = 0; i < sizeof(modes)/sizeof(modes[0]); i++) {
+
+		unsigned long const start_ms = timer.elapsed_ms();
+		sink.run(modes[i]);
+		source.run(modes[i]);
+		sink.wait_for_completion();
+		unsigned long const ms = timer.elapsed_ms() - start_ms;
+
+		unsigned long const signals = source.signals + sink.signals;
+		printf("%s: %u packets in %lu ms, %lu packets/s, "
+		       "%lu.%03lu signals/packet\n",
+		       modes[i].name, PACKETS, ms,
+		       ms ? (unsigned long)PACKETS * 1000 / ms : 0,
+		       signals / PACKETS, signals * 1000 / PACKETS % 1000);
+	}
+	printf("--- end of packet stream benchmark ---\n");
+	return 0;
+}
@@ -61,6 +61,14 @@ struct Ptc : Mmio
 			       Capte::bits(0); }
 	};
 
+	/**
+	 * Emulator-local register that selects the model of the PTC
+	 */
+	struct Fidelity : Register<0xffc, 32>
+	{
+		enum { TRANSACTION_LEVEL = 0, RTL = 1 };
+	};
+
 	Ptc(addr_t base) : Mmio(base) { }
 };
 
@@ -91,6 +99,18 @@ int main(int argc, char **argv)
 	PINF("PTC %x %x", ptc.read<Ptc::Cntr>(), ptc.read<Ptc::Ctrl>());
 	PINF("PTC %x %x", ptc.read<Ptc::Cntr>(), ptc.read<Ptc::Ctrl>());
 
+	/* switch between the models with the timer running */
+	ptc.write<Ptc::Fidelity>(Ptc::Fidelity::RTL);
+	PINF("PTC RTL %x %x", ptc.read<Ptc::Cntr>(), ptc.read<Ptc::Ctrl>());
+	ptc.write<Ptc::Ctrl::Int>(0);
+	ptc_irq.wait_for_irq();
+	PINF("PTC RTL %x %x", ptc.read<Ptc::Cntr>(), ptc.read<Ptc::Ctrl>());
+	ptc.write<Ptc::Fidelity>(Ptc::Fidelity::TRANSACTION_LEVEL);
+	PINF("PTC TLM %x %x", ptc.read<Ptc::Cntr>(), ptc.read<Ptc::Ctrl>());
+	ptc.write<Ptc::Ctrl::Int>(0);
+	ptc_irq.wait_for_irq();
+	PINF("PTC TLM %x %x", ptc.read<Ptc::Cntr>(), ptc.read<Ptc::Ctrl>());
+
 	while(1);
 }
 
@@ -11,12 +11,17 @@
  * under the terms of the GNU General Public License version 2.
  */
 
+/* Genode includes */
+#include <os/config.h>
+
 /* local includes */
 #include "Vptc_top.h"
+#include "ptc_model.h"
 
 /* verilator_env includes */
 #include <verilator_env/irq.h>
 #include <verilator_env/wishbone_slave.h>
+#include <verilator_env/dual_fidelity.h>
 #include <emulation_session_component.h>
 
 using namespace Genode;
@@ -60,10 +65,48 @@ struct Raw_wishbone_slave
 static Sync_wishbone_slave<Raw_wishbone_slave, 10> wbs(&hdl_lock);
 
 /**
- * Connect emulator interface and HDL design
+ * Present the verilated design as model of the PTC
  */
-         Emulation::Session_component::Session_component() { wbs.initialize(); }
-void     Emulation::Session_component::write_mmio(addr_t const addr, Access const a, umword_t const v) { wbs.write_mmio(addr, a, v); }
-umword_t Emulation::Session_component::read_mmio(addr_t const addr, Access const a) { return wbs.read_mmio(addr, a); }
-bool     Emulation::Session_component::irq_handler(unsigned i, Signal_context_capability s) { return irq_listener.irq_handler(i, s); }
+struct Ptc_rtl : Device_model
+{
+	Ptc_rtl() : Device_model(ptc_regs, PTC_REGS) { }
+
+	void     pause()                                                    { clk.enable(0); }
+	void     resume()                                                   { clk.enable(1); }
+	void     initialize()                                               { wbs.initialize(); }
+	void     write_mmio(addr_t const addr, Access const a, umword_t const v) { wbs.write_mmio(addr, a, v); }
+	umword_t read_mmio(addr_t const addr, Access const a)              { return wbs.read_mmio(addr, a); }
+	bool     irq_handler(unsigned const i, Signal_context_capability s) { return irq_listener.irq_handler(i, s); }
+};
 
+/**
+ * Let the PTC be emulated either by the design or by a C++ model
+ *
+ * The fidelity to start with is taken from the 'fidelity' attribute of
+ * the config ('tlm' or 'rtl', default 'rtl'). At runtime, the driver
+ * may switch by writing the control register behind the PTC registers.
+ */
+enum { CONTROL_REG = 0xffc };
+
+static Ptc_rtl ptc_rtl;
+static Ptc_model ptc_tlm(100, 10);
+static Dual_fidelity_device ptc(&ptc_tlm, &ptc_rtl, CONTROL_REG);
+
+static Emulation::Session::Fidelity initial_fidelity()
+{
+	try {
+		if (config()->xml_node().attribute("fidelity").has_value("tlm"))
+			return Emulation::Session::TRANSACTION_LEVEL;
+	} catch (...) { }
+	return Emulation::Session::RTL;
+}
+
+/**
+ * Connect emulator interface and PTC
+ */
+         Emulation::Session_component::Session_component() { ptc.initialize(initial_fidelity()); }
+void     Emulation::Session_component::write_mmio(addr_t const addr, Access const a, umword_t const v) { ptc.write_mmio(addr, a, v); }
+umword_t Emulation::Session_component::read_mmio(addr_t const addr, Access const a) { return ptc.read_mmio(addr, a); }
+bool     Emulation::Session_component::irq_handler(unsigned i, Signal_context_capability s) { return ptc.irq_handler(i, s); }
+bool     Emulation::Session_component::fidelity(Fidelity const f) { return ptc.fidelity(f); }
+bool     Emulation::Session_component::data_window(addr_t const, Dataspace_capability) { return 0; }
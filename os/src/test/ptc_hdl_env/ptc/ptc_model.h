@@ -0,0 +1,235 @@
+/*
+ * \brief   Transaction-level model of the PTC
+ * \author  Martin Stein
+ * \date    2013-01-14
+ */
+
+/*
+ * Copyright (C) 2013 Genode Labs GmbH
+ *
+ * This file is part of the Genode OS framework, which is distributed
+ * under the terms of the GNU General Public License version 2.
+ */
+
+#ifndef _PTC__PTC_MODEL_H_
+#define _PTC__PTC_MODEL_H_
+
+/* Genode includes */
+#include <base/thread.h>
+#include <base/lock.h>
+#include <timer_session/connection.h>
+#include <util/register.h>
+
+/* verilator_env includes */
+#include <verilator_env/device_model.h>
+
+namespace Genode
+{
+	/**
+	 * MMIO offsets of the architectural PTC registers in restore order
+	 */
+	enum {
+		PTC_CNTR = 0x0,
+		PTC_HRC  = 0x4,
+		PTC_LRC  = 0x8,
+		PTC_CTRL = 0xc,
+		PTC_REGS = 4,
+	};
+
+	static addr_t const ptc_regs[PTC_REGS] = {
+		PTC_CNTR, PTC_HRC, PTC_LRC, PTC_CTRL };
+
+	/**
+	 * Transaction-level model of the PTC
+	 *
+	 * Instead of evaluating each clock cycle, the counter is advanced
+	 * arithmetically by all cycles of an update interval at once.
+	 * Capture mode and the external clock input aren't modeled
+	 * as the RTL integration doesn't drive the related pads either.
+	 */
+	class Ptc_model : public Device_model, public Thread<1024>
+	{
+		/**
+		 * Control register
+		 */
+		struct Ctrl : Register<32>
+		{
+			struct En     : Bitfield<0, 1> { };
+			struct Eclk   : Bitfield<1, 1> { };
+			struct Single : Bitfield<4, 1> { };
+			struct Inte   : Bitfield<5, 1> { };
+			struct Int    : Bitfield<6, 1> { };
+			struct Cntrst : Bitfield<7, 1> { };
+
+			enum { MASK = 0x1ff };
+		};
+
+		unsigned const            _freq_ms;     /* clock cycles per ms */
+		unsigned const            _interval_ms; /* delay between updates */
+		Timer::Connection         _timer;
+		Lock                      _lock;        /* sync model access */
+		bool                      _running;
+		uint32_t                  _cntr;
+		uint32_t                  _hrc;
+		uint32_t                  _lrc;
+		uint32_t                  _ctrl;
+		Signal_context_capability _irq;
+
+		/**
+		 * Wether the counter passes 'target' within 'steps' cycles
+		 */
+		static bool _passes(uint32_t const from, uint64_t const steps,
+		                    uint32_t const target)
+		{ return (uint32_t)(target - from) <= steps; }
+
+		/**
+		 * Set the IRQ output and signal an edge to the IRQ listener
+		 */
+		void _irq_state(bool const up)
+		{
+			if (Ctrl::Int::get(_ctrl) == up) return;
+			Ctrl::Int::set(_ctrl, up);
+			if (_irq.valid()) Signal_transmitter(_irq).submit();
+		}
+
+		/**
+		 * Advance the counter by 'cycles' clock cycles
+		 */
+		void _advance(uint64_t const cycles)
+		{
+			if (!Ctrl::En::get(_ctrl) || Ctrl::Eclk::get(_ctrl) || !cycles)
+				return;
+
+			bool match;
+			if (Ctrl::Cntrst::get(_ctrl)) {
+
+				/* the counter is held at zero */
+				_cntr = 0;
+				match = !_lrc || !_hrc;
+
+			} else if (Ctrl::Single::get(_ctrl)) {
+
+				/* the counter stops when it reaches LRC */
+				match = _passes(_cntr, cycles, _lrc) ||
+				        _passes(_cntr, cycles, _hrc);
+				if (_passes(_cntr, cycles, _lrc)) _cntr = _lrc;
+				else _cntr += cycles;
+
+			} else {
+
+				/* the counter restarts after reaching LRC */
+				uint64_t const to_lrc = (uint32_t)(_lrc - _cntr);
+				if (cycles <= to_lrc) {
+					match = _passes(_cntr, cycles, _hrc) || cycles == to_lrc;
+					_cntr += cycles;
+				} else {
+					uint64_t const period = (uint64_t)_lrc + 1;
+					uint64_t const rest   = cycles - to_lrc - 1;
+					match = 1;
+					_cntr = rest % period;
+				}
+			}
+			if (match && Ctrl::Inte::get(_ctrl)) _irq_state(1);
+		}
+
+		public:
+
+			/**
+			 * Constructor
+			 *
+			 * \param freq_ms      clock frequency per ms
+			 * \param interval_ms  delay between counter updates
+			 */
+			Ptc_model(unsigned const freq_ms, unsigned const interval_ms)
+			:
+				Device_model(ptc_regs, PTC_REGS),
+				_freq_ms(freq_ms), _interval_ms(interval_ms), _running(0),
+				_cntr(0), _hrc(0), _lrc(0), _ctrl(0)
+			{ Thread::start(); }
+
+
+			/******************
+			 ** Device_model **
+			 ******************/
+
+			void pause()
+			{
+				Lock::Guard guard(_lock);
+				_running = 0;
+			}
+
+			void resume()
+			{
+				Lock::Guard guard(_lock);
+				_running = 1;
+			}
+
+			void initialize()
+			{
+				Lock::Guard guard(_lock);
+				_cntr = _hrc = _lrc = _ctrl = 0;
+			}
+
+			umword_t read_mmio(addr_t const off, Access const a)
+			{
+				Lock::Guard guard(_lock);
+				switch (off) {
+				case PTC_CNTR: return _cntr;
+				case PTC_HRC:  return _hrc;
+				case PTC_LRC:  return _lrc;
+				case PTC_CTRL: return _ctrl;
+				default:
+					PERR("%s:%d: Invalid offset", __FILE__, __LINE__);
+					return 0;
+				}
+			}
+
+			void write_mmio(addr_t const off, Access const a,
+			                umword_t const value)
+			{
+				Lock::Guard guard(_lock);
+				switch (off) {
+				case PTC_CNTR: _cntr = value; return;
+				case PTC_HRC:  _hrc  = value; return;
+				case PTC_LRC:  _lrc  = value; return;
+				case PTC_CTRL: {
+					/* keep the IRQ bit to be able to detect edges */
+					Ctrl::access_t ctrl = value & Ctrl::MASK;
+					Ctrl::Int::set(ctrl, Ctrl::Int::get(_ctrl));
+					_ctrl = ctrl;
+					_irq_state(Ctrl::Int::get(value));
+					return; }
+				default:
+					PERR("%s:%d: Invalid offset", __FILE__, __LINE__);
+				}
+			}
+
+			bool irq_handler(unsigned const irq,
+			                 Signal_context_capability irq_edge)
+			{
+				Lock::Guard guard(_lock);
+				if (irq) {
+					PERR("%s:%d: Invalid IRQ", __FILE__, __LINE__);
+					return 0;
+				}
+				_irq = irq_edge;
+				return Ctrl::Int::get(_ctrl);
+			}
+
+
+			/************
+			 ** Thread **
+			 ************/
+
+			void entry()
+			{
+				while (1) {
+					_timer.msleep(_interval_ms);
+					Lock::Guard guard(_lock);
+					if (_running) _advance((uint64_t)_interval_ms * _freq_ms);
+				}
+			}
+	};
+}
+
+#endif /* _PTC__PTC_MODEL_H_ */
@@ -16,3 +16,6 @@ SRC_CC = integration.cc
 # add library dependencies
 LIBS = verilator_env
 
+
+# clock input for the host benchmark of 'VERILATOR_PROFILE' builds
+VERILATOR_BENCH_CLK = wb_clk_i
@@ -0,0 +1,112 @@
+/*
+ * \brief  Benchmark of directory operations at the RAM file system
+ * \author Martin Stein
+ * \date   2013-02-15
+ *
+ * For directories of increasing size, the benchmark reports the time of
+ * creating all files, of looking up random files, and of reading all
+ * directory entries.
+ */
+
+/*
+ * Copyright (C) 2013 Genode Labs GmbH
+ *
+ * This file is part of the Genode OS framework, which is distributed
+ * under the terms of the GNU General Public License version 2.
+ */
+
+/* Genode includes */
+#include <base/allocator_avl.h>
+#include <base/printf.h>
+#include <base/snprintf.h>
+#include <file_system_session/connection.h>
+#include <timer_session/connection.h>
+
+using namespace Genode;
+
+enum { NUM_LOOKUPS = 10*1000 };
+
+static unsigned const sizes[] = { 100, 1000, 10*1000, 30*1000 };
+
+
+/**
+ * Return microseconds per operation
+ */
+static unsigned long us_per_op(unsigned long ms, unsigned long ops) {
+	return ops ? ms * 1000 / ops : 0; }
+
+
+static void bench(Timer::Session &timer, File_system::Session &fs,
+                  unsigned num_files)
+{
+	using namespace File_system;
+
+	char dir_path[32];
+	snprintf(dir_path, sizeof(dir_path), "/dir%u", num_files);
+	Dir_handle dir = fs.dir(dir_path, true);
+
+	/* create files */
+	unsigned long start = timer.elapsed_ms();
+	for (unsigned i = 0; i < num_files; i++) {
+		char name[32];
+		snprintf(name, sizeof(name), "file%u", i);
+		fs.close(fs.file(dir, name, READ_WRITE, true));
+	}
+	unsigned long const create_ms = timer.elapsed_ms() - start;
+
+	/* look up random files */
+	unsigned seed = num_files;
+	start = timer.elapsed_ms();
+	for (unsigned i = 0; i < NUM_LOOKUPS; i++) {
+		seed = seed * 1103515245 + 12345;
+		char path[64];
+		snprintf(path, sizeof(path), "%s/file%u", dir_path, (seed >> 8) % num_files);
+		Node_handle node = fs.node(path);
+		fs.status(node);
+		fs.close(node);
+	}
+	unsigned long const lookup_ms = timer.elapsed_ms() - start;
+
+	/* read all directory entries, one entry per packet */
+	typedef File_system::Packet_descriptor Packet;
+	File_system::Session::Tx::Source &source = *fs.tx();
+	unsigned entries = 0;
+	start = timer.elapsed_ms();
+	for (;; entries++) {
+		Packet packet(source.alloc_packet(sizeof(Directory_entry)), 0, dir,
+		              Packet::READ, sizeof(Directory_entry),
+		              entries * sizeof(Directory_entry));
+		source.submit_packet(packet);
+		packet = source.get_acked_packet();
+		source.release_packet(packet);
+		if (!packet.succeeded() || packet.length() < sizeof(Directory_entry))
+			break;
+	}
+	unsigned long const readdir_ms = timer.elapsed_ms() - start;
+
+	fs.close(dir);
+
+	if (entries != num_files)
+		PERR("read %u directory entries, expected %u", entries, num_files);
+
+	printf("%6u files: create %4lu us/file, lookup %4lu us/file, "
+	       "readdir %4lu us/entry\n", num_files,
+	       us_per_op(create_ms, num_files), us_per_op(lookup_ms, NUM_LOOKUPS),
+	       us_per_op(readdir_ms, entries));
+}
+
+
+int main(int, char **)
+{
+	printf("--- ram_fs benchmark ---\n");
+
+	static Timer::Connection timer;
+	static Allocator_avl     tx_alloc(env()->heap());
+	static File_system::Connection fs(tx_alloc);
+
+	for (unsigned i = 0; i < sizeof(sizes)/sizeof(sizes[0]); i++)
+		bench(timer, fs, sizes[i]);
+
+	printf("--- end of ram_fs benchmark ---\n");
+	return 0;
+}
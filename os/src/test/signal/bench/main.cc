@@ -0,0 +1,106 @@
+/*
+ * \brief  Benchmark of the signal throughput against the number of contexts
+ * \author Martin Stein
+ * \date   2013-02-05
+ *
+ * A sender thread submits signals round-robin to all contexts of one
+ * receiver, while the main thread receives them. With an increasing
+ * number of contexts, the throughput should stay roughly the same.
+ */
+
+/*
+ * Copyright (C) 2013 Genode Labs GmbH
+ *
+ * This file is part of the Genode OS framework, which is distributed
+ * under the terms of the GNU General Public License version 2.
+ */
+
+/* Genode includes */
+#include <base/printf.h>
+#include <base/signal.h>
+#include <base/thread.h>
+#include <base/semaphore.h>
+#include <timer_session/connection.h>
+
+using namespace Genode;
+
+enum {
+	MAX_CONTEXTS = 1024,
+	SIGNALS      = 20*1000,
+};
+
+
+/**
+ * Thread that submits signals round-robin to a set of contexts
+ */
+class Sender : public Thread<4096>
+{
+	private:
+
+		Signal_transmitter _transmitters[MAX_CONTEXTS];
+		unsigned           _contexts;
+		Semaphore          _start;
+
+	public:
+
+		Sender() : Thread<4096>("sender"), _contexts(0) { start(); }
+
+		/**
+		 * Submit 'SIGNALS' signals to the first 'contexts' contexts
+		 */
+		void run(Signal_context_capability const * const caps,
+		         unsigned const contexts)
+		{
+			for (unsigned i = 0; i < contexts; i++)
+				_transmitters[i].context(caps[i]);
+			_contexts = contexts;
+			_start.up();
+		}
+
+		void entry()
+		{
+			while (1) {
+				_start.down();
+				for (unsigned i = 0; i < SIGNALS; i++)
+					_transmitters[i % _contexts].submit();
+			}
+		}
+};
+
+
+int main(int, char **)
+{
+	printf("--- signal benchmark ---\n");
+
+	static Timer::Connection         timer;
+	static Signal_receiver           receiver;
+	static Signal_context            contexts[MAX_CONTEXTS];
+	static Signal_context_capability caps[MAX_CONTEXTS];
+	static Sender                    sender;
+
+	static unsigned const runs[] = { 1, 16, 256, MAX_CONTEXTS };
+	unsigned managed = 0;
+	for (unsigned r = 0; r < sizeof(runs)/sizeof(runs[0]); r++) {
+
+		/* let the receiver manage the contexts of this run */
+		for (; managed < runs[r]; managed++)
+			caps[managed] = receiver.manage(&contexts[managed]);
+
+		unsigned long const start_ms = timer.elapsed_ms();
+		sender.run(caps, runs[r]);
+
+		/* signals of one context may get merged into one wakeup */
+		unsigned long received = 0, wakeups = 0;
+		while (received < SIGNALS) {
+			received += receiver.wait_for_signal().num();
+			wakeups++;
+		}
+		unsigned long const ms = timer.elapsed_ms() - start_ms;
+
+		printf("%u contexts: %u signals in %lu ms, %lu signals/s, "
+		       "%lu wakeups\n", runs[r], SIGNALS, ms,
+		       ms ? (unsigned long)SIGNALS * 1000 / ms : 0, wakeups);
+	}
+	printf("--- end of signal benchmark ---\n");
+	return 0;
+}
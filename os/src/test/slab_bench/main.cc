@@ -0,0 +1,87 @@
+/*
+ * \brief  Benchmark of the slab allocator under alloc/free churn
+ * \author Martin Stein
+ * \date   2013-02-08
+ *
+ * For an increasing number of live objects, the benchmark fills a slab,
+ * frees a pseudo-random half of the objects, and refills the gaps again
+ * and again. It reports the alloc/free pairs per second and the memory
+ * that the slab holds afterwards.
+ */
+
+/*
+ * Copyright (C) 2013 Genode Labs GmbH
+ *
+ * This file is part of the Genode OS framework, which is distributed
+ * under the terms of the GNU General Public License version 2.
+ */
+
+/* Genode includes */
+#include <base/env.h>
+#include <base/printf.h>
+#include <base/slab.h>
+#include <timer_session/connection.h>
+
+using namespace Genode;
+
+enum {
+	OBJECT_SIZE = 32,
+	BLOCK_SIZE  = 4096,
+	MAX_OBJECTS = 1000*1000,
+	CHURN       = 1000*1000, /* alloc/free pairs per run */
+};
+
+
+static unsigned seed = 1;
+
+static unsigned random()
+{
+	seed ^= seed << 13; seed ^= seed >> 17; seed ^= seed << 5;
+	return seed;
+}
+
+
+int main(int, char **)
+{
+	printf("--- slab benchmark ---\n");
+
+	static Timer::Connection timer;
+	static unsigned const runs[] = { 10*1000, 100*1000, MAX_OBJECTS };
+
+	void ** const objects = (void **)env()->heap()->alloc(MAX_OBJECTS * sizeof(void *));
+
+	for (unsigned r = 0; r < sizeof(runs)/sizeof(runs[0]); r++) {
+
+		unsigned const num = runs[r];
+		Slab slab(OBJECT_SIZE, BLOCK_SIZE, 0, env()->heap());
+		for (unsigned i = 0; i < num; i++)
+			if (!slab.alloc(OBJECT_SIZE, &objects[i])) {
+				PERR("slab exhausted");
+				return -1;
+			}
+
+		unsigned long const start_ms = timer.elapsed_ms();
+		for (unsigned done = 0; done < CHURN; ) {
+
+			/* free a random half of the objects, then refill the gaps */
+			unsigned const n = num / 2 < CHURN - done ? num / 2 : CHURN - done;
+			unsigned const first = random() % num;
+			for (unsigned i = 0; i < n; i++)
+				slab.free(objects[(first + i * 2) % num]);
+			for (unsigned i = 0; i < n; i++)
+				slab.alloc(OBJECT_SIZE, &objects[(first + i * 2) % num]);
+			done += n;
+		}
+		unsigned long const ms = timer.elapsed_ms() - start_ms;
+
+		printf("%u objects: %u alloc/free pairs in %lu ms, %lu pairs/s, "
+		       "%lu KiB consumed\n", num, CHURN, ms,
+		       ms ? (unsigned long)CHURN * 1000 / ms : 0,
+		       (unsigned long)slab.consumed() / 1024);
+
+		for (unsigned i = 0; i < num; i++)
+			slab.free(objects[i]);
+	}
+	printf("--- end of slab benchmark ---\n");
+	return 0;
+}
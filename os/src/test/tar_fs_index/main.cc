@@ -0,0 +1,92 @@
+/*
+ * \brief  Benchmark of path lookups at the TAR file system
+ * \author Martin Stein
+ * \date   2013-02-15
+ *
+ * The archive contains 'NUM_DIRS' directories with 'NUM_FILES' files
+ * each. The test checks the number of entries of all directories and
+ * reports the time of opening random files.
+ */
+
+/*
+ * Copyright (C) 2013 Genode Labs GmbH
+ *
+ * This file is part of the Genode OS framework, which is distributed
+ * under the terms of the GNU General Public License version 2.
+ */
+
+/* Genode includes */
+#include <base/allocator_avl.h>
+#include <base/printf.h>
+#include <base/snprintf.h>
+#include <file_system_session/connection.h>
+#include <timer_session/connection.h>
+
+using namespace Genode;
+
+enum {
+	NUM_DIRS    = 100,
+	NUM_FILES   = 1000,
+	NUM_LOOKUPS = 10*1000,
+};
+
+
+static unsigned num_entries(File_system::Session &fs, char const *path)
+{
+	File_system::Dir_handle dir = fs.dir(path, false);
+	unsigned const num = fs.status(dir).size / sizeof(File_system::Directory_entry);
+	fs.close(dir);
+	return num;
+}
+
+
+int main(int, char **)
+{
+	printf("--- tar_fs index test ---\n");
+
+	static Timer::Connection timer;
+	static Allocator_avl     tx_alloc(env()->heap());
+	static File_system::Connection fs(tx_alloc);
+
+	/* directory listings */
+	unsigned long start = timer.elapsed_ms();
+	unsigned n = num_entries(fs, "/");
+	if (n != NUM_DIRS) {
+		PERR("root directory has %u entries, expected %u", n, (unsigned)NUM_DIRS);
+		return -1;
+	}
+	for (unsigned d = 0; d < NUM_DIRS; d++) {
+		char path[64];
+		snprintf(path, sizeof(path), "/dir%u", d);
+		if ((n = num_entries(fs, path)) != NUM_FILES) {
+			PERR("%s has %u entries, expected %u", path, n, (unsigned)NUM_FILES);
+			return -1;
+		}
+	}
+	printf("counted entries of %u directories in %lu ms\n",
+	       NUM_DIRS + 1, timer.elapsed_ms() - start);
+
+	/* lookups of random files */
+	unsigned seed = 1;
+	start = timer.elapsed_ms();
+	for (unsigned i = 0; i < NUM_LOOKUPS; i++) {
+		seed = seed * 1103515245 + 12345;
+		char path[64];
+		snprintf(path, sizeof(path), "/dir%u/file%u",
+		         (seed >> 8) % NUM_DIRS, (seed >> 16) % NUM_FILES);
+		try {
+			File_system::Node_handle node = fs.node(path);
+			fs.status(node);
+			fs.close(node);
+		} catch (File_system::Lookup_failed) {
+			PERR("lookup of %s failed", path);
+			return -1;
+		}
+	}
+	unsigned long const ms = timer.elapsed_ms() - start;
+	printf("%u lookups in %lu ms (%lu us per lookup)\n", (unsigned)NUM_LOOKUPS,
+	       ms, ms * 1000 / NUM_LOOKUPS);
+
+	printf("--- tar_fs index test finished ---\n");
+	return 0;
+}
@@ -0,0 +1,3 @@
+TARGET = test-tar_fs_index
+SRC_CC = main.cc
+LIBS   = env cxx
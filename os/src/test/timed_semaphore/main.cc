@@ -77,6 +77,47 @@ bool test_loop(Timer::Session *timer, Alarm::Time timeout1, Alarm::Time timeout2
 }
 
 
+/**
+ * Measure how precise timeouts of 'down' trigger
+ */
+static void test_accuracy(Timer::Session *timer)
+{
+	static Alarm::Time const timeouts[] = { 1, 2, 5, 15, 50 };
+
+	for (unsigned i = 0; i < sizeof(timeouts)/sizeof(timeouts[0]); i++) {
+		Timed_semaphore sem;
+		unsigned long const start_us = timer->elapsed_us();
+		try { sem.down(timeouts[i]); }
+		catch (Timeout_exception) { }
+		unsigned long const us = timer->elapsed_us() - start_us;
+
+		printf("timeout of %lu ms triggered after %lu us, late by %ld us\n",
+		       timeouts[i], us, (long)us - (long)timeouts[i] * 1000);
+	}
+}
+
+
+enum { IDLE_MS = 2000 };
+
+
+/**
+ * Count wakeups of the alarm thread while no timeout is pending
+ *
+ * A timeout that got discarded may still wake up the thread once.
+ */
+static unsigned long test_idle_wakeups(Timer::Session *timer)
+{
+	Timeout_thread * const t = Timeout_thread::alarm_timer();
+	unsigned long const wakeups = t->wakeups();
+	timer->msleep(IDLE_MS);
+	unsigned long const idle = t->wakeups() - wakeups;
+
+	printf("%lu wakeups of the alarm thread in %u ms of idle time\n",
+	       idle, IDLE_MS);
+	return idle;
+}
+
+
 int main(int, char **)
 {
 	printf("--- timed-semaphore test ---\n");
@@ -97,6 +138,17 @@ int main(int, char **)
 	}
 	printf("--- everything went ok  --\n");
 
+	printf("--- test 3: timeout accuracy --\n");
+	test_accuracy(&timer);
+	printf("--- everything went ok  --\n");
+
+	printf("--- test 4: no wakeups while idle --\n");
+	if (test_idle_wakeups(&timer) > IDLE_MS / 1000) {
+		PERR("Test 4 failed!");
+		return -4;
+	}
+	printf("--- everything went ok  --\n");
+
 	printf("--- end of timed-semaphore test ---\n");
 	return 0;
 }
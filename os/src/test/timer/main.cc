@@ -5,7 +5,7 @@
  */
 
 /*
- * Copyright (C) 2009-2012 Genode Labs GmbH
+ * Copyright (C) 2009-2013 Genode Labs GmbH
  *
  * This file is part of the Genode OS framework, which is distributed
  * under the terms of the GNU General Public License version 2.
@@ -15,7 +15,9 @@
 #include <base/printf.h>
 #include <base/sleep.h>
 #include <base/thread.h>
+#include <base/signal.h>
 #include <timer_session/connection.h>
+#include <timer_session/timeout_multiplexer.h>
 
 enum { STACK_SIZE = 4096 };
 
@@ -79,6 +81,116 @@ using namespace Genode;
 extern "C" int usleep(unsigned long usec);
 
 
+/**
+ * Local alarm that counts its triggers and re-schedules itself
+ */
+struct Counting_alarm : Alarm
+{
+	Timer::Timeout_multiplexer *multiplexer;
+	Alarm::Time                 period_us;
+	unsigned long               cnt;
+
+	Counting_alarm() : multiplexer(0), period_us(0), cnt(0) { }
+
+	bool on_alarm()
+	{
+		cnt++;
+		multiplexer->schedule_us(this, period_us);
+		return false;
+	}
+};
+
+
+/**
+ * Check signal-based timeouts, also multiplexed by one session
+ *
+ * \return  0 on success
+ */
+static int test_signal_timeouts(Timer::Connection &timer)
+{
+	enum {
+		PERIOD_US = 10*1000, DURATION_US = 1000*1000, NUM_ALARMS = 32,
+		ONCE_US = 2500, MAX_LATENCY_US = 100*1000,
+	};
+
+	static Signal_receiver sig_rec;
+
+	/* periodic timeout */
+	static Signal_context periodic_ctx;
+	printf("periodic timeout of %u us\n", PERIOD_US);
+	timer.sigh(sig_rec.manage(&periodic_ctx));
+	unsigned long signals = 0;
+	uint64_t const start_us = timer.elapsed_us();
+	timer.trigger_periodic(PERIOD_US);
+	while (timer.elapsed_us() - start_us < DURATION_US)
+		signals += sig_rec.wait_for_signal().num();
+	timer.trigger_periodic(0);
+	unsigned long const periodic_us = timer.elapsed_us() - start_us;
+	unsigned long const expected    = periodic_us / PERIOD_US;
+	printf("%lu signals in %lu us, expected %lu\n", signals, periodic_us, expected);
+
+	/* signals get merged but periods that were missed must not be made up */
+	if (signals < expected / 2 || signals > expected + 1) {
+		PERR("unexpected number of periodic signals");
+		return -1;
+	}
+
+	/* drop periodic signals that may still be in flight */
+	sig_rec.dissolve(&periodic_ctx);
+
+	/* one-shot timeout */
+	static Signal_context once_ctx;
+	timer.sigh(sig_rec.manage(&once_ctx));
+	uint64_t const once_start_us = timer.elapsed_us();
+	timer.trigger_once(ONCE_US);
+	Signal once = sig_rec.wait_for_signal();
+	unsigned long const once_us = timer.elapsed_us() - once_start_us;
+	printf("one-shot timeout of %u us fired after %lu us\n", ONCE_US, once_us);
+	if (once.context() != &once_ctx || once.num() != 1) {
+		PERR("unexpected one-shot signal");
+		return -2;
+	}
+	if (once_us < ONCE_US || once_us > ONCE_US + MAX_LATENCY_US) {
+		PERR("one-shot timeout fired at the wrong time");
+		return -3;
+	}
+	sig_rec.dissolve(&once_ctx);
+
+	/* many local alarms multiplexed by one session */
+	static Signal_context mux_ctx;
+	static Timer::Timeout_multiplexer multiplexer(timer, sig_rec.manage(&mux_ctx));
+	static Counting_alarm alarms[NUM_ALARMS];
+	for (unsigned i = 0; i < NUM_ALARMS; i++) {
+		alarms[i].multiplexer = &multiplexer;
+		alarms[i].period_us   = 1000 * (i + 1);
+		multiplexer.schedule_us(&alarms[i], alarms[i].period_us);
+	}
+	unsigned long const mux_start_us = multiplexer.now();
+	while (multiplexer.now() - mux_start_us < DURATION_US) {
+		sig_rec.wait_for_signal();
+		multiplexer.handle();
+	}
+	unsigned long const mux_us = multiplexer.now() - mux_start_us;
+	int result = 0;
+	for (unsigned i = 0; i < NUM_ALARMS; i++) {
+		multiplexer.discard(&alarms[i]);
+
+		/*
+		 * An alarm re-schedules itself relative to its trigger, so it
+		 * may trigger less often than its period suggests, never more.
+		 */
+		unsigned long const max = mux_us / alarms[i].period_us;
+		printf("alarm (period %lu us) triggered %lu times, at most %lu\n",
+		       alarms[i].period_us, alarms[i].cnt, max);
+		if (!alarms[i].cnt || alarms[i].cnt > max) {
+			PERR("unexpected number of alarm triggers");
+			result = -4;
+		}
+	}
+	return result;
+}
+
+
 int main(int argc, char **argv)
 {
 	printf("--- timer test ---\n");
@@ -86,6 +198,11 @@ int main(int argc, char **argv)
 	static Genode::List<Timer_client> timer_clients;
 	static Timer::Connection main_timer;
 
+	if (test_signal_timeouts(main_timer)) {
+		printf("--- timer test failed ---\n");
+		return -1;
+	}
+
 	/* check long single timeout */
 	printf("register two-seconds timeout...\n");
 	main_timer.msleep(2000);
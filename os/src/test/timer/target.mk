@@ -1,3 +1,3 @@
 TARGET = test-timer
 SRC_CC = main.cc
-LIBS   = cxx env thread
+LIBS   = cxx env thread signal alarm
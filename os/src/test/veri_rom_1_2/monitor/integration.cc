@@ -65,3 +65,10 @@ bool Emulation::Session_component::irq_handler(unsigned const,
 	return 0;
 }
 
+
+bool Emulation::Session_component::fidelity(Fidelity const f) {
+	return f == RTL; }
+
+bool Emulation::Session_component::data_window(addr_t const,
+                                               Dataspace_capability) {
+	return 0; }
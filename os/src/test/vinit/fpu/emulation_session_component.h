@@ -398,6 +398,9 @@ namespace Emulation
 				else PERR("%s:%d: Invalid IRQ", __FILE__, __LINE__);
 				return 0;
 			}
+
+			/* the FPU exists only as transaction-level model */
+			bool fidelity(Fidelity const f) { return f == TRANSACTION_LEVEL; }
 	};
 }
 
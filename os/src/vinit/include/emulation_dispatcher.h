@@ -0,0 +1,282 @@
+/*
+ * \brief  Shared dispatching of events that concern emulated resources
+ * \author Martin Stein
+ * \date   2013-01-21
+ */
+
+/*
+ * Copyright (C) 2013 Genode Labs GmbH
+ *
+ * This file is part of the Genode OS framework, which is distributed
+ * under the terms of the GNU General Public License version 2.
+ */
+
+#ifndef _INCLUDE__EMULATION_DISPATCHER_H_
+#define _INCLUDE__EMULATION_DISPATCHER_H_
+
+/* Genode includes */
+#include <base/thread.h>
+#include <base/signal.h>
+#include <base/semaphore.h>
+#include <base/env.h>
+#include <util/fifo.h>
+#include <util/list.h>
+
+/* local includes */
+#include <util/assert.h>
+
+namespace Init
+{
+	using namespace Genode;
+
+	class Emulation_dispatcher;
+
+	/**
+	 * Source of events that concern one emulated resource
+	 *
+	 * All events of a context are processed strictly in the order they
+	 * occured and never concurrently.
+	 */
+	class Dispatch_context : public Signal_context,
+	                         public Fifo<Dispatch_context>::Element
+	{
+		friend class Emulation_dispatcher;
+
+		unsigned  _pending;     /* events that await processing */
+		unsigned  _worker;      /* index of the serving worker */
+		bool      _managed;     /* the dispatcher takes the events */
+		bool      _dispatching; /* the worker is inside 'dispatch' */
+		bool      _dissolving;  /* 'dissolve' waits for '_left' */
+		Semaphore _left;        /* the worker left 'dispatch' */
+
+		public:
+
+			/**
+			 * Constructor
+			 */
+			Dispatch_context()
+			: _pending(0), _worker(0), _managed(false), _dispatching(false),
+			  _dissolving(false) { }
+
+			/**
+			 * Destructor
+			 */
+			virtual ~Dispatch_context() { }
+
+			/**
+			 * Process one event of the context
+			 */
+			virtual void dispatch() = 0;
+	};
+
+	/**
+	 * Shared dispatching of events that concern emulated resources
+	 *
+	 * One signal receiver takes the events of all emulated resources.
+	 * Each context is bound to one thread out of a fixed pool of workers
+	 * when it gets managed. Hence, events of the same context are served
+	 * in order, while different contexts get processed in parallel, and
+	 * the number of threads doesn't depend on the number of resources.
+	 */
+	class Emulation_dispatcher : public Thread<4*1024>
+	{
+		public:
+
+			enum { MAX_WORKERS = 8, WORKER_STACK_SIZE = 8*1024 };
+
+		private:
+
+			/**
+			 * Thread that processes the events of a subset of all contexts
+			 */
+			class Worker : public Thread<WORKER_STACK_SIZE>
+			{
+				Lock                   _lock;     /* sync access to '_queue' */
+				Fifo<Dispatch_context> _queue;    /* contexts with pending events */
+				Semaphore              _queued;   /* counts queued contexts */
+
+				public:
+
+					/**
+					 * Constructor
+					 */
+					Worker() : Thread<WORKER_STACK_SIZE>("emu_worker") { start(); }
+
+					/**
+					 * Announce 'num' new events of context 'c'
+					 */
+					void submit(Dispatch_context * const c, unsigned const num)
+					{
+						Lock::Guard guard(_lock);
+						c->_pending += num;
+						if (c->is_enqueued()) return;
+						_queue.enqueue(c);
+						_queued.up();
+					}
+
+					/**
+					 * Forget about pending events of context 'c'
+					 *
+					 * If the worker currently dispatches an event of 'c',
+					 * the function blocks until the dispatching is done.
+					 * Afterwards, the worker doesn't touch 'c' anymore.
+					 */
+					void remove(Dispatch_context * const c)
+					{
+						{
+							Lock::Guard guard(_lock);
+							c->_pending = 0;
+							_queue.remove(c);
+							if (!c->_dispatching) return;
+							c->_dissolving = true;
+						}
+						c->_left.down();
+					}
+
+
+					/************
+					 ** Thread **
+					 ************/
+
+					void entry()
+					{
+						while (1) {
+							_queued.down();
+
+							/* take one event of the next pending context */
+							Dispatch_context * c;
+							{
+								Lock::Guard guard(_lock);
+								c = _queue.dequeue();
+								if (!c) continue;
+								c->_pending--;
+								c->_dispatching = true;
+							}
+							c->dispatch();
+
+							Lock::Guard guard(_lock);
+							c->_dispatching = false;
+
+							/* the context may vanish as soon as we wake 'remove' */
+							if (c->_dissolving) {
+								c->_dissolving = false;
+								c->_left.up();
+								continue;
+							}
+
+							/* requeue the context if it has further events */
+							if (c->_pending && !c->is_enqueued()) {
+								_queue.enqueue(c);
+								_queued.up();
+							}
+						}
+					}
+			};
+
+			/**
+			 * Waiter for the dispatcher to drop the signal it holds
+			 */
+			struct Barrier : List<Barrier>::Element
+			{
+				Semaphore passed;
+			};
+
+			Signal_receiver           _receiver;
+			Worker *                  _workers[MAX_WORKERS];
+			unsigned const            _num_workers;
+			unsigned                  _next_worker; /* round-robin assignment hint */
+			Lock                      _lock;        /* sync assignment of workers */
+			List<Barrier>             _barriers;    /* waiting 'dissolve' calls */
+			Signal_context            _barrier_context;
+			Signal_context_capability _barrier_cap;
+
+		public:
+
+			/**
+			 * Constructor
+			 *
+			 * \param num_workers  size of the worker pool
+			 */
+			Emulation_dispatcher(unsigned const num_workers)
+			:
+				Thread<4*1024>("emu_dispatcher"),
+				_num_workers(num_workers < 1 ? 1 :
+				             num_workers > MAX_WORKERS ? MAX_WORKERS : num_workers),
+				_next_worker(0)
+			{
+				for (unsigned i = 0; i < _num_workers; i++)
+					_workers[i] = new (env()->heap()) Worker();
+
+				_barrier_cap = _receiver.manage(&_barrier_context);
+				start();
+			}
+
+			/**
+			 * Let the dispatcher take the events of context 'c'
+			 *
+			 * \return  capability to submit events to 'c'
+			 */
+			Signal_context_capability manage(Dispatch_context * const c)
+			{
+				Lock::Guard guard(_lock);
+				c->_worker  = _next_worker++ % _num_workers;
+				c->_managed = true;
+				return _receiver.manage(c);
+			}
+
+			/**
+			 * Stop taking the events of context 'c'
+			 *
+			 * When the function returns, no thread of the dispatcher
+			 * refers to 'c' anymore, so it may get destructed.
+			 *
+			 * The dispatcher may have received a signal of 'c' already. So
+			 * we wait until it took the next signal, which is submitted
+			 * only after 'c' got dissolved at the receiver.
+			 */
+			void dissolve(Dispatch_context * const c)
+			{
+				Barrier barrier;
+				{
+					Lock::Guard guard(_lock);
+					c->_managed = false;
+					_receiver.dissolve(c);
+					_barriers.insert(&barrier);
+				}
+				Signal_transmitter(_barrier_cap).submit();
+				barrier.passed.down();
+
+				_workers[c->_worker]->remove(c);
+			}
+
+
+			/************
+			 ** Thread **
+			 ************/
+
+			void entry()
+			{
+				while (1) {
+					Signal s = _receiver.wait_for_signal();
+					Lock::Guard guard(_lock);
+
+					/* we hold no signal of a dissolved context anymore */
+					if (s.context() == &_barrier_context) {
+						while (Barrier *b = _barriers.first()) {
+							_barriers.remove(b);
+							b->passed.up();
+						}
+						continue;
+					}
+
+					/* drop signals of contexts that got dissolved meanwhile */
+					Dispatch_context * const c =
+						static_cast<Dispatch_context *>(s.context());
+					if (c->_managed)
+						_workers[c->_worker]->submit(c, s.num());
+				}
+			}
+	};
+}
+
+#endif /* _INCLUDE__EMULATION_DISPATCHER_H_ */
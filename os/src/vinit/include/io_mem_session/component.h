@@ -15,11 +15,13 @@
 #define _INCLUDE__IO_MEM_SESSION__COMPONENT_H_
 
 /* Genode includes */
-#include <base/thread.h>
 #include <io_mem_session/io_mem_session.h>
+#include <emulation_session/data_window.h>
+#include <base/env.h>
 
 /* local includes */
 #include <rm_session/connection.h>
+#include <emulation_dispatcher.h>
 
 namespace Init
 {
@@ -28,10 +30,9 @@ namespace Init
 	/**
 	 * Pagefault handler for emulated IO_MEM regions
 	 */
-	class Io_mem_fault_handler : public Thread<8*1024>
+	class Io_mem_fault_handler : public Dispatch_context
 	{
 		Rm_session * const _rm; /* nested RM wich backs the IO_MEM dataspace */
-		Signal_receiver * const _sig_recvr; /* receives fault signals */
 		Emulation::Session * const _emu; /* session to emulate
 		                                  * sideeffects of the faults */
 		addr_t const _io_mem_base; /* emulator-local base of the IO region */
@@ -42,18 +43,21 @@ namespace Init
 			 * Constructor
 			 */
 			Io_mem_fault_handler(Rm_session * const rm,
-			                     Signal_receiver * const sr,
 			                     Emulation::Session * const emu,
 			                     addr_t const io_mem_base)
 			:
-				_rm(rm), _sig_recvr(sr), _emu(emu), _io_mem_base(io_mem_base)
+				_rm(rm), _emu(emu), _io_mem_base(io_mem_base)
 			{ }
 
 
+			/**********************
+			 ** Dispatch_context **
+			 **********************/
+
 			/**
 			 * Process pending faults
 			 */
-			void handle_fault()
+			void dispatch()
 			{
 				/* fetch fault attributes */
 				using namespace Genode;
@@ -76,45 +80,91 @@ namespace Init
 				/* end fault */
 				_rm->processed(s);
 			}
-
-			/**
-			 * Thread main routine
-			 */
-			void entry()
-			{
-				while (1) {
-					Signal s = _sig_recvr->wait_for_signal();
-					for (int i = 0; i < s.num(); i++) handle_fault();
-				}
-			}
 	};
 
 	/**
 	 * Session component of an emulated IO_MEM service
+	 *
+	 * Normally each access to the IO_MEM dataspace faults and gets
+	 * forwarded to the emulator. A data window instead is backed by a
+	 * RAM dataspace that is shared with the emulator, so the driver can
+	 * stream bursts through it without faulting.
 	 */
 	class Io_mem_session_component : public Rpc_object<Io_mem_session>
 	{
 		Rm_connection _rm;
-		Signal_receiver _fault_recvr;
-		Signal_context _fault;
 		Io_mem_fault_handler _fault_handler;
+		Emulation_dispatcher * const _dispatcher;
+		Ram_dataspace_capability _window; /* backing store of a data window */
+
+		/**
+		 * Try to back the whole IO_MEM with a shared data window
+		 *
+		 * \return  wether the emulator accepted the window
+		 */
+		bool _init_window(addr_t const base, size_t const size,
+		                  Emulation::Session * const emulation)
+		{
+			using Emulation::Data_window;
+			if (size <= sizeof(Data_window)) {
+				PERR("Data window too small");
+				return 0;
+			}
+			try { _window = env()->ram_session()->alloc(size); }
+			catch (...) {
+				PERR("Failed to allocate data window");
+				return 0;
+			}
+			Data_window * const w = env()->rm_session()->attach(_window);
+			w->init(size);
+			env()->rm_session()->detach(w);
+
+			if (!emulation->data_window(base, _window)) {
+				PWRN("Emulator declines data window, emulate it through faults");
+				env()->ram_session()->free(_window);
+				_window = Ram_dataspace_capability();
+				return 0;
+			}
+			_rm.attach_at(_window, 0);
+			return 1;
+		}
 
 		public:
 
 			/**
 			 * Constructor
+			 *
+			 * \param data_window  wether the IO_MEM is a data window
 			 */
 			Io_mem_session_component(Rm_root * const rm_root,
 			                         addr_t const base,
 			                         size_t const size,
-			                         Emulation::Session * const emulation)
+			                         Emulation::Session * const emulation,
+			                         Emulation_dispatcher * const dispatcher,
+			                         bool const data_window)
 			:
 				_rm(rm_root, 0, size),
-				_fault_handler(&_rm, &_fault_recvr, emulation, base)
+				_fault_handler(&_rm, emulation, base),
+				_dispatcher(dispatcher)
 			{
-				/* set fault handler and start handling */
-				_rm.fault_handler(_fault_recvr.manage(&_fault));
-				_fault_handler.start();
+				if (data_window && _init_window(base, size, emulation)) return;
+
+				/* let core decode faults and the shared dispatcher handle them */
+				_rm.decode_faults(1);
+				_rm.fault_handler(_dispatcher->manage(&_fault_handler));
+			}
+
+			/**
+			 * Destructor
+			 */
+			~Io_mem_session_component()
+			{
+				if (!_window.valid()) {
+					_dispatcher->dissolve(&_fault_handler);
+					return;
+				}
+				_rm.detach(0);
+				env()->ram_session()->free(_window);
 			}
 
 			/**
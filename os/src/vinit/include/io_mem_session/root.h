@@ -35,6 +35,7 @@ namespace Init
 	class Io_mem_root : public Root_component<Io_mem_session_component>
 	{
 		Rm_root * const _rm_root;
+		Emulation_dispatcher * const _dispatcher;
 
 		/**
 		 * Create a new session for the requested MMIO
@@ -49,10 +50,13 @@ namespace Init
 			Emulation::Session * const emu_session = (Emulation::Session *)
 				Arg_string::find_arg(args, emulation_key()).ulong_value(0);
 			assert(emu_session);
+			bool const data_window =
+				Arg_string::find_arg(args, "data_window").long_value(0);
 
 			/* create session */
 			return new (md_alloc())
-				Io_mem_session_component(_rm_root, base, size, emu_session);
+				Io_mem_session_component(_rm_root, base, size, emu_session,
+				                         _dispatcher, data_window);
 		}
 
 		public:
@@ -60,15 +64,18 @@ namespace Init
 			/**
 			 * Constructor
 			 *
-			 * \param ep        Entrypoint for the root component
-			 * \param md_alloc  Meta-data allocator for the root component
+			 * \param ep          Entrypoint for the root component
+			 * \param md_alloc    Meta-data allocator for the root component
+			 * \param rm_root     Local RM service that backs the IO_MEM
+			 * \param dispatcher  Handles the faults of all sessions
 			 */
 			Io_mem_root(Rpc_entrypoint * const ep,
 			            Allocator * const md,
-			            Rm_root * const rm_root)
+			            Rm_root * const rm_root,
+			            Emulation_dispatcher * const dispatcher)
 			:
 				Root_component<Io_mem_session_component>(ep, md),
-				_rm_root(rm_root)
+				_rm_root(rm_root), _dispatcher(dispatcher)
 			{ }
 	};
 }
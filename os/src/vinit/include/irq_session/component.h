@@ -22,12 +22,19 @@
 #include <irq_session/capability.h>
 #include <util/list.h>
 
+/* local includes */
+#include <emulation_dispatcher.h>
+
 namespace Init
 {
 	using namespace Genode;
 
 	/**
 	 * Session component of an emulated IRQ service
+	 *
+	 * All sessions share one entrypoint. A client that waits for its
+	 * IRQ doesn't block the entrypoint but is answered out of order as
+	 * soon as the emulator signals an edge of the IRQ.
 	 */
 	class Irq_session_component : public Rpc_object<Irq_session>,
 	                              public List<Irq_session_component>::Element
@@ -36,8 +43,8 @@ namespace Init
 
 			struct Irq_control
 			{
-				GENODE_RPC(Rpc_associate_to_irq, void, associate_to_irq, unsigned);
-				GENODE_RPC_INTERFACE(Rpc_associate_to_irq);
+				GENODE_RPC(Rpc_deliver_edge, void, deliver_edge);
+				GENODE_RPC_INTERFACE(Rpc_deliver_edge);
 			};
 
 			struct Irq_control_client : Rpc_client<Irq_control>
@@ -45,20 +52,38 @@ namespace Init
 					Irq_control_client(Capability<Irq_control> cap)
 					: Rpc_client<Irq_control>(cap) { }
 
-					void associate_to_irq(unsigned irq)
-					{ call<Rpc_associate_to_irq>(irq); }
+					void deliver_edge() { call<Rpc_deliver_edge>(); }
 			};
 
 			struct Irq_control_component : Rpc_object<Irq_control,
 			                                          Irq_control_component>
 			{
-				void associate_to_irq(unsigned irq) { };
+				Irq_session_component * const _session;
+
+				Irq_control_component(Irq_session_component * const s)
+				: _session(s) { }
+
+				void deliver_edge() { _session->_deliver_edge(); }
 			};
 
-			unsigned _irq;
+			/**
+			 * Receives the IRQ edges that are signalled by the emulator
+			 *
+			 * This gets called by a dispatcher worker, thus it forwards
+			 * the edge to the entrypoint that holds the reply capability.
+			 */
+			struct Irq_edge : Dispatch_context
+			{
+				Irq_control_client _control;
+
+				Irq_edge(Capability<Irq_control> cap) : _control(cap) { }
+
+				void dispatch() { _control.deliver_edge(); }
+			};
 
-			enum { STACK_SIZE = 2048 };
-			Rpc_entrypoint _ep;
+			unsigned _irq;
+			Rpc_entrypoint * const _ep;
+			Emulation_dispatcher * const _dispatcher;
 
 
 			/********************************************
@@ -67,28 +92,44 @@ namespace Init
 
 			Irq_control_component     _control_component;  /* ctrl component */
 			Capability<Irq_control>   _control_cap;        /* capability for ctrl server */
-			Irq_control_client        _control_client;     /* ctrl client */
 			Capability<Irq_session>   _irq_cap;            /* capability for IRQ */
 			Emulation::Session *      _emulation;
-			Signal_receiver           _irq_receiver;
-			Signal_context            _irq_edge;
+			Irq_edge                  _irq_edge;
 			Signal_context_capability _irq_edge_cap;
+			Untyped_capability        _reply_cap;          /* waiting client */
+
+			/**
+			 * Unblock a waiting client, called by the entrypoint
+			 */
+			void _deliver_edge()
+			{
+				/* ignore edges that nobody waits for */
+				if (!_reply_cap.valid()) return;
+
+				/* stop listening to the IRQ state of the emulator */
+				_emulation->irq_handler(_irq, Signal_context_capability());
+				_ep->explicit_reply(_reply_cap, 0);
+				_reply_cap = Untyped_capability();
+			}
 
 		public:
 
 			/**
 			 * Constructor
 			 *
-			 * \param cap_session  capability session to use
-			 * \param args         session construction arguments
+			 * \param ep          entrypoint that serves all IRQ sessions
+			 * \param dispatcher  receives the IRQ edges of all sessions
+			 * \param args        session construction arguments
 			 */
-			Irq_session_component(Cap_session * cap_session,
-			                      const char  * args)
+			Irq_session_component(Rpc_entrypoint * const       ep,
+			                      Emulation_dispatcher * const dispatcher,
+			                      const char  *                args)
 			:
-				_ep(cap_session, STACK_SIZE, "irqctrl"),
-				_control_cap(_ep.manage(&_control_component)),
-				_control_client(_control_cap),
-				_irq_edge_cap(_irq_receiver.manage(&_irq_edge))
+				_ep(ep), _dispatcher(dispatcher),
+				_control_component(this),
+				_control_cap(_ep->manage(&_control_component)),
+				_irq_edge(_control_cap),
+				_irq_edge_cap(_dispatcher->manage(&_irq_edge))
 			{
 				/* fetch and validate session attributes */
 				bool shared = Arg_string::find_arg(args, "irq_shared").bool_value(false);
@@ -97,15 +138,14 @@ namespace Init
 					Arg_string::find_arg(args, emulation_key()).long_value(0);
 				if (!_emulation || shared || !irq_number.valid()) {
 					PERR("%s:%d: Invalid arguments", __FILE__, __LINE__);
+					_dispatcher->dissolve(&_irq_edge);
+					_ep->dissolve(&_control_component);
 					throw Root::Invalid_args();
 				}
 				_irq = irq_number.long_value(0);
 
-				/* configure control client */
-				_control_client.associate_to_irq(_irq);
-
 				/* create IRQ capability */
-				_irq_cap = Irq_session_capability(_ep.manage(this));
+				_irq_cap = Irq_session_capability(_ep->manage(this));
 			}
 
 			/**
@@ -113,8 +153,9 @@ namespace Init
 			 */
 			~Irq_session_component()
 			{
-				PERR("%s:%d: Not implemented", __FILE__, __LINE__);
-				while (1) ;
+				_ep->dissolve(this);
+				_dispatcher->dissolve(&_irq_edge);
+				_ep->dissolve(&_control_component);
 			}
 
 			/**
@@ -133,10 +174,16 @@ namespace Init
 			{
 				/* start listening to the IRQ state of the emulator */
 				bool irq_state = _emulation->irq_handler(_irq, _irq_edge_cap);
-				if (!irq_state) _irq_receiver.wait_for_signal();
-
-				/* stop listening to the IRQ state of the emulator */
-				_emulation->irq_handler(_irq, Signal_context_capability());
+				if (irq_state) {
+					_emulation->irq_handler(_irq, Signal_context_capability());
+					return;
+				}
+				/*
+				 * Keep the client blocked until the emulator signals an
+				 * edge, meanwhile the entrypoint serves other sessions.
+				 */
+				_reply_cap = _ep->reply_dst();
+				_ep->omit_reply();
 			}
 	};
 }
@@ -36,7 +36,10 @@ namespace Init
 	{
 		private:
 
-			Cap_session * const _cap_session;
+			enum { STACK_SIZE = 8*1024 };
+
+			Rpc_entrypoint _ep; /* serves all IRQ sessions */
+			Emulation_dispatcher * const _dispatcher;
 			Allocator * const _md_alloc; /* meta-data allocator */
 			List<Irq_session_component> _sessions; /* started IRQ sessions */
 
@@ -46,12 +49,15 @@ namespace Init
 			 * Constructor
 			 *
 			 * \param cap_session  capability allocator
-			 * \param irq_alloc    IRQ range that can be assigned to clients
+			 * \param dispatcher   receives the IRQ edges of all sessions
 			 * \param md_alloc     meta-data allocator to be used by root component
 			 */
 			Irq_root(Cap_session * const cap_session,
+			         Emulation_dispatcher * const dispatcher,
 			         Allocator * const md_alloc)
-			: _cap_session(cap_session), _md_alloc(md_alloc) { }
+			:
+				_ep(cap_session, STACK_SIZE, "irq_ep"),
+				_dispatcher(dispatcher), _md_alloc(md_alloc) { }
 
 
 			/********************
@@ -80,7 +86,8 @@ namespace Init
 				/* create session component */
 				Irq_session_component *s;
 				try {
-					s = new (_md_alloc) Irq_session_component(_cap_session, args.string());
+					s = new (_md_alloc) Irq_session_component(&_ep, _dispatcher,
+					                                          args.string());
 				} catch (Allocator::Out_of_memory) { return Session_capability(); }
 
 				/* return session capability */
@@ -105,8 +112,6 @@ namespace Init
 				if (!s) return;
 
 				_sessions.remove(s);
-
-				/* XXX Currently we support only one client... */
 				destroy(_md_alloc, s);
 			}
 	};
@@ -17,11 +17,11 @@
 /* Genode includes */
 #include <base/env.h>
 #include <base/allocator_guard.h>
+#include <base/instruction.h>
 
 /* local includes */
 #include <cpu_client.h>
 #include <util/indexed.h>
-#include <instruction.h>
 #include <spy_session_args.h>
 
 namespace Init
@@ -219,6 +219,9 @@ namespace Init
 				if (state.type != Rm_session::READ_FAULT &&
 				    state.type != Rm_session::WRITE_FAULT) return state;
 
+				/* core might have decoded the instruction already */
+				if (state.decoded) return state;
+
 				/* get related RM client through the RM-state imprint */
 				Rm_client * const rm_client = Rm_client::by_id(state.imprint);
 
@@ -267,6 +270,11 @@ namespace Init
 
 			void processed(State state)
 			{
+				/* core continues the faulter itself if it decoded the fault */
+				if (state.decoded) {
+					_backend.processed(state);
+					return;
+				}
 				/* get affected RM client and its state via state imprint */
 				Rm_client * const rm_client = Rm_client::by_id(state.imprint);
 				Rm_client::State * const client_state = rm_client->state();
@@ -327,6 +335,9 @@ namespace Init
 			void fault_handler(Signal_context_capability handler) {
 				_backend.fault_handler(handler); }
 
+			bool decode_faults(bool const enable) {
+				return _backend.decode_faults(enable); }
+
 			Dataspace_capability dataspace()
 			{
 				/* get managed dataspace from parent */
@@ -28,6 +28,7 @@
 #include <irq_session/root.h>
 #include <cpu_session/connection.h>
 #include <rm_session/connection.h>
+#include <emulation_dispatcher.h>
 
 namespace Init
 {
@@ -47,6 +48,7 @@ namespace Init
 		addr_t const _base;
 		addr_t const _end;
 		addr_t const _local;
+		bool const _data_window; /* backed by shared memory, no faults */
 		Emulation_context * const _emu_context;
 
 		public:
@@ -57,11 +59,11 @@ namespace Init
 			 * For parameter description see same-named members.
 			 */
 			Emulated_region(addr_t const base, size_t const size,
-			                addr_t const local,
+			                addr_t const local, bool const data_window,
 			                Emulation_context * const emu_context)
 			:
 				_base(base), _end(base + size), _local(local),
-				_emu_context(emu_context)
+				_data_window(data_window), _emu_context(emu_context)
 			{ }
 
 			/**
@@ -89,6 +91,7 @@ namespace Init
 			addr_t base() const { return _base; }
 			addr_t end() const { return _end; }
 			addr_t local() const { return _local; }
+			bool data_window() const { return _data_window; }
 			Emulation_context * emu_context() const { return _emu_context; }
 
 			/**************
@@ -283,9 +286,19 @@ namespace Init
 						resource.attribute("base").value(&base);
 						resource.attribute("size").value(&size);
 						resource.attribute("local").value(&local);
+
+						/* IO_MEM may be a data window instead of registers */
+						bool data_window = 0;
+						try {
+							data_window = resource.attribute("type")
+							              .has_value("data_window");
+						} catch (...) { }
+						assert(!data_window || regions == emulated_io_mem());
+
 						Emulated_region * region;
 						region = new (_md_alloc)
-							Emulated_region(base, size, local, this);
+							Emulated_region(base, size, local, data_window,
+							                this);
 						regions->insert(region);
 					} catch (...) { assert(0); }
 
@@ -422,10 +435,26 @@ namespace Init
 		snprintf(value, sizeof(value), "0x%p", emu_session);
 		Arg_string::set_arg(args, args_len, emulation_key(), value);
 		Arg_string::set_arg(args, args_len, local_key, region->local());
+		if (region->data_window())
+			Arg_string::set_arg(args, args_len, "data_window", 1);
 	}
 	/* vinit end */
 
 
+	/**
+	 * Read the number of threads that process emulation events
+	 */
+	inline unsigned read_emulation_workers()
+	{
+		enum { DEFAULT_EMULATION_WORKERS = 2 };
+		unsigned workers = DEFAULT_EMULATION_WORKERS;
+		try {
+			config()->xml_node().attribute("emulation_workers").value(&workers); }
+		catch (...) { }
+		return workers;
+	}
+
+
 	/**
 	 * Read priority-levels declaration from config file
 	 */
@@ -548,6 +577,7 @@ int main(int, char **)
 	static Rpc_entrypoint   io_mem_ep(&cap, ENTRYPOINT_STACK_SIZE, "io_mem_entrypoint");
 	static Service_registry spy_services;
 	static Service_registry emulated_services;
+	static Emulation_dispatcher dispatcher(read_emulation_workers());
 	/* vinit end */
 
 	static Service_registry parent_services;
@@ -563,11 +593,11 @@ int main(int, char **)
 	static Local_service rm(Rm_session::service_name(), &rm_root);
 	spy_services.insert(&rm);
 
-	static Io_mem_root io_mem_root(&io_mem_ep, &heap, &rm_root);
+	static Io_mem_root io_mem_root(&io_mem_ep, &heap, &rm_root, &dispatcher);
 	static Local_service io_mem(Io_mem_session::service_name(), &io_mem_root);
 	emulated_services.insert(&io_mem);
 
-	static Irq_root irq_root(&cap, &heap);
+	static Irq_root irq_root(&cap, &dispatcher, &heap);
 	static Local_service irq(Irq_session::service_name(), &irq_root);
 	emulated_services.insert(&irq);
 	/* vinit end */